@@ -710,24 +710,16 @@ static void Png_EncodeRow(const cc_uint8* cur, const cc_uint8* prior, cc_uint8*
 
 static BitmapCol* DefaultGetRow(struct Bitmap* bmp, int y, void* ctx) { return Bitmap_GetRow(bmp, y); }
 static cc_result Png_EncodeCore(struct Bitmap* bmp, struct Stream* stream, cc_uint8* buffer,
-					Png_RowGetter getRow, cc_bool alpha, void* ctx) {
+					struct ZLibState* zlState, Png_RowGetter getRow, cc_bool alpha, void* ctx) {
 	cc_uint8 tmp[32];
 	cc_uint8* prevLine = buffer;
 	cc_uint8*  curLine = buffer + (bmp->width * 4) * 1;
 	cc_uint8* bestLine = buffer + (bmp->width * 4) * 2;
-
-#if CC_BUILD_MAXSTACK <= (64 * 1024)
-	struct ZLibState* zlState = (struct ZLibState*)Mem_TryAlloc(1, sizeof(struct ZLibState));
-#else
-	struct ZLibState _zlState;
-	struct ZLibState* zlState = &_zlState;
-#endif
 	struct Stream chunk, zlStream;
 	cc_uint32 stream_end, stream_beg;
 	int y, lineSize;
 	cc_result res;
 
-	if (!zlState) return ERR_OUT_OF_MEMORY;
 	/* stream may not start at 0 (e.g. when making default.zip) */
 	if ((res = stream->Position(stream, &stream_beg))) return res;
 
@@ -790,12 +782,18 @@ static cc_result Png_EncodeCore(struct Bitmap* bmp, struct Stream* stream, cc_ui
 
 cc_result Png_Encode(struct Bitmap* bmp, struct Stream* stream, 
 					Png_RowGetter getRow, cc_bool alpha, void* ctx) {
+	struct ZLibState* zlState;
 	cc_result res;
 	/* Add 1 for scanline filter type byter */
 	cc_uint8* buffer = (cc_uint8*)Mem_TryAlloc(3, bmp->width * 4 + 1);
 	if (!buffer) return ERR_NOT_SUPPORTED;
 
-	res = Png_EncodeCore(bmp, stream, buffer, getRow, alpha, ctx);
+	/* ZLibState is too large to safely allocate on the stack */
+	zlState = (struct ZLibState*)Mem_TryAlloc(1, sizeof(struct ZLibState));
+	if (!zlState) { Mem_Free(buffer); return ERR_OUT_OF_MEMORY; }
+
+	res = Png_EncodeCore(bmp, stream, buffer, zlState, getRow, alpha, ctx);
+	Mem_Free(zlState);
 	Mem_Free(buffer);
 	return res;
 }
@@ -92,6 +92,13 @@ static RNGState physics_rnd;
 static int physics_tickCount;
 static int physics_maxWaterX, physics_maxWaterY, physics_maxWaterZ;
 static struct TickQueue lavaQ, waterQ;
+/* Number of blocks with a random tick handler in each chunk */
+static cc_uint16* physics_tickCounts;
+/* Indices of chunks with at least one block with a random tick handler */
+static int* physics_activeChunks;
+/* Index of each chunk in physics_activeChunks, or -1 if chunk has no blocks with a random tick handler */
+static int* physics_activePos;
+static int physics_activeCount, physics_chunksCount;
 
 #define PHYSICS_DELAY_MASK 0xF8000000UL
 #define PHYSICS_POS_MASK   0x07FFFFFFUL
@@ -100,15 +107,108 @@ static struct TickQueue lavaQ, waterQ;
 #define PHYSICS_LAVA_DELAY (30U << PHYSICS_DELAY_SHIFT)
 #define PHYSICS_WATER_DELAY (5U << PHYSICS_DELAY_SHIFT)
 
+/*########################################################################################################################*
+*---------------------------------------------------Random tick chunks----------------------------------------------------*
+*#########################################################################################################################*/
+#define Physics_ChunkIndex(x, y, z) World_ChunkPack((x) >> CHUNK_SHIFT, (y) >> CHUNK_SHIFT, (z) >> CHUNK_SHIFT)
+
+static void Physics_FreeTickCounts(void) {
+	Mem_Free(physics_tickCounts);
+	Mem_Free(physics_activeChunks);
+	Mem_Free(physics_activePos);
+
+	physics_tickCounts   = NULL;
+	physics_activeChunks = NULL;
+	physics_activePos    = NULL;
+	physics_activeCount  = 0;
+	physics_chunksCount  = 0;
+}
+
+static void Physics_ActivateChunk(int chunk) {
+	physics_activePos[chunk] = physics_activeCount;
+	physics_activeChunks[physics_activeCount++] = chunk;
+}
+
+static void Physics_DeactivateChunk(int chunk) {
+	int pos  = physics_activePos[chunk];
+	int last = physics_activeChunks[--physics_activeCount];
+
+	/* Swap last active chunk into the removed chunk's slot */
+	physics_activeChunks[pos] = last;
+	physics_activePos[last]   = pos;
+	physics_activePos[chunk]  = -1;
+}
+
+/* Counts blocks with a random tick handler in every chunk of the world */
+static void Physics_CountRandomTicks(void) {
+	cc_bool tickable[256];
+	int x, y, z, index, chunk, i;
+	Physics_FreeTickCounts();
+	if (!World.Blocks) return;
+
+	for (i = 0; i < 256; i++) { tickable[i] = Physics.OnRandomTick[i] != NULL; }
+	physics_chunksCount  = World.ChunksCount;
+	physics_tickCounts   = (cc_uint16*)Mem_AllocCleared(physics_chunksCount, sizeof(cc_uint16), "physics tick counts");
+	physics_activeChunks = (int*)Mem_Alloc(physics_chunksCount, sizeof(int), "physics active chunks");
+	physics_activePos    = (int*)Mem_Alloc(physics_chunksCount, sizeof(int), "physics active positions");
+
+	for (y = 0; y < World.Height; y++) {
+		for (z = 0; z < World.Length; z++) {
+			index = World_Pack(0, y, z);
+
+			for (x = 0; x < World.Width; x++, index++) {
+				if (!tickable[World_GetLowerBlock(index)]) continue;
+				physics_tickCounts[Physics_ChunkIndex(x, y, z)]++;
+			}
+		}
+	}
+
+	for (chunk = 0; chunk < physics_chunksCount; chunk++) {
+		physics_activePos[chunk] = -1;
+		if (physics_tickCounts[chunk]) Physics_ActivateChunk(chunk);
+	}
+}
+
+/* Updates random tick counts of the chunk containing the given block after it changed */
+static void Physics_UpdateTickCount(int x, int y, int z, BlockID old, BlockID now) {
+	cc_bool didTick = Physics.OnRandomTick[(BlockRaw)old] != NULL;
+	cc_bool nowTick = Physics.OnRandomTick[(BlockRaw)now] != NULL;
+	int chunk;
+	if (didTick == nowTick || !physics_tickCounts) return;
+
+	chunk = Physics_ChunkIndex(x, y, z);
+	if (nowTick) {
+		if (physics_tickCounts[chunk]++ == 0) Physics_ActivateChunk(chunk);
+	} else if (physics_tickCounts[chunk]) {
+		if (--physics_tickCounts[chunk] == 0) Physics_DeactivateChunk(chunk);
+	}
+}
+
+/* Changes a block in the world, keeping random tick counts up to date */
+static void Physics_UpdateBlock(int x, int y, int z, BlockID block) {
+	Physics_UpdateTickCount(x, y, z, World_GetBlock(x, y, z), block);
+	Game_UpdateBlock(x, y, z, block);
+}
+
+
 static void Physics_OnNewMapLoaded(void* obj) {
 	TickQueue_Clear(&lavaQ);
 	TickQueue_Clear(&waterQ);
+	if (Physics.Enabled) {
+		Physics_CountRandomTicks();
+	} else {
+		Physics_FreeTickCounts();
+	}
 
 	physics_maxWaterX = World.MaxX - 2;
 	physics_maxWaterY = World.MaxY - 2;
 	physics_maxWaterZ = World.MaxZ - 2;
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+	Tree_Blocks = NULL;
+#else
 	Tree_Blocks = World.Blocks;
+#endif
 	Random_SeedFromCurrentTime(&physics_rnd);
 	Tree_Rnd = &physics_rnd;
 }
@@ -119,7 +219,7 @@ void Physics_SetEnabled(cc_bool enabled) {
 }
 
 static void Physics_Activate(int index) {
-	BlockID block = World.Blocks[index];
+	BlockID block = World_GetLowerBlock(index);
 	PhysicsHandler activate = Physics.OnActivate[block];
 	if (activate) activate(index, block);
 }
@@ -145,10 +245,11 @@ void Physics_OnBlockChanged(int x, int y, int z, BlockID old, BlockID now) {
 	PhysicsHandler handler;
 	int index;
 	if (!Physics.Enabled) return;
+	Physics_UpdateTickCount(x, y, z, old, now);
 
 	if (now == BLOCK_AIR && Physics_IsEdgeWater(x, y, z)) {
 		now = BLOCK_STILL_WATER;
-		Game_UpdateBlock(x, y, z, BLOCK_STILL_WATER);
+		Physics_UpdateBlock(x, y, z, BLOCK_STILL_WATER);
 	}
 	index = World_Pack(x, y, z);
 
@@ -163,39 +264,53 @@ void Physics_OnBlockChanged(int x, int y, int z, BlockID old, BlockID now) {
 	Physics_ActivateNeighbours(x, y, z, index);
 }
 
-static void Physics_TickRandomBlocks(void) {
-	int lo, hi, index;
+/* Randomly ticks a block within the given chunk bounds */
+static void Physics_TickRandomBlock(int x, int y, int z, int width, int height, int length) {
+	int index, offset;
 	BlockID block;
 	PhysicsHandler tick;
-	int x, y, z, x2, y2, z2;
-
-	for (y = 0; y < World.Height; y += CHUNK_SIZE) {
-		y2 = min(y + CHUNK_MAX, World.MaxY);
-		for (z = 0; z < World.Length; z += CHUNK_SIZE) {
-			z2 = min(z + CHUNK_MAX, World.MaxZ);
-			for (x = 0; x < World.Width; x += CHUNK_SIZE) {
-				x2 = min(x + CHUNK_MAX, World.MaxX);
-
-				/* Inlined 3 random ticks for this chunk */
-				lo = World_Pack( x,  y,  z);
-				hi = World_Pack(x2, y2, z2);
-				
-				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
-
-				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
-
-				index = Random_Range(&physics_rnd, lo, hi);
-				block = World.Blocks[index];
-				tick = Physics.OnRandomTick[block];
-				if (tick) tick(index, block);
-			}
-		}
+
+	if (width == CHUNK_SIZE && height == CHUNK_SIZE && length == CHUNK_SIZE) {
+		/* Common case of a full chunk, so only one random number is needed */
+		offset = Random_Next(&physics_rnd, CHUNK_SIZE_3);
+		x += offset & CHUNK_MASK;
+		z += (offset >> CHUNK_SHIFT) & CHUNK_MASK;
+		y += offset >> (CHUNK_SHIFT * 2);
+	} else {
+		x += Random_Next(&physics_rnd, width);
+		y += Random_Next(&physics_rnd, height);
+		z += Random_Next(&physics_rnd, length);
+	}
+
+	index = World_Pack(x, y, z);
+	block = World_GetLowerBlock(index);
+	tick  = Physics.OnRandomTick[block];
+	if (tick) tick(index, block);
+}
+
+static void Physics_TickRandomBlocks(void) {
+	int i, chunk, x, y, z, width, height, length;
+	/* Counts are only recalculated once the new map has finished loading */
+	if (physics_chunksCount != World.ChunksCount) return;
+
+	/* Only chunks with blocks that can actually be randomly ticked are visited */
+	/* NOTE: Iterated backwards, as ticking a block may add or remove active chunks */
+	for (i = physics_activeCount - 1; i >= 0; i--) {
+		if (i >= physics_activeCount) continue;
+		chunk = physics_activeChunks[i];
+
+		x = (chunk % World.ChunksX) << CHUNK_SHIFT;
+		y = ((chunk / World.ChunksX) % World.ChunksY) << CHUNK_SHIFT;
+		z = ((chunk / World.ChunksX) / World.ChunksY) << CHUNK_SHIFT;
+
+		width  = min(CHUNK_SIZE, World.Width  - x);
+		height = min(CHUNK_SIZE, World.Height - y);
+		length = min(CHUNK_SIZE, World.Length - z);
+
+		/* 3 random ticks for this chunk */
+		Physics_TickRandomBlock(x, y, z, width, height, length);
+		Physics_TickRandomBlock(x, y, z, width, height, length);
+		Physics_TickRandomBlock(x, y, z, width, height, length);
 	}
 }
 
@@ -208,7 +323,7 @@ static void Physics_DoFalling(int index, BlockID block) {
 	/* Find lowest block can fall into */
 	while (index >= World.OneY) {
 		index -= World.OneY;
-		other  = World.Blocks[index];
+		other  = World_GetLowerBlock(index);
 
 		if (other == BLOCK_AIR || (other >= BLOCK_WATER && other <= BLOCK_STILL_LAVA))
 			found = index;
@@ -218,10 +333,10 @@ static void Physics_DoFalling(int index, BlockID block) {
 
 	if (found == -1) return;
 	World_Unpack(found, x, y, z);
-	Game_UpdateBlock(x, y, z, block);
+	Physics_UpdateBlock(x, y, z, block);
 
 	World_Unpack(start, x, y, z);
-	Game_UpdateBlock(x, y, z, BLOCK_AIR);
+	Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 	Physics_ActivateNeighbours(x, y, z, start);
 }
 
@@ -248,12 +363,12 @@ static void Physics_HandleSapling(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 
 	below = BLOCK_AIR;
-	if (y > 0) below = World.Blocks[index - World.OneY];
+	if (y > 0) below = World_GetLowerBlock(index - World.OneY);
 	/* Saplings stay alive on dirt */
 	if (below == BLOCK_DIRT) return;
 
 	/* Saplings grow if on grass in light, otherwise turn to air */
-	Game_UpdateBlock(x, y, z, BLOCK_AIR);
+	Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 	if (below != BLOCK_GRASS || !Lighting.IsLit(x, y, z)) return;
 
 	height = 5 + Random_Next(&physics_rnd, 3);
@@ -263,7 +378,7 @@ static void Physics_HandleSapling(int index, BlockID block) {
 
 		for (i = 0; i < count; i++) 
 		{
-			Game_UpdateBlock(coords[i].x, coords[i].y, coords[i].z, blocks[i]);
+			Physics_UpdateBlock(coords[i].x, coords[i].y, coords[i].z, blocks[i]);
 		}
 	}
 }
@@ -273,7 +388,7 @@ static void Physics_HandleDirt(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 
 	if (Lighting.IsLit(x, y, z)) {
-		Game_UpdateBlock(x, y, z, BLOCK_GRASS);
+		Physics_UpdateBlock(x, y, z, BLOCK_GRASS);
 	}
 }
 
@@ -282,7 +397,7 @@ static void Physics_HandleGrass(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 
 	if (!Lighting.IsLit(x, y, z)) {
-		Game_UpdateBlock(x, y, z, BLOCK_DIRT);
+		Physics_UpdateBlock(x, y, z, BLOCK_DIRT);
 	}
 }
 
@@ -292,15 +407,15 @@ static void Physics_HandleFlower(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 
 	if (!Lighting.IsLit(x, y, z)) {
-		Game_UpdateBlock(x, y, z, BLOCK_AIR);
+		Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 		Physics_ActivateNeighbours(x, y, z, index);
 		return;
 	}
 
 	below = BLOCK_DIRT;
-	if (y > 0) below = World.Blocks[index - World.OneY];
+	if (y > 0) below = World_GetLowerBlock(index - World.OneY);
 	if (!(below == BLOCK_DIRT || below == BLOCK_GRASS)) {
-		Game_UpdateBlock(x, y, z, BLOCK_AIR);
+		Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 		Physics_ActivateNeighbours(x, y, z, index);
 	}
 }
@@ -311,15 +426,15 @@ static void Physics_HandleMushroom(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 
 	if (Lighting.IsLit(x, y, z)) {
-		Game_UpdateBlock(x, y, z, BLOCK_AIR);
+		Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 		Physics_ActivateNeighbours(x, y, z, index);
 		return;
 	}
 
 	below = BLOCK_STONE;
-	if (y > 0) below = World.Blocks[index - World.OneY];
+	if (y > 0) below = World_GetLowerBlock(index - World.OneY);
 	if (!(below == BLOCK_STONE || below == BLOCK_COBBLE)) {
-		Game_UpdateBlock(x, y, z, BLOCK_AIR);
+		Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 		Physics_ActivateNeighbours(x, y, z, index);
 	}
 }
@@ -330,16 +445,16 @@ static void Physics_PlaceLava(int index, BlockID block) {
 }
 
 static void Physics_PropagateLava(int posIndex, int x, int y, int z) {
-	BlockID block = World.Blocks[posIndex];
+	BlockID block = World_GetLowerBlock(posIndex);
 
 	if (block >= BLOCK_WATER && block <= BLOCK_STILL_LAVA) {
 		/* Lava spreading into water turns the water solid */
 		if (block == BLOCK_WATER || block == BLOCK_STILL_WATER) {
-			Game_UpdateBlock(x, y, z, BLOCK_STONE);
+			Physics_UpdateBlock(x, y, z, BLOCK_STONE);
 		}
 	} else if (Blocks.Draw[block] == DRAW_GAS) {
 		TickQueue_Enqueue(&lavaQ, PHYSICS_LAVA_DELAY | posIndex);
-		Game_UpdateBlock(x, y, z, BLOCK_LAVA);
+		Physics_UpdateBlock(x, y, z, BLOCK_LAVA);
 	}
 }
 
@@ -359,7 +474,7 @@ static void Physics_TickLava(void) {
 	for (i = 0; i < count; i++) {
 		int index;
 		if (Physics_CheckItem(&lavaQ, &index)) {
-			BlockID block = World.Blocks[index];
+			BlockID block = World_GetLowerBlock(index);
 			if (!(block == BLOCK_LAVA || block == BLOCK_STILL_LAVA)) continue;
 			Physics_ActivateLava(index, block);
 		}
@@ -371,48 +486,238 @@ static void Physics_PlaceWater(int index, BlockID block) {
 	TickQueue_Enqueue(&waterQ, PHYSICS_WATER_DELAY | index);
 }
 
-static void Physics_PropagateWater(int posIndex, int x, int y, int z) {
-	BlockID block = World.Blocks[posIndex];
-	int xx, yy, zz;
+/* Whether there is a sponge anywhere in the given area of the world */
+static cc_bool Physics_HasSponge(int minX, int minY, int minZ, int maxX, int maxY, int maxZ) {
+	int x, y, z, index;
+	minX = max(minX, 0); maxX = min(maxX, World.MaxX);
+	minY = max(minY, 0); maxY = min(maxY, World.MaxY);
+	minZ = max(minZ, 0); maxZ = min(maxZ, World.MaxZ);
+
+	for (y = minY; y <= maxY; y++) {
+		for (z = minZ; z <= maxZ; z++) {
+			index = World_Pack(minX, y, z);
+
+			for (x = minX; x <= maxX; x++, index++) {
+				if (World_GetLowerBlock(index) == BLOCK_SPONGE) return true;
+			}
+		}
+	}
+	return false;
+}
+#define Physics_IsNearSponge(x, y, z) Physics_HasSponge(x - 2, y - 2, z - 2, x + 2, y + 2, z + 2)
+
+#define WATER_DIR_XMIN 0x01
+#define WATER_DIR_XMAX 0x02
+#define WATER_DIR_ZMIN 0x04
+#define WATER_DIR_ZMAX 0x08
+#define WATER_DIR_YMIN 0x10
+
+/* Number of recently checked blocks that a liquid worker remembers whether are near a sponge */
+#define SPONGE_CACHE_SIZE 16384
+/* Remembers whether blocks are near a sponge during a water tick */
+/* NOTE: Results are only valid for the tick they were calculated in */
+struct SpongeCache {
+	int indices[SPONGE_CACHE_SIZE];
+	cc_uint8 nearSponge[SPONGE_CACHE_SIZE];
+};
+
+/* Whether water can't spread into the given block due to a nearby sponge */
+/* NOTE: Only blocks water could actually spread into are checked, as checking for sponges is slow */
+static cc_bool Physics_IsSpongeBlocked(struct SpongeCache* cache, int index, int x, int y, int z) {
+	int slot;
+	if (Blocks.Draw[World_GetLowerBlock(index)] != DRAW_GAS) return false;
+	if (!cache) return Physics_IsNearSponge(x, y, z);
+
+	slot = index & (SPONGE_CACHE_SIZE - 1);
+	if (cache->indices[slot] != index) {
+		cache->indices[slot]    = index;
+		cache->nearSponge[slot] = Physics_IsNearSponge(x, y, z);
+	}
+	return cache->nearSponge[slot];
+}
+
+/* Returns bit flags of which neighbours water at the given coordinates can't spread into due to a nearby sponge */
+/* NOTE: Only reads from the world, so can be safely called from multiple threads at once (with different caches) */
+static int Physics_CalcSpongeMask(struct SpongeCache* cache, int index, int x, int y, int z) {
+	int mask = 0;
+	if (x > 0          && Physics_IsSpongeBlocked(cache, index - 1,           x - 1, y,     z))     mask |= WATER_DIR_XMIN;
+	if (x < World.MaxX && Physics_IsSpongeBlocked(cache, index + 1,           x + 1, y,     z))     mask |= WATER_DIR_XMAX;
+	if (z > 0          && Physics_IsSpongeBlocked(cache, index - World.Width, x,     y,     z - 1)) mask |= WATER_DIR_ZMIN;
+	if (z < World.MaxZ && Physics_IsSpongeBlocked(cache, index + World.Width, x,     y,     z + 1)) mask |= WATER_DIR_ZMAX;
+	if (y > 0          && Physics_IsSpongeBlocked(cache, index - World.OneY,  x,     y - 1, z))     mask |= WATER_DIR_YMIN;
+	return mask;
+}
+
+static void Physics_PropagateWater(int posIndex, int x, int y, int z, cc_bool nearSponge) {
+	BlockID block = World_GetLowerBlock(posIndex);
 
 	if (block >= BLOCK_WATER && block <= BLOCK_STILL_LAVA) {
 		/* Water spreading into lava turns the lava solid */
 		if (block == BLOCK_LAVA || block == BLOCK_STILL_LAVA) {
-			Game_UpdateBlock(x, y, z, BLOCK_STONE);
+			Physics_UpdateBlock(x, y, z, BLOCK_STONE);
 		}
 	} else if (Blocks.Draw[block] == DRAW_GAS) {
-		/* Sponge check */		
-		for (yy = (y < 2 ? 0 : y - 2); yy <= (y > physics_maxWaterY ? World.MaxY : y + 2); yy++) {
-			for (zz = (z < 2 ? 0 : z - 2); zz <= (z > physics_maxWaterZ ? World.MaxZ : z + 2); zz++) {
-				for (xx = (x < 2 ? 0 : x - 2); xx <= (x > physics_maxWaterX ? World.MaxX : x + 2); xx++) {
-					block = World_GetBlock(xx, yy, zz);
-					if (block == BLOCK_SPONGE) return;
-				}
-			}
-		}
+		if (nearSponge) return;
 
 		TickQueue_Enqueue(&waterQ, PHYSICS_WATER_DELAY | posIndex);
-		Game_UpdateBlock(x, y, z, BLOCK_WATER);
+		Physics_UpdateBlock(x, y, z, BLOCK_WATER);
 	}
 }
 
+/* Spreads water into its neighbours, except for the neighbours in the given sponge mask */
+static void Physics_SpreadWater(int index, int spongeMask) {
+	int x, y, z;
+	World_Unpack(index, x, y, z);
+
+	if (x > 0)          Physics_PropagateWater(index - 1,           x - 1, y,     z,     spongeMask & WATER_DIR_XMIN);
+	if (x < World.MaxX) Physics_PropagateWater(index + 1,           x + 1, y,     z,     spongeMask & WATER_DIR_XMAX);
+	if (z > 0)          Physics_PropagateWater(index - World.Width, x,     y,     z - 1, spongeMask & WATER_DIR_ZMIN);
+	if (z < World.MaxZ) Physics_PropagateWater(index + World.Width, x,     y,     z + 1, spongeMask & WATER_DIR_ZMAX);
+	if (y > 0)          Physics_PropagateWater(index - World.OneY,  x,     y - 1, z,     spongeMask & WATER_DIR_YMIN);
+}
+
 static void Physics_ActivateWater(int index, BlockID block) {
 	int x, y, z;
 	World_Unpack(index, x, y, z);
+	Physics_SpreadWater(index, Physics_CalcSpongeMask(NULL, index, x, y, z));
+}
+
+
+/*########################################################################################################################*
+*--------------------------------------------------Liquid worker threads--------------------------------------------------*
+*#########################################################################################################################*/
+/* When lots of water is flowing, the water queue is ticked in two phases: */
+/*  1) Worker threads each calculate the sponge masks of separate portions of the queue */
+/*     (only reading from the world, so it doesn't matter where in the world the entries are) */
+/*  2) The main thread then spreads water for every entry in queue order, rechecking the current */
+/*     block of each neighbour as it goes, so the results are exactly the same as ticking serially */
+/* Phase 2 has to be done on the main thread, as it changes blocks in the world (which raises events) */
+/* Unlike when ticking serially, phase 1 can't skip checking neighbours that an earlier entry in the */
+/*  queue will spread water into, so nearby entries would often check the same blocks for sponges */
+/*  if not for each thread remembering the results of recent checks */
+/* Min number of water queue entries before worker threads are used */
+#define LIQUID_PARALLEL_MIN 2048
+/* Number of water queue entries each worker processes at a time */
+#define LIQUID_JOB_SIZE 512
+
+static cc_uint32* liquidItems;
+static cc_uint8*  liquidMasks;
+static int liquidCapacity, liquidCount, nextLiquidJob;
+
+static struct WorkerPool liquidPool;
+static cc_bool liquidWorkersStarted;
+static struct SpongeCache* spongeCaches; /* One for each worker thread, plus one for the main thread */
+
+static void Physics_RunLiquidJobs(int workerID) {
+	struct SpongeCache* cache = &spongeCaches[workerID + 1];
+	int i, end, index, x, y, z;
+	cc_uint32 item;
+	/* Sponges may have been placed or deleted since the last tick */
+	Mem_Set(cache->indices, 0xFF, sizeof(cache->indices));
+
+	for (;;)
+	{
+		Mutex_Lock(liquidPool.mutex);
+		{
+			i = nextLiquidJob;
+			nextLiquidJob += LIQUID_JOB_SIZE;
+		}
+		Mutex_Unlock(liquidPool.mutex);
+		if (i >= liquidCount) return;
 
-	if (x > 0)          Physics_PropagateWater(index - 1,           x - 1, y,     z);
-	if (x < World.MaxX) Physics_PropagateWater(index + 1,           x + 1, y,     z);
-	if (z > 0)          Physics_PropagateWater(index - World.Width, x,     y,     z - 1);
-	if (z < World.MaxZ) Physics_PropagateWater(index + World.Width, x,     y,     z + 1);
-	if (y > 0)          Physics_PropagateWater(index - World.OneY,  x,     y - 1, z);
+		end = min(i + LIQUID_JOB_SIZE, liquidCount);
+		for (; i < end; i++)
+		{
+			item = liquidItems[i];
+			if (item >= PHYSICS_ONE_DELAY) continue;
+
+			/* NOTE: Mask is calculated even if this entry isn't currently water, */
+			/*  as an earlier entry in the queue might spread water into it during this tick */
+			/* Water ticks never turn blocks into air, so any neighbour water might spread into */
+			/*  when the main thread spreads this entry is also one that can be spread into now */
+			index = (int)(item & PHYSICS_POS_MASK);
+			World_Unpack(index, x, y, z);
+			liquidMasks[i] = Physics_CalcSpongeMask(cache, index, x, y, z);
+		}
+	}
+}
+
+/* Starts the liquid worker threads if not already, returning whether there are any worker threads */
+static cc_bool Physics_StartLiquidWorkers(void) {
+	int count;
+	if (liquidWorkersStarted) return liquidPool.count > 0;
+	liquidWorkersStarted = true;
+
+#ifdef CC_BUILD_COOPTHREADED
+	count = 0;
+#else
+	count = Options_GetInt(OPT_PHYSICS_THREADS, 0, WORKERPOOL_MAX_THREADS, 2);
+#endif
+	if (!count) return false;
+
+	WorkerPool_Start(&liquidPool, count, Physics_RunLiquidJobs, 128 * 1024, "Liquid physics");
+	return liquidPool.count > 0;
+}
+
+static void Physics_FreeLiquidItems(void) {
+	Mem_Free(liquidItems);
+	Mem_Free(liquidMasks);
+	liquidItems    = NULL;
+	liquidMasks    = NULL;
+	liquidCapacity = 0;
+}
+
+static cc_bool Physics_TickWaterParallel(void) {
+	int i, index, count = waterQ.count;
+	cc_uint32 item;
+	BlockID block;
+	if (!Physics_StartLiquidWorkers()) return false;
+
+	if (!spongeCaches) {
+		spongeCaches = (struct SpongeCache*)Mem_Alloc(liquidPool.count + 1, sizeof(struct SpongeCache), "sponge caches");
+	}
+
+	if (count > liquidCapacity) {
+		Physics_FreeLiquidItems();
+		liquidItems    = (cc_uint32*)Mem_Alloc(count, sizeof(cc_uint32), "liquid items");
+		liquidMasks    = (cc_uint8*)Mem_Alloc(count,  sizeof(cc_uint8),  "liquid masks");
+		liquidCapacity = count;
+	}
+	for (i = 0; i < count; i++)
+	{
+		liquidItems[i] = TickQueue_Dequeue(&waterQ);
+	}
+
+	liquidCount   = count;
+	nextLiquidJob = 0;
+	/* Main thread calculates sponge masks too while waiting */
+	WorkerPool_Run(&liquidPool);
+
+	/* Spread water in queue order, so entries are requeued in the same order as Physics_CheckItem */
+	for (i = 0; i < count; i++)
+	{
+		item = liquidItems[i];
+		if (item >= PHYSICS_ONE_DELAY) {
+			TickQueue_Enqueue(&waterQ, item - PHYSICS_ONE_DELAY);
+			continue;
+		}
+
+		index = (int)(item & PHYSICS_POS_MASK);
+		block = World_GetLowerBlock(index);
+		if (!(block == BLOCK_WATER || block == BLOCK_STILL_WATER)) continue;
+		Physics_SpreadWater(index, liquidMasks[i]);
+	}
+	return true;
 }
 
 static void Physics_TickWater(void) {
 	int i, count = waterQ.count;
+	if (count >= LIQUID_PARALLEL_MIN && Physics_TickWaterParallel()) return;
+
 	for (i = 0; i < count; i++) {
 		int index;
 		if (Physics_CheckItem(&waterQ, &index)) {
-			BlockID block = World.Blocks[index];
+			BlockID block = World_GetLowerBlock(index);
 			if (!(block == BLOCK_WATER || block == BLOCK_STILL_WATER)) continue;
 			Physics_ActivateWater(index, block);
 		}
@@ -431,7 +736,7 @@ static void Physics_PlaceSponge(int index, BlockID block) {
 
 				block = World_GetBlock(xx, yy, zz);
 				if (block == BLOCK_WATER || block == BLOCK_STILL_WATER) {
-					Game_UpdateBlock(xx, yy, zz, BLOCK_AIR);
+					Physics_UpdateBlock(xx, yy, zz, BLOCK_AIR);
 				}
 			}
 		}
@@ -449,7 +754,7 @@ static void Physics_DeleteSponge(int index, BlockID block) {
 					if (!World_Contains(xx, yy, zz)) continue;
 
 					index = World_Pack(xx, yy, zz);
-					block = World.Blocks[index];
+					block = World_GetLowerBlock(index);
 					if (block == BLOCK_WATER || block == BLOCK_STILL_WATER) {
 						TickQueue_Enqueue(&waterQ, index | PHYSICS_ONE_DELAY);
 					}
@@ -465,9 +770,9 @@ static void Physics_HandleSlab(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 	if (index < World.OneY) return;
 
-	if (World.Blocks[index - World.OneY] != BLOCK_SLAB) return;
-	Game_UpdateBlock(x, y,     z, BLOCK_AIR);
-	Game_UpdateBlock(x, y - 1, z, BLOCK_DOUBLE_SLAB);
+	if (World_GetLowerBlock(index - World.OneY) != BLOCK_SLAB) return;
+	Physics_UpdateBlock(x, y,     z, BLOCK_AIR);
+	Physics_UpdateBlock(x, y - 1, z, BLOCK_DOUBLE_SLAB);
 }
 
 static void Physics_HandleCobblestoneSlab(int index, BlockID block) {
@@ -475,9 +780,9 @@ static void Physics_HandleCobblestoneSlab(int index, BlockID block) {
 	World_Unpack(index, x, y, z);
 	if (index < World.OneY) return;
 
-	if (World.Blocks[index - World.OneY] != BLOCK_COBBLE_SLAB) return;
-	Game_UpdateBlock(x, y,     z, BLOCK_AIR);
-	Game_UpdateBlock(x, y - 1, z, BLOCK_COBBLE);
+	if (World_GetLowerBlock(index - World.OneY) != BLOCK_COBBLE_SLAB) return;
+	Physics_UpdateBlock(x, y,     z, BLOCK_AIR);
+	Physics_UpdateBlock(x, y - 1, z, BLOCK_COBBLE);
 }
 
 
@@ -496,7 +801,7 @@ static void Physics_HandleTnt(int index, BlockID block) {
 	int dx, dy, dz, xx, yy, zz;
 
 	World_Unpack(index, x, y, z);
-	Game_UpdateBlock(x, y, z, BLOCK_AIR);
+	Physics_UpdateBlock(x, y, z, BLOCK_AIR);
 	Physics_ActivateNeighbours(x, y, z, index);
 	
 	for (dy = -TNT_POWER; dy <= TNT_POWER; dy++) {
@@ -508,10 +813,10 @@ static void Physics_HandleTnt(int index, BlockID block) {
 				if (!World_Contains(xx, yy, zz)) continue;
 				index = World_Pack(xx, yy, zz);
 
-				block = World.Blocks[index];
+				block = World_GetLowerBlock(index);
 				if (BlocksTNT(block)) continue;
 
-				Game_UpdateBlock(xx, yy, zz, BLOCK_AIR);
+				Physics_UpdateBlock(xx, yy, zz, BLOCK_AIR);
 				Physics_ActivateNeighbours(xx, yy, zz, index);
 			}
 		}
@@ -563,10 +868,16 @@ void Physics_Init(void) {
 
 void Physics_Free(void) {
 	Event_Unregister_(&WorldEvents.MapLoaded,    NULL, Physics_OnNewMapLoaded);
+	Physics_FreeTickCounts();
+	Physics_FreeLiquidItems();
+
+	Mem_Free(spongeCaches);
+	spongeCaches = NULL;
 }
 
 void Physics_Tick(void) {
 	if (!Physics.Enabled || !World.Blocks) return;
+	Game_BeginBlockBatch();
 
 	/*if ((tickCount % 5) == 0) {*/
 	Physics_TickLava();
@@ -574,4 +885,5 @@ void Physics_Tick(void) {
 	/*}*/
 	physics_tickCount++;
 	Physics_TickRandomBlocks();
+	Game_EndBlockBatch();
 }
@@ -20,14 +20,16 @@ int Builder_SidesLevel, Builder_EdgeLevel;
 /* Packs an index into the 18x18x18 chunk array. Coordinates range from -1 to 16. */
 #define Builder_PackChunk(xx, yy, zz) (((yy) + 1) * EXTCHUNK_SIZE_2 + ((zz) + 1) * EXTCHUNK_SIZE + ((xx) + 1))
 
-static BlockID* Builder_Chunk;
-static cc_uint8* Builder_Counts;
-static int* Builder_BitFlags;
-static int Builder_X, Builder_Y, Builder_Z;
-static BlockID Builder_Block;
-static int Builder_ChunkIndex;
-static cc_bool Builder_FullBright;
-static int Builder_ChunkEndX, Builder_ChunkEndZ;
+/* NOTE: State for the chunk currently being built is thread local, */
+/*  as chunk meshes may be built on multiple worker threads at once */
+static CC_THREADLOCAL BlockID* Builder_Chunk;
+static CC_THREADLOCAL cc_uint8* Builder_Counts;
+static CC_THREADLOCAL int* Builder_BitFlags;
+static CC_THREADLOCAL int Builder_X, Builder_Y, Builder_Z;
+static CC_THREADLOCAL BlockID Builder_Block;
+static CC_THREADLOCAL int Builder_ChunkIndex;
+static CC_THREADLOCAL cc_bool Builder_FullBright;
+static CC_THREADLOCAL int Builder_ChunkEndX, Builder_ChunkEndY, Builder_ChunkEndZ;
 static int Builder_Offsets[FACE_COUNT] = { -1,1, -EXTCHUNK_SIZE,EXTCHUNK_SIZE, -EXTCHUNK_SIZE_2,EXTCHUNK_SIZE_2 };
 
 static int (*Builder_StretchXLiquid)(int countIndex, int x, int y, int z, int chunkIndex, BlockID block);
@@ -49,8 +51,8 @@ struct Builder1DPart {
 
 /* Part builder data, for both normal and translucent parts.
 The first ATLAS1D_MAX_ATLASES parts are for normal parts, remainder are for translucent parts. */
-static CC_BIG_VAR struct Builder1DPart Builder_Parts[ATLAS1D_MAX_ATLASES * 2];
-static struct VertexTextured* Builder_Vertices;
+static CC_BIG_VAR CC_THREADLOCAL struct Builder1DPart Builder_Parts[ATLAS1D_MAX_ATLASES * 2];
+static CC_THREADLOCAL struct VertexTextured* Builder_Vertices;
 
 static int Builder1DPart_VerticesCount(struct Builder1DPart* part) {
 	int i, count = part->sCount;
@@ -155,20 +157,6 @@ static void PrepareChunk(int x1, int y1, int z1) {
 	BlockID b;
 	int x, y, z, xx, yy, zz;
 
-#ifdef OCCLUSION
-	int flags = ComputeOcclusion();
-#endif
-#ifdef DEBUG_OCCLUSION
-	FastColour col = new FastColour(60, 60, 60, 255);
-	if (flags & 1) col.R = 255; /* x */
-	if (flags & 4) col.G = 255; /* y */
-	if (flags & 2) col.B = 255; /* z */
-	map.Sunlight = map.Shadowlight = col;
-	map.SunlightXSide = map.ShadowlightXSide = col;
-	map.SunlightZSide = map.ShadowlightZSide = col;
-	map.SunlightYBottom = map.ShadowlightYBottom = col;
-#endif
-	
 	for (y = y1, yy = 0; y < yMax; y++, yy++) {
 		for (z = z1, zz = 0; z < zMax; z++, zz++) {
 			cIndex = Builder_PackChunk(0, yy, zz);
@@ -244,6 +232,26 @@ static void PrepareChunk(int x1, int y1, int z1) {
 	}
 }
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/* Decompresses a row of blocks in the world */
+static void ReadWorldRow(int index, BlockID* row) {
+	BlockRaw blocks[EXTCHUNK_SIZE];
+	int i;
+	WorldSections_Read(World.Blocks, index, blocks, EXTCHUNK_SIZE);
+	for (i = 0; i < EXTCHUNK_SIZE; i++) row[i] = blocks[i];
+
+#ifdef EXTENDED_BLOCKS
+	if (World.IDMask <= 0xFF) return;
+	WorldSections_Read(World.Blocks2, index, blocks, EXTCHUNK_SIZE);
+	for (i = 0; i < EXTCHUNK_SIZE; i++) row[i] |= blocks[i] << 8;
+#endif
+}
+/* Rows are decompressed all at once, instead of decompressing each block individually */
+#define ReadChunkRow(index) ReadWorldRow(index, row)
+#else
+#define ReadChunkRow(index)
+#endif
+
 #define ReadChunkBody(get_block)\
 for (yy = -1; yy < 17; ++yy) {\
 	y = yy + y1;\
@@ -251,6 +259,7 @@ for (yy = -1; yy < 17; ++yy) {\
 \
 		index  = World_Pack(x1 - 1, y, z1 + zz);\
 		cIndex = Builder_PackChunk(-1, yy, zz);\
+		ReadChunkRow(index);\
 		for (xx = -1; xx < 17; ++xx, ++index, ++cIndex) {\
 \
 			block    = get_block;\
@@ -262,15 +271,19 @@ for (yy = -1; yy < 17; ++yy) {\
 }
 
 static cc_bool ReadChunkData(int x1, int y1, int z1, cc_bool* outAllAir) {
-	BlockRaw* blocks = World.Blocks;
 	cc_bool allAir = true, allSolid = true;
 	int index, cIndex;
 	BlockID block;
 	int xx, yy, zz, y;
 
-#ifndef EXTENDED_BLOCKS
+#if defined CC_BUILD_COMPRESSEDWORLD
+	BlockID row[EXTCHUNK_SIZE];
+	ReadChunkBody(row[xx + 1]);
+#elif !defined EXTENDED_BLOCKS
+	BlockRaw* blocks = World.Blocks;
 	ReadChunkBody(blocks[index]);
 #else
+	BlockRaw* blocks = World.Blocks;
 	BlockRaw* blocks2;
 
 	if (World.IDMask <= 0xFF) {
@@ -312,16 +325,20 @@ for (yy = -1; yy < 17; ++yy) {\
 }
 
 static cc_bool ReadBorderChunkData(int x1, int y1, int z1, cc_bool* outAllAir) {
-	BlockRaw* blocks = World.Blocks;
-	BlockRaw* blocks2;
 	cc_bool allAir = true;
 	int index, cIndex;
 	BlockID block;
 	int xx, yy, zz, x, y, z;
 
-#ifndef EXTENDED_BLOCKS
+#if defined CC_BUILD_COMPRESSEDWORLD
+	ReadBorderChunkBody(World_GetRawBlock(index));
+#elif !defined EXTENDED_BLOCKS
+	BlockRaw* blocks = World.Blocks;
 	ReadBorderChunkBody(blocks[index]);
 #else
+	BlockRaw* blocks = World.Blocks;
+	BlockRaw* blocks2;
+
 	if (World.IDMask <= 0xFF) {
 		ReadBorderChunkBody(blocks[index]);
 	} else {
@@ -334,7 +351,7 @@ static cc_bool ReadBorderChunkData(int x1, int y1, int z1, cc_bool* outAllAir) {
 	return false;
 }
 
-static void OutputChunkPartsMeta(int x, int y, int z, struct ChunkInfo* info) {
+static void OutputChunkPartsMeta(int x, int y, int z, struct Builder1DPart* parts, struct ChunkInfo* info) {
 	cc_bool hasNorm, hasTran;
 	int partsIndex;
 	int i, j, curIdx, offset;
@@ -348,8 +365,8 @@ static void OutputChunkPartsMeta(int x, int y, int z, struct ChunkInfo* info) {
 		j = i + ATLAS1D_MAX_ATLASES;
 		curIdx = partsIndex + i * World.ChunksCount;
 
-		hasNorm |= SetPartInfo(&Builder_Parts[i], &offset, &MapRenderer_PartsNormal[curIdx]);
-		hasTran |= SetPartInfo(&Builder_Parts[j], &offset, &MapRenderer_PartsTranslucent[curIdx]);
+		hasNorm |= SetPartInfo(&parts[i], &offset, &MapRenderer_PartsNormal[curIdx]);
+		hasTran |= SetPartInfo(&parts[j], &offset, &MapRenderer_PartsTranslucent[curIdx]);
 	}
 
 	if (hasNorm) {
@@ -360,6 +377,133 @@ static void OutputChunkPartsMeta(int x, int y, int z, struct ChunkInfo* info) {
 	}
 }
 
+/* Reads the blocks of the chunk and its immediate neighbours into Builder_Chunk */
+/* Returns whether all of these blocks are fully opaque */
+static cc_bool ReadChunk(int x1, int y1, int z1, cc_bool* allAir) {
+	cc_bool onBorder = 
+		x1 == 0 || y1 == 0 || z1 == 0   || x1 + CHUNK_SIZE >= World.Width ||
+		y1 + CHUNK_SIZE >= World.Height || z1 + CHUNK_SIZE >= World.Length;
+
+	if (onBorder) {
+		/* less optimal case here */
+		Mem_Set(Builder_Chunk, BLOCK_AIR, EXTCHUNK_SIZE_3 * sizeof(BlockID));
+		return ReadBorderChunkData(x1, y1, z1, allAir);
+	}
+	return ReadChunkData(x1, y1, z1, allAir);
+}
+
+/* Calculates the number of vertices in each part of the chunk mesh */
+/* Returns the total number of vertices in the chunk mesh */
+static int CountChunkVertices(int x1, int y1, int z1) {
+	Mem_Set(Builder_Counts, 1, CHUNK_SIZE_3 * FACE_COUNT);
+	Builder_ChunkEndX = min(World.Width,  x1 + CHUNK_SIZE);
+	Builder_ChunkEndY = min(World.Height, y1 + CHUNK_SIZE);
+	Builder_ChunkEndZ = min(World.Length, z1 + CHUNK_SIZE);
+
+	PrepareChunk(x1, y1, z1);
+	return Builder_TotalVerticesCount();
+}
+
+/* Generates the vertices of the chunk mesh into Builder_Vertices */
+static void RenderChunk(int x1, int y1, int z1) {
+	int xMax = min(World.Width,  x1 + CHUNK_SIZE);
+	int yMax = min(World.Height, y1 + CHUNK_SIZE);
+	int zMax = min(World.Length, z1 + CHUNK_SIZE);
+	int cIndex, index;
+	int x, y, z, xx, yy, zz;
+
+	Builder_PostPrepareChunk();
+	/* now render the chunk */
+
+	for (y = y1, yy = 0; y < yMax; y++, yy++) {
+		for (z = z1, zz = 0; z < zMax; z++, zz++) {
+			cIndex = Builder_PackChunk(0, yy, zz);
+
+			for (x = x1, xx = 0; x < xMax; x++, xx++, cIndex++) {
+				Builder_Block = Builder_Chunk[cIndex];
+				if (Blocks.Draw[Builder_Block] == DRAW_GAS) continue;
+
+				index = Builder_PackCount(xx, yy, zz);
+				Builder_ChunkIndex = cIndex;
+				Builder_RenderBlock(index, x, y, z);
+			}
+		}
+	}
+}
+
+
+/*########################################################################################################################*
+*-------------------------------------------------Chunk face connectivity-------------------------------------------------*
+*#########################################################################################################################*/
+/* Whether each block in the chunk has been visited (or is fully opaque and so can't be visited) */
+static CC_BIG_VAR CC_THREADLOCAL cc_uint8  conn_visited[CHUNK_SIZE_3];
+static CC_BIG_VAR CC_THREADLOCAL cc_uint16 conn_stack[CHUNK_SIZE_3];
+/* Maps a bitmask of faces to the ChunkInfo.connectedFaces bits for every pair of those faces */
+static cc_uint16 conn_facePairs[1 << FACE_COUNT];
+
+#define Conn_Visit(index) if (!conn_visited[index]) { conn_visited[index] = true; conn_stack[count++] = index; }
+
+/* Flood fills through the non-opaque blocks reachable from the given block */
+/* Returns the bitmask of chunk faces that were reached */
+static int FloodFillFaces(int start) {
+	int faces = 0, count = 0, index;
+	int x, y, z;
+	Conn_Visit(start);
+
+	while (count) {
+		index = conn_stack[--count];
+		x = index & CHUNK_MASK; z = (index >> CHUNK_SHIFT) & CHUNK_MASK; y = index >> (CHUNK_SHIFT * 2);
+
+		if (x == 0)          { faces |= FACE_BIT_XMIN; } else { Conn_Visit(index - 1); }
+		if (x == CHUNK_MAX)  { faces |= FACE_BIT_XMAX; } else { Conn_Visit(index + 1); }
+		if (z == 0)          { faces |= FACE_BIT_ZMIN; } else { Conn_Visit(index - CHUNK_SIZE); }
+		if (z == CHUNK_MAX)  { faces |= FACE_BIT_ZMAX; } else { Conn_Visit(index + CHUNK_SIZE); }
+		if (y == 0)          { faces |= FACE_BIT_YMIN; } else { Conn_Visit(index - CHUNK_SIZE_2); }
+		if (y == CHUNK_MAX)  { faces |= FACE_BIT_YMAX; } else { Conn_Visit(index + CHUNK_SIZE_2); }
+	}
+	return faces;
+}
+
+/* Calculates which pairs of faces of the chunk in Builder_Chunk can see each other */
+/* (i.e. whether there is a path of non-opaque blocks from one face to the other) */
+static cc_uint16 ComputeConnectedFaces(cc_bool allAir, cc_bool allSolid) {
+	cc_uint16 connected = 0;
+	int i, cIndex, xx, yy, zz;
+	if (allAir)   return CHUNK_ALL_FACES_CONNECTED;
+	if (allSolid) return 0;
+
+	for (yy = 0, i = 0; yy < CHUNK_SIZE; yy++) {
+		for (zz = 0; zz < CHUNK_SIZE; zz++) {
+			cIndex = Builder_PackChunk(0, yy, zz);
+
+			for (xx = 0; xx < CHUNK_SIZE; xx++, i++, cIndex++) {
+				conn_visited[i] = Blocks.FullOpaque[Builder_Chunk[cIndex]];
+			}
+		}
+	}
+
+	for (i = 0; i < CHUNK_SIZE_3 && connected != CHUNK_ALL_FACES_CONNECTED; i++) {
+		if (conn_visited[i]) continue;
+		connected |= conn_facePairs[FloodFillFaces(i)];
+	}
+	return connected;
+}
+
+static void InitFacePairs(void) {
+	int faces, a, b;
+	cc_uint16 pairs;
+
+	for (faces = 0; faces < Array_Elems(conn_facePairs); faces++) {
+		pairs = 0;
+		for (a = 0; a < FACE_COUNT; a++) {
+			for (b = a + 1; b < FACE_COUNT; b++) {
+				if ((faces & (1 << a)) && (faces & (1 << b))) pairs |= ChunkInfo_FacesBit(a, b);
+			}
+		}
+		conn_facePairs[faces] = pairs;
+	}
+}
+
 cc_bool Builder_MakeChunk(struct ChunkInfo* info) {
 #if CC_BUILD_MAXSTACK <= (32 * 1024)
 	void* mem        = TempMem_Alloc((EXTCHUNK_SIZE_3 * sizeof(BlockID)) + (CHUNK_SIZE_3 * FACE_COUNT));
@@ -376,51 +520,30 @@ cc_bool Builder_MakeChunk(struct ChunkInfo* info) {
 	int bitFlags[1];
 #endif
 
-	cc_bool allAir, allSolid, onBorder;
-	int xMax, yMax, zMax, totalVerts;
-	int cIndex, index;
-	int x, y, z, xx, yy, zz;
+	cc_bool allAir, allSolid;
+	int totalVerts;
 	int x1 = info->centreX - HALF_CHUNK_SIZE;
 	int y1 = info->centreY - HALF_CHUNK_SIZE;
 	int z1 = info->centreZ - HALF_CHUNK_SIZE;
+#if CC_GFX_BACKEND == CC_GFX_BACKEND_GL11
+	int i, cIndex, curIdx;
+#endif
 
 	Builder_Chunk  = chunk;
 	Builder_Counts = counts;
 	Builder_BitFlags = bitFlags;
 	Builder_PrePrepareChunk();
-	
-	onBorder = 
-		x1 == 0 || y1 == 0 || z1 == 0   || x1 + CHUNK_SIZE >= World.Width ||
-		y1 + CHUNK_SIZE >= World.Height || z1 + CHUNK_SIZE >= World.Length;
-
-	if (onBorder) {
-		/* less optimal case here */
-		Mem_Set(chunk, BLOCK_AIR, EXTCHUNK_SIZE_3 * sizeof(BlockID));
-		allSolid = ReadBorderChunkData(x1, y1, z1, &allAir);
-	} else {
-		allSolid = ReadChunkData(x1, y1, z1, &allAir);
-	}
+	allSolid = ReadChunk(x1, y1, z1, &allAir);
 
 	info->allAir = allAir;
+	info->connectedFaces = ComputeConnectedFaces(allAir, allSolid);
 	if (allAir || allSolid) return true;
 	Lighting.LightHint(x1 - 1, y1 - 1, z1 - 1);
 
-	Mem_Set(counts, 1, CHUNK_SIZE_3 * FACE_COUNT);
-	xMax = min(World.Width,  x1 + CHUNK_SIZE);
-	yMax = min(World.Height, y1 + CHUNK_SIZE);
-	zMax = min(World.Length, z1 + CHUNK_SIZE);
-
-	Builder_ChunkEndX = xMax; Builder_ChunkEndZ = zMax;
-	PrepareChunk(x1, y1, z1);
-
-	totalVerts = Builder_TotalVerticesCount();
+	totalVerts = CountChunkVertices(x1, y1, z1);
 	if (!totalVerts) return true;
 	
-	OutputChunkPartsMeta(x1, y1, z1, info);
-#ifdef OCCLUSION
-	if (info.NormalParts != null || info.TranslucentParts != null)
-		info.occlusionFlags = (cc_uint8)ComputeOcclusion();
-#endif
+	OutputChunkPartsMeta(x1, y1, z1, Builder_Parts, info);
 
 #if CC_GFX_BACKEND != CC_GFX_BACKEND_GL11
 	/* add an extra element to fix crashing on some GPUs */
@@ -434,29 +557,13 @@ cc_bool Builder_MakeChunk(struct ChunkInfo* info) {
 	Builder_Vertices = (struct VertexTextured*)Gfx_LockVb(0, 
 													VERTEX_FORMAT_TEXTURED, totalVerts + 1);
 #endif
-	Builder_PostPrepareChunk();
-	/* now render the chunk */
-
-	for (y = y1, yy = 0; y < yMax; y++, yy++) {
-		for (z = z1, zz = 0; z < zMax; z++, zz++) {
-			cIndex = Builder_PackChunk(0, yy, zz);
-
-			for (x = x1, xx = 0; x < xMax; x++, xx++, cIndex++) {
-				Builder_Block = chunk[cIndex];
-				if (Blocks.Draw[Builder_Block] == DRAW_GAS) continue;
-
-				index = Builder_PackCount(xx, yy, zz);
-				Builder_ChunkIndex = cIndex;
-				Builder_RenderBlock(index, x, y, z);
-			}
-		}
-	}
+	RenderChunk(x1, y1, z1);
 
 #if CC_GFX_BACKEND == CC_GFX_BACKEND_GL11
 	cIndex = World_ChunkPack(x1 >> CHUNK_SHIFT, y1 >> CHUNK_SHIFT, z1 >> CHUNK_SHIFT);
 
-	for (index = 0; index < MapRenderer_1DUsedCount; index++) {
-		int curIdx = cIndex + index * World.ChunksCount;
+	for (i = 0; i < MapRenderer_1DUsedCount; i++) {
+		curIdx = cIndex + i * World.ChunksCount;
 
 		BuildPartVbs(&MapRenderer_PartsNormal[curIdx]);
 		BuildPartVbs(&MapRenderer_PartsTranslucent[curIdx]);
@@ -492,7 +599,7 @@ static void DefaultPostStretchChunk(void) {
 	}
 }
 
-static RNGState spriteRng;
+static CC_THREADLOCAL RNGState spriteRng;
 static void Builder_DrawSprite(int x, int y, int z) {
 	struct Builder1DPart* part;
 	struct VertexTextured* v;
@@ -654,6 +761,9 @@ static int NormalBuilder_StretchZ(int countIndex, int x, int y, int z, int chunk
 	return count;
 }
 
+/* Global Drawer can't be used, as it is also used by the main thread */
+static CC_THREADLOCAL struct _DrawerData normal_drawer;
+
 static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {	
 	/* counters */
 	int count_XMin, count_XMax, count_ZMin;
@@ -688,15 +798,15 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 	baseOffset = (Blocks.Draw[Builder_Block] == DRAW_TRANSLUCENT) * ATLAS1D_MAX_ATLASES;
 	lightFlags = Blocks.LightOffset[Builder_Block];
 
-	Drawer.MinBB = Blocks.MinBB[Builder_Block]; Drawer.MinBB.y = 1.0f - Drawer.MinBB.y;
-	Drawer.MaxBB = Blocks.MaxBB[Builder_Block]; Drawer.MaxBB.y = 1.0f - Drawer.MaxBB.y;
+	normal_drawer.MinBB = Blocks.MinBB[Builder_Block]; normal_drawer.MinBB.y = 1.0f - normal_drawer.MinBB.y;
+	normal_drawer.MaxBB = Blocks.MaxBB[Builder_Block]; normal_drawer.MaxBB.y = 1.0f - normal_drawer.MaxBB.y;
 
 	min = Blocks.RenderMinBB[Builder_Block]; max = Blocks.RenderMaxBB[Builder_Block];
-	Drawer.X1 = x + min.x; Drawer.Y1 = y + min.y; Drawer.Z1 = z + min.z;
-	Drawer.X2 = x + max.x; Drawer.Y2 = y + max.y; Drawer.Z2 = z + max.z;
+	normal_drawer.X1 = x + min.x; normal_drawer.Y1 = y + min.y; normal_drawer.Z1 = z + min.z;
+	normal_drawer.X2 = x + max.x; normal_drawer.Y2 = y + max.y; normal_drawer.Z2 = z + max.z;
 
-	Drawer.Tinted  = Blocks.Tinted[Builder_Block];
-	Drawer.TintCol = Blocks.FogCol[Builder_Block];
+	normal_drawer.Tinted  = Blocks.Tinted[Builder_Block];
+	normal_drawer.TintCol = Blocks.FogCol[Builder_Block];
 
 	if (count_XMin) {
 		loc    = Block_Tex(Builder_Block, FACE_XMIN);
@@ -705,7 +815,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			x >= offset ? Lighting.Color_XSide_Fast(x - offset, y, z) : Env.SunXSide;
-		Drawer_XMin(count_XMin, col, loc, &part->faces.vertices[FACE_XMIN]);
+		Drawer_XMinEx(&normal_drawer, count_XMin, col, loc, &part->faces.vertices[FACE_XMIN]);
 	}
 
 	if (count_XMax) {
@@ -715,7 +825,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			x <= (World.MaxX - offset) ? Lighting.Color_XSide_Fast(x + offset, y, z) : Env.SunXSide;
-		Drawer_XMax(count_XMax, col, loc, &part->faces.vertices[FACE_XMAX]);
+		Drawer_XMaxEx(&normal_drawer, count_XMax, col, loc, &part->faces.vertices[FACE_XMAX]);
 	}
 
 	if (count_ZMin) {
@@ -725,7 +835,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			z >= offset ? Lighting.Color_ZSide_Fast(x, y, z - offset) : Env.SunZSide;
-		Drawer_ZMin(count_ZMin, col, loc, &part->faces.vertices[FACE_ZMIN]);
+		Drawer_ZMinEx(&normal_drawer, count_ZMin, col, loc, &part->faces.vertices[FACE_ZMIN]);
 	}
 
 	if (count_ZMax) {
@@ -735,7 +845,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 
 		col = fullBright ? PACKEDCOL_WHITE :
 			z <= (World.MaxZ - offset) ? Lighting.Color_ZSide_Fast(x, y, z + offset) : Env.SunZSide;
-		Drawer_ZMax(count_ZMax, col, loc, &part->faces.vertices[FACE_ZMAX]);
+		Drawer_ZMaxEx(&normal_drawer, count_ZMax, col, loc, &part->faces.vertices[FACE_ZMAX]);
 	}
 
 	if (count_YMin) {
@@ -744,7 +854,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 		part   = &Builder_Parts[baseOffset + Atlas1D_Index(loc)];
 
 		col = fullBright ? PACKEDCOL_WHITE : Lighting.Color_YMin_Fast(x, y - offset, z);
-		Drawer_YMin(count_YMin, col, loc, &part->faces.vertices[FACE_YMIN]);
+		Drawer_YMinEx(&normal_drawer, count_YMin, col, loc, &part->faces.vertices[FACE_YMIN]);
 	}
 
 	if (count_YMax) {
@@ -753,7 +863,7 @@ static void NormalBuilder_RenderBlock(int index, int x, int y, int z) {
 		part   = &Builder_Parts[baseOffset + Atlas1D_Index(loc)];
 
 		col = fullBright ? PACKEDCOL_WHITE : Lighting.Color_YMax_Fast(x, y + offset, z);
-		Drawer_YMax(count_YMax, col, loc, &part->faces.vertices[FACE_YMAX]);
+		Drawer_YMaxEx(&normal_drawer, count_YMax, col, loc, &part->faces.vertices[FACE_YMAX]);
 	}
 }
 
@@ -776,16 +886,178 @@ static void NormalBuilder_SetActive(void) {
 }
 
 
+/*########################################################################################################################*
+*--------------------------------------------------Greedy mesh builder----------------------------------------------------*
+*#########################################################################################################################*/
+/* Same as the normal mesh builder, except that faces of different blocks are also merged together, */
+/*  provided that the faces are fully opaque and would be drawn exactly the same way. */
+/* When each 1D atlas only contains a single tile, textures also repeat along V, */
+/*  so runs of faces of fully opaque blocks are then further merged into rectangles. */
+static CC_BIG_VAR CC_THREADLOCAL cc_uint8 greedy_rows[CHUNK_SIZE_3 * FACE_COUNT];
+
+static PackedCol Greedy_FaceColor(int x, int y, int z, Face face, BlockID block) {
+	PackedCol col = Blocks.Brightness[block] ? PACKEDCOL_WHITE : Normal_LightColor(x, y, z, face, block);
+	if (Blocks.Tinted[block]) col = PackedCol_Tint(col, Blocks.FogCol[block]);
+	return col;
+}
+
+static cc_bool Greedy_CanStretch(BlockID initial, int countIndex, int chunkIndex, int x, int y, int z, Face face) {
+	BlockID cur = Builder_Chunk[chunkIndex];
+	/* Face may already be part of a rectangle that started on an earlier row */
+	if (!Builder_Counts[countIndex]) return false;
+	/* Top faces of blocks with liquid IDs are always stretched by Builder_StretchXLiquid instead */
+	if (face == FACE_YMAX && cur >= BLOCK_WATER && cur <= BLOCK_STILL_LAVA) return false;
+	if (cur == initial) return Normal_CanStretch(initial, chunkIndex, x, y, z, face);
+
+	if (!Blocks.FullOpaque[initial] || !Blocks.FullOpaque[cur]) return false;
+	/* Liquids are drawn slightly offset (see Block_CalcRenderBounds) */
+	if (Blocks.IsLiquid[initial]    || Blocks.IsLiquid[cur])    return false;
+	if (Block_Tex(initial, face) != Block_Tex(cur, face))       return false;
+	if (!(Blocks.CanStretch[cur] & (1 << face)))                return false;
+	if (Block_IsFaceHidden(cur, Builder_Chunk[chunkIndex + Builder_Offsets[face]], face)) return false;
+
+	return Greedy_FaceColor(Builder_X, Builder_Y, Builder_Z, face, initial) == Greedy_FaceColor(x, y, z, face, cur);
+}
+
+/* Merges following rows of faces into the given run of faces, for as long as every face in the row can be merged */
+/* Rows are along Z for top and bottom faces, and along Y for all other faces */
+/* Returns the number of rows in the resulting rectangle */
+static int Greedy_MergeRows(int count, int countIndex, int chunkIndex, int x, int y, int z, BlockID block, Face face, cc_bool alongX) {
+	cc_bool rowsAlongZ = face == FACE_YMIN || face == FACE_YMAX;
+	int runCount = alongX ? FACE_COUNT : CHUNK_SIZE * FACE_COUNT;
+	int runChunk = alongX ? 1          : EXTCHUNK_SIZE;
+	int rowCount = rowsAlongZ ? CHUNK_SIZE * FACE_COUNT : CHUNK_SIZE_2 * FACE_COUNT;
+	int rowChunk = rowsAlongZ ? EXTCHUNK_SIZE           : EXTCHUNK_SIZE_2;
+	int rows, i, xx, zz, cIndex, cChunk;
+
+	if (Atlas1D.TilesPerAtlas != 1 || !Blocks.FullOpaque[block] || Blocks.IsLiquid[block]) return 1;
+	if (!(Blocks.CanStretch[block] & (1 << face))) return 1;
+
+	for (rows = 1; ; rows++) {
+		if (rowsAlongZ) { z++; if (z >= Builder_ChunkEndZ) break; }
+		else {            y++; if (y >= Builder_ChunkEndY) break; }
+		countIndex += rowCount;
+		chunkIndex += rowChunk;
+
+		cIndex = countIndex; cChunk = chunkIndex; xx = x; zz = z;
+		for (i = 0; i < count; i++) {
+			if (!Greedy_CanStretch(block, cIndex, cChunk, xx, y, zz, face)) break;
+			cIndex += runCount; cChunk += runChunk;
+			if (alongX) xx++; else zz++;
+		}
+		if (i < count) break;
+
+		for (i = 0, cIndex = countIndex; i < count; i++, cIndex += runCount) {
+			Builder_Counts[cIndex] = 0;
+		}
+	}
+	return rows;
+}
+
+/* NOTE: Blocks with liquid IDs may be redefined as fully opaque blocks */
+static int GreedyBuilder_StretchXLiquid(int countIndex, int x, int y, int z, int chunkIndex, BlockID block) {
+	greedy_rows[countIndex] = 1;
+	return NormalBuilder_StretchXLiquid(countIndex, x, y, z, chunkIndex, block);
+}
+
+static int GreedyBuilder_StretchX(int countIndex, int x, int y, int z, int chunkIndex, BlockID block, Face face) {
+	int count = 1; cc_bool stretchTile;
+	int x1 = x, origCount = countIndex, origChunk = chunkIndex;
+	x++;
+	chunkIndex++;
+	countIndex += FACE_COUNT;
+	stretchTile = (Blocks.CanStretch[block] & (1 << face)) != 0;
+
+	while (x < Builder_ChunkEndX && stretchTile && Greedy_CanStretch(block, countIndex, chunkIndex, x, y, z, face)) {
+		Builder_Counts[countIndex] = 0;
+		count++;
+		x++;
+		chunkIndex++;
+		countIndex += FACE_COUNT;
+	}
+	greedy_rows[origCount] = Greedy_MergeRows(count, origCount, origChunk, x1, y, z, block, face, true);
+	AddVertices(block, face);
+	return count;
+}
+
+static int GreedyBuilder_StretchZ(int countIndex, int x, int y, int z, int chunkIndex, BlockID block, Face face) {
+	int count = 1; cc_bool stretchTile;
+	int z1 = z, origCount = countIndex, origChunk = chunkIndex;
+	z++;
+	chunkIndex += EXTCHUNK_SIZE;
+	countIndex += CHUNK_SIZE * FACE_COUNT;
+	stretchTile = (Blocks.CanStretch[block] & (1 << face)) != 0;
+
+	while (z < Builder_ChunkEndZ && stretchTile && Greedy_CanStretch(block, countIndex, chunkIndex, x, y, z, face)) {
+		Builder_Counts[countIndex] = 0;
+		count++;
+		z++;
+		chunkIndex += EXTCHUNK_SIZE;
+		countIndex += CHUNK_SIZE * FACE_COUNT;
+	}
+	greedy_rows[origCount] = Greedy_MergeRows(count, origCount, origChunk, x, y, z1, block, face, false);
+	AddVertices(block, face);
+	return count;
+}
+
+/* Extends the quad drawn by Drawer for the first row of a rectangle to cover all the rows */
+/* NOTE: Relies on V being 0 at the top/near edge of the tile, as each 1D atlas is a single tile */
+static void Greedy_ExtendQuad(struct VertexTextured* v, int rows, int y, int z, Face face) {
+	int i;
+	for (i = 0; i < 4; i++, v++) 
+	{
+		if (face == FACE_YMIN || face == FACE_YMAX) {
+			if (v->z > z) { v->z += rows - 1; v->V += rows - 1; }
+		} else {
+			/* V increases from the top of side faces downwards */
+			if (v->y > y) { v->y += rows - 1; } else { v->V += rows - 1; }
+		}
+	}
+}
+
+static void GreedyBuilder_RenderBlock(int index, int x, int y, int z) {
+	struct VertexTextured* vertices[FACE_COUNT];
+	struct Builder1DPart* part;
+	int face;
+
+	if (Atlas1D.TilesPerAtlas != 1 || !Blocks.FullOpaque[Builder_Block] || Blocks.IsLiquid[Builder_Block]) {
+		NormalBuilder_RenderBlock(index, x, y, z); return;
+	}
+
+	/* Fully opaque blocks are always drawn into the non-translucent parts */
+	for (face = 0; face < FACE_COUNT; face++) 
+	{
+		part = &Builder_Parts[Atlas1D_Index(Block_Tex(Builder_Block, face))];
+		vertices[face] = part->faces.vertices[face];
+	}
+	NormalBuilder_RenderBlock(index, x, y, z);
+
+	for (face = 0; face < FACE_COUNT; face++) 
+	{
+		if (!Builder_Counts[index + face] || greedy_rows[index + face] <= 1) continue;
+		Greedy_ExtendQuad(vertices[face], greedy_rows[index + face], y, z, face);
+	}
+}
+
+static void GreedyBuilder_SetActive(void) {
+	NormalBuilder_SetActive();
+	Builder_StretchXLiquid = GreedyBuilder_StretchXLiquid;
+	Builder_StretchX       = GreedyBuilder_StretchX;
+	Builder_StretchZ       = GreedyBuilder_StretchZ;
+	Builder_RenderBlock    = GreedyBuilder_RenderBlock;
+}
+
+
 /*########################################################################################################################*
 *-------------------------------------------------Advanced mesh builder---------------------------------------------------*
 *#########################################################################################################################*/
 #ifdef CC_BUILD_ADVLIGHTING
-static Vec3 adv_minBB, adv_maxBB;
-static int adv_initBitFlags, adv_baseOffset;
-static int* adv_bitFlags;
-static float adv_x1, adv_y1, adv_z1, adv_x2, adv_y2, adv_z2;
-static PackedCol adv_lerp[5], adv_lerpX[5], adv_lerpZ[5], adv_lerpY[5];
-static cc_bool adv_tinted;
+static CC_THREADLOCAL Vec3 adv_minBB, adv_maxBB;
+static CC_THREADLOCAL int adv_initBitFlags, adv_baseOffset;
+static CC_THREADLOCAL int* adv_bitFlags;
+static CC_THREADLOCAL float adv_x1, adv_y1, adv_z1, adv_x2, adv_y2, adv_z2;
+static CC_THREADLOCAL PackedCol adv_lerp[5], adv_lerpX[5], adv_lerpZ[5], adv_lerpY[5];
+static CC_THREADLOCAL cc_bool adv_tinted;
 
 enum ADV_MASK {
 	/* z-1 cube points */
@@ -1630,11 +1902,298 @@ static void ModernBuilder_SetActive(void) {
 static void ModernBuilder_SetActive(void) { NormalBuilder_SetActive(); }
 #endif
 
+/*########################################################################################################################*
+*------------------------------------------------Threaded mesh building---------------------------------------------------*
+*#########################################################################################################################*/
+#ifdef CC_BUILD_THREADEDBUILDER
+/* Maximum number of chunks that can be queued/built/waiting to be uploaded at once */
+#define BUILDER_MAX_JOBS 128
+
+/* State for building the mesh of a chunk on a worker thread */
+struct BuilderJob {
+	struct BuilderJob* next;
+	struct ChunkInfo* info;
+	int x1, y1, z1;
+	cc_bool allAir;
+	cc_uint16 connectedFaces;
+	/* Number of vertices in the built mesh (-1 if vertices couldn't be allocated) */
+	int totalVerts;
+	int maxVerts;
+	struct VertexTextured* vertices;
+	struct Builder1DPart parts[ATLAS1D_MAX_ATLASES * 2];
+	BlockID chunk[EXTCHUNK_SIZE_3];
+};
+struct BuilderJobList { struct BuilderJob* head; struct BuilderJob* tail; };
+
+static struct BuilderJob* builder_jobs;
+static struct BuilderJobList freeJobs, pendingJobs, builtJobs;
+static struct BuilderJob* uploadJob;
+static int workersCount, busyWorkers;
+static void* jobsMutex;
+static void* workerWaitable;
+
+static void JobList_Add(struct BuilderJobList* list, struct BuilderJob* job) {
+	job->next = NULL;
+	if (list->tail) {
+		list->tail->next = job;
+	} else {
+		list->head = job;
+	}
+	list->tail = job;
+}
+
+static struct BuilderJob* JobList_Take(struct BuilderJobList* list) {
+	struct BuilderJob* job = list->head;
+	if (!job) return NULL;
+
+	list->head = job->next;
+	if (!list->head) list->tail = NULL;
+	return job;
+}
+
+static void BuildJob(struct BuilderJob* job) {
+	cc_uint8 counts[CHUNK_SIZE_3 * FACE_COUNT];
+#ifdef CC_BUILD_ADVLIGHTING
+	int bitFlags[EXTCHUNK_SIZE_3];
+#else
+	int bitFlags[1];
+#endif
+	int totalVerts;
+
+	Builder_Chunk    = job->chunk;
+	Builder_Counts   = counts;
+	Builder_BitFlags = bitFlags;
+	Builder_PrePrepareChunk();
+
+	job->connectedFaces = ComputeConnectedFaces(false, false);
+	totalVerts      = CountChunkVertices(job->x1, job->y1, job->z1);
+	job->totalVerts = totalVerts;
+	if (!totalVerts) return;
+
+	/* Face counts get replaced by vertex pointers when rendering, so need to save them now */
+	Mem_Copy(job->parts, Builder_Parts, sizeof(Builder_Parts));
+
+	if (totalVerts > job->maxVerts) {
+		Mem_Free(job->vertices);
+		job->vertices = (struct VertexTextured*)Mem_TryAlloc(totalVerts, sizeof(struct VertexTextured));
+		job->maxVerts = job->vertices ? totalVerts : 0;
+	}
+	if (!job->vertices) { job->totalVerts = -1; return; }
+
+	Builder_Vertices = job->vertices;
+	RenderChunk(job->x1, job->y1, job->z1);
+}
+
+static void WorkerLoop(void) {
+	struct BuilderJob* job;
+	cc_bool moreJobs;
+
+	for (;;) {
+		Mutex_Lock(jobsMutex);
+		{
+			job      = JobList_Take(&pendingJobs);
+			moreJobs = pendingJobs.head != NULL;
+			if (job) busyWorkers++;
+		}
+		Mutex_Unlock(jobsMutex);
+
+		if (!job) {
+			/* Block until the main thread queues another chunk */
+			Waitable_Wait(workerWaitable);
+			continue;
+		}
+
+		/* Multiple signals may only wake up one worker, so wake up another worker if needed */
+		if (moreJobs) Waitable_Signal(workerWaitable);
+		BuildJob(job);
+
+		Mutex_Lock(jobsMutex);
+		{
+			JobList_Add(&builtJobs, job);
+			busyWorkers--;
+		}
+		Mutex_Unlock(jobsMutex);
+	}
+}
+
+static void StartWorkers(void) {
+	void* thread;
+	int i, count;
+	/* Builder component gets initialised multiple times on Android */
+	if (workersCount) return;
+
+	count = Options_GetInt(OPT_BUILDER_THREADS, 0, 64, 4);
+	if (!count) return;
+
+	builder_jobs = (struct BuilderJob*)Mem_TryAllocCleared(BUILDER_MAX_JOBS, sizeof(struct BuilderJob));
+	if (!builder_jobs) return;
+
+	for (i = 0; i < BUILDER_MAX_JOBS; i++)
+	{
+		JobList_Add(&freeJobs, &builder_jobs[i]);
+	}
+
+	jobsMutex      = Mutex_Create("Builder jobs");
+	workerWaitable = Waitable_Create("Builder wakeup");
+
+	for (i = 0; i < count; i++)
+	{
+		Thread_Run(&thread, WorkerLoop, 256 * 1024, "Chunk builder");
+		Thread_Detach(thread);
+	}
+	workersCount = count;
+}
+
+int Builder_WorkersCount(void) {
+	/* Fancy lighting calculates chunk lighting on demand, which isn't thread safe */
+	return Lighting_Mode == LIGHTING_MODE_CLASSIC ? workersCount : 0;
+}
+
+cc_bool Builder_QueueChunk(struct ChunkInfo* info) {
+	struct BuilderJob* job;
+	cc_bool allSolid;
+
+	Mutex_Lock(jobsMutex);
+	{
+		job = JobList_Take(&freeJobs);
+	}
+	Mutex_Unlock(jobsMutex);
+	if (!job) return false;
+
+	job->info = info;
+	job->x1   = info->centreX - HALF_CHUNK_SIZE;
+	job->y1   = info->centreY - HALF_CHUNK_SIZE;
+	job->z1   = info->centreZ - HALF_CHUNK_SIZE;
+	job->totalVerts = 0;
+
+	/* Blocks are copied on the main thread, so worker threads never read the world while it is being changed */
+	Builder_Chunk = job->chunk;
+	allSolid = ReadChunk(job->x1, job->y1, job->z1, &job->allAir);
+
+	if (job->allAir || allSolid) {
+		/* Nothing to build, so chunk can be uploaded straight away */
+		job->connectedFaces = ComputeConnectedFaces(job->allAir, allSolid);
+		Mutex_Lock(jobsMutex);
+		{
+			JobList_Add(&builtJobs, job);
+		}
+		Mutex_Unlock(jobsMutex);
+		return true;
+	}
+
+	/* Worker threads only read lighting, so lighting state must be calculated beforehand */
+	Lighting.LightHint(job->x1 - 1, job->y1 - 1, job->z1 - 1);
+
+	Mutex_Lock(jobsMutex);
+	{
+		JobList_Add(&pendingJobs, job);
+	}
+	Mutex_Unlock(jobsMutex);
+	Waitable_Signal(workerWaitable);
+	return true;
+}
+
+struct ChunkInfo* Builder_NextBuiltChunk(void) {
+	if (!workersCount) return NULL;
+
+	Mutex_Lock(jobsMutex);
+	{
+		uploadJob = JobList_Take(&builtJobs);
+	}
+	Mutex_Unlock(jobsMutex);
+	return uploadJob ? uploadJob->info : NULL;
+}
+
+cc_bool Builder_UploadChunk(struct ChunkInfo* info) {
+	struct BuilderJob* job = uploadJob;
+	int totalVerts = job->totalVerts;
+	cc_bool success = totalVerts >= 0;
+	void* data;
+
+	info->allAir = job->allAir;
+	info->connectedFaces = job->connectedFaces;
+	if (totalVerts > 0) {
+		/* add an extra element to fix crashing on some GPUs */
+		info->vb = Gfx_TryCreateStaticVb(VERTEX_FORMAT_TEXTURED, totalVerts + 1);
+		success  = info->vb != 0;
+	}
+
+	if (success && totalVerts > 0) {
+		OutputChunkPartsMeta(job->x1, job->y1, job->z1, job->parts, info);
+
+		data = Gfx_LockVb(info->vb, VERTEX_FORMAT_TEXTURED, totalVerts + 1);
+		Mem_Copy(data, job->vertices, totalVerts * sizeof(struct VertexTextured));
+		Gfx_UnlockVb(info->vb);
+	}
+
+	Mutex_Lock(jobsMutex);
+	{
+		JobList_Add(&freeJobs, job);
+	}
+	Mutex_Unlock(jobsMutex);
+
+	uploadJob = NULL;
+	return success;
+}
+
+static void DiscardJobs(struct BuilderJobList* list) {
+	struct BuilderJob* job;
+
+	while ((job = JobList_Take(list))) 
+	{
+		job->info->building = false;
+		job->info->dirty    = true;
+		JobList_Add(&freeJobs, job);
+	}
+}
+
+void Builder_CancelChunks(void) {
+	int busy;
+	if (!workersCount) return;
+
+	Mutex_Lock(jobsMutex);
+	{
+		DiscardJobs(&pendingJobs);
+	}
+	Mutex_Unlock(jobsMutex);
+
+	/* Wait for worker threads to finish building their current chunks */
+	for (;;) {
+		Mutex_Lock(jobsMutex);
+		{
+			busy = busyWorkers;
+			if (!busy) DiscardJobs(&builtJobs);
+		}
+		Mutex_Unlock(jobsMutex);
+
+		if (!busy) return;
+		Thread_Sleep(1);
+	}
+}
+#else
+static void StartWorkers(void) { }
+
+int Builder_WorkersCount(void) { return 0; }
+cc_bool Builder_QueueChunk(struct ChunkInfo* info) { return false; }
+
+struct ChunkInfo* Builder_NextBuiltChunk(void) { return NULL; }
+cc_bool Builder_UploadChunk(struct ChunkInfo* info) { return false; }
+
+void Builder_CancelChunks(void) { }
+#endif
+
+
 /*########################################################################################################################*
 *---------------------------------------------------Builder interface-----------------------------------------------------*
 *#########################################################################################################################*/
 cc_bool Builder_SmoothLighting;
+cc_bool Builder_GreedyMeshing;
 void Builder_ApplyActive(void) {
+	/* Worker threads may be using the current builder functions */
+	Builder_CancelChunks();
+	/* Greedy builder can only merge faces along both axes when textures repeat along V */
+	Atlas1D_UseSingleTiles(!Builder_SmoothLighting && Builder_GreedyMeshing);
+
 	if (Builder_SmoothLighting) {
 		if (Lighting_Mode != LIGHTING_MODE_CLASSIC) {
 			ModernBuilder_SetActive();
@@ -1642,6 +2201,8 @@ void Builder_ApplyActive(void) {
 		else {
 			AdvBuilder_SetActive();
 		}
+	} else if (Builder_GreedyMeshing) {
+		GreedyBuilder_SetActive();
 	} else {
 		NormalBuilder_SetActive();
 	}
@@ -1656,7 +2217,10 @@ static void OnInit(void) {
 	Builder_Offsets[FACE_YMAX] =  EXTCHUNK_SIZE_2;
 
 	if (!Game_ClassicMode) Builder_SmoothLighting = Options_GetBool(OPT_SMOOTH_LIGHTING, false);
+	Builder_GreedyMeshing = Options_GetBool(OPT_GREEDY_MESHING, false);
+	InitFacePairs();
 	Builder_ApplyActive();
+	StartWorkers();
 }
 
 static void OnNewMapLoaded(void) {
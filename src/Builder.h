@@ -18,11 +18,30 @@ extern struct IGameComponent Builder_Component;
 extern int Builder_SidesLevel, Builder_EdgeLevel;
 /* Whether smooth/advanced lighting mesh builder is used. */
 extern cc_bool Builder_SmoothLighting;
+/* Whether faces of different blocks that look identical are merged together by the normal mesh builder. */
+/* NOTE: Faces of fully opaque blocks are also merged into rectangles, see Atlas1D_UseSingleTiles */
+extern cc_bool Builder_GreedyMeshing;
 
 /* Builds the mesh of vertices for the given chunk. */
 /* Returns false if vertex buffer allocation fails */
 cc_bool Builder_MakeChunk(struct ChunkInfo* info);
 
+/* Returns the number of worker threads that chunk meshes can currently be built on. */
+/* NOTE: Returns 0 when chunk meshes must be built on the main thread with Builder_MakeChunk */
+int Builder_WorkersCount(void);
+/* Queues the given chunk to have its mesh built on a worker thread. */
+/* Returns false if too many chunks are already queued */
+cc_bool Builder_QueueChunk(struct ChunkInfo* info);
+/* Returns a chunk whose mesh has finished being built on a worker thread, or NULL if none. */
+/* NOTE: Builder_UploadChunk must then be called on the returned chunk */
+struct ChunkInfo* Builder_NextBuiltChunk(void);
+/* Creates the vertex buffer for the chunk last returned by Builder_NextBuiltChunk */
+/* Returns false if vertex buffer allocation fails */
+cc_bool Builder_UploadChunk(struct ChunkInfo* info);
+/* Discards all queued chunks, after waiting for worker threads to finish building chunks. */
+/* NOTE: Must be called before changing any state that worker threads may be reading */
+void Builder_CancelChunks(void);
+
 void Builder_ApplyActive(void);
 
 CC_END_HEADER
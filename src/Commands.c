@@ -406,7 +406,9 @@ static void DrawOpCommand_Execute(void) {
 	if (!World_Contains(min.x, min.y, min.z)) return;
 	if (!World_Contains(max.x, max.y, max.z)) return;
 
+	Game_BeginBlockBatch();
 	drawOp_Func(min, max);
+	Game_EndBlockBatch();
 }
 
 static void DrawOpCommand_BlockChanged(void* obj, IVec3 coords, BlockID old, BlockID now) {
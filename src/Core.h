@@ -715,12 +715,42 @@ typedef cc_uint8  cc_bool;
 #undef CC_BUILD_PLUGINS
 #endif
 
+/* Chunk meshes can only be built on worker threads when thread local variables are supported */
+/* NOTE: Compressed world sections may be reallocated by the main thread while a worker is reading them */
+#if defined CC_BUILD_COOPTHREADED || defined CC_BUILD_LOWMEM || CC_GFX_BACKEND == CC_GFX_BACKEND_GL11 || defined CC_BUILD_COMPRESSEDWORLD
+	/* Chunk meshes are always built on the main thread */
+#elif defined _MSC_VER
+	#define CC_BUILD_THREADEDBUILDER
+	#define CC_THREADLOCAL __declspec(thread)
+#elif defined __GNUC__ && (defined CC_BUILD_WIN || defined CC_BUILD_LINUX || defined CC_BUILD_BSD || defined CC_BUILD_ANDROID)
+	#define CC_BUILD_THREADEDBUILDER
+	#define CC_THREADLOCAL __thread
+#elif defined __clang__ && defined CC_BUILD_MACOS
+	#define CC_BUILD_THREADEDBUILDER
+	#define CC_THREADLOCAL __thread
+#endif
+#ifndef CC_THREADLOCAL
+	#define CC_THREADLOCAL
+#endif
+
+/* SIMD instruction set used to process multiple values at once (e.g. by SoftGPU, noise generation and lighting) */
+/* NOTE: Define CC_BUILD_NOSIMD to always use the plain C loops instead */
+#if defined CC_BUILD_NOSIMD
+	/* Values are always processed one at a time */
+#elif defined __SSE2__ || defined _M_X64 || (defined _M_IX86_FP && _M_IX86_FP >= 2)
+	#define CC_BUILD_SSE2
+#elif defined __aarch64__ && defined __ARM_NEON
+	#define CC_BUILD_NEON
+#endif
+
 #ifdef CC_BUILD_NETWORKING
 	#define CUSTOM_MODELS
 #endif
 #ifndef CC_BUILD_LOWMEM
 	#define EXTENDED_BLOCKS
 #endif
+/* NOTE: Define CC_BUILD_COMPRESSEDWORLD to store the blocks of the world in palette compressed sections */
+/*  instead of flat arrays, which greatly reduces memory usage at the cost of slower block access (see World.h) */
 #ifndef CC_BUILD_TINYMEM
 	#define EXTENDED_TEXTURES
 #endif
@@ -14,7 +14,8 @@
 enum GzipState {
 	GZIP_STATE_HEADER1, GZIP_STATE_HEADER2, GZIP_STATE_COMPRESSIONMETHOD, GZIP_STATE_FLAGS,
 	GZIP_STATE_LASTMODIFIED, GZIP_STATE_COMPRESSIONFLAGS, GZIP_STATE_OPERATINGSYSTEM, 
-	GZIP_STATE_HEADERCHECKSUM, GZIP_STATE_FILENAME, GZIP_STATE_COMMENT, GZIP_STATE_DONE
+	GZIP_STATE_EXTRALENGTH, GZIP_STATE_EXTRA, GZIP_STATE_FILENAME, GZIP_STATE_COMMENT, 
+	GZIP_STATE_HEADERCHECKSUM, GZIP_STATE_DONE
 };
 
 void GZipHeader_Init(struct GZipHeader* header) {
@@ -22,6 +23,51 @@ void GZipHeader_Init(struct GZipHeader* header) {
 	header->done  = false;
 	header->flags = 0;
 	header->partsRead = 0;
+
+	header->extraLeft = 0;
+	header->fieldRead = 0;
+	header->value     = 0;
+	header->segments  = NULL;
+}
+
+/* Processes the next byte of the extra field, which is made up of subfields */
+/*  (2 byte ID, 2 byte length, then data) */
+static void GZipHeader_ParseExtra(struct GZipHeader* header, cc_uint8 value) {
+	struct GZipSegments* segs = header->segments;
+	cc_uint32 pos = header->fieldRead++;
+	cc_bool isIndex;
+	int idx;
+
+	if (pos == 0) { header->fieldLen = 0; header->value = 0; }
+	if (pos < 2)  { header->fieldID[pos] = value; return; }
+	if (pos < 4) {
+		header->fieldLen |= (cc_uint32)value << (8 * (pos - 2));
+		if (pos == 3 && !header->fieldLen) header->fieldRead = 0;
+		return;
+	}
+
+	/* 'CS' subfield is index of the compressed segments */
+	/*  (4 byte segment size, then 4 byte compressed size of each segment) */
+	isIndex = segs && header->fieldID[0] == 'C' && header->fieldID[1] == 'S';
+	pos -= 4;
+
+	if (isIndex) header->value |= (cc_uint32)value << (8 * (pos & 3));
+
+	if (isIndex && (pos & 3) == 3) {
+		idx = pos >> 2;
+		if (idx == 0) {
+			segs->Size = header->value;
+		} else if (idx <= GZIP_MAX_SEGMENTS) {
+			segs->Lens[idx - 1] = header->value;
+			segs->Count = idx;
+		}
+		header->value = 0;
+	}
+	if (pos + 1 != header->fieldLen) return;
+
+	header->fieldRead = 0;
+	/* Ignore malformed or truncated index */
+	if (isIndex && (header->fieldLen != 4 + segs->Count * 4 || !segs->Size)) segs->Count = 0;
 }
 
 cc_result GZipHeader_Read(struct Stream* s, struct GZipHeader* header) {
@@ -50,7 +96,6 @@ cc_result GZipHeader_Read(struct Stream* s, struct GZipHeader* header) {
 	case GZIP_STATE_FLAGS:
 		Header_ReadU8(tmp);
 		header->flags = tmp;
-		if (header->flags & 0x04) return GZIP_ERR_FLAGS;
 		header->state++;
 		
 	/* FALLTHRU */
@@ -70,6 +115,30 @@ cc_result GZipHeader_Read(struct Stream* s, struct GZipHeader* header) {
 	case GZIP_STATE_OPERATINGSYSTEM:
 		Header_ReadU8(tmp);
 		header->state++;
+		if (header->segments) header->segments->Count = 0;
+		
+	/* FALLTHRU */
+	case GZIP_STATE_EXTRALENGTH:
+		if (header->flags & 0x04) {
+			for (; header->partsRead < 2; header->partsRead++) {
+				Header_ReadU8(tmp);
+				header->extraLeft |= (cc_uint32)tmp << (8 * header->partsRead);
+			}
+		}
+		header->state++;
+		header->partsRead = 0;
+		header->fieldRead = 0;
+		header->fieldLen  = 0;
+		
+	/* FALLTHRU */
+	case GZIP_STATE_EXTRA:
+		for (; header->extraLeft; header->extraLeft--) {
+			Header_ReadU8(tmp);
+			GZipHeader_ParseExtra(header, tmp);
+		}
+		/* Ignore index if extra field ends partway through it */
+		if (header->fieldRead && header->segments) header->segments->Count = 0;
+		header->state++;
 		
 	/* FALLTHRU */
 	case GZIP_STATE_FILENAME:
@@ -106,6 +175,73 @@ cc_result GZipHeader_Read(struct Stream* s, struct GZipHeader* header) {
 }
 
 
+/*########################################################################################################################*
+*-------------------------------------------------------Segments----------------------------------------------------------*
+*#########################################################################################################################*/
+#if defined CC_BUILD_COMPRESSION
+/* Independently compressed segments are compressed/decompressed in parallel */
+/*  by having each thread repeatedly take the next unprocessed segment */
+static struct WorkerPool segs_pool;
+static cc_bool segs_workersStarted;
+static void* segs_ctx;
+static int segs_nextJob, segs_numJobs, segs_numWorkers;
+static cc_result segs_result;
+static void (*segs_process)(int job, int worker);
+
+static void Segments_WorkerLoop(int workerID) {
+	/* Calling thread is always worker 0 */
+	int job, worker = workerID + 1;
+	if (worker >= segs_numWorkers) return;
+
+	for (;;)
+	{
+		Mutex_Lock(segs_pool.mutex);
+		{
+			job = segs_nextJob++;
+		}
+		Mutex_Unlock(segs_pool.mutex);
+
+		if (job >= segs_numJobs) return;
+		segs_process(job, worker);
+	}
+}
+
+/* Starts the worker threads if not already, so that up to numThreads threads can process segments */
+/* NOTE: Must be called from the main thread */
+/* NOTE: The number of worker threads is fixed by the first call, so later calls can't increase it */
+static void Segments_StartWorkers(int numThreads) {
+	if (segs_workersStarted) return;
+	segs_workersStarted = true;
+
+	/* The calling thread processes segments too */
+	WorkerPool_Start(&segs_pool, numThreads - 1, Segments_WorkerLoop, 256 * 1024, "Deflate segments");
+}
+
+/* Records the first error that occurred while processing a segment */
+static void Segments_Fail(cc_result res) {
+	Mutex_Lock(segs_pool.mutex);
+	{
+		if (!segs_result) segs_result = res;
+	}
+	Mutex_Unlock(segs_pool.mutex);
+}
+
+/* Processes the given number of segments using up to numThreads threads (including the calling thread) */
+/* NOTE: worker passed to process is always less than numThreads */
+static cc_result Segments_Run(int numJobs, int numThreads, void* ctx, void (*process)(int job, int worker)) {
+	segs_ctx        = ctx;
+	segs_process    = process;
+	segs_numJobs    = numJobs;
+	segs_numWorkers = min(numThreads, numJobs);
+	segs_nextJob    = 0;
+	segs_result     = 0;
+
+	WorkerPool_Run(&segs_pool);
+	return segs_result;
+}
+#endif
+
+
 /*########################################################################################################################*
 *--------------------------------------------------Inflate (decompress)---------------------------------------------------*
 *#########################################################################################################################*/
@@ -121,6 +257,12 @@ void Inflate_Process(struct InflateState* s) {
 void Inflate_MakeStream2(struct Stream* stream, struct InflateState* state, struct Stream* underlying) {
 	Process_Abort("Should never be called");
 }
+
+cc_result Inflate_MakeSegmentedStream(struct Stream* stream, struct InflateState* state, struct Stream* underlying,
+										const struct GZipSegments* index, int numThreads) {
+	Process_Abort("Should never be called");
+	return 0;
+}
 #else
 enum INFLATE_STATE_ {
 	INFLATE_STATE_HEADER, INFLATE_STATE_UNCOMPRESSED_HEADER,
@@ -155,8 +297,9 @@ enum INFLATE_STATE_ {
 #define Inflate_NextCompressState(state) ((state->AvailIn >= INFLATE_FASTINF_IN && state->AvailOut >= INFLATE_FASTINF_OUT) ? INFLATE_STATE_FASTCOMPRESSED : INFLATE_STATE_COMPRESSED_LIT)
 /* The maximum amount of bytes that can be output is 258 */
 #define INFLATE_FASTINF_OUT 258
-/* The most input bytes required for huffman codes and extra data is 16 + 5 + 16 + 13 bits. Add 3 extra bytes to account for putting data into the bit buffer. */
-#define INFLATE_FASTINF_IN 10
+/* The most input bytes required for huffman codes and extra data is 15 + 5 + 15 + 13 bits. */
+/* However, refilling the bit buffer may read up to 8 bytes at once, so leave plenty of room */
+#define INFLATE_FASTINF_IN 16
 
 static cc_uint32 Huffman_ReverseBits(cc_uint32 n, cc_uint8 bits) {
 	n = ((n & 0xAAAA) >> 1) | ((n & 0x5555) << 1);
@@ -287,43 +430,27 @@ static int Huffman_Decode(struct InflateState* state, struct HuffmanTable* table
 	return -1;
 }
 
-/* Inline the common <= 9 bits case */
-#define Huffman_UNSAFE_Decode(state, table, result) \
-{\
-	Inflate_UNSAFE_EnsureBits(state, INFLATE_MAX_BITS);\
-	packed = table.fast[Inflate_PeekBits(state, INFLATE_FAST_BITS)];\
-	if (packed >= 0) {\
-		consumedBits = packed >> INFLATE_FAST_BITS;\
-		Inflate_ConsumeBits(state, consumedBits);\
-		result = packed & 0x1FF;\
-	} else {\
-		result = Huffman_UNSAFE_Decode_Slow(state, &table);\
-	}\
-}
-
-static int Huffman_UNSAFE_Decode_Slow(struct InflateState* state, struct HuffmanTable* table) {
-	cc_uint32 i, j, codeword;
+/* Decodes a codeword longer than INFLATE_FAST_BITS from the given bits */
+/* Returns the value, and sets codeLen to length of the codeword (or 0 if codeword is invalid) */
+static int Huffman_DecodeSlow(struct HuffmanTable* table, cc_uint32 bits, cc_uint32* codeLen) {
+	cc_uint32 i, codeword;
 	int offset;
 
 	/* Slow, bit by bit lookup. Need to reverse order for huffman. */
-	codeword = Inflate_PeekBits(state,       INFLATE_FAST_BITS);
+	codeword = bits & ((1 << INFLATE_FAST_BITS) - 1);
 	codeword = Huffman_ReverseBits(codeword, INFLATE_FAST_BITS);
 
-	for (i = INFLATE_FAST_BITS + 1, j = INFLATE_FAST_BITS; i < INFLATE_MAX_BITS; i++, j++) {
-		codeword = (codeword << 1) | ((state->Bits >> j) & 1);
+	for (i = INFLATE_FAST_BITS + 1; i < INFLATE_MAX_BITS; i++) {
+		codeword = (codeword << 1) | ((bits >> (i - 1)) & 1);
 
 		if (codeword < table->endCodewords[i]) {
-			offset = table->firstOffsets[i] + (codeword - table->firstCodewords[i]);
-			Inflate_ConsumeBits(state, i);
+			offset   = table->firstOffsets[i] + (codeword - table->firstCodewords[i]);
+			*codeLen = i;
 			return table->values[offset];
 		}
 	}
 
-	Inflate_Fail(state, INF_ERR_INVALID_CODE);
-	/* Need to exit the fast decode loop */
-	/* TODO: This means a few garbage bytes can get written */
-	/* to the output, but it probably doesn't matter */
-	state->AvailIn = 0;
+	*codeLen = 0;
 	return 0;
 }
 
@@ -380,80 +507,169 @@ static const cc_uint8 codelens_order[INFLATE_MAX_CODELENS] = {
 	16,17,18,0,8,7,9,6,10,5,11,4,12,3,13,2,14,1,15 
 };
 
+/* Layout of an entry in the combined literal/length lookup table (FastLits): */
+/*  bits 0-3 = codeword length, bits 4-7 = number of extra length bits, */
+/*  bits 8-9 = type of entry, bits 16-31 = literal value or base length */
+#define INFLATE_ENTRY_SLOW 0 /* Codeword longer than INFLATE_FAST_BITS (or invalid) */
+#define INFLATE_ENTRY_LIT  1
+#define INFLATE_ENTRY_LEN  2
+#define INFLATE_ENTRY_END  3
+#define Inflate_EntryType(entry) (((entry) >> 8) & 0x03)
+
+static cc_uint32 Inflate_MakeLitEntry(int value, cc_uint32 codeLen) {
+	if (value < 256)  return (value << 16) | (INFLATE_ENTRY_LIT << 8) | codeLen;
+	if (value == 256) return (INFLATE_ENTRY_END << 8) | codeLen;
+
+	value -= 257;
+	if (value >= 29) return INFLATE_ENTRY_SLOW;
+	return (len_base[value] << 16) | (INFLATE_ENTRY_LEN << 8) | (len_bits[value] << 4) | codeLen;
+}
+
+/* Builds combined literal/length lookup table from the fast table of literals huffman table */
+static void Inflate_BuildFastLits(struct InflateState* s) {
+	int i, packed;
+
+	for (i = 0; i < Array_Elems(s->FastLits); i++) {
+		packed = s->Table.Lits.fast[i];
+
+		if (packed < 0) {
+			s->FastLits[i] = INFLATE_ENTRY_SLOW;
+		} else {
+			s->FastLits[i] = Inflate_MakeLitEntry(packed & INFLATE_FAST_VAL_MASK, packed >> INFLATE_FAST_LEN_SHIFT);
+		}
+	}
+}
+
+/* Copies recently output data into the window */
+static void Inflate_UpdateWindow(struct InflateState* s, cc_uint8* data, cc_uint32 len) {
+	cc_uint32 partLen;
+
+	if (len >= INFLATE_WINDOW_SIZE) {
+		Mem_Copy(s->Window, data + (len - INFLATE_WINDOW_SIZE), INFLATE_WINDOW_SIZE);
+		s->WindowIndex = 0;
+		return;
+	}
+
+	partLen = INFLATE_WINDOW_SIZE - s->WindowIndex;
+	partLen = min(partLen, len);
+	Mem_Copy(&s->Window[s->WindowIndex], data, partLen);
+	/* Wrap around remainder of copy to start from beginning of window */
+	Mem_Copy(s->Window, data + partLen, len - partLen);
+	s->WindowIndex = (s->WindowIndex + len) & INFLATE_WINDOW_MASK;
+}
+
+/* The fast decoder uses a bit buffer as wide as a machine word (i.e. 64 bits on 64 bit systems) */
+typedef cc_uintptr Inflate_BitBuffer;
+#define INFLATE_BITBUF_BITS (sizeof(Inflate_BitBuffer) * 8)
+/* Fills bit buffer with as many whole bytes as possible */
+#define Inflate_FastRefill() while (numBits <= INFLATE_BITBUF_BITS - 8) { bits |= (Inflate_BitBuffer)(*in++) << numBits; numBits += 8; }
+/* Consumes/eats up bits from the fast decoder bit buffer */
+#define Inflate_FastConsume(count) bits >>= (count); numBits -= (count);
+
+/* Decodes huffman compressed data directly into the output buffer */
+/* NOTE: Must only be called when there is at least INFLATE_FASTINF_IN input and INFLATE_FASTINF_OUT output space */
 static void Inflate_InflateFast(struct InflateState* s) {
-	/* huffman variables */
-	cc_uint32 lit, len, dist;
-	cc_uint32 bits, lenIdx, distIdx;
-	int packed, consumedBits;
+	Inflate_BitBuffer bits = s->Bits;
+	cc_uint32 numBits      = s->NumBits;
+	cc_uint8* in    = s->NextIn;
+	cc_uint8* inEnd = s->NextIn + (s->AvailIn - INFLATE_FASTINF_IN);
+	cc_uint8* out    = s->Output;
+	cc_uint8* outEnd = s->Output + (s->AvailOut - INFLATE_FASTINF_OUT);
+	cc_uint8* window = s->Window;
+	cc_uint8* src;
+
+	cc_uint32 entry, codeLen, extra;
+	cc_uint32 len, dist, avail, i, idx;
+	int packed, value;
+
+	while (in <= inEnd && out <= outEnd) {
+		Inflate_FastRefill();
+		entry = s->FastLits[bits & ((1 << INFLATE_FAST_BITS) - 1)];
+
+		if (Inflate_EntryType(entry) == INFLATE_ENTRY_SLOW) {
+			value = Huffman_DecodeSlow(&s->Table.Lits, (cc_uint32)bits, &codeLen);
+			entry = codeLen ? Inflate_MakeLitEntry(value, codeLen) : INFLATE_ENTRY_SLOW;
+			if (Inflate_EntryType(entry) == INFLATE_ENTRY_SLOW) { Inflate_Fail(s, INF_ERR_INVALID_CODE); break; }
+		}
+		Inflate_FastConsume(entry & 0x0F);
 
-	/* window variables */
-	cc_uint8* window;
-	cc_uint32 i, curIdx, startIdx;
-	cc_uint32 copyStart, copyLen, partLen;
+		if (Inflate_EntryType(entry) == INFLATE_ENTRY_LIT) {
+			*out++ = (cc_uint8)(entry >> 16);
+			continue;
+		} else if (Inflate_EntryType(entry) == INFLATE_ENTRY_END) {
+			s->State = Inflate_NextBlockState(s);
+			break;
+		}
 
-	window = s->Window;
-	curIdx = s->WindowIndex;
-	copyStart = s->WindowIndex;
-	copyLen   = 0;
+		/* Length extra bits count and base were already decoded by the lookup table */
+		extra = (entry >> 4) & 0x0F;
+		len   = (entry >> 16) + (cc_uint32)(bits & ((1UL << extra) - 1));
+		Inflate_FastConsume(extra);
+		if (INFLATE_BITBUF_BITS < 64) { Inflate_FastRefill(); }
 
-#define INFLATE_FAST_COPY_MAX (INFLATE_WINDOW_SIZE - INFLATE_FASTINF_OUT)
-	while (s->AvailOut >= INFLATE_FASTINF_OUT && s->AvailIn >= INFLATE_FASTINF_IN && copyLen < INFLATE_FAST_COPY_MAX) {
-		Huffman_UNSAFE_Decode(s, s->Table.Lits, lit);
+		packed = s->TableDists.fast[bits & ((1 << INFLATE_FAST_BITS) - 1)];
+		if (packed >= 0) {
+			value   = packed & INFLATE_FAST_VAL_MASK;
+			codeLen = packed >> INFLATE_FAST_LEN_SHIFT;
+		} else {
+			value = Huffman_DecodeSlow(&s->TableDists, (cc_uint32)bits, &codeLen);
+			if (!codeLen) { Inflate_Fail(s, INF_ERR_INVALID_CODE); break; }
+		}
+		if (value >= 30) { Inflate_Fail(s, INF_ERR_INVALID_CODE); break; }
+		Inflate_FastConsume(codeLen);
+		if (INFLATE_BITBUF_BITS < 64) { Inflate_FastRefill(); }
 
-		if (lit <= 256) {
-			if (lit < 256) {
-				window[curIdx] = (cc_uint8)lit;
-				s->AvailOut--; copyLen++;
-				curIdx = (curIdx + 1) & INFLATE_WINDOW_MASK;
-			} else {
-				s->State = Inflate_NextBlockState(s);
-				break;
+		extra = dist_bits[value];
+		dist  = dist_base[value] + (cc_uint32)(bits & ((1UL << extra) - 1));
+		Inflate_FastConsume(extra);
+
+		/* If match starts before the data output by this call, copy that part from the window */
+		avail = (cc_uint32)(out - s->Output);
+		if (dist > avail) {
+			/* Window infinitely repeats like ...xyz|uvwxyz|uvwxyz|uvw... */
+			idx = (s->WindowIndex - (dist - avail)) & INFLATE_WINDOW_MASK;
+			for (i = min(len, dist - avail); i > 0; i--, len--) {
+				*out++ = window[idx];
+				idx    = (idx + 1) & INFLATE_WINDOW_MASK;
 			}
+		}
+
+		src = out - dist;
+		if (len < 16) {
+			/* NOTE: Source and destination may overlap, so must copy forwards byte by byte */
+			for (i = 0; i < (len & ~0x3); i += 4) {
+				*out++ = *src++; *out++ = *src++; *out++ = *src++; *out++ = *src++;
+			}
+			for (; i < len; i++) { *out++ = *src++; }
+		} else if (dist == 1) {
+			Mem_Set(out, *src, len);
+			out += len;
 		} else {
-			lenIdx = lit - 257;
-			bits = len_bits[lenIdx];
-			Inflate_UNSAFE_EnsureBits(s, bits);
-			len  = len_base[lenIdx] + Inflate_ReadBits(s, bits);
-
-			Huffman_UNSAFE_Decode(s, s->TableDists, distIdx);
-			bits = dist_bits[distIdx];
-			Inflate_UNSAFE_EnsureBits(s, bits);
-			dist = dist_base[distIdx] + Inflate_ReadBits(s, bits);
-	
-			/* Window infinitely repeats like ...xyz|uvwxyz|uvwxyz|uvw... */
-			/* If start and end don't cross a boundary, can avoid masking index */
-			startIdx = (curIdx - dist) & INFLATE_WINDOW_MASK;
-			if (curIdx >= startIdx && (curIdx + len) < INFLATE_WINDOW_SIZE) {
-				cc_uint8* src = &window[startIdx]; 
-				cc_uint8* dst = &window[curIdx];
-
-				for (i = 0; i < (len & ~0x3); i += 4) {
-					*dst++ = *src++; *dst++ = *src++; *dst++ = *src++; *dst++ = *src++;
-				}
-				for (; i < len; i++) { *dst++ = *src++; }
-			} else {
-				for (i = 0; i < len; i++) {
-					window[(curIdx + i) & INFLATE_WINDOW_MASK] = window[(startIdx + i) & INFLATE_WINDOW_MASK];
-				}
+			/* Data repeats every 'dist' bytes, so copy in non overlapping chunks */
+			/*  (chunk size doubles every copy, since the repeated data doubles too) */
+			for (; len > 0; len -= i, out += i) {
+				i = (cc_uint32)(out - src);
+				i = min(i, len);
+				Mem_Copy(out, src, i);
 			}
-			curIdx = (curIdx + len) & INFLATE_WINDOW_MASK;
-			s->AvailOut -= len; copyLen += len;
 		}
 	}
 
-	s->WindowIndex = curIdx;
-	if (!copyLen) return;
-
-	if (copyStart + copyLen < INFLATE_WINDOW_SIZE) {
-		Mem_Copy(s->Output, &s->Window[copyStart], copyLen);
-		s->Output += copyLen;
-	} else {
-		partLen = INFLATE_WINDOW_SIZE - copyStart;
-		Mem_Copy(s->Output, &s->Window[copyStart], partLen);
-		s->Output += partLen;
-		Mem_Copy(s->Output, s->Window, copyLen - partLen);
-		s->Output += (copyLen - partLen);
+	/* Return whole bytes that were read into bit buffer, but not used */
+	i = min(numBits >> 3, (cc_uint32)(in - s->NextIn));
+	if (i) {
+		in -= i; numBits -= i * 8;
+		bits &= ((Inflate_BitBuffer)1 << numBits) - 1;
 	}
+	s->Bits    = (cc_uint32)bits;
+	s->NumBits = numBits;
+	s->AvailIn -= (cc_uint32)(in - s->NextIn);
+	s->NextIn   = in;
+
+	len = (cc_uint32)(out - s->Output);
+	Inflate_UpdateWindow(s, s->Output, len);
+	s->Output   += len;
+	s->AvailOut -= len;
 }
 
 void Inflate_Process(struct InflateState* s) {
@@ -488,6 +704,7 @@ void Inflate_Process(struct InflateState* s) {
 			case 1: { /* Fixed/static huffman compressed */
 				(void)Huffman_Build(&s->Table.Lits, fixed_lits,  INFLATE_MAX_LITS);
 				(void)Huffman_Build(&s->TableDists, fixed_dists, INFLATE_MAX_DISTS);
+				Inflate_BuildFastLits(s);
 				s->State = Inflate_NextCompressState(s);
 			} break;
 
@@ -600,6 +817,7 @@ void Inflate_Process(struct InflateState* s) {
 				if (res) { Inflate_Fail(s, res); return; }
 				res = Huffman_Build(&s->TableDists, s->Buffer + s->NumLits, s->NumDists);
 				if (res) { Inflate_Fail(s, res); return; }
+				Inflate_BuildFastLits(s);
 			}
 			break;
 		}
@@ -768,6 +986,141 @@ void Inflate_MakeStream2(struct Stream* stream, struct InflateState* state, stru
 	stream->meta.inflate = state;
 	stream->Read = Inflate_StreamRead;
 }
+
+
+struct InflateSegments {
+	struct GZipSegments Index;
+	cc_uint32 Offsets[GZIP_MAX_SEGMENTS]; /* Offset of each segment within Data */
+	cc_uint8* Data;   /* Compressed data of all the segments */
+	int NumThreads;
+	int Cur;          /* Segment currently being read from */
+	cc_uint32 Pos;    /* Uncompressed position within current segment */
+	struct Stream Source, Inflater;
+	struct InflateState* Workers[GZIP_MAX_THREADS];
+	cc_uint8* Output; /* Destination of segments being decompressed in parallel */
+};
+
+/* Starts decompressing current segment on the calling thread */
+static void InflateSegments_Begin(struct InflateSegments* s) {
+	int i = s->Cur;
+	Stream_ReadonlyMemory(&s->Source, s->Data + s->Offsets[i], s->Index.Lens[i]);
+	Inflate_MakeStream2(&s->Inflater, s->Workers[0], &s->Source);
+}
+
+static void InflateSegments_Process(int job, int worker) {
+	struct InflateSegments* s = (struct InflateSegments*)segs_ctx;
+	struct Stream src, comp;
+	int i = s->Cur + job;
+	cc_result res;
+
+	Stream_ReadonlyMemory(&src, s->Data + s->Offsets[i], s->Index.Lens[i]);
+	Inflate_MakeStream2(&comp, s->Workers[worker], &src);
+
+	res = Stream_Read(&comp, s->Output + (cc_uintptr)job * s->Index.Size, s->Index.Size);
+	if (res) Segments_Fail(res);
+}
+
+/* Decompresses the next num segments directly into data in parallel */
+static cc_result InflateSegments_Batch(struct InflateSegments* s, cc_uint8* data, int num) {
+	int i;
+	for (i = 1; i < s->NumThreads; i++)
+	{
+		if (s->Workers[i]) continue;
+		s->Workers[i] = (struct InflateState*)Mem_TryAlloc(1, sizeof(struct InflateState));
+		/* Just use less threads if out of memory */
+		if (!s->Workers[i]) { s->NumThreads = i; break; }
+	}
+
+	s->Output = data;
+	return Segments_Run(num, s->NumThreads, s, InflateSegments_Process);
+}
+
+static cc_result InflateSegments_StreamRead(struct Stream* stream, cc_uint8* data, cc_uint32 count, cc_uint32* modified) {
+	struct InflateSegments* s = (struct InflateSegments*)stream->meta.inflate;
+	cc_uint32 size = s->Index.Size, read;
+	int num, last  = s->Index.Count - 1;
+	cc_result res;
+	*modified = 0;
+
+	while (count > 0) {
+		/* Whole segments can be decompressed in parallel straight into the destination */
+		if (!s->Pos && s->Cur < last && count >= size) {
+			num = min(count / size, (cc_uint32)(last - s->Cur));
+			if ((res = InflateSegments_Batch(s, data, num))) return res;
+
+			s->Cur += num;
+			read    = num * size;
+		} else {
+			if (!s->Pos) InflateSegments_Begin(s);
+			/* Size of last segment isn't known in advance */
+			read = s->Cur < last ? min(count, size - s->Pos) : count;
+
+			res = s->Inflater.Read(&s->Inflater, data, read, &read);
+			if (res)   return res;
+			if (!read) return 0;
+
+			s->Pos += read;
+			if (s->Cur < last && s->Pos == size) { s->Cur++; s->Pos = 0; }
+		}
+
+		data  += read;
+		count -= read;
+		*modified += read;
+	}
+	return 0;
+}
+
+static cc_result InflateSegments_StreamClose(struct Stream* stream) {
+	struct InflateSegments* s = (struct InflateSegments*)stream->meta.inflate;
+	int i;
+
+	for (i = 1; i < GZIP_MAX_THREADS; i++)
+	{
+		if (s->Workers[i]) Mem_Free(s->Workers[i]);
+	}
+	Mem_Free(s->Data);
+	Mem_Free(s);
+	return 0;
+}
+
+cc_result Inflate_MakeSegmentedStream(struct Stream* stream, struct InflateState* state, struct Stream* underlying,
+										const struct GZipSegments* index, int numThreads) {
+	struct InflateSegments* s;
+	cc_uint32 total = 0;
+	cc_result res;
+	int i;
+
+	s = (struct InflateSegments*)Mem_TryAllocCleared(1, sizeof(struct InflateSegments));
+	if (!s) { Inflate_MakeStream2(stream, state, underlying); return 0; }
+	
+	for (i = 0; i < index->Count; i++)
+	{
+		if (index->Lens[i] >= 0x7FFFFFFFUL - total) break; /* bogus index */
+		s->Offsets[i] = total;
+		total += index->Lens[i];
+	}
+
+	/* Segments are still a valid DEFLATE stream, so fallback to decompressing normally */
+	if (i < index->Count || !(s->Data = (cc_uint8*)Mem_TryAlloc(total + 1, 1))) {
+		Mem_Free(s);
+		Inflate_MakeStream2(stream, state, underlying); return 0;
+	}
+
+	if ((res = Stream_Read(underlying, s->Data, total))) {
+		Mem_Free(s->Data); Mem_Free(s); return res;
+	}
+
+	s->Index      = *index;
+	s->NumThreads = max(1, min(numThreads, GZIP_MAX_THREADS));
+	s->Workers[0] = state;
+	Segments_StartWorkers(s->NumThreads);
+
+	Stream_Init(stream);
+	stream->meta.inflate = s;
+	stream->Read  = InflateSegments_StreamRead;
+	stream->Close = InflateSegments_StreamClose;
+	return 0;
+}
 #endif
 
 
@@ -778,6 +1131,13 @@ void Inflate_MakeStream2(struct Stream* stream, struct InflateState* state, stru
 void GZip_MakeStream(struct Stream* stream, struct GZipState* state, struct Stream* underlying) { 
 	Process_Abort("Should never be called");
 }
+
+void GZip_MakeParallelStream(struct Stream* stream, struct GZipParallelState* state, 
+							struct Stream* underlying, int level, int numThreads) {
+	Process_Abort("Should never be called");
+}
+
+void GZip_FreeParallelStream(struct GZipParallelState* state) { }
 #else
 
 /* these are copies of len_base and dist_base, with UINT16_MAX instead of 0 for sentinel cutoff */
@@ -792,12 +1152,19 @@ static const cc_uint16 deflate_dist[31] = {
 	1025,1537,2049,3073,4097,6145,8193,12289,16385,24577,UInt16_MaxValue
 };
 
+/* Literal/length symbol (minus 257) for each match length (minus 3) */
+static cc_uint8 deflate_lenCodes[256];
+/* Distance symbol for distances 1 to 256 (at dist - 1), and for larger distances (at 256 + ((dist - 1) >> 7)) */
+static cc_uint8 deflate_distCodes[512];
+static cc_bool deflate_tablesInited;
+#define Deflate_DistCode(dist) ((dist) <= 256 ? deflate_distCodes[(dist) - 1] : deflate_distCodes[256 + (((dist) - 1) >> 7)])
+
 /* Pushes given bits, but does not write them */
 #define Deflate_PushBits(state, value, bits) state->Bits |= (value) << state->NumBits; state->NumBits += (bits);
 /* Pushes bits of the huffman codeword bits for the given literal, but does not write them */
 #define Deflate_PushLit(state, value) Deflate_PushBits(state, state->LitsCodewords[value], state->LitsLens[value])
-/* Pushes given bits (reversing for huffman code), but does not write them */
-#define Deflate_PushHuff(state, value, bits) Deflate_PushBits(state, Huffman_ReverseBits(value, bits), bits)
+/* Pushes bits of the huffman codeword bits for the given distance, but does not write them */
+#define Deflate_PushDist(state, value) Deflate_PushBits(state, state->DistsCodewords[value], state->DistsLens[value])
 /* Writes given byte to output */
 #define Deflate_WriteByte(state) *state->NextOut++ = state->Bits; state->AvailOut--; state->Bits >>= 8; state->NumBits -= 8;
 /* Flushes bits in buffer to output buffer */
@@ -805,6 +1172,25 @@ static const cc_uint16 deflate_dist[31] = {
 
 #define MIN_MATCH_LEN 3
 #define MAX_MATCH_LEN 258
+/* Matches of MIN_MATCH_LEN further away than this usually need more bits than 3 literals */
+#define DEFLATE_TOO_FAR 4096
+#define DEFLATE_EOB 256
+
+static void Deflate_InitTables(void) {
+	int i, j, dist;
+	if (deflate_tablesInited) return;
+
+	for (i = 0, j = 0; i < Array_Elems(deflate_lenCodes); i++) {
+		while (i + MIN_MATCH_LEN >= deflate_len[j + 1]) j++;
+		deflate_lenCodes[i] = j;
+	}
+	for (i = 0; i < Array_Elems(deflate_distCodes); i++) {
+		dist = i < 256 ? i + 1 : ((i - 256) << 7) + 1;
+		for (j = 0; dist >= deflate_dist[j + 1]; j++);
+		deflate_distCodes[i] = j;
+	}
+	deflate_tablesInited = true;
+}
 
 /* Number of bytes that match (are the same) from a and b */
 static int Deflate_MatchLen(cc_uint8* a, cc_uint8* b, int maxLen) {
@@ -815,133 +1201,398 @@ static int Deflate_MatchLen(cc_uint8* a, cc_uint8* b, int maxLen) {
 
 /* Hashes 3 bytes of data */
 static cc_uint32 Deflate_Hash(cc_uint8* src) {
-	return (cc_uint32)((src[0] << 8) ^ (src[1] << 4) ^ (src[2])) & DEFLATE_HASH_MASK;
+	cc_uint32 value = (src[0] << 16) | (src[1] << 8) | src[2];
+	return (cc_uint32)(value * 0x9E3779B1UL) >> (32 - DEFLATE_HASH_BITS);
 }
 
-/* Writes a literal to state->Output */
-static void Deflate_Lit(struct DeflateState* state, int lit) {
-	Deflate_PushLit(state, lit);
-	Deflate_FlushBits(state);
+/* Inserts the data at the given position into the hash chains */
+static CC_INLINE void Deflate_Insert(struct DeflateState* state, int pos) {
+	cc_uint32 hash = Deflate_Hash(&state->Input[pos]);
+	state->Prev[pos]  = state->Head[hash];
+	state->Head[hash] = pos;
 }
 
-/* Writes a length-distance pair to state->Output */
-static void Deflate_LenDist(struct DeflateState* state, int len, int dist) {
-	int j;
-	/* TODO: Do we actually need the if (len_bits[j]) ????????? does writing 0 bits matter??? */
+/* Finds the longest previous match for the data at the given position */
+/* Returns length of the match, which is less than MIN_MATCH_LEN if there is no match */
+static int Deflate_FindMatch(struct DeflateState* state, int cur, int maxLen, int* matchPos) {
+	cc_uint8* input = state->Input;
+	cc_uint8* src   = input + cur;
+	int bestLen = MIN_MATCH_LEN - 1;
+	int pos, len, depth;
+
+	pos = state->Head[Deflate_Hash(src)];
+	for (depth = 0; pos != 0 && depth < state->MaxChainLen; depth++) {
+		/* Quickly reject matches that can't be longer than the current best match */
+		if (input[pos + bestLen] == src[bestLen] && input[pos] == src[0]) {
+			len = Deflate_MatchLen(&input[pos], src, maxLen);
+
+			if (len > bestLen) {
+				bestLen = len; *matchPos = pos;
+				if (len >= state->NiceLen || len == maxLen) break;
+			}
+		}
+		pos = state->Prev[pos];
+	}
+	return bestLen;
+}
 
-	for (j = 0; len >= deflate_len[j + 1]; j++);
-	Deflate_PushLit(state, j + 257);
-	if (len_bits[j]) { Deflate_PushBits(state, len - deflate_len[j], len_bits[j]); }
-	Deflate_FlushBits(state);
+static void Deflate_RecordLit(struct DeflateState* state, int lit) {
+	state->SymLens[state->NumSymbols]  = lit;
+	state->SymDists[state->NumSymbols] = 0;
+	state->NumSymbols++;
+	state->LitsFreqs[lit]++;
+}
+
+static void Deflate_RecordMatch(struct DeflateState* state, int len, int dist) {
+	state->SymLens[state->NumSymbols]  = len - MIN_MATCH_LEN;
+	state->SymDists[state->NumSymbols] = dist;
+	state->NumSymbols++;
+	state->LitsFreqs[257 + deflate_lenCodes[len - MIN_MATCH_LEN]]++;
+	state->DistsFreqs[Deflate_DistCode(dist)]++;
+}
+
+/* Writes the Output buffer to the destination stream */
+static cc_result Deflate_WriteOutput(struct DeflateState* state) {
+	cc_result res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
+	state->NextOut  = state->Output;
+	state->AvailOut = DEFLATE_OUT_SIZE;
+	return res;
+}
+/* Leave room in Output buffer for at least a few symbols */
+#define DEFLATE_OUT_MARGIN 32
+
+
+/* Computes length limited huffman code lengths for the given symbol frequencies */
+static void Deflate_BuildLengths(const cc_uint32* freqs, int count, int maxBits, cc_uint8* lens) {
+	cc_uint16 syms[INFLATE_MAX_LITS];
+	cc_uint32 A[INFLATE_MAX_LITS];
+	int bl_count[INFLATE_MAX_BITS];
+	int root, leaf, next, avail, used, depth;
+	int i, j, n = 0;
+	cc_uint32 freq, total;
+
+	/* Sort used symbols by frequency (ascending) */
+	for (i = 0; i < count; i++) {
+		lens[i] = 0;
+		if (!(freq = freqs[i])) continue;
+
+		for (j = n; j > 0 && A[j - 1] > freq; j--) {
+			A[j] = A[j - 1]; syms[j] = syms[j - 1];
+		}
+		A[j] = freq; syms[j] = i; n++;
+	}
+
+	/* Always use at least 2 codewords, as some decoders reject a single codeword */
+	if (n < 2) {
+		lens[0] = 1;
+		lens[(n && syms[0]) ? syms[0] : 1] = 1;
+		return;
+	}
+
+	/* Calculate optimal code lengths in place, based off the algorithm from */
+	/*  "In-Place Calculation of Minimum-Redundancy Codes" by Moffat and Katajainen */
+	/* First pass turns frequencies into the tree of parent node indices */
+	A[0] += A[1]; root = 0; leaf = 2;
+	for (next = 1; next < n - 1; next++) {
+		if (leaf >= n || A[root] < A[leaf]) {
+			A[next] = A[root]; A[root++] = next;
+		} else {
+			A[next] = A[leaf++];
+		}
+
+		if (leaf >= n || (root < next && A[root] < A[leaf])) {
+			A[next] += A[root]; A[root++] = next;
+		} else {
+			A[next] += A[leaf++];
+		}
+	}
+
+	/* Second pass turns parent node indices into node depths */
+	A[n - 2] = 0;
+	for (next = n - 3; next >= 0; next--) { A[next] = A[A[next]] + 1; }
+
+	/* Third pass turns node depths into leaf depths (i.e. code lengths) */
+	avail = 1; used = 0; depth = 0;
+	root  = n - 2; next = n - 1;
+	while (avail > 0) {
+		while (root >= 0 && (int)A[root] == depth) { used++; root--; }
+		while (avail > used) { A[next--] = depth; avail--; }
+		avail = 2 * used; depth++; used = 0;
+	}
+
+	/* Clamp code lengths to maxBits, then lengthen shorter codes until the code is no longer over-subscribed */
+	for (i = 0; i <= maxBits; i++) bl_count[i] = 0;
+	for (i = 0; i < n; i++) bl_count[min((int)A[i], maxBits)]++;
+
+	total = 0;
+	for (i = 1; i <= maxBits; i++) total += (cc_uint32)bl_count[i] << (maxBits - i);
+
+	while (total > (1UL << maxBits)) {
+		bl_count[maxBits]--;
+		for (i = maxBits - 1; i > 0; i--) {
+			if (!bl_count[i]) continue;
+			bl_count[i]--; bl_count[i + 1] += 2; break;
+		}
+		total--;
+	}
 
-	for (j = 0; dist >= deflate_dist[j + 1]; j++);
-	Deflate_PushHuff(state, j, 5);
-	if (dist_bits[j]) { Deflate_PushBits(state, dist - deflate_dist[j], dist_bits[j]); }
+	/* Least frequent symbols get the longest codes */
+	for (i = maxBits, j = 0; i > 0; i--) {
+		for (n = bl_count[i]; n > 0; n--) { lens[syms[j++]] = i; }
+	}
+}
+
+/* Constructs a huffman encoding table (for values to codewords) */
+static void Deflate_BuildTable(const cc_uint8* lens, int count, cc_uint16* codewords, cc_uint8* bitlens) {
+	int i, j, offset, codeword;
+	struct HuffmanTable table;
+
+	/* NOTE: Can ignore since lens table is not user controlled */
+	(void)Huffman_Build(&table, lens, count);
+	for (i = 0; i < INFLATE_MAX_BITS; i++) {
+		if (!table.endCodewords[i]) continue;
+		count = table.endCodewords[i] - table.firstCodewords[i];
+
+		for (j = 0; j < count; j++) {
+			offset   = table.values[table.firstOffsets[i] + j];
+			codeword = table.firstCodewords[i] + j;
+			bitlens[offset]   = i;
+			codewords[offset] = Huffman_ReverseBits(codeword, i);
+		}
+	}
+}
+
+/* Run length encodes the code lengths of the literal/length and distance huffman codes */
+/* Returns the number of code length symbols produced */
+static int Deflate_EncodeLens(const cc_uint8* lens, int count, cc_uint8* codes, cc_uint8* extra, cc_uint32* freqs) {
+	int i, j, len, run, rep, n = 0;
+	#define Deflate_AddCode(code, value) codes[n] = code; extra[n] = value; freqs[code]++; n++;
+
+	for (i = 0; i < count; i = j) {
+		len = lens[i];
+		for (j = i + 1; j < count && lens[j] == len; j++);
+		run = j - i;
+
+		if (len == 0 && run >= 3) {
+			/* 18 = 11 to 138 zeroes, 17 = 3 to 10 zeroes */
+			for (; run >= 11; run -= rep) {
+				rep = min(run, 138);
+				Deflate_AddCode(18, rep - 11);
+			}
+			if (run >= 3) { 
+				Deflate_AddCode(17, run - 3); run = 0; 
+			}
+		} else {
+			/* 16 = repeat previous length 3 to 6 times */
+			Deflate_AddCode(len, 0); run--;
+			for (; run >= 3; run -= rep) {
+				rep = min(run, 6);
+				Deflate_AddCode(16, rep - 3);
+			}
+		}
+		for (; run > 0; run--) { Deflate_AddCode(len, 0); }
+	}
+	return n;
+}
+
+/* Number of extra bits following each code length symbol */
+static const cc_uint8 codelens_bits[INFLATE_MAX_CODELENS] = {
+	0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 2,3,7
+};
+
+/* Returns number of bits needed to encode the symbols of the current block using the given code lengths */
+static cc_uint32 Deflate_SymbolsCost(struct DeflateState* state, const cc_uint8* litLens, const cc_uint8* distLens) {
+	cc_uint32 bits = 0;
+	int i;
+
+	for (i = 0; i < INFLATE_MAX_LITS; i++) {
+		bits += state->LitsFreqs[i] * (litLens[i] + (i > DEFLATE_EOB ? len_bits[i - 257] : 0));
+	}
+	for (i = 0; i < INFLATE_MAX_DISTS; i++) {
+		bits += state->DistsFreqs[i] * (distLens[i] + dist_bits[i]);
+	}
+	return bits;
+}
+
+/* Writes the symbols buffered for the current block as a fixed or dynamic huffman block */
+/* The block type is chosen based on which one produces smaller output */
+static cc_result Deflate_WriteBlock(struct DeflateState* state, cc_bool lastBlock) {
+	cc_uint8 litLens[INFLATE_MAX_LITS], distLens[INFLATE_MAX_DISTS];
+	cc_uint8 lens[INFLATE_MAX_LITS_DISTS];
+	cc_uint8 codes[INFLATE_MAX_LITS_DISTS], extra[INFLATE_MAX_LITS_DISTS];
+	cc_uint32 codelensFreqs[INFLATE_MAX_CODELENS] = { 0 };
+	cc_uint8  codelensLens[INFLATE_MAX_CODELENS], codelensBits[INFLATE_MAX_CODELENS];
+	cc_uint16 codelensCodewords[INFLATE_MAX_CODELENS];
+	int numLits, numDists, numCodelens, numCodes;
+	cc_uint32 fixedCost, dynamicCost;
+	int i, len, dist, code;
+	cc_result res;
+
+	/* Compute the dynamic huffman codes for this block */
+	Deflate_BuildLengths(state->LitsFreqs,  INFLATE_MAX_LITS - 2,  15, litLens);
+	Deflate_BuildLengths(state->DistsFreqs, INFLATE_MAX_DISTS - 2, 15, distLens);
+	litLens[286]  = 0; litLens[287]  = 0;
+	distLens[30]  = 0; distLens[31]  = 0;
+
+	for (numLits  = 286; numLits  > 257 && !litLens[numLits   - 1]; numLits--);
+	for (numDists = 30;  numDists > 1   && !distLens[numDists - 1]; numDists--);
+	Mem_Copy(lens,           litLens,  numLits);
+	Mem_Copy(lens + numLits, distLens, numDists);
+
+	numCodes = Deflate_EncodeLens(lens, numLits + numDists, codes, extra, codelensFreqs);
+	Deflate_BuildLengths(codelensFreqs, INFLATE_MAX_CODELENS, 7, codelensLens);
+	for (numCodelens = INFLATE_MAX_CODELENS; numCodelens > 4 && !codelensLens[codelens_order[numCodelens - 1]]; numCodelens--);
+
+	/* Estimate the size of the block for each block type */
+	dynamicCost = 5 + 5 + 4 + 3 * numCodelens;
+	for (i = 0; i < INFLATE_MAX_CODELENS; i++) {
+		dynamicCost += codelensFreqs[i] * (codelensLens[i] + codelens_bits[i]);
+	}
+	dynamicCost += Deflate_SymbolsCost(state, litLens,    distLens);
+	fixedCost    = Deflate_SymbolsCost(state, fixed_lits, fixed_dists);
+
+	if (dynamicCost < fixedCost) {
+		Deflate_PushBits(state, lastBlock | (2 << 1), 3); /* block type DYNAMIC */
+		Deflate_PushBits(state, numLits  - 257, 5);
+		Deflate_PushBits(state, numDists - 1,   5);
+		Deflate_FlushBits(state);
+		Deflate_PushBits(state, numCodelens - 4, 4);
+
+		for (i = 0; i < numCodelens; i++) {
+			Deflate_FlushBits(state);
+			Deflate_PushBits(state, codelensLens[codelens_order[i]], 3);
+		}
+		Deflate_FlushBits(state);
+
+		Deflate_BuildTable(codelensLens, INFLATE_MAX_CODELENS, codelensCodewords, codelensBits);
+		for (i = 0; i < numCodes; i++) {
+			code = codes[i];
+			Deflate_PushBits(state, codelensCodewords[code], codelensLens[code]);
+			Deflate_PushBits(state, extra[i], codelens_bits[code]);
+			Deflate_FlushBits(state);
+
+			if (state->AvailOut >= DEFLATE_OUT_MARGIN) continue;
+			if ((res = Deflate_WriteOutput(state))) return res;
+		}
+
+		Deflate_BuildTable(litLens,  INFLATE_MAX_LITS,  state->LitsCodewords,  state->LitsLens);
+		Deflate_BuildTable(distLens, INFLATE_MAX_DISTS, state->DistsCodewords, state->DistsLens);
+	} else {
+		Deflate_PushBits(state, lastBlock | (1 << 1), 3); /* block type FIXED */
+		Deflate_BuildTable(fixed_lits,  INFLATE_MAX_LITS,  state->LitsCodewords,  state->LitsLens);
+		Deflate_BuildTable(fixed_dists, INFLATE_MAX_DISTS, state->DistsCodewords, state->DistsLens);
+	}
+
+	for (i = 0; i < state->NumSymbols; i++) {
+		len  = state->SymLens[i];
+		dist = state->SymDists[i];
+
+		if (!dist) {
+			Deflate_PushLit(state, len);
+		} else {
+			code = deflate_lenCodes[len];
+			Deflate_PushLit(state, code + 257);
+			Deflate_PushBits(state, len + MIN_MATCH_LEN - deflate_len[code], len_bits[code]);
+			Deflate_FlushBits(state);
+
+			code = Deflate_DistCode(dist);
+			Deflate_PushDist(state, code);
+			Deflate_FlushBits(state);
+			Deflate_PushBits(state, dist - deflate_dist[code], dist_bits[code]);
+		}
+		Deflate_FlushBits(state);
+
+		if (state->AvailOut >= DEFLATE_OUT_MARGIN) continue;
+		if ((res = Deflate_WriteOutput(state))) return res;
+	}
+
+	Deflate_PushLit(state, DEFLATE_EOB);
 	Deflate_FlushBits(state);
+
+	state->NumSymbols = 0;
+	Mem_Set(state->LitsFreqs,  0, sizeof(state->LitsFreqs));
+	Mem_Set(state->DistsFreqs, 0, sizeof(state->DistsFreqs));
+	state->LitsFreqs[DEFLATE_EOB] = 1;
+	return 0;
 }
 
 /* Moves "current block" to "previous block", adjusting state if needed. */
 static void Deflate_MoveBlock(struct DeflateState* state) {
-	int i;
+	int i, pos;
 	Mem_Copy(state->Input, state->Input + DEFLATE_BLOCK_SIZE, DEFLATE_BLOCK_SIZE);
 	state->InputPosition = DEFLATE_BLOCK_SIZE;
 
 	/* adjust hash table offsets, removing offsets that are no longer in data at all */
 	for (i = 0; i < Array_Elems(state->Head); i++) {
-		state->Head[i] = state->Head[i] < DEFLATE_BLOCK_SIZE ? 0 : (state->Head[i] - DEFLATE_BLOCK_SIZE);
+		pos = state->Head[i];
+		state->Head[i] = pos < DEFLATE_BLOCK_SIZE ? 0 : (pos - DEFLATE_BLOCK_SIZE);
 	}
-	for (i = 0; i < Array_Elems(state->Prev); i++) {
-		state->Prev[i] = state->Prev[i] < DEFLATE_BLOCK_SIZE ? 0 : (state->Prev[i] - DEFLATE_BLOCK_SIZE);
+	/* hash chains of "current block" become hash chains of "previous block" */
+	/* NOTE: Stale chains in "current block" are always overwritten before being followed */
+	for (i = 0; i < DEFLATE_BLOCK_SIZE; i++) {
+		pos = state->Prev[i + DEFLATE_BLOCK_SIZE];
+		state->Prev[i] = pos < DEFLATE_BLOCK_SIZE ? 0 : (pos - DEFLATE_BLOCK_SIZE);
 	}
 }
 
 /* Compresses current block of data */
 static cc_result Deflate_FlushBlock(struct DeflateState* state, int len) {
-	cc_uint32 hash, nextHash;
-	int bestLen, maxLen, matchLen, depth;
-	int bestPos, pos, nextPos;
-	cc_uint16 oldHead;
-	cc_uint8* input;
-	cc_uint8* cur;
+	int bestLen, nextLen, maxLen;
+	int bestPos, nextPos;
+	int pos, end, i;
 	cc_result res;
 
-	if (!state->WroteHeader) {
-		state->WroteHeader = true;
-		Deflate_PushBits(state, 3, 3); /* final block TRUE, block type FIXED */
-	}
-
 	/* Based off descriptions from http://www.gzip.org/algorithm.txt and
 	https://github.com/nothings/stb/blob/master/stb_image_write.h */
-	input = state->Input;
-	cur   = input + DEFLATE_BLOCK_SIZE;
+	pos = DEFLATE_BLOCK_SIZE;
+	end = DEFLATE_BLOCK_SIZE + len;
 
 	/* Compress current block of data */
 	/* Use > instead of >=, because also try match at one byte after current */
-	while (len > MIN_MATCH_LEN) {
-		hash   = Deflate_Hash(cur);
-		maxLen = min(len, MAX_MATCH_LEN);
-
-		bestLen = MIN_MATCH_LEN - 1; /* Match must be at least 3 bytes */
-		bestPos = 0;
+	while (end - pos > MIN_MATCH_LEN) {
+		if (state->NumSymbols == DEFLATE_MAX_SYMBOLS) {
+			if ((res = Deflate_WriteBlock(state, false))) return res;
+		}
 
 		/* Find longest match starting at this byte */
-		/* Only explore up to 5 previous matches, to avoid slow performance */
-		/* (i.e prefer quickly saving maps/screenshots to completely optimal filesize) */
-		pos = state->Head[hash];
-		for (depth = 0; pos != 0 && depth < 5; depth++) {
-			matchLen = Deflate_MatchLen(&input[pos], cur, maxLen);
-			if (matchLen > bestLen) { bestLen = matchLen; bestPos = pos; }
-			pos = state->Prev[pos];
-		}
+		maxLen  = min(end - pos, MAX_MATCH_LEN);
+		bestLen = Deflate_FindMatch(state, pos, maxLen, &bestPos);
+		Deflate_Insert(state, pos);
 
-		/* Insert this entry into the hash chain */
-		pos = (int)(cur - input);
-		oldHead = state->Head[hash];
-		state->Head[hash] = pos;
-		state->Prev[pos]  = oldHead;
+		if (bestLen == MIN_MATCH_LEN && pos - bestPos > DEFLATE_TOO_FAR) bestLen = 0;
 
 		/* Lazy evaluation: Find longest match starting at next byte */
 		/* If that's longer than the longest match at current byte, throwaway this match */
-		if (bestPos) {
-			nextHash = Deflate_Hash(cur + 1);
-			nextPos  = state->Head[nextHash];
-			maxLen   = min(len - 1, MAX_MATCH_LEN);
-
-			for (depth = 0; nextPos != 0 && depth < 5; depth++) {
-				matchLen = Deflate_MatchLen(&input[nextPos], cur + 1, maxLen);
-				if (matchLen > bestLen) { bestPos = 0; break; }
-				nextPos = state->Prev[nextPos];
-			}
+		if (bestLen >= MIN_MATCH_LEN && bestLen < state->NiceLen && state->LazyMatch) {
+			maxLen  = min(end - pos - 1, MAX_MATCH_LEN);
+			nextLen = Deflate_FindMatch(state, pos + 1, maxLen, &nextPos);
+			if (nextLen > bestLen) bestLen = 0;
 		}
 
-		if (bestPos) {
-			Deflate_LenDist(state, bestLen, pos - bestPos);
-			len -= bestLen; cur += bestLen;
+		if (bestLen >= MIN_MATCH_LEN) {
+			Deflate_RecordMatch(state, bestLen, pos - bestPos);
+
+			/* Also add the rest of the matched bytes to the hash chains */
+			for (i = 1; i < bestLen && end - (pos + i) >= MIN_MATCH_LEN; i++) {
+				Deflate_Insert(state, pos + i);
+			}
+			pos += bestLen;
 		} else {
-			Deflate_Lit(state, *cur);
-			len--; cur++;
+			Deflate_RecordLit(state, state->Input[pos]);
+			pos++;
 		}
-
-		/* leave room for a few bytes and literals at end */
-		if (state->AvailOut >= 20) continue;
-		res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
-		state->NextOut  = state->Output;
-		state->AvailOut = DEFLATE_OUT_SIZE;
-		if (res) return res;
 	}
 
 	/* literals for last few bytes */
-	while (len > 0) {
-		Deflate_Lit(state, *cur);
-		len--; cur++;
+	for (; pos < end; pos++) {
+		if (state->NumSymbols == DEFLATE_MAX_SYMBOLS) {
+			if ((res = Deflate_WriteBlock(state, false))) return res;
+		}
+		Deflate_RecordLit(state, state->Input[pos]);
 	}
 
-	res = Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
-	state->NextOut  = state->Output;
-	state->AvailOut = DEFLATE_OUT_SIZE;
-
 	Deflate_MoveBlock(state);
-	return res;
+	return 0;
 }
 
 /* Adds data to buffered output data, flushing if needed */
@@ -973,7 +1624,7 @@ static cc_result Deflate_StreamWrite(struct Stream* stream, const cc_uint8* data
 	return 0;
 }
 
-/* Flushes any buffered data, then writes terminating symbol */
+/* Flushes any buffered data, then writes the final block */
 static cc_result Deflate_StreamClose(struct Stream* stream) {
 	struct DeflateState* state;
 	cc_result res;
@@ -981,10 +1632,8 @@ static cc_result Deflate_StreamClose(struct Stream* stream) {
 	state = (struct DeflateState*)stream->meta.inflate;
 	res   = Deflate_FlushBlock(state, state->InputPosition - DEFLATE_BLOCK_SIZE);
 	if (res) return res;
-
-	/* Write huffman encoded "literal 256" to terminate symbols */
-	Deflate_PushLit(state, 256);
-	Deflate_FlushBits(state);
+	res   = Deflate_WriteBlock(state, true);
+	if (res) return res;
 
 	/* In case last byte still has a few extra bits */
 	if (state->NumBits) {
@@ -992,26 +1641,45 @@ static cc_result Deflate_StreamClose(struct Stream* stream) {
 		Deflate_FlushBits(state);
 	}
 
-	return Stream_Write(state->Dest, state->Output, DEFLATE_OUT_SIZE - state->AvailOut);
+	return Deflate_WriteOutput(state);
 }
 
-/* Constructs a huffman encoding table (for values to codewords) */
-static void Deflate_BuildTable(const cc_uint8* lens, int count, cc_uint16* codewords, cc_uint8* bitlens) {
-	int i, j, offset, codeword;
-	struct HuffmanTable table;
+/* Flushes any buffered data, then pads output to a byte boundary without writing the final block */
+/*  (so that other DEFLATE compressed data can be directly appended after the output) */
+static cc_result Deflate_StreamFlush(struct Stream* stream) {
+	struct DeflateState* state;
+	cc_result res;
 
-	/* NOTE: Can ignore since lens table is not user controlled */
-	(void)Huffman_Build(&table, lens, count);
-	for (i = 0; i < INFLATE_MAX_BITS; i++) {
-		if (!table.endCodewords[i]) continue;
-		count = table.endCodewords[i] - table.firstCodewords[i];
+	state = (struct DeflateState*)stream->meta.inflate;
+	res   = Deflate_FlushBlock(state, state->InputPosition - DEFLATE_BLOCK_SIZE);
+	if (res) return res;
+	res   = Deflate_WriteBlock(state, false);
+	if (res) return res;
 
-		for (j = 0; j < count; j++) {
-			offset   = table.values[table.firstOffsets[i] + j];
-			codeword = table.firstCodewords[i] + j;
-			bitlens[offset]   = i;
-			codewords[offset] = Huffman_ReverseBits(codeword, i);
-		}
+	/* Empty stored block (non final, 0 length) */
+	/* NOTE: Writing a block always leaves at least DEFLATE_OUT_MARGIN bytes free */
+	Deflate_PushBits(state, 0, 3);
+	while (state->NumBits & 7) { Deflate_PushBits(state, 0, 1); }
+	Deflate_FlushBits(state);
+
+	*state->NextOut++ = 0x00; *state->NextOut++ = 0x00;
+	*state->NextOut++ = 0xFF; *state->NextOut++ = 0xFF;
+	state->AvailOut  -= 4;
+	return Deflate_WriteOutput(state);
+}
+
+void Deflate_SetLevel(struct DeflateState* state, int level) {
+	switch (level)
+	{
+	case DEFLATE_LEVEL_FAST:
+		state->MaxChainLen = 8;    state->NiceLen = 32;
+		state->LazyMatch   = true;  break;
+	case DEFLATE_LEVEL_BEST:
+		state->MaxChainLen = 256;  state->NiceLen = MAX_MATCH_LEN;
+		state->LazyMatch   = true;  break;
+	default:
+		state->MaxChainLen = 32;   state->NiceLen = 128;
+		state->LazyMatch   = true;  break;
 	}
 }
 
@@ -1029,11 +1697,17 @@ void Deflate_MakeStream(struct Stream* stream, struct DeflateState* state, struc
 	state->NextOut  = state->Output;
 	state->AvailOut = DEFLATE_OUT_SIZE;
 	state->Dest     = underlying;
-	state->WroteHeader = false;
 
 	Mem_Set(state->Head, 0, sizeof(state->Head));
 	Mem_Set(state->Prev, 0, sizeof(state->Prev));
-	Deflate_BuildTable(fixed_lits, INFLATE_MAX_LITS, state->LitsCodewords, state->LitsLens);
+
+	state->NumSymbols = 0;
+	Mem_Set(state->LitsFreqs,  0, sizeof(state->LitsFreqs));
+	Mem_Set(state->DistsFreqs, 0, sizeof(state->DistsFreqs));
+	state->LitsFreqs[DEFLATE_EOB] = 1;
+
+	Deflate_InitTables();
+	Deflate_SetLevel(state, DEFLATE_LEVEL_DEFAULT);
 }
 
 
@@ -1084,6 +1758,246 @@ void GZip_MakeStream(struct Stream* stream, struct GZipState* state, struct Stre
 }
 
 
+/*########################################################################################################################*
+*-------------------------------------------------GZip parallel (compress)------------------------------------------------*
+*#########################################################################################################################*/
+/* Multiplies two polynomials modulo the CRC32 polynomial (in bit reversed representation) */
+static cc_uint32 Crc32_MultModP(cc_uint32 a, cc_uint32 b) {
+	cc_uint32 m = 1UL << 31, p = 0;
+
+	for (;;) 
+	{
+		if (a & m) {
+			p ^= b;
+			if (!(a & (m - 1))) break;
+		}
+		m >>= 1;
+		b = (b & 1) ? ((b >> 1) ^ 0xEDB88320UL) : (b >> 1);
+	}
+	return p;
+}
+
+/* Calculates CRC32 of data A followed by data B, from the CRC32s of A and B */
+static cc_uint32 Crc32_Combine(cc_uint32 crcA, cc_uint32 crcB, cc_uint32 lenB) {
+	cc_uint32 p = 1UL << 31; /* x^0 */
+	cc_uint32 x = 1UL << 23; /* x^8 */
+
+	/* p = x^(8 * lenB), i.e. effect of appending lenB zero bytes */
+	for (; lenB; lenB >>= 1)
+	{
+		if (lenB & 1) p = Crc32_MultModP(x, p);
+		x = Crc32_MultModP(x, x);
+	}
+	return Crc32_MultModP(p, crcA) ^ crcB;
+}
+
+static cc_result Segment_StreamWrite(struct Stream* stream, const cc_uint8* data, cc_uint32 count, cc_uint32* modified) {
+	struct GZipSegment* seg = (struct GZipSegment*)stream->meta.inflate;
+	cc_uint32 capacity;
+	cc_uint8* ptr;
+
+	if (seg->Length + count > seg->Capacity) {
+		capacity = max(seg->Capacity * 2, seg->Length + count);
+		ptr = (cc_uint8*)Mem_TryRealloc(seg->Data, capacity, 1);
+		if (!ptr) return ERR_OUT_OF_MEMORY;
+
+		seg->Data     = ptr;
+		seg->Capacity = capacity;
+	}
+
+	Mem_Copy(seg->Data + seg->Length, data, count);
+	seg->Length += count;
+	*modified    = count;
+	return 0;
+}
+
+static const cc_uint8* gzp_data;
+static cc_uint32 gzp_len;
+static cc_bool gzp_final;
+
+static void GZipParallel_Process(int job, int worker) {
+	struct GZipParallelState* state = (struct GZipParallelState*)segs_ctx;
+	struct GZipSegment* seg = &state->Segments[state->NumSegments + job];
+	struct DeflateState* deflate = state->Workers[worker];
+	struct Stream segStream, compStream;
+	cc_uint32 offset = (cc_uint32)job * GZIP_SEGMENT_SIZE;
+	cc_uint32 size   = min(GZIP_SEGMENT_SIZE, gzp_len - offset);
+	cc_result res;
+
+	seg->Size  = size;
+	seg->Crc32 = Utils_CRC32(gzp_data + offset, size);
+
+	Stream_Init(&segStream);
+	segStream.meta.inflate = seg;
+	segStream.Write        = Segment_StreamWrite;
+
+	Deflate_MakeStream(&compStream, deflate, &segStream);
+	Deflate_SetLevel(deflate, state->Level);
+	res = Stream_Write(&compStream, gzp_data + offset, size);
+
+	/* Only the very last segment ends with the final block */
+	if (!res && gzp_final && job == segs_numJobs - 1) {
+		res = Deflate_StreamClose(&compStream);
+	} else if (!res) {
+		res = Deflate_StreamFlush(&compStream);
+	}
+	if (res) Segments_Fail(res);
+}
+
+/* Compresses the given data as a batch of segments in parallel */
+static cc_result GZipParallel_Compress(struct GZipParallelState* state, const cc_uint8* data, cc_uint32 len, cc_bool final) {
+	int i, count, numThreads;
+	cc_result res;
+
+	count = len / GZIP_SEGMENT_SIZE + ((len % GZIP_SEGMENT_SIZE) != 0);
+	/* Final segment may be empty */
+	if (final && !count) count = 1;
+	/* Always leave room for the final segment */
+	if (state->NumSegments + count + !final > GZIP_MAX_SEGMENTS) return ERR_OUT_OF_MEMORY;
+
+	numThreads = min(state->NumThreads, count);
+	for (i = 0; i < numThreads; i++)
+	{
+		if (state->Workers[i]) continue;
+		state->Workers[i] = (struct DeflateState*)Mem_TryAlloc(1, sizeof(struct DeflateState));
+		if (state->Workers[i]) continue;
+
+		/* Just use less threads if out of memory */
+		if (!i) return ERR_OUT_OF_MEMORY;
+		numThreads = i; break;
+	}
+
+	gzp_data  = data;
+	gzp_len   = len;
+	gzp_final = final;
+	res = Segments_Run(count, numThreads, state, GZipParallel_Process);
+
+	state->NumSegments += count;
+	return res;
+}
+
+static cc_result GZipParallel_StreamWrite(struct Stream* stream, const cc_uint8* data, cc_uint32 total, cc_uint32* modified) {
+	struct GZipParallelState* state = (struct GZipParallelState*)stream->meta.inflate;
+	cc_uint32 batchSize = (cc_uint32)state->NumThreads * GZIP_SEGMENT_SIZE;
+	cc_uint32 len;
+	cc_result res;
+	*modified = 0;
+
+	while (total > 0) {
+		res = 0;
+
+		if (!state->BufferLen && total >= batchSize) {
+			/* Compress whole segments directly from the data, avoiding a copy */
+			len = total - (total % GZIP_SEGMENT_SIZE);
+			res = GZipParallel_Compress(state, data, len, false);
+		} else {
+			if (!state->Buffer) {
+				state->Buffer = (cc_uint8*)Mem_TryAlloc(batchSize, 1);
+				if (!state->Buffer) return ERR_OUT_OF_MEMORY;
+			}
+
+			len = min(total, batchSize - state->BufferLen);
+			Mem_Copy(state->Buffer + state->BufferLen, data, len);
+			state->BufferLen += len;
+
+			if (state->BufferLen == batchSize) {
+				res = GZipParallel_Compress(state, state->Buffer, batchSize, false);
+				state->BufferLen = 0;
+			}
+		}
+		if (res) return res;
+
+		data  += len;
+		total -= len;
+		*modified += len;
+	}
+	return 0;
+}
+
+static cc_result GZipParallel_StreamClose(struct Stream* stream) {
+	struct GZipParallelState* state = (struct GZipParallelState*)stream->meta.inflate;
+	cc_uint8 header[20] = { 0x1F, 0x8B, 0x08, 0x04 }; /* GZip header, with extra field */
+	cc_uint32 crc32 = 0, size = 0;
+	struct GZipSegment* seg;
+	cc_uint8 data[256];
+	int i, j, count;
+	cc_result res;
+
+	res = GZipParallel_Compress(state, state->Buffer, state->BufferLen, true);
+	state->BufferLen = 0;
+	if (res) return res;
+	count = state->NumSegments;
+
+	/* Extra field contains 'CS' subfield, which is index of the segments */
+	Mem_WriteU16_LE(&header[10], 8 + count * 4);
+	header[12] = 'C'; header[13] = 'S';
+	Mem_WriteU16_LE(&header[14], 4 + count * 4);
+	Mem_WriteU32_LE(&header[16], GZIP_SEGMENT_SIZE);
+	if ((res = Stream_Write(state->Dest, header, sizeof(header)))) return res;
+
+	for (i = 0; i < count; i += j)
+	{
+		for (j = 0; j < Array_Elems(data) / 4 && i + j < count; j++)
+		{
+			Mem_WriteU32_LE(&data[j * 4], state->Segments[i + j].Length);
+		}
+		if ((res = Stream_Write(state->Dest, data, j * 4))) return res;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		seg   = &state->Segments[i];
+		crc32 = Crc32_Combine(crc32, seg->Crc32, seg->Size);
+		size += seg->Size;
+		if ((res = Stream_Write(state->Dest, seg->Data, seg->Length))) return res;
+	}
+
+	Mem_WriteU32_LE(&data[0], crc32);
+	Mem_WriteU32_LE(&data[4], size);
+	return Stream_Write(state->Dest, data, 8);
+}
+
+void GZip_MakeParallelStream(struct Stream* stream, struct GZipParallelState* state, 
+							struct Stream* underlying, int level, int numThreads) {
+	Stream_Init(stream);
+	stream->meta.inflate = state;
+	stream->Write = GZipParallel_StreamWrite;
+	stream->Close = GZipParallel_StreamClose;
+
+	state->Dest        = underlying;
+	state->Level       = level;
+	state->NumThreads  = max(1, min(numThreads, GZIP_MAX_THREADS));
+	state->NumSegments = 0;
+	state->Buffer      = NULL;
+	state->BufferLen   = 0;
+
+	Mem_Set(state->Workers,  0, sizeof(state->Workers));
+	Mem_Set(state->Segments, 0, sizeof(state->Segments));
+	/* Worker threads can't safely initialise the shared tables */
+	Deflate_InitTables();
+	Segments_StartWorkers(state->NumThreads);
+}
+
+void GZip_FreeParallelStream(struct GZipParallelState* state) {
+	int i;
+	for (i = 0; i < GZIP_MAX_THREADS; i++)
+	{
+		Mem_Free(state->Workers[i]);
+		state->Workers[i] = NULL;
+	}
+
+	for (i = 0; i < state->NumSegments; i++)
+	{
+		Mem_Free(state->Segments[i].Data);
+		state->Segments[i].Data = NULL;
+	}
+	state->NumSegments = 0;
+
+	Mem_Free(state->Buffer);
+	state->Buffer = NULL;
+}
+
+
 /*########################################################################################################################*
 *-----------------------------------------------------ZLib (compress)-----------------------------------------------------*
 *#########################################################################################################################*/
@@ -14,7 +14,26 @@ CC_BEGIN_HEADER
 */
 struct Stream;
 
-struct GZipHeader { cc_uint8 state; cc_bool done; cc_uint8 partsRead; int flags; };
+/* Max number of independently compressed segments data can be split into */
+#define GZIP_MAX_SEGMENTS 4096
+/* Uncompressed size of each segment (except the last) written by GZip_MakeParallelStream */
+#define GZIP_SEGMENT_SIZE (1024 * 1024)
+/* Max number of threads used to compress/decompress segments */
+#define GZIP_MAX_THREADS 64
+
+/* Index of the independently compressed segments the DEFLATE data of a GZIP file is made of */
+/* NOTE: Stored in the 'CS' subfield of the GZIP header extra field */
+struct GZipSegments {
+	cc_uint32 Size; /* Uncompressed size of each segment, except the last */
+	int Count;      /* Number of segments, 0 if the data does not have a segment index */
+	cc_uint32 Lens[GZIP_MAX_SEGMENTS]; /* Compressed size of each segment */
+};
+
+struct GZipHeader { 
+	cc_uint8 state; cc_bool done; cc_uint8 partsRead; int flags; 
+	cc_uint32 extraLeft, fieldRead, fieldLen, value; cc_uint8 fieldID[2];
+	struct GZipSegments* segments; /* If not NULL, receives the segment index (if any) */
+};
 void GZipHeader_Init(struct GZipHeader* header);
 cc_result GZipHeader_Read(struct Stream* s, struct GZipHeader* header);
 
@@ -65,6 +84,7 @@ struct InflateState {
 		struct HuffmanTable Lits;           /* Values represent literal or lengths */
 	} Table; /* union to save on memory */
 	struct HuffmanTable TableDists;         /* Values represent distances back */
+	cc_uint32 FastLits[1 << INFLATE_FAST_BITS]; /* Combined literal/length lookup table used by fast decoder */
 	cc_uint8 Window[INFLATE_WINDOW_SIZE];    /* Holds circular buffer of recent output data, used for LZ77 */
 	cc_result result;
 };
@@ -79,12 +99,26 @@ void Inflate_Process(struct InflateState* s);
 /* If data starts with a GZIP or ZLIB header, use GZipHeader_Read or ZLibHeader_Read to first skip it. */
 CC_API void Inflate_MakeStream2(struct Stream* stream, struct InflateState* state, struct Stream* underlying);
 
+/* Decompresses DEFLATE data made of independently compressed segments (see GZip_MakeParallelStream). Read only stream. */
+/* Large reads that span whole segments are decompressed across multiple threads at once. */
+/* NOTE: Reads the compressed data of all the segments from the underlying stream into memory first */
+/* NOTE: The stream MUST be closed afterwards, as this allocates memory */
+/* NOTE: Must be called from the main thread */
+cc_result Inflate_MakeSegmentedStream(struct Stream* stream, struct InflateState* state, struct Stream* underlying,
+										const struct GZipSegments* index, int numThreads);
+
 
 #define DEFLATE_BLOCK_SIZE  16384
 #define DEFLATE_BUFFER_SIZE 32768
 #define DEFLATE_OUT_SIZE 8192
-#define DEFLATE_HASH_SIZE 0x1000UL
-#define DEFLATE_HASH_MASK 0x0FFFUL
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_HASH_SIZE (1UL << DEFLATE_HASH_BITS)
+#define DEFLATE_MAX_SYMBOLS 16384
+
+/* Compression levels, trading off compression speed against compressed size */
+#define DEFLATE_LEVEL_FAST    0
+#define DEFLATE_LEVEL_DEFAULT 1
+#define DEFLATE_LEVEL_BEST    2
 struct DeflateState {
 	cc_uint32 Bits;         /* Holds bits across byte boundaries */
 	cc_uint32 NumBits;      /* Number of bits in Bits buffer */
@@ -94,20 +128,38 @@ struct DeflateState {
 	cc_uint32 AvailOut;   /* Max number of bytes that can be written to Output buffer */
 	struct Stream* Dest; /* Destination that Output buffer is written to */
 
-	cc_uint16 LitsCodewords[INFLATE_MAX_LITS]; /* Codewords for each value */
-	cc_uint8 LitsLens[INFLATE_MAX_LITS];       /* Bit lengths of each codeword */
-	
+	cc_uint16 LitsCodewords[INFLATE_MAX_LITS];   /* Codewords for each value */
+	cc_uint8 LitsLens[INFLATE_MAX_LITS];         /* Bit lengths of each codeword */
+	cc_uint16 DistsCodewords[INFLATE_MAX_DISTS]; /* Codewords for each distance */
+	cc_uint8 DistsLens[INFLATE_MAX_DISTS];       /* Bit lengths of each distance codeword */
+
+	int MaxChainLen; /* Max number of previous positions to check when searching for a match */
+	int NiceLen;     /* Stops searching for a match once a match of at least this length is found */
+	cc_bool LazyMatch; /* Whether to also check if a longer match starts at next byte */
+
+	/* Literal/length and distance symbols buffered for the current block */
+	/*  (huffman codes for the block can only be computed after all symbols are known) */
+	int NumSymbols;
+	cc_uint32 LitsFreqs[INFLATE_MAX_LITS];   /* Number of times each literal/length symbol is used */
+	cc_uint32 DistsFreqs[INFLATE_MAX_DISTS]; /* Number of times each distance symbol is used */
+	cc_uint8 SymLens[DEFLATE_MAX_SYMBOLS];   /* Literal value, or length of match - 3 */
+	cc_uint16 SymDists[DEFLATE_MAX_SYMBOLS]; /* Distance of match, or 0 for a literal */
+
+
 	cc_uint8 Input[DEFLATE_BUFFER_SIZE];
 	cc_uint8 Output[DEFLATE_OUT_SIZE];
 	cc_uint16 Head[DEFLATE_HASH_SIZE];
 	cc_uint16 Prev[DEFLATE_BUFFER_SIZE];
 	/* NOTE: The largest possible value that can get */
 	/*  stored in Head/Prev is <= DEFLATE_BUFFER_SIZE */
-	cc_bool WroteHeader;
 };
 /* Compresses input data using DEFLATE, then writes compressed output to another stream. Write only stream. */
 /* DEFLATE compression is pure compressed data, there is no header or footer. */
+/* NOTE: The stream uses DEFLATE_LEVEL_DEFAULT compression level by default */
 CC_API void Deflate_MakeStream(struct Stream* stream, struct DeflateState* state, struct Stream* underlying);
+/* Sets how much effort is spent on finding matches. (see DEFLATE_LEVEL_ defines) */
+/* NOTE: Must be called before any data is written to the stream */
+CC_API void Deflate_SetLevel(struct DeflateState* state, int level);
 
 struct GZipState { struct DeflateState Base; cc_uint32 Crc32, Size; };
 /* Compresses input data using GZIP, then writes compressed output to another stream. Write only stream. */
@@ -115,6 +167,27 @@ struct GZipState { struct DeflateState Base; cc_uint32 Crc32, Size; };
 CC_API  void GZip_MakeStream(      struct Stream* stream, struct GZipState* state, struct Stream* underlying);
 typedef void (*FP_GZip_MakeStream)(struct Stream* stream, struct GZipState* state, struct Stream* underlying);
 
+struct GZipSegment { cc_uint8* Data; cc_uint32 Length, Capacity, Crc32, Size; };
+struct GZipParallelState {
+	struct Stream* Dest;
+	int Level, NumThreads, NumSegments;
+	cc_uint8* Buffer;    /* Data waiting to be compressed, up to NumThreads segments worth */
+	cc_uint32 BufferLen;
+	struct DeflateState* Workers[GZIP_MAX_THREADS];
+	struct GZipSegment Segments[GZIP_MAX_SEGMENTS];
+};
+/* Compresses input data using GZIP, then writes compressed output to another stream. Write only stream. */
+/* The data is split into GZIP_SEGMENT_SIZE segments that are DEFLATE compressed independently across */
+/*  multiple threads, then joined together with sync flushes. (so the output is still a valid GZIP file) */
+/* The header also contains an index of the segments, so they can be decompressed in parallel too. */
+/* NOTE: Compressed output is only written to the underlying stream when the stream is closed */
+/* NOTE: Older ClassiCube versions fail to load GZIP files with an extra field in the header */
+/* NOTE: Must be called from the main thread */
+CC_API void GZip_MakeParallelStream(struct Stream* stream, struct GZipParallelState* state, 
+									struct Stream* underlying, int level, int numThreads);
+/* Frees memory allocated by the stream. Must always be called, even if writing or closing failed. */
+CC_API void GZip_FreeParallelStream(struct GZipParallelState* state);
+
 struct ZLibState { struct DeflateState Base; cc_uint32 Adler32; };
 /* Compresses input data using ZLIB, then writes compressed output to another stream. Write only stream. */
 /* ZLIB compression is ZLIB header, followed by DEFLATE compressed data, followed by ZLIB footer. */
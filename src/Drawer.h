@@ -38,5 +38,14 @@ CC_API void Drawer_YMin(int count, PackedCol col, TextureLoc texLoc, struct Vert
 /* Draws maximum Y face of the cuboid. (i.e. at Y2) */
 CC_API void Drawer_YMax(int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
 
+/* Variants of the above functions, which use the given state instead of the global Drawer state */
+/* NOTE: Used by chunk mesh builder, as the global Drawer state can only be used from the main thread */
+void Drawer_XMinEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+void Drawer_XMaxEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+void Drawer_ZMinEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+void Drawer_ZMaxEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+void Drawer_YMinEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+void Drawer_YMaxEx(const struct _DrawerData* d, int count, PackedCol col, TextureLoc texLoc, struct VertexTextured** vertices);
+
 CC_END_HEADER
 #endif
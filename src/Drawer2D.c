@@ -125,6 +125,14 @@ cc_bool Font_SetBitmapAtlas(struct Bitmap* bmp) {
 	return true;
 }
 
+struct Bitmap* Font_GetBitmapAtlas(void) {
+	return fontBitmap.scan0 ? &fontBitmap : NULL;
+}
+
+int Font_GetBitmapCharWidth(char c) {
+	return tileWidths[(cc_uint8)c];
+}
+
 void Font_SetPadding(struct FontDesc* desc, int amount) {
 	if (!Font_IsBitmap(desc)) return;
 	desc->height = desc->size + Display_ScaleY(amount) * 2;
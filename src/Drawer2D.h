@@ -125,6 +125,10 @@ void Drawer2D_Fill(struct Bitmap* bmp, int x, int y, int width, int height, Bitm
 /* Sets the bitmap used for drawing bitmapped fonts. (i.e. default.png) */
 /* The bitmap must be square and consist of a 16x16 tile layout */
 cc_bool Font_SetBitmapAtlas(struct Bitmap* bmp);
+/* Returns the bitmap used for drawing bitmapped fonts, or NULL if default.png has not been loaded */
+struct Bitmap* Font_GetBitmapAtlas(void);
+/* Returns the width in pixels of the given character's tile in the bitmapped font atlas */
+int Font_GetBitmapCharWidth(char c);
 /* Sets padding for a bitmapped font */
 void Font_SetPadding(struct FontDesc* desc, int amount);
 /* Initialises the given font for drawing bitmapped text using default.png */
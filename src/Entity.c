@@ -492,6 +492,333 @@ void Entity_LerpAngles(struct Entity* e, float t) {
 }
 
 
+/*########################################################################################################################*
+*-------------------------------------------------------Entity grid-------------------------------------------------------*
+*#########################################################################################################################*/
+/* Entities are stored in a spatial hash of cells in the XZ plane, so that queries only check nearby entities */
+/* NOTE: Each entity is only stored in the cell its position is in, so queries also check neighbouring cells */
+/*  to find entities whose bounds cross over into them. Entities too large for that to work are instead */
+/*  stored in a separate list which is always checked. */
+#define GRID_CELL_SIZE 4
+#define GRID_BUCKETS   512
+#define GRID_LARGE     GRID_BUCKETS
+#define GRID_NONE      -1
+#define EntityGrid_Cell(value) Math_Floor((value) * (1.0f / GRID_CELL_SIZE))
+#define EntityGrid_Bucket(x, z) ((((cc_uint32)(x) * 73856093u) ^ ((cc_uint32)(z) * 19349663u)) & (GRID_BUCKETS - 1))
+
+static struct Entity* grid_entities[ENTITIES_MAX_COUNT]; /* Entity each ID was added as, NULL when not in the grid */
+static int grid_cellX[ENTITIES_MAX_COUNT], grid_cellZ[ENTITIES_MAX_COUNT];
+static cc_int16 grid_prev[ENTITIES_MAX_COUNT], grid_next[ENTITIES_MAX_COUNT];
+static cc_uint16 grid_bucket[ENTITIES_MAX_COUNT];
+static cc_int16 grid_heads[GRID_BUCKETS + 1]; /* Last list is for large entities */
+static cc_uint32 grid_checked[ENTITIES_MAX_COUNT], grid_stamp;
+static int grid_count, grid_cellsCount;
+
+/* Range of cells that contain entities */
+static int grid_minX, grid_minZ, grid_maxX, grid_maxZ;
+/* Largest horizontal distance from the position of an entity stored in a cell to the edge of its bounds */
+static float grid_maxWidth;
+
+static void EntityGrid_Init(void) {
+	int i;
+	for (i = 0; i <= GRID_BUCKETS; i++) grid_heads[i] = GRID_NONE;
+}
+
+static void EntityGrid_Link(int id, struct Entity* e, int bucket, int x, int z) {
+	int head = grid_heads[bucket];
+
+	grid_entities[id] = e;
+	grid_bucket[id]   = bucket;
+	grid_cellX[id]    = x;
+	grid_cellZ[id]    = z;
+	grid_prev[id]     = GRID_NONE;
+	grid_next[id]     = head;
+
+	if (head != GRID_NONE) grid_prev[head] = id;
+	grid_heads[bucket] = id;
+
+	grid_count++;
+	if (bucket != GRID_LARGE) grid_cellsCount++;
+}
+
+static void EntityGrid_Unlink(int id) {
+	int prev = grid_prev[id], next = grid_next[id];
+
+	if (prev != GRID_NONE) {
+		grid_next[prev] = next;
+	} else {
+		grid_heads[grid_bucket[id]] = next;
+	}
+	if (next != GRID_NONE) grid_prev[next] = prev;
+
+	grid_entities[id] = NULL;
+	grid_count--;
+	if (grid_bucket[id] != GRID_LARGE) grid_cellsCount--;
+}
+
+/* Returns the furthest horizontal distance from the entity's position that its picking bounds can reach */
+static float EntityGrid_PickRadius(struct Entity* e) {
+	struct AABB* bb = &e->ModelAABB;
+	float radius = 
+		max(bb->Min.x * bb->Min.x, bb->Max.x * bb->Max.x) +
+		max(bb->Min.z * bb->Min.z, bb->Max.z * bb->Max.z);
+
+	/* Rotation around X or Z axes can tip the vertical extent of the bounds over horizontally */
+	if (e->RotX || e->RotZ) radius += max(bb->Min.y * bb->Min.y, bb->Max.y * bb->Max.y);
+	return Math_SqrtF(radius);
+}
+
+/* Moves the given entity into the cell its position is now in */
+static void EntityGrid_Update(int id) {
+	struct Entity* e = Entities.List[id];
+	float width;
+	int x, z, bucket;
+
+	if (grid_entities[id] && grid_entities[id] != e) EntityGrid_Unlink(id);
+	if (!e) return;
+
+	x = EntityGrid_Cell(e->Position.x);
+	z = EntityGrid_Cell(e->Position.z);
+	width  = max(e->Size.x, e->Size.z) * 0.5f;
+	bucket = EntityGrid_Bucket(x, z);
+
+	/* Bounds of the entity must not reach further than the neighbouring cells */
+	if (width > GRID_CELL_SIZE || EntityGrid_PickRadius(e) > GRID_CELL_SIZE) bucket = GRID_LARGE;
+
+	if (grid_entities[id] && (bucket != grid_bucket[id] || x != grid_cellX[id] || z != grid_cellZ[id])) {
+		EntityGrid_Unlink(id);
+	}
+	if (!grid_entities[id]) EntityGrid_Link(id, e, bucket, x, z);
+	if (bucket == GRID_LARGE) return;
+
+	grid_minX = min(grid_minX, x); grid_maxX = max(grid_maxX, x);
+	grid_minZ = min(grid_minZ, z); grid_maxZ = max(grid_maxZ, z);
+	grid_maxWidth = max(grid_maxWidth, width);
+}
+
+void Entities_UpdateGrid(void) {
+	int i;
+	grid_minX = Int32_MaxValue; grid_maxX = Int32_MinValue;
+	grid_minZ = Int32_MaxValue; grid_maxZ = Int32_MinValue;
+	grid_maxWidth = 0.0f;
+
+	for (i = 0; i < ENTITIES_MAX_COUNT; i++)
+	{
+		EntityGrid_Update(i);
+	}
+}
+
+
+static cc_bool EntityGrid_IsNear(int id, const Vec3* pos, float radius) {
+	struct Entity* e = grid_entities[id];
+	float dx, dy, dz;
+	if (Entities.List[id] != e) return false;
+
+	/* Distance from the point to the closest point in the entity's bounding box (see Entity_GetBounds) */
+	dx = max(0.0f, Math_AbsF(pos->x - e->Position.x) - e->Size.x * 0.5f);
+	dz = max(0.0f, Math_AbsF(pos->z - e->Position.z) - e->Size.z * 0.5f);
+	dy = max(0.0f, max(e->Position.y - pos->y, pos->y - (e->Position.y + e->Size.y)));
+	return dx * dx + dy * dy + dz * dz <= radius * radius;
+}
+
+int Entities_FindNear(const Vec3* pos, float radius, EntityID* ids, int maxIds) {
+	/* Bit for each entity that was found, so that IDs can be returned in ascending order */
+	cc_uint32 found[(ENTITIES_MAX_COUNT + 31) / 32] = { 0 };
+	float reach = radius + grid_maxWidth;
+	int minX, minZ, maxX, maxZ;
+	int x, z, id, count = 0;
+	if (!grid_count || radius < 0.0f || maxIds <= 0) return 0;
+
+	minX = max(grid_minX, EntityGrid_Cell(pos->x - reach));
+	maxX = min(grid_maxX, EntityGrid_Cell(pos->x + reach));
+	minZ = max(grid_minZ, EntityGrid_Cell(pos->z - reach));
+	maxZ = min(grid_maxZ, EntityGrid_Cell(pos->z + reach));
+
+	/* Checking every cell in a large area is slower than just checking every entity */
+	if (minX <= maxX && minZ <= maxZ && (float)(maxX - minX + 1) * (maxZ - minZ + 1) >= grid_cellsCount) {
+		for (id = 0; id < ENTITIES_MAX_COUNT && count < maxIds; id++)
+		{
+			if (grid_entities[id] && EntityGrid_IsNear(id, pos, radius)) ids[count++] = id;
+		}
+		return count;
+	}
+
+	for (id = grid_heads[GRID_LARGE]; id != GRID_NONE; id = grid_next[id])
+	{
+		if (EntityGrid_IsNear(id, pos, radius)) found[id >> 5] |= 1u << (id & 31);
+	}
+
+	for (z = minZ; z <= maxZ; z++)
+		for (x = minX; x <= maxX; x++)
+	{
+		for (id = grid_heads[EntityGrid_Bucket(x, z)]; id != GRID_NONE; id = grid_next[id])
+		{
+			if (grid_cellX[id] != x || grid_cellZ[id] != z) continue;
+			if (EntityGrid_IsNear(id, pos, radius)) found[id >> 5] |= 1u << (id & 31);
+		}
+	}
+
+	for (x = 0; x < Array_Elems(found); x++)
+	{
+		if (!found[x]) continue;
+
+		for (id = x * 32; id < x * 32 + 32; id++)
+		{
+			if (!(found[x] & (1u << (id & 31)))) continue;
+			if (count == maxIds) return count;
+			ids[count++] = id;
+		}
+	}
+	return count;
+}
+
+
+struct EntityGridRay {
+	Vec3 origin, dir;
+	struct Entity* ignore;
+	float closest;
+	int target;
+};
+
+static void EntityGrid_RayTest(struct EntityGridRay* r, int id) {
+	struct Entity* e = grid_entities[id];
+	float t0, t1;
+
+	if (grid_checked[id] == grid_stamp) return;
+	grid_checked[id] = grid_stamp;
+
+	if (e == r->ignore || Entities.List[id] != e) return;
+	if (!Intersection_RayIntersectsRotatedBox(r->origin, r->dir, e, &t0, &t1)) return;
+
+	/* Lower ID wins ties, same as when checking every entity in order */
+	if (r->target < 0 || t0 < r->closest || (t0 == r->closest && id < r->target)) {
+		r->closest = t0;
+		r->target  = id;
+	}
+}
+
+/* Checks entities in the given cell and the cells around it */
+static void EntityGrid_RayTestCells(struct EntityGridRay* r, int cellX, int cellZ) {
+	int minX = max(grid_minX, cellX - 1), maxX = min(grid_maxX, cellX + 1);
+	int minZ = max(grid_minZ, cellZ - 1), maxZ = min(grid_maxZ, cellZ + 1);
+	int x, z, id;
+
+	for (z = minZ; z <= maxZ; z++)
+		for (x = minX; x <= maxX; x++)
+	{
+		for (id = grid_heads[EntityGrid_Bucket(x, z)]; id != GRID_NONE; id = grid_next[id])
+		{
+			if (grid_cellX[id] != x || grid_cellZ[id] != z) continue;
+			EntityGrid_RayTest(r, id);
+		}
+	}
+}
+
+/* Calculates the range of t where the ray is inside the given range of positions along one axis */
+static cc_bool EntityGrid_ClipRay(float origin, float dir, int minCell, int maxCell, float* tEnter, float* tExit) {
+	float minPos = (float)minCell * GRID_CELL_SIZE, maxPos = (float)(maxCell + 1) * GRID_CELL_SIZE;
+	float t1, t2, tmp;
+	if (dir == 0.0f) return origin >= minPos && origin < maxPos;
+
+	t1 = (minPos - origin) / dir;
+	t2 = (maxPos - origin) / dir;
+	if (t1 > t2) { tmp = t1; t1 = t2; t2 = tmp; }
+
+	*tEnter = max(*tEnter, t1);
+	*tExit  = min(*tExit,  t2);
+	return *tEnter <= *tExit;
+}
+
+/* Initialises state for stepping through the cells along one axis of the ray */
+static void EntityGrid_InitStep(float origin, float dir, int cell, int* step, float* tNext, float* tDelta) {
+	if (dir > 0.0f) {
+		*step   = 1;
+		*tNext  = ((cell + 1) * (float)GRID_CELL_SIZE - origin) / dir;
+		*tDelta = GRID_CELL_SIZE / dir;
+	} else if (dir < 0.0f) {
+		*step   = -1;
+		*tNext  = (cell * (float)GRID_CELL_SIZE - origin) / dir;
+		*tDelta = -GRID_CELL_SIZE / dir;
+	} else {
+		*step   = 0;
+		*tNext  = MATH_LARGENUM;
+		*tDelta = MATH_LARGENUM;
+	}
+}
+
+/* Checks entities in cells along the ray, stopping once past the closest intersection */
+static void EntityGrid_RayTestPath(struct EntityGridRay* r) {
+	Vec3 origin = r->origin, dir = r->dir;
+	float tEnter, tExit, t, tNextX, tNextZ, tDeltaX, tDeltaZ;
+	int x, z, stepX, stepZ, steps, maxSteps, id;
+
+	/* Only the part of the ray within reach of a cell containing entities needs to be checked */
+	/* NOTE: When the ray starts inside an entity, that entity is always within reach of the origin */
+	tEnter = 0.0f; tExit = MATH_LARGENUM;
+	if (!EntityGrid_ClipRay(origin.x, dir.x, grid_minX - 1, grid_maxX + 1, &tEnter, &tExit)) return;
+	if (!EntityGrid_ClipRay(origin.z, dir.z, grid_minZ - 1, grid_maxZ + 1, &tEnter, &tExit)) return;
+
+	x = EntityGrid_Cell(origin.x + dir.x * tEnter);
+	z = EntityGrid_Cell(origin.z + dir.z * tEnter);
+	maxSteps = 
+		Math_AbsI(EntityGrid_Cell(origin.x + dir.x * tExit) - x) + 
+		Math_AbsI(EntityGrid_Cell(origin.z + dir.z * tExit) - z) + 2;
+
+	/* Checking every cell along a long ray is slower than just checking every entity */
+	if ((float)maxSteps * 9 >= grid_cellsCount) {
+		for (id = 0; id < ENTITIES_MAX_COUNT; id++)
+		{
+			if (grid_entities[id] && grid_bucket[id] != GRID_LARGE) EntityGrid_RayTest(r, id);
+		}
+		return;
+	}
+
+	EntityGrid_InitStep(origin.x, dir.x, x, &stepX, &tNextX, &tDeltaX);
+	EntityGrid_InitStep(origin.z, dir.z, z, &stepZ, &tNextZ, &tDeltaZ);
+	t = tEnter;
+
+	for (steps = 0; steps < maxSteps; steps++)
+	{
+		/* Any entity the ray intersects is found when checking around the cell of the intersection point, */
+		/*  so entities found in later cells can't be closer than the closest intersection found so far */
+		if (r->target >= 0 && t > r->closest) break;
+		EntityGrid_RayTestCells(r, x, z);
+
+		if (tNextX < tNextZ) {
+			t = tNextX; tNextX += tDeltaX; x += stepX;
+		} else {
+			t = tNextZ; tNextZ += tDeltaZ; z += stepZ;
+		}
+		if (t > tExit) break;
+	}
+}
+
+int Entities_RayCast(Vec3 origin, Vec3 dir, struct Entity* ignore, float* tMin) {
+	struct EntityGridRay r;
+	int id;
+
+	r.origin  = origin;
+	r.dir     = dir;
+	r.ignore  = ignore;
+	r.closest = 0.0f;
+	r.target  = -1;
+
+	if (!(++grid_stamp)) {
+		Mem_Set(grid_checked, 0, sizeof(grid_checked));
+		grid_stamp = 1;
+	}
+
+	for (id = grid_heads[GRID_LARGE]; id != GRID_NONE; id = grid_next[id])
+	{
+		EntityGrid_RayTest(&r, id);
+	}
+	if (grid_cellsCount) EntityGrid_RayTestPath(&r);
+
+	*tMin = r.closest;
+	return r.target;
+}
+
+
 /*########################################################################################################################*
 *--------------------------------------------------------Entities---------------------------------------------------------*
 *#########################################################################################################################*/
@@ -499,24 +826,51 @@ struct _EntitiesData Entities;
 
 static cc_bool Entities_Tick(struct ScheduledTask2* task) {
 	int i;
+	Entities_UpdateGrid();
 
 	for (i = 0; i < ENTITIES_MAX_COUNT; i++)
 	{
 		if (!Entities.List[i]) continue;
 		Entities.List[i]->VTABLE->Tick(Entities.List[i], task->interval);
+		/* So entities ticked afterwards see where this entity moved to */
+		EntityGrid_Update(i);
 	}
 	return true;
 }
 
+cc_uint16 Entities_VisibleIDs[ENTITIES_MAX_COUNT];
+int Entities_VisibleCount;
+
+/* Whether the entity's model is at least partially inside the view frustum */
+/* NOTE: The frustum's far plane is at view distance, so entities are culled on */
+/*  depth along the view direction the same way that the GPU clips them */
+static cc_bool Entity_IsVisible(struct Entity* e) {
+	if (!Model_ShouldRender(e)) return false;
+
+	/* Original classic only shows players up to 64 blocks away */
+	return !Game_ClassicMode || Model_RenderDistance(e) <= 64 * 64;
+}
+
 void Entities_RenderModels(float delta, float t) {
+	struct Entity* e;
 	int i;
 	Gfx_SetAlphaTest(true);
+	Model_BeginBatch();
+	Entities_VisibleCount = 0;
 	
 	for (i = 0; i < ENTITIES_MAX_COUNT; i++)
 	{
-		if (!Entities.List[i]) continue;
-		Entities.List[i]->VTABLE->RenderModel(Entities.List[i], delta, t);
+		e = Entities.List[i];
+		if (!e) continue;
+
+		/* NOTE: RenderModel may recalculate this after interpolating position */
+		e->ShouldRender = Entity_IsVisible(e);
+		e->VTABLE->RenderModel(e, delta, t);
+
+		/* Shadows and names are only drawn for entities in this list */
+		if (e->ShouldRender) Entities_VisibleIDs[Entities_VisibleCount++] = i;
 	}
+	Model_EndBatch();
 	Gfx_SetAlphaTest(false);
 }
 
@@ -545,6 +899,7 @@ void Entities_Remove(int id) {
 	Event_RaiseInt(&EntityEvents.Removed, id);
 	e->VTABLE->Despawn(e);
 	Entities.List[id] = NULL;
+	EntityGrid_Update(id);
 
 	/* TODO: Move to EntityEvents.Removed callback instead */
 	if (id < TABLIST_MAX_NAMES && TabList_EntityLinked_Get(id)) {
@@ -556,24 +911,12 @@ void Entities_Remove(int id) {
 int Entities_GetClosest(struct Entity* src) {
 	Vec3 eyePos = Entity_GetEyePosition(src);
 	Vec3 dir    = Vec3_GetDirVector(src->Yaw * MATH_DEG2RAD, src->Pitch * MATH_DEG2RAD);
-	float closestDist = -200; /* NOTE: was previously positive infinity */
-	int targetID = -1;
-
-	float t0, t1;
-	int i;
+	float t0;
 
-	for (i = 0; i < ENTITIES_MAX_COUNT; i++) /* because we don't want to pick against local player */
-	{
-		struct Entity* e = Entities.List[i];
-		if (!e || e == &Entities.CurPlayer->Base) continue;
-		if (!Intersection_RayIntersectsRotatedBox(eyePos, dir, e, &t0, &t1)) continue;
-
-		if (targetID < 0 || t0 < closestDist) {
-			closestDist = t0;
-			targetID    = i;
-		}
-	}
-	return targetID;
+	/* Entities are interpolated every frame, so may have moved since the last tick */
+	Entities_UpdateGrid();
+	/* because we don't want to pick against local player */
+	return Entities_RayCast(eyePos, dir, &Entities.CurPlayer->Base, &t0);
 }
 
 static void Player_Despawn(struct Entity* e) {
@@ -762,7 +1105,7 @@ static void LocalPlayer_RenderModel(struct Entity* e, float delta, float t) {
 	AnimatedComp_GetCurrent(e, t);
 
 	if (!Camera.Active->isThirdPerson && p == Entities.CurPlayer) return;
-	Model_Render(e->Model, e);
+	if (e->ShouldRender) Model_Render(e->Model, e);
 }
 
 static cc_bool LocalPlayer_ShouldRenderName(struct Entity* e) {
@@ -1146,10 +1489,7 @@ static void NetPlayer_RenderModel(struct Entity* e, float delta, float t) {
 	Entity_LerpAngles(e, t);
 
 	AnimatedComp_GetCurrent(e, t);
-	e->ShouldRender = Model_ShouldRender(e);
-	/* Original classic only shows players up to 64 blocks away */
-	if (Game_ClassicMode) e->ShouldRender &= Model_RenderDistance(e) <= 64 * 64;
-
+	e->ShouldRender = Entity_IsVisible(e);
 	if (e->ShouldRender) Model_Render(e->Model, e);
 }
 
@@ -1181,6 +1521,7 @@ void NetPlayer_Init(struct NetPlayer* p) {
 static void Entities_Init(void) {
 	int i;
 	Event_Register_(&GfxEvents.ContextLost, NULL, Entities_ContextLost);
+	EntityGrid_Init();
 
 	Entities.NamesMode = Options_GetEnum(OPT_NAMES_MODE, NAME_MODE_HOVERED,
 		NameMode_Names, Array_Elems(NameMode_Names));
@@ -118,7 +118,7 @@ struct Entity {
 	struct Model* Model;
 	BlockID ModelBlock; /* BlockID, if model name was originally a valid block. */
 	cc_uint8 Flags;
-	cc_uint8 ShouldRender;
+	cc_uint8 ShouldRender; /* Whether the entity is in the view frustum (set by Entities_RenderModels each frame) */
 	struct AABB ModelAABB;
 	Vec3 ModelScale, Size;
 	int _skinReqID;
@@ -183,7 +183,12 @@ CC_VAR extern struct _EntitiesData {
 	struct LocalPlayer* CurPlayer;
 } Entities;
 
-/* Renders all entities */
+/* IDs of entities that may be visible this frame (i.e. at least partially in the view frustum) */
+/* NOTE: Calculated in Entities_RenderModels, so only valid for the rest of the frame after that */
+extern cc_uint16 Entities_VisibleIDs[ENTITIES_MAX_COUNT];
+extern int Entities_VisibleCount;
+
+/* Renders all entities, and calculates which entities may be visible this frame */
 void Entities_RenderModels(float delta, float t);
 /* Removes the given entity, raising EntityEvents.Removed event */
 void Entities_Remove(int id);
@@ -191,6 +196,18 @@ void Entities_Remove(int id);
 /* Returns -1 if there is no other entity nearby */
 int Entities_GetClosest(struct Entity* src);
 
+/* Updates the spatial grid used by Entities_FindNear and Entities_RayCast to where entities currently are */
+/* NOTE: This is done automatically every tick, so only needs to be called if entities moved since then */
+CC_API void Entities_UpdateGrid(void);
+/* Finds entities whose bounding box is within the given distance of the given point */
+/* IDs of up to maxIds of these entities are stored in ids, in ascending order */
+/* Returns the number of IDs stored */
+CC_API int  Entities_FindNear(const Vec3* pos, float radius, EntityID* ids, int maxIds);
+/* Finds the entity whose rotated picking bounds the given ray intersects closest to its origin */
+/* tMin is set to how far along the ray that intersection is */
+/* Returns -1 if the ray does not intersect any entity (other than the ignored entity) */
+CC_API int  Entities_RayCast(Vec3 origin, Vec3 dir, struct Entity* ignore, float* tMin);
+
 #define TABLIST_MAX_NAMES 256
 /* Data for all entries in tab list */
 CC_VAR extern struct _TabListData {
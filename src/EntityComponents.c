@@ -1024,15 +1024,22 @@ float PhysicsComp_CalcJumpVelocity(float jumpHeight) {
 }
 
 void PhysicsComp_DoEntityPush(struct Entity* entity) {
+	EntityID ids[ENTITIES_MAX_COUNT];
 	struct Entity* other;
 	cc_bool yIntersects;
-	Vec3 dir;
-	float dist, pushStrength;
-	int id;
+	Vec3 dir, centre;
+	float dist, pushStrength, radius;
+	int i, count;
 	dir.y = 0.0f;
 
-	for (id = 0; id < ENTITIES_MAX_COUNT; id++) {
-		other = Entities.List[id];
+	/* Bounding boxes of entities within pushing distance horizontally that also intersect vertically */
+	/*  are always within this distance of the middle of the entity */
+	centre = entity->Position; centre.y += entity->Size.y * 0.5f;
+	radius = Math_SqrtF(1.0f + entity->Size.y * entity->Size.y * 0.25f) + ENTITY_ADJUSTMENT;
+	count  = Entities_FindNear(&centre, radius, ids, ENTITIES_MAX_COUNT);
+
+	for (i = 0; i < count; i++) {
+		other = Entities.List[ids[i]];
 		if (!other || other == entity) continue;
 		if (!other->Model->pushes)     continue;
 
@@ -13,6 +13,7 @@
 #include "Drawer2D.h"
 #include "Server.h"
 #include "Platform.h"
+#include "Camera.h"
 
 /*########################################################################################################################*
 *------------------------------------------------------Entity Shadow------------------------------------------------------*
@@ -270,10 +271,10 @@ void EntityShadows_Render(void) {
 	EntityShadow_Draw(&Entities.CurPlayer->Base);
 
 	if (Entities.ShadowsMode == SHADOW_MODE_CIRCLE_ALL) {	
-		for (i = 0; i < ENTITIES_MAX_COUNT; i++) 
+		for (i = 0; i < Entities_VisibleCount; i++) 
 		{
-			e = Entities.List[i];
-			if (!e || !e->ShouldRender || e == &Entities.CurPlayer->Base) continue;
+			e = Entities.List[Entities_VisibleIDs[i]];
+			if (!e || e == &Entities.CurPlayer->Base) continue;
 			EntityShadow_Draw(e);
 		}
 	}
@@ -290,6 +291,10 @@ void EntityShadows_Render(void) {
 static GfxResourceID names_VB;
 #define NAME_IS_EMPTY -30000
 #define NAME_OFFSET 3 /* offset of back layer of name above an entity */
+/* Max number of glyphs drawn from names_VB in one draw call */
+#define NAMES_MAX_GLYPHS 1024
+/* Each glyph consists of a quad for the back layer and a quad for the front layer */
+#define NAMES_MAX_VERTS (NAMES_MAX_GLYPHS * 8)
 
 static void MakeNameTexture(struct Entity* e) {
 	cc_string colorlessName; char colorlessBuffer[STRING_SIZE];
@@ -351,7 +356,7 @@ static void DrawName(struct Entity* e) {
 	Gfx_BindTexture(e->NameTex.ID);
 
 	if (!names_VB)
-		names_VB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, 4);
+		names_VB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, NAMES_MAX_VERTS);
 
 	model = e->Model;
 	Model_GetEntityTransform(model, e, &transform);
@@ -383,6 +388,212 @@ void EntityNames_Delete(struct Entity* e) {
 }
 
 
+/*########################################################################################################################*
+*------------------------------------------------------Nametag glyphs-----------------------------------------------------*
+*#########################################################################################################################*/
+/* Names are drawn as quads of glyphs from the default.png font atlas, */
+/*  so that all visible names can be drawn using just one texture and VB */
+#define NAME_POINT 24
+#define NAME_PADDING 3 /* Math_CeilDiv(NAME_POINT, 8), see Drawer2D_XPadding */
+/* Back layer quads are scaled away from the camera position by this factor. */
+/* This pushes them behind the front layer, while still covering the same pixels on screen */
+#define NAME_BACK_SCALE 1.01f
+
+static GfxResourceID names_tex;
+static struct Entity* names_list[ENTITIES_MAX_COUNT];
+static cc_uint8  names_glyphs[ENTITIES_MAX_COUNT];
+static cc_uint16 names_widths[ENTITIES_MAX_COUNT];
+static int names_count;
+static cc_bool names_unscaled;
+static struct Vec4 names_w; /* W column of View * Projection matrix */
+
+static cc_bool Names_MakeTexture(void) {
+	struct Bitmap* atlas;
+	if (names_tex) return true;
+	if (Gfx.Limitations & GFX_LIMIT_NO_UV_SUPPORT) return false;
+
+	atlas = Font_GetBitmapAtlas();
+	if (!atlas || !Gfx_CheckTextureSize(atlas->width, atlas->height, 0)) return false;
+
+	names_tex = Gfx_CreateTexture(atlas, TEXTURE_FLAG_LOWRES, false);
+	return names_tex != 0;
+}
+
+static void Names_Begin(void) {
+	struct Matrix mat;
+	Names_MakeTexture();
+	names_count    = 0;
+	names_unscaled = Entities.NamesMode == NAME_MODE_ALL_UNSCALED && Entities.CurPlayer->Hacks.CanSeeAllNames;
+	if (!names_unscaled) return;
+
+	Matrix_Mul(&mat, &Gfx.View, &Gfx.Projection);
+	names_w.x = mat.row1.w; names_w.y = mat.row2.w;
+	names_w.z = mat.row3.w; names_w.w = mat.row4.w;
+}
+
+static void Names_Add(struct Entity* e) {
+	struct Bitmap* atlas;
+	cc_string name;
+	int i, tileSize, glyphs = 0, width = 0;
+
+	if (!e->VTABLE->ShouldRenderName(e)) return;
+	if (!names_tex) { DrawName(e); return; }
+
+	atlas    = Font_GetBitmapAtlas();
+	tileSize = atlas->width >> 4;
+	name     = String_FromRawArray(e->NameRaw);
+
+	for (i = 0; i < name.length; i++)
+	{
+		if (name.buffer[i] == '&' && Drawer2D_ValidColorCodeAt(&name, i + 1)) {
+			i++; continue; /* skip over the color code */
+		}
+		width += Math_CeilDiv(Font_GetBitmapCharWidth(name.buffer[i]) * NAME_POINT, tileSize) + NAME_PADDING;
+		glyphs++;
+	}
+	if (!glyphs) return;
+
+	names_list[names_count]   = e;
+	names_glyphs[names_count] = glyphs;
+	/* No padding after last glyph, but back layer is offset to the right */
+	names_widths[names_count] = width - NAME_PADDING + NAME_OFFSET;
+	names_count++;
+}
+
+static void Names_AddGlyph(struct VertexTextured* v, const Vec3* origin, const Vec3* right, const Vec3* down,
+							int x, int y, int width, const TextureRec* rec, PackedCol col) {
+	float x1 = (float)x, x2 = (float)(x + width);
+	float y1 = (float)y, y2 = (float)(y + NAME_POINT);
+	Vec3 a, b; /* top left and bottom left corners */
+
+	a.x = origin->x + right->x * x1 + down->x * y1;
+	a.y = origin->y + right->y * x1 + down->y * y1;
+	a.z = origin->z + right->z * x1 + down->z * y1;
+	b.x = origin->x + right->x * x1 + down->x * y2;
+	b.y = origin->y + right->y * x1 + down->y * y2;
+	b.z = origin->z + right->z * x1 + down->z * y2;
+	x2 -= x1;
+
+	v->x = b.x; v->y = b.y; v->z = b.z; v->Col = col; v->U = rec->u1; v->V = rec->v2; v++;
+	v->x = a.x; v->y = a.y; v->z = a.z; v->Col = col; v->U = rec->u1; v->V = rec->v1; v++;
+	v->x = a.x + right->x * x2; v->y = a.y + right->y * x2; v->z = a.z + right->z * x2;
+	v->Col = col; v->U = rec->u2; v->V = rec->v1; v++;
+	v->x = b.x + right->x * x2; v->y = b.y + right->y * x2; v->z = b.z + right->z * x2;
+	v->Col = col; v->U = rec->u2; v->V = rec->v2; v++;
+}
+
+static struct VertexTextured* Names_Emit(struct VertexTextured* v, int index) {
+	struct Entity* e = names_list[index];
+	struct VertexTextured* back  = v;
+	struct VertexTextured* front = v + names_glyphs[index] * 4;
+	PackedCol backCol = PackedCol_Make(80, 80, 80, 255);
+	PackedCol col;
+	BitmapCol color;
+
+	struct Bitmap* atlas;
+	struct Model* model;
+	struct Matrix transform;
+	Vec3 pos, origin, right, down, eye;
+	Vec3 backOrigin, backRight, backDown;
+	int i, x, tileSize, srcWidth, dstWidth;
+	float scale, uvScale, width, height;
+	TextureRec rec;
+	cc_uint8 c;
+	cc_string name;
+
+	model = e->Model;
+	Model_GetEntityTransform(model, e, &transform);
+	Vec3_TransformY(&pos, model->GetNameY(e), &transform);
+
+	scale = e->ModelScale.y;
+	scale = scale > 1.0f ? (1.0f/70.0f) : (scale/70.0f);
+	if (names_unscaled) {
+		/* Get W component of transformed position */
+		scale *= (pos.x * names_w.x + pos.y * names_w.y + pos.z * names_w.z + names_w.w) * 0.2f;
+	}
+
+	right.x =  Gfx.View.row1.x * scale; right.y =  Gfx.View.row2.x * scale; right.z =  Gfx.View.row3.x * scale;
+	down.x  = -Gfx.View.row1.y * scale; down.y  = -Gfx.View.row2.y * scale; down.z  = -Gfx.View.row3.y * scale;
+
+	/* Same placement as Particle_DoRender, which centres on a point height/2 above pos */
+	width  = names_widths[index] * 0.5f;
+	height = (NAME_POINT + NAME_OFFSET) * 0.5f;
+	pos.y += height * scale;
+
+	origin.x = pos.x - right.x * width - down.x * height;
+	origin.y = pos.y - right.y * width - down.y * height;
+	origin.z = pos.z - right.z * width - down.z * height;
+
+	eye = Camera.CurrentPos;
+	Vec3_Sub(&backOrigin, &origin, &eye);
+	Vec3_Mul1By(&backOrigin, NAME_BACK_SCALE);
+	Vec3_AddBy(&backOrigin, &eye);
+	Vec3_Mul1(&backRight, &right, NAME_BACK_SCALE);
+	Vec3_Mul1(&backDown,  &down,  NAME_BACK_SCALE);
+
+	atlas    = Font_GetBitmapAtlas();
+	tileSize = atlas->width >> 4;
+	uvScale  = 1.0f / atlas->width;
+	name     = String_FromRawArray(e->NameRaw);
+
+	color = Drawer2D.Colors['f'];
+	col   = PackedCol_Make(BitmapCol_R(color), BitmapCol_G(color), BitmapCol_B(color), 255);
+
+	for (i = 0, x = 0; i < name.length; i++)
+	{
+		c = (cc_uint8)name.buffer[i];
+		if (c == '&' && Drawer2D_ValidColorCodeAt(&name, i + 1)) {
+			color = Drawer2D_GetColor(name.buffer[i + 1]);
+			col   = PackedCol_Make(BitmapCol_R(color), BitmapCol_G(color), BitmapCol_B(color), 255);
+			i++; continue; /* skip over the color code */
+		}
+
+		srcWidth = Font_GetBitmapCharWidth(c);
+		dstWidth = Math_CeilDiv(srcWidth * NAME_POINT, tileSize);
+
+		rec.u1 = (c & 0x0F) * tileSize * uvScale; rec.u2 = rec.u1 + srcWidth * uvScale;
+		rec.v1 = (c >> 4)   * tileSize * uvScale; rec.v2 = rec.v1 + tileSize * uvScale;
+
+		Names_AddGlyph(back,  &backOrigin, &backRight, &backDown, 
+						x + NAME_OFFSET, NAME_OFFSET, dstWidth, &rec, backCol);
+		Names_AddGlyph(front, &origin,     &right,     &down,
+						x,               0,           dstWidth, &rec, col);
+
+		back += 4; front += 4;
+		x    += dstWidth + NAME_PADDING;
+	}
+	return front;
+}
+
+static void Names_End(void) {
+	struct VertexTextured* v;
+	int i, j, glyphs;
+	if (!names_count) return;
+
+	if (!names_VB)
+		names_VB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, NAMES_MAX_VERTS);
+
+	Gfx_BindTexture(names_tex);
+	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
+
+	for (i = 0; i < names_count; )
+	{
+		/* Draw as many names as fit in names_VB in one call */
+		for (j = i, glyphs = 0; j < names_count && glyphs + names_glyphs[j] <= NAMES_MAX_GLYPHS; j++)
+		{
+			glyphs += names_glyphs[j];
+		}
+
+		v = (struct VertexTextured*)Gfx_LockDynamicVb(names_VB, VERTEX_FORMAT_TEXTURED, glyphs * 8);
+		for (; i < j; i++) { v = Names_Emit(v, i); }
+		Gfx_UnlockDynamicVb(names_VB);
+
+		Gfx_DrawVb_IndexedTris(glyphs * 8);
+	}
+	names_count = 0;
+}
+
+
 /*########################################################################################################################*
 *-----------------------------------------------------Names rendering-----------------------------------------------------*
 *#########################################################################################################################*/
@@ -391,7 +602,7 @@ static int closestEntityId;
 void EntityNames_Render(void) {
 	struct LocalPlayer* p = Entities.CurPlayer;
 	cc_bool hadFog;
-	int i;
+	int i, id;
 
 	if (Entities.NamesMode == NAME_MODE_NONE) return;
 	if (Server.IsSinglePlayer && Game_NumStates == 1) return;
@@ -403,11 +614,14 @@ void EntityNames_Render(void) {
 	hadFog = Gfx_GetFog();
 	if (hadFog) Gfx_SetFog(false);
 
-	for (i = 0; i < ENTITIES_MAX_COUNT; i++) 
+	Names_Begin();
+	for (i = 0; i < Entities_VisibleCount; i++) 
 	{
-		if (!Entities.List[i]) continue;
-		if (i != closestEntityId) DrawName(Entities.List[i]);
+		id = Entities_VisibleIDs[i];
+		if (!Entities.List[id]) continue;
+		if (id != closestEntityId) Names_Add(Entities.List[id]);
 	}
+	Names_End();
 
 	Gfx_SetAlphaTest(false);
 	if (hadFog) Gfx_SetFog(true);
@@ -418,7 +632,7 @@ void EntityNames_RenderHovered(void) {
 	struct Entity* e;
 	cc_bool allNames, hadFog;
 	cc_bool setupState = false;
-	int i;
+	int i, id;
 
 	if (Entities.NamesMode == NAME_MODE_NONE) return;
 	if (Server.IsSinglePlayer && Game_NumStates == 1) return;
@@ -426,11 +640,12 @@ void EntityNames_RenderHovered(void) {
 	allNames = !(Entities.NamesMode == NAME_MODE_HOVERED || Entities.NamesMode == NAME_MODE_ALL) 
 		&& p->Hacks.CanSeeAllNames;
 
-	for (i = 0; i < ENTITIES_MAX_COUNT; i++) 
+	for (i = 0; i < Entities_VisibleCount; i++) 
 	{
-		e = Entities.List[i];
+		id = Entities_VisibleIDs[i];
+		e  = Entities.List[id];
 		if (!e || e == &p->Base) continue;
-		if (!allNames && i != closestEntityId) continue;
+		if (!allNames && id != closestEntityId) continue;
 
 		/* Only alter the GPU state when actually necessary */
 		if (!setupState) {
@@ -441,11 +656,13 @@ void EntityNames_RenderHovered(void) {
 			setupState = true;
 			hadFog = Gfx_GetFog();
 			if (hadFog) Gfx_SetFog(false);
+			Names_Begin();
 		}
-		DrawName(e);
+		Names_Add(e);
 	}
 
 	if (!setupState) return;
+	Names_End();
 	Gfx_SetAlphaTest(false);
 	Gfx_SetDepthTest(true);
 	Gfx_SetDepthWrite(true);
@@ -462,6 +679,7 @@ static void DeleteAllNameTextures(void) {
 }
 
 static void EntityNames_ChatFontChanged(void* obj) {
+	Gfx_DeleteTexture(&names_tex);
 	DeleteAllNameTextures();
 }
 
@@ -474,6 +692,7 @@ static void EntityRenderers_ContextLost(void* obj) {
 	Gfx_DeleteDynamicVb(&shadows_VB);
 	
 	Gfx_DeleteDynamicVb(&names_VB);
+	Gfx_DeleteTexture(&names_tex);
 	DeleteAllNameTextures();
 }
 
@@ -410,12 +410,12 @@ static int CalcRainHeightAt(int x, int maxY, int z, int hIndex) {
 	cc_uint8 draw;
 
 #ifndef EXTENDED_BLOCKS
-	RainCalcBody(World.Blocks[i]);
+	RainCalcBody(World_GetLowerBlock(i));
 #else
 	if (World.IDMask <= 0xFF) {
-		RainCalcBody(World.Blocks[i]);
+		RainCalcBody(World_GetLowerBlock(i));
 	} else {
-		RainCalcBody(World.Blocks[i] | (World.Blocks2[i] << 8));
+		RainCalcBody(World_GetLowerBlock(i) | (World_GetUpperBlock(i) << 8));
 	}
 #endif
 
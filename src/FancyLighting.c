@@ -11,22 +11,47 @@
 #include "Chat.h"
 #include "ExtMath.h"
 #include "Options.h"
-#include "Queue.h"
 
-struct LightNode {
-	IVec3 coords; /* 12 bytes */
-	cc_uint8 brightness; /* 1 byte */
-	/* char padding[3]; */
+/* Light nodes are packed into 32 bits, as X in bits 0-7, Z in bits 8-15, Y in bits 16-23 and light level in bits 24-27 */
+/* Coordinates are stored relative to the anchor of the flood fill they belong to, and wrap around */
+/*  (this works because light never spreads anywhere near 128 blocks away from the anchor) */
+typedef cc_uint32 LightNode;
+/* Lava light, lamp light and sky light are each spread separately */
+#define LIGHT_CHANNEL_LAVA 0
+#define LIGHT_CHANNEL_LAMP 1
+#define LIGHT_CHANNEL_SKY  2
+#define LIGHT_CHANNELS     3
+
+/* Light nodes grouped by light level, so that brighter cells are always spread first */
+/*  (which means that each cell is only ever lit once in a flood fill) */
+struct LightBucket { LightNode* nodes; int count, capacity; };
+struct LightQueue  { struct LightBucket levels[FANCY_LIGHTING_LEVELS]; };
+
+struct LightFlood {
+	int anchorX, anchorY, anchorZ;
+	/* Whether light can only be spread into the cells of the owner chunk */
+	cc_bool hasOwner;
+	int ownerX, ownerY, ownerZ;
+	/* Whether chunks need to be refreshed when the light level of a cell changes */
+	cc_bool refresh;
+	/* Lit cells whose light still needs to be spread into neighbouring cells */
+	struct LightQueue queue[LIGHT_CHANNELS];
+	/* Cells that still need to be lit later, because they are either outside the owner chunk */
+	/*  or because they are waiting for light to be removed from the surrounding cells first */
+	struct LightQueue pending[LIGHT_CHANNELS];
 };
 
-static struct Queue lightQueue;
-static struct Queue unlightQueue;
+static struct LightFlood mainFlood;
+static struct LightQueue unlightQueue;
+static void StartLightWorkers(void);
+static void FreeLightWorkers(void);
 
 /* Top face, X face, Z face, bottomY face*/
 #define PALETTE_SHADES 4
 /* One palette-group for sunlight, one palette-group for shadow */
+/*  (or one palette-group per sky light level when sky light is enabled) */
 #define PALLETE_GROUP_COUNT 2
-#define PALETTE_COUNT (PALETTE_SHADES * PALLETE_GROUP_COUNT)
+#define PALETTE_COUNT (PALETTE_SHADES * FANCY_LIGHTING_LEVELS)
 
 #define PALETTE_YMAX_INDEX  0
 #define PALETTE_XSIDE_INDEX 1
@@ -35,9 +60,11 @@ static struct Queue unlightQueue;
 
 /* Index into palettes of light colors. */
 /* There are 8 different palettes: Four block-face shades for shadowed areas and four block-face shades for sunlit areas. */
+/* (when sky light is enabled, there are instead four block-face shades for each sky light level) */
 /* A palette is a 16x16 color array indexed by a byte where the leftmost 4 bits represent lamplight level and the rightmost 4 bits represent lavalight level */
 /* E.G. myPalette[0b_0010_0001] will give us the color for lamp level 2 and lava level 1 (lowest level is 0) */
 static PackedCol* palettes[PALETTE_COUNT];
+static int paletteGroups;
 
 typedef cc_uint8* LightingChunk;
 static cc_uint8* chunkLightingDataFlags;
@@ -45,6 +72,11 @@ static cc_uint8* chunkLightingDataFlags;
 #define CHUNK_SELF_CALCULATED 1
 #define CHUNK_ALL_CALCULATED 2
 static LightingChunk* chunkLightingData;
+/* Sky light level of each cell that isn't directly exposed to the sky */
+/*  (cells above the ClassicLighting heightmap always have maximum sky light) */
+static LightingChunk* chunkSkyData;
+/* Whether sunlight is spread into caves and under overhangs as a separate channel of light */
+static cc_bool skyLight;
 
 #define MakePaletteIndex(lampLevel, lavaLevel) ((lampLevel << FANCY_LIGHTING_LAMP_SHIFT) | lavaLevel)
 /* Fill in a palette with values based on the current light colors, shaded by the given shade value and lightened by the given ambientColor */
@@ -77,39 +109,55 @@ static void InitPalette(PackedCol* palette, float shaded, PackedCol ambientColor
 		}
 	}
 }
+/* Returns the ambient color of the given palette group, ranging from shadow color to sun color */
+static PackedCol GetAmbientColor(int group) {
+	float curLerp;
+	if (group == 0)                 return Env.ShadowCol;
+	if (group == paletteGroups - 1) return Env.SunCol;
+
+	curLerp = group / (float)(paletteGroups - 1);
+	curLerp *= (MATH_PI / 2);
+	curLerp = Math_CosF(curLerp);
+	return PackedCol_Lerp(Env.ShadowCol, Env.SunCol, 1 - curLerp);
+}
 static void InitPalettes(void) {
-	int i;
-	for (i = 0; i < PALETTE_COUNT; i++) {
+	PackedCol ambientColor;
+	int i, group;
+	for (i = 0; i < paletteGroups * PALETTE_SHADES; i++) {
+		if (palettes[i]) continue;
 		palettes[i] = (PackedCol*)Mem_Alloc(FANCY_LIGHTING_LEVELS * FANCY_LIGHTING_LEVELS, sizeof(PackedCol), "light color palette");
 	}
-	i = 0;
-	InitPalette(palettes[i + PALETTE_YMAX_INDEX],  1,                    Env.ShadowCol);
-	InitPalette(palettes[i + PALETTE_XSIDE_INDEX], PACKEDCOL_SHADE_X,    Env.ShadowCol);
-	InitPalette(palettes[i + PALETTE_ZSIDE_INDEX], PACKEDCOL_SHADE_Z,    Env.ShadowCol);
-	InitPalette(palettes[i + PALETTE_YMIN_INDEX],  PACKEDCOL_SHADE_YMIN, Env.ShadowCol);
-	i += PALETTE_SHADES;
-	InitPalette(palettes[i + PALETTE_YMAX_INDEX],  1,                    Env.SunCol);
-	InitPalette(palettes[i + PALETTE_XSIDE_INDEX], PACKEDCOL_SHADE_X,    Env.SunCol);
-	InitPalette(palettes[i + PALETTE_ZSIDE_INDEX], PACKEDCOL_SHADE_Z,    Env.SunCol);
-	InitPalette(palettes[i + PALETTE_YMIN_INDEX],  PACKEDCOL_SHADE_YMIN, Env.SunCol);
+
+	for (group = 0; group < paletteGroups; group++) {
+		ambientColor = GetAmbientColor(group);
+		i = group * PALETTE_SHADES;
+
+		InitPalette(palettes[i + PALETTE_YMAX_INDEX],  1,                    ambientColor);
+		InitPalette(palettes[i + PALETTE_XSIDE_INDEX], PACKEDCOL_SHADE_X,    ambientColor);
+		InitPalette(palettes[i + PALETTE_ZSIDE_INDEX], PACKEDCOL_SHADE_Z,    ambientColor);
+		InitPalette(palettes[i + PALETTE_YMIN_INDEX],  PACKEDCOL_SHADE_YMIN, ambientColor);
+	}
 }
 static void FreePalettes(void) {
 	int i;
 	for (i = 0; i < PALETTE_COUNT; i++) {
 		Mem_Free(palettes[i]);
+		palettes[i] = NULL;
 	}
 }
 
 static int chunksCount;
 static void AllocState(void) {
 	ClassicLighting_AllocState();
+	skyLight      = Options_GetBool(OPT_FANCY_SKY_LIGHT, false);
+	paletteGroups = skyLight ? FANCY_LIGHTING_LEVELS : PALLETE_GROUP_COUNT;
 	InitPalettes();
 	chunksCount = World.ChunksCount;
 
 	chunkLightingDataFlags = (cc_uint8*)Mem_AllocCleared(chunksCount, sizeof(cc_uint8), "light flags");
 	chunkLightingData = (LightingChunk*)Mem_AllocCleared(chunksCount, sizeof(LightingChunk), "light chunks");
-	Queue_Init(&lightQueue, sizeof(struct LightNode));
-	Queue_Init(&unlightQueue, sizeof(struct LightNode));
+	chunkSkyData      = (LightingChunk*)Mem_AllocCleared(chunksCount, sizeof(LightingChunk), "sky light chunks");
+	StartLightWorkers();
 }
 
 static void FreeState(void) {
@@ -123,14 +171,16 @@ static void FreeState(void) {
 
 	for (i = 0; i < chunksCount; i++) {
 		Mem_Free(chunkLightingData[i]);
+		Mem_Free(chunkSkyData[i]);
 	}
 
 	Mem_Free(chunkLightingDataFlags);
 	Mem_Free(chunkLightingData);
+	Mem_Free(chunkSkyData);
 	chunkLightingDataFlags = NULL;
 	chunkLightingData = NULL;
-	Queue_Clear(&lightQueue);
-	Queue_Clear(&unlightQueue);
+	chunkSkyData      = NULL;
+	FreeLightWorkers();
 }
 
 /* Converts chunk x/y/z coordinates to the corresponding index in chunks array/list */
@@ -141,29 +191,31 @@ static void FreeState(void) {
 #define GlobalCoordsToChunkCoordsIndex(x, y, z) (LocalCoordsToIndex(x & CHUNK_MASK, y & CHUNK_MASK, z & CHUNK_MASK))
 
 /* Sets the light level at this cell. Does NOT check that the cell is in bounds. */
-static void SetBrightness(cc_uint8 brightness, int x, int y, int z, cc_bool isLamp, cc_bool refreshChunk) {
-	cc_uint8 clearMask, shift = isLamp ? FANCY_LIGHTING_LAMP_SHIFT : 0, prevValue;
+static void SetBrightness(cc_uint8 brightness, int x, int y, int z, int channel, cc_bool refreshChunk) {
+	cc_uint8 clearMask, shift = channel == LIGHT_CHANNEL_LAMP ? FANCY_LIGHTING_LAMP_SHIFT : 0, prevValue;
 	int cx = x >> CHUNK_SHIFT, lx = x & CHUNK_MASK;
 	int cy = y >> CHUNK_SHIFT, ly = y & CHUNK_MASK;
 	int cz = z >> CHUNK_SHIFT, lz = z & CHUNK_MASK;
 	int chunkIndex = ChunkCoordsToIndex(cx, cy, cz);
 	int localIndex = LocalCoordsToIndex(lx, ly, lz);
+	/* Sky light is stored separately, one level per byte */
+	LightingChunk* chunks = channel == LIGHT_CHANNEL_SKY ? chunkSkyData : chunkLightingData;
 
-	if (chunkLightingData[chunkIndex] == NULL) {
-		chunkLightingData[chunkIndex] = (cc_uint8*)Mem_TryAllocCleared(CHUNK_SIZE_3, sizeof(cc_uint8));
+	if (chunks[chunkIndex] == NULL) {
+		chunks[chunkIndex] = (cc_uint8*)Mem_TryAllocCleared(CHUNK_SIZE_3, sizeof(cc_uint8));
 	}
 
-	/* 00001111 if lamp, otherwise 11110000*/
-	clearMask = ~(FANCY_LIGHTING_MAX_LEVEL << shift);
+	/* 00001111 if lamp, 11110000 if lava, 00000000 if sky */
+	clearMask = channel == LIGHT_CHANNEL_SKY ? 0 : ~(FANCY_LIGHTING_MAX_LEVEL << shift);
 
 	if (refreshChunk) {
-		prevValue = chunkLightingData[chunkIndex][localIndex];
+		prevValue = chunks[chunkIndex][localIndex];
 
-		chunkLightingData[chunkIndex][localIndex] &= clearMask;
-		chunkLightingData[chunkIndex][localIndex] |= brightness << shift;
+		chunks[chunkIndex][localIndex] &= clearMask;
+		chunks[chunkIndex][localIndex] |= brightness << shift;
 
 		/* There is no reason to refresh current chunk as the builder does that automatically */
-		if (prevValue != chunkLightingData[chunkIndex][localIndex]) {
+		if (prevValue != chunks[chunkIndex][localIndex]) {
 			if (lx == CHUNK_MAX) MapRenderer_RefreshChunk(cx + 1, cy, cz);
 			if (lx == 0)         MapRenderer_RefreshChunk(cx - 1, cy, cz);
 			if (ly == CHUNK_MAX) MapRenderer_RefreshChunk(cx, cy + 1, cz);
@@ -173,21 +225,29 @@ static void SetBrightness(cc_uint8 brightness, int x, int y, int z, cc_bool isLa
 		}
 	}
 	else {
-		chunkLightingData[chunkIndex][localIndex] &= clearMask;
-		chunkLightingData[chunkIndex][localIndex] |= brightness << shift;
+		chunks[chunkIndex][localIndex] &= clearMask;
+		chunks[chunkIndex][localIndex] |= brightness << shift;
 	}
 }
 /* Returns the light level at this cell. Does NOT check that the cell is in bounds. */
-static cc_uint8 GetBrightness(int x, int y, int z, cc_bool isLamp) {
+static cc_uint8 GetBrightness(int x, int y, int z, int channel) {
 	int cx = x >> CHUNK_SHIFT, lx = x & CHUNK_MASK;
 	int cy = y >> CHUNK_SHIFT, ly = y & CHUNK_MASK;
 	int cz = z >> CHUNK_SHIFT, lz = z & CHUNK_MASK;
 	int chunkIndex = ChunkCoordsToIndex(cx, cy, cz), localIndex;
 
+	if (channel == LIGHT_CHANNEL_SKY) {
+		/* Cells above the heightmap are always fully lit by the sky */
+		if (y > ClassicLighting_GetLightHeight(x, z)) return FANCY_LIGHTING_MAX_LEVEL;
+
+		if (chunkSkyData[chunkIndex] == NULL) { return 0; }
+		return chunkSkyData[chunkIndex][LocalCoordsToIndex(lx, ly, lz)];
+	}
+
 	if (chunkLightingData[chunkIndex] == NULL) { return 0; }
 	localIndex = LocalCoordsToIndex(lx, ly, lz);
 
-	return isLamp ?
+	return channel == LIGHT_CHANNEL_LAMP ?
 		chunkLightingData[chunkIndex][localIndex] >> FANCY_LIGHTING_LAMP_SHIFT :
 		chunkLightingData[chunkIndex][localIndex] & FANCY_LIGHTING_MAX_LEVEL;
 }
@@ -214,68 +274,170 @@ static cc_bool CanLightPass(BlockID thisBlock, Face face) {
 	return !Block_IsFaceHidden(BLOCK_STONE, thisBlock, face);
 }
 
-#define Light_TrySpreadInto(axis, AXIS, dir, limit, isLamp, thisFace, thatFace) \
-	if (ln.coords.axis dir ## = limit && \
-		CanLightPass(thisBlock, FACE_ ## AXIS ## thisFace) && \
-		CanLightPass(World_GetBlock(ln.coords.x, ln.coords.y, ln.coords.z), FACE_ ## AXIS ## thatFace) && \
-		GetBrightness(ln.coords.x, ln.coords.y, ln.coords.z, isLamp) < ln.brightness) { \
-		Queue_Enqueue(&lightQueue, &ln); \
-	} \
+/*########################################################################################################################*
+*----------------------------------------------------Light flood fill-----------------------------------------------------*
+*#########################################################################################################################*/
+#define LightNode_Make(f, x, y, z, level) ((((x) - (f)->anchorX) & 0xFF) | ((((z) - (f)->anchorZ) & 0xFF) << 8) | \
+										   ((((y) - (f)->anchorY) & 0xFF) << 16) | ((cc_uint32)(level) << 24))
+/* Sign extends the 8 bits of a relative coordinate */
+#define LightNode_Coord(node, shift) ((int)((((node) >> (shift)) & 0xFF) ^ 0x80) - 0x80)
+#define LightNode_X(f, node) ((f)->anchorX + LightNode_Coord(node, 0))
+#define LightNode_Z(f, node) ((f)->anchorZ + LightNode_Coord(node, 8))
+#define LightNode_Y(f, node) ((f)->anchorY + LightNode_Coord(node, 16))
+#define LightNode_Level(node) ((int)((node) >> 24))
+
+static void LightQueue_Push(struct LightQueue* queue, LightNode node) {
+	struct LightBucket* bucket = &queue->levels[LightNode_Level(node)];
+
+	if (bucket->count == bucket->capacity) {
+		bucket->capacity = max(bucket->capacity * 2, 256);
+		bucket->nodes    = (LightNode*)Mem_Realloc(bucket->nodes, bucket->capacity, sizeof(LightNode), "light nodes");
+	}
+	bucket->nodes[bucket->count++] = node;
+}
 
-static void FlushLightQueue(cc_bool isLamp, cc_bool refreshChunk) {
-	struct LightNode ln;
-	cc_uint8 brightnessHere;
-	BlockID thisBlock;
+static void LightQueue_Free(struct LightQueue* queue) {
+	int i;
+	for (i = 0; i < FANCY_LIGHTING_LEVELS; i++) 
+	{
+		Mem_Free(queue->levels[i].nodes);
+		queue->levels[i].nodes    = NULL;
+		queue->levels[i].count    = 0;
+		queue->levels[i].capacity = 0;
+	}
+}
 
-	while (lightQueue.count > 0) {
-		ln = *(struct LightNode*)(Queue_Dequeue(&lightQueue));
+static void LightFlood_Begin(struct LightFlood* f, int anchorX, int anchorY, int anchorZ, cc_bool refresh) {
+	f->anchorX  = anchorX;
+	f->anchorY  = anchorY;
+	f->anchorZ  = anchorZ;
+	f->hasOwner = false;
+	f->refresh  = refresh;
+}
 
-		brightnessHere = GetBrightness(ln.coords.x, ln.coords.y, ln.coords.z, isLamp);
+static void LightFlood_Free(struct LightFlood* f) {
+	int i;
+	for (i = 0; i < LIGHT_CHANNELS; i++)
+	{
+		LightQueue_Free(&f->queue[i]);
+		LightQueue_Free(&f->pending[i]);
+	}
+}
 
-		/* If this cell is already more lit, we can assume this cell and its neighbors have been accounted for */
-		if (brightnessHere >= ln.brightness) { continue; }
-		if (ln.brightness == 0) { continue; }
+/* Lights the given cell, if it is currently darker than the given light level */
+static void LightFlood_Light(struct LightFlood* f, int x, int y, int z, int level, int channel) {
+	if (f->hasOwner && ((x >> CHUNK_SHIFT) != f->ownerX || (y >> CHUNK_SHIFT) != f->ownerY || (z >> CHUNK_SHIFT) != f->ownerZ)) {
+		/* Another thread might be lighting that chunk, so leave the cell for later */
+		LightQueue_Push(&f->pending[channel], LightNode_Make(f, x, y, z, level));
+		return;
+	}
 
-		SetBrightness(ln.brightness, ln.coords.x, ln.coords.y, ln.coords.z, isLamp, refreshChunk);
+	if (GetBrightness(x, y, z, channel) >= level) return;
+	SetBrightness(level, x, y, z, channel, f->refresh);
 
-		thisBlock = World_GetBlock(ln.coords.x, ln.coords.y, ln.coords.z);
-		ln.brightness--;
-		if (ln.brightness == 0) continue;
+	/* Cells with light level 1 can't spread light any further */
+	if (level > 1) LightQueue_Push(&f->queue[channel], LightNode_Make(f, x, y, z, level));
+}
 
-		ln.coords.x--;
-		Light_TrySpreadInto(x, X, > , 0, isLamp, MAX, MIN)
-		ln.coords.x += 2;
-		Light_TrySpreadInto(x, X, < , World.MaxX, isLamp, MIN, MAX)
-		ln.coords.x--;
+/* Lights all the pending cells of the given flood fill */
+static void LightFlood_LightPending(struct LightFlood* f, struct LightFlood* src, int channel) {
+	struct LightBucket* bucket;
+	LightNode node;
+	int i, level;
+
+	for (level = 1; level < FANCY_LIGHTING_LEVELS; level++)
+	{
+		bucket = &src->pending[channel].levels[level];
+		for (i = 0; i < bucket->count; i++)
+		{
+			node = bucket->nodes[i];
+			LightFlood_Light(f, LightNode_X(src, node), LightNode_Y(src, node), LightNode_Z(src, node), level, channel);
+		}
+		bucket->count = 0;
+	}
+	src->pending[channel].levels[0].count = 0;
+}
 
-		ln.coords.y--;
-		Light_TrySpreadInto(y, Y, >, 0, isLamp, MAX, MIN)
-		ln.coords.y += 2;
-		Light_TrySpreadInto(y, Y, <, World.MaxY, isLamp, MIN, MAX)
-		ln.coords.y--;
+#define Light_TrySpreadInto(inBounds, nx, ny, nz, thisFace, thatFace) \
+	if (inBounds && \
+		CanLightPass(thisBlock, thisFace) && \
+		CanLightPass(World_GetBlock(nx, ny, nz), thatFace)) { \
+		LightFlood_Light(f, nx, ny, nz, level - 1, channel); \
+	}
 
-		ln.coords.z--;
-		Light_TrySpreadInto(z, Z, > , 0, isLamp, MAX, MIN)
-		ln.coords.z += 2;
-		Light_TrySpreadInto(z, Z, < , World.MaxZ, isLamp, MIN, MAX)
+/* Spreads light out from all the lit cells in the queue, brightest cells first */
+static void LightFlood_Spread(struct LightFlood* f, int channel) {
+	struct LightBucket* bucket;
+	LightNode node;
+	BlockID thisBlock;
+	int x, y, z, level;
+
+	for (level = FANCY_LIGHTING_MAX_LEVEL; level > 1; level--)
+	{
+		/* Spreading only adds darker cells, so this bucket won't be added to again */
+		bucket = &f->queue[channel].levels[level];
+
+		while (bucket->count > 0) {
+			node = bucket->nodes[--bucket->count];
+			x = LightNode_X(f, node);
+			y = LightNode_Y(f, node);
+			z = LightNode_Z(f, node);
+			thisBlock = World_GetBlock(x, y, z);
+
+			Light_TrySpreadInto(x > 0,           x - 1, y, z, FACE_XMAX, FACE_XMIN)
+			Light_TrySpreadInto(x < World.MaxX,  x + 1, y, z, FACE_XMIN, FACE_XMAX)
+			Light_TrySpreadInto(y > 0,           x, y - 1, z, FACE_YMAX, FACE_YMIN)
+			Light_TrySpreadInto(y < World.MaxY,  x, y + 1, z, FACE_YMIN, FACE_YMAX)
+			Light_TrySpreadInto(z > 0,           x, y, z - 1, FACE_ZMAX, FACE_ZMIN)
+			Light_TrySpreadInto(z < World.MaxZ,  x, y, z + 1, FACE_ZMIN, FACE_ZMAX)
+		}
 	}
 }
 
-cc_uint8 GetBlockBrightness(BlockID curBlock, cc_bool isLamp) {
-	if (isLamp) return Blocks.Brightness[curBlock] >> FANCY_LIGHTING_LAMP_SHIFT;
+cc_uint8 GetBlockBrightness(BlockID curBlock, int channel) {
+	/* Blocks never emit sky light */
+	if (channel == LIGHT_CHANNEL_SKY)  return 0;
+	if (channel == LIGHT_CHANNEL_LAMP) return Blocks.Brightness[curBlock] >> FANCY_LIGHTING_LAMP_SHIFT;
 	return Blocks.Brightness[curBlock] & FANCY_LIGHTING_MAX_LEVEL;
 }
 
-#define LightNode_Init(node, X, Y, Z, bright) \
-	node.coords.x = X; node.coords.y = Y; node.coords.z = Z; node.brightness = bright;
+/* Returns the light height of the given column, or -1 if the column is outside the map */
+static int GetNeighbourHeight(int x, int z) {
+	if (!World_ContainsXZ(x, z)) return -1;
+	return ClassicLighting_GetLightHeight(x, z);
+}
 
-static void CalculateChunkLightingSelf(int chunkIndex, int cx, int cy, int cz) {
-	int x, y, z;
+/* Seeds the cells in the given region that are directly lit by the sky, */
+/*  but are next to cells that are not (i.e. where sky light can start spreading from) */
+static void SeedSkyLight(struct LightFlood* f, int x1, int y1, int z1, int x2, int y2, int z2) {
+	int x, y, z, height, maxY;
+
+	for (z = z1; z < z2; z++) {
+		for (x = x1; x < x2; x++) {
+			height = ClassicLighting_GetLightHeight(x, z);
+			/* Cell directly above the column's light blocking block */
+			maxY   = height + 1;
+			/* Cells next to the side of a neighbouring column's light blocking blocks */
+			maxY   = max(maxY, GetNeighbourHeight(x - 1, z));
+			maxY   = max(maxY, GetNeighbourHeight(x + 1, z));
+			maxY   = max(maxY, GetNeighbourHeight(x, z - 1));
+			maxY   = max(maxY, GetNeighbourHeight(x, z + 1));
+
+			for (y = max(height + 1, y1); y <= maxY && y < y2; y++) {
+				/* Cell already has maximum sky light, so add it straight to the queue */
+				LightQueue_Push(&f->queue[LIGHT_CHANNEL_SKY], LightNode_Make(f, x, y, z, FANCY_LIGHTING_MAX_LEVEL));
+			}
+		}
+	}
+}
+
+/* Spreads the light from all of the light casting blocks in the given chunk */
+static void CalculateChunkLightingSelf(struct LightFlood* f, int cx, int cy, int cz) {
+	int x, y, z, index;
 	/* Block coordinates */
 	int chunkStartX, chunkStartY, chunkStartZ, chunkEndX, chunkEndY, chunkEndZ;
 	cc_uint8 brightness;
 	BlockID curBlock;
-	struct LightNode entry;
 
 	chunkStartX = cx * CHUNK_SIZE;
 	chunkStartY = cy * CHUNK_SIZE;
@@ -288,28 +450,22 @@ static void CalculateChunkLightingSelf(int chunkIndex, int cx, int cy, int cz) {
 	if (chunkEndY > World.Height) { chunkEndY = World.Height; }
 	if (chunkEndZ > World.Length) { chunkEndZ = World.Length; }
 
+	/* Seed all the light casting blocks first, so the chunk is only flood filled once */
 	for (y = chunkStartY; y < chunkEndY; y++) {
 		for (z = chunkStartZ; z < chunkEndZ; z++) {
-			for (x = chunkStartX; x < chunkEndX; x++) {
-
-				curBlock = World_GetBlock(x, y, z);
-				
-				if (Blocks.Brightness[curBlock] > 0) {
-
-					brightness = GetBlockBrightness(curBlock, false);
-
-					if (brightness > 0) {
-						LightNode_Init(entry, x, y, z, brightness);
-						Queue_Enqueue(&lightQueue, &entry);
-						FlushLightQueue(false, false);
-					}
-					else {
-						/* If no lava brightness, it must use lamp brightness */
-						brightness = Blocks.Brightness[curBlock] >> FANCY_LIGHTING_LAMP_SHIFT;
-						LightNode_Init(entry, x, y, z, brightness);
-						Queue_Enqueue(&lightQueue, &entry);
-						FlushLightQueue(true, false);
-					}
+			index = World_Pack(chunkStartX, y, z);
+
+			for (x = chunkStartX; x < chunkEndX; x++, index++) {
+				curBlock = World_GetRawBlock(index);
+				if (!Blocks.Brightness[curBlock]) continue;
+
+				brightness = GetBlockBrightness(curBlock, LIGHT_CHANNEL_LAVA);
+				if (brightness > 0) {
+					LightFlood_Light(f, x, y, z, brightness, LIGHT_CHANNEL_LAVA);
+				} else {
+					/* If no lava brightness, it must use lamp brightness */
+					brightness = Blocks.Brightness[curBlock] >> FANCY_LIGHTING_LAMP_SHIFT;
+					LightFlood_Light(f, x, y, z, brightness, LIGHT_CHANNEL_LAMP);
 				}
 
 				/* Note: This code only deals with generating light from block sources.
@@ -319,11 +475,104 @@ static void CalculateChunkLightingSelf(int chunkIndex, int cx, int cy, int cz) {
 		}
 	}
 
-	chunkLightingDataFlags[chunkIndex] = CHUNK_SELF_CALCULATED;
+	LightFlood_Spread(f, LIGHT_CHANNEL_LAVA);
+	LightFlood_Spread(f, LIGHT_CHANNEL_LAMP);
+
+	if (!skyLight) return;
+	SeedSkyLight(f, chunkStartX, chunkStartY, chunkStartZ, chunkEndX, chunkEndY, chunkEndZ);
+	LightFlood_Spread(f, LIGHT_CHANNEL_SKY);
+}
+
+
+/*########################################################################################################################*
+*---------------------------------------------------Light worker threads--------------------------------------------------*
+*#########################################################################################################################*/
+/* Chunks are lit in parallel, with each thread only lighting the cells of its own chunk. */
+/* Light that spreads across chunk borders is handed off to the main thread, */
+/*  which then spreads that light afterwards once all of the chunks have been lit. */
+/* Max number of chunks that CalculateChunkLightingAll lights at once */
+#define MAX_LIGHT_JOBS 27
+
+struct LightJob { int cx, cy, cz; };
+static struct LightJob lightJobs[MAX_LIGHT_JOBS];
+static int lightJobsCount, nextLightJob;
+static int lightAnchorX, lightAnchorY, lightAnchorZ;
+
+static struct WorkerPool lightPool;
+static struct LightFlood* workerFloods;
+
+static void RunLightJobs(int workerID) {
+	struct LightFlood* f = workerID < 0 ? &mainFlood : &workerFloods[workerID];
+	struct LightJob* job;
+	int i;
+
+	for (;;)
+	{
+		Mutex_Lock(lightPool.mutex);
+		{
+			i = nextLightJob++;
+		}
+		Mutex_Unlock(lightPool.mutex);
+		if (i >= lightJobsCount) return;
+
+		job = &lightJobs[i];
+		LightFlood_Begin(f, lightAnchorX, lightAnchorY, lightAnchorZ, false);
+		f->hasOwner = true;
+		f->ownerX   = job->cx; f->ownerY = job->cy; f->ownerZ = job->cz;
+		CalculateChunkLightingSelf(f, job->cx, job->cy, job->cz);
+	}
+}
+
+static void StartLightWorkers(void) {
+	int count;
+	if (lightPool.count) return;
+
+#ifdef CC_BUILD_COOPTHREADED
+	count = 0;
+#else
+	count = Options_GetInt(OPT_LIGHTING_THREADS, 0, WORKERPOOL_MAX_THREADS, 4);
+#endif
+	if (!count) return;
+
+	workerFloods = (struct LightFlood*)Mem_TryAllocCleared(count, sizeof(struct LightFlood));
+	if (!workerFloods) return;
+
+	WorkerPool_Start(&lightPool, count, RunLightJobs, 128 * 1024, "Chunk lighter");
+}
+
+/* Frees the memory used by flood fills (worker threads are idle at this point) */
+static void FreeLightWorkers(void) {
+	int i;
+	LightFlood_Free(&mainFlood);
+	LightQueue_Free(&unlightQueue);
+
+	for (i = 0; i < lightPool.count; i++)
+	{
+		LightFlood_Free(&workerFloods[i]);
+	}
+}
+
+static void LightChunksParallel(void) {
+	int i, channel;
+	nextLightJob = 0;
+	/* Main thread lights chunks too while waiting */
+	WorkerPool_Run(&lightPool);
+
+	/* Spread the light that was handed off across chunk borders */
+	LightFlood_Begin(&mainFlood, lightAnchorX, lightAnchorY, lightAnchorZ, false);
+	for (channel = 0; channel < LIGHT_CHANNELS; channel++)
+	{
+		LightFlood_LightPending(&mainFlood, &mainFlood, channel);
+		for (i = 0; i < lightPool.count; i++)
+		{
+			LightFlood_LightPending(&mainFlood, &workerFloods[i], channel);
+		}
+		LightFlood_Spread(&mainFlood, channel);
+	}
 }
 
 static void CalculateChunkLightingAll(int chunkIndex, int cx, int cy, int cz) {
-	int x, y, z;
+	int x, y, z, i;
 	/* Chunk coordinates */
 	int chunkStartX, chunkStartY, chunkStartZ;
 	int chunkEndX, chunkEndY, chunkEndZ;
@@ -343,105 +592,142 @@ static void CalculateChunkLightingAll(int chunkIndex, int cx, int cy, int cz) {
 	if (chunkEndY == World.ChunksY) { chunkEndY--; }
 	if (chunkEndZ == World.ChunksZ) { chunkEndZ--; }
 
+	lightJobsCount = 0;
 	for (y = chunkStartY; y <= chunkEndY; y++) {
 		for (z = chunkStartZ; z <= chunkEndZ; z++) {
 			for (x = chunkStartX; x <= chunkEndX; x++) {
 				curChunkIndex = ChunkCoordsToIndex(x, y, z);
+				if (chunkLightingDataFlags[curChunkIndex] != CHUNK_UNCALCULATED) continue;
 
-				if (chunkLightingDataFlags[curChunkIndex] == CHUNK_UNCALCULATED) {
-					CalculateChunkLightingSelf(curChunkIndex, x, y, z);
-				}
+				lightJobs[lightJobsCount].cx = x;
+				lightJobs[lightJobsCount].cy = y;
+				lightJobs[lightJobsCount].cz = z;
+				lightJobsCount++;
 			}
 		}
 	}
+
+	lightAnchorX = cx * CHUNK_SIZE + HALF_CHUNK_SIZE;
+	lightAnchorY = cy * CHUNK_SIZE + HALF_CHUNK_SIZE;
+	lightAnchorZ = cz * CHUNK_SIZE + HALF_CHUNK_SIZE;
+
+	if (lightPool.count && lightJobsCount > 1) {
+		/* Sky light reads the heightmap, which is lazily calculated, so calculate it beforehand */
+		/*  (including the neighbouring columns of each chunk) */
+		for (i = 0; skyLight && i < lightJobsCount; i++)
+		{
+			ClassicLighting_LightHint(lightJobs[i].cx * CHUNK_SIZE - 1, 0, lightJobs[i].cz * CHUNK_SIZE - 1);
+		}
+		LightChunksParallel();
+	} else {
+		LightFlood_Begin(&mainFlood, lightAnchorX, lightAnchorY, lightAnchorZ, false);
+		for (i = 0; i < lightJobsCount; i++)
+		{
+			CalculateChunkLightingSelf(&mainFlood, lightJobs[i].cx, lightJobs[i].cy, lightJobs[i].cz);
+		}
+	}
+
+	for (i = 0; i < lightJobsCount; i++)
+	{
+		curChunkIndex = ChunkCoordsToIndex(lightJobs[i].cx, lightJobs[i].cy, lightJobs[i].cz);
+		chunkLightingDataFlags[curChunkIndex] = CHUNK_SELF_CALCULATED;
+	}
 	chunkLightingDataFlags[chunkIndex] = CHUNK_ALL_CALCULATED;
 }
 
 
-#define Light_TryUnSpreadInto(axis, dir, limit, AXIS, thisFace, thatFace) \
-		if (neighborCoords.axis dir ## = limit && \
-			CanLightPass(thisBlock, FACE_ ## AXIS ## thisFace) && \
-			CanLightPass(World_GetBlock(neighborCoords.x, neighborCoords.y, neighborCoords.z), FACE_ ## AXIS ## thatFace) \
+/*########################################################################################################################*
+*-----------------------------------------------------Block changes-------------------------------------------------------*
+*#########################################################################################################################*/
+#define Light_TryUnSpreadInto(inBounds, nx, ny, nz, thisFace, thatFace) \
+		if (inBounds && \
+			CanLightPass(thisBlock, thisFace) && \
+			CanLightPass(World_GetBlock(nx, ny, nz), thatFace) \
 		) \
 		{ \
-			neighborBrightness = GetBrightness(neighborCoords.x, neighborCoords.y, neighborCoords.z, isLamp); \
-			neighborBlockBrightness = GetBlockBrightness(World_GetBlock(neighborCoords.x, neighborCoords.y, neighborCoords.z), isLamp); \
+			neighborBrightness = GetBrightness(nx, ny, nz, channel); \
+			neighborBlockBrightness = GetBlockBrightness(World_GetBlock(nx, ny, nz), channel); \
 			/* This spot is a light caster, mark this spot as needing to be re-spread */ \
 			if (neighborBlockBrightness > 0) { \
-				LightNode_Init(otherNode, neighborCoords.x, neighborCoords.y, neighborCoords.z, neighborBlockBrightness); \
-				Queue_Enqueue(&lightQueue, &otherNode); \
+				LightQueue_Push(&f->pending[channel], LightNode_Make(f, nx, ny, nz, neighborBlockBrightness)); \
 			} \
 			if (neighborBrightness > 0) { \
 				/* This neighbor is darker than cur spot, darken it*/ \
-				if (neighborBrightness < curNode.brightness) { \
-					SetBrightness(0, neighborCoords.x, neighborCoords.y, neighborCoords.z, isLamp, true); \
-					LightNode_Init(otherNode, neighborCoords.x, neighborCoords.y, neighborCoords.z, neighborBrightness); \
-					Queue_Enqueue(&unlightQueue, &otherNode); \
+				if (neighborBrightness < level) { \
+					SetBrightness(0, nx, ny, nz, channel, true); \
+					LightQueue_Push(&unlightQueue, LightNode_Make(f, nx, ny, nz, neighborBrightness)); \
 				} \
 				/* This neighbor is brighter or same, mark this spot as needing to be re-spread */ \
 				else { \
 					/* But only if the neighbor actually *can* spread to this block */ \
 					if ( \
-						CanLightPass(thisBlockTrue, FACE_ ## AXIS ## thisFace) && \
-						CanLightPass(World_GetBlock(neighborCoords.x, neighborCoords.y, neighborCoords.z), FACE_ ## AXIS ## thatFace) \
+						CanLightPass(thisBlockTrue, thisFace) && \
+						CanLightPass(World_GetBlock(nx, ny, nz), thatFace) \
 					) \
 					{ \
-						otherNode = curNode; \
-						otherNode.brightness = neighborBrightness-1; \
-						Queue_Enqueue(&lightQueue, &otherNode); \
+						LightQueue_Push(&f->pending[channel], LightNode_Make(f, x, y, z, neighborBrightness - 1)); \
 					} \
 				} \
 			} \
 		} \
 
-/* Spreads darkness out from this point and relights any necessary areas afterward */
-static void CalcUnlight(int x, int y, int z, cc_uint8 brightness, cc_bool isLamp) {
-	int count = 0;
-	struct LightNode curNode, otherNode;
+/* Spreads darkness out from the cells in the unlight queue, and relights any necessary areas afterward */
+/* NOTE: The starting cells must all have the given brightness, and must already have been darkened */
+static void LightFlood_Unlight(struct LightFlood* f, cc_uint8 brightness, int channel) {
+	struct LightBucket* bucket;
 	cc_uint8 neighborBrightness, neighborBlockBrightness;
-	IVec3 neighborCoords;
 	BlockID thisBlockTrue, thisBlock;
+	int x, y, z, level;
+	LightNode node;
+
+	/* Darkening a cell only ever adds darker cells, so process brightest cells first */
+	for (level = brightness; level >= 0; level--)
+	{
+		bucket = &unlightQueue.levels[level];
+
+		while (bucket->count > 0) {
+			node = bucket->nodes[--bucket->count];
+			x = LightNode_X(f, node);
+			y = LightNode_Y(f, node);
+			z = LightNode_Z(f, node);
+
+			thisBlockTrue = World_GetBlock(x, y, z);
+			/* For the original cells in the queue, assume this block is air
+			so that light can unspread "out" of it in the case of a solid blocks. */
+			/* (only the original cells can have the starting brightness, as cells added are always darker) */
+			thisBlock = level == brightness ? BLOCK_AIR : thisBlockTrue;
+
+			/* Cells directly exposed to the sky are always sky light sources, so light must be re-spread from them */
+			if (level == brightness && channel == LIGHT_CHANNEL_SKY && y > ClassicLighting_GetLightHeight(x, z)) {
+				LightQueue_Push(&f->queue[channel], LightNode_Make(f, x, y, z, FANCY_LIGHTING_MAX_LEVEL));
+			}
 
-	SetBrightness(0, x, y, z, isLamp, true);
-	LightNode_Init(curNode, x, y, z, brightness);
-	Queue_Enqueue(&unlightQueue, &curNode);
-
-	while (unlightQueue.count > 0) {
-		curNode = *(struct LightNode*)(Queue_Dequeue(&unlightQueue));
-		neighborCoords = curNode.coords;
-
-		thisBlockTrue = World_GetBlock(neighborCoords.x, neighborCoords.y, neighborCoords.z);
-		/* For the original cell in the queue, assume this block is air
-		so that light can unspread "out" of it in the case of a solid blocks. */
-		thisBlock = count == 0 ? BLOCK_AIR : thisBlockTrue;
-
-		count++;
-
-		neighborCoords.x--;
-		Light_TryUnSpreadInto(x, >, 0, X, MAX, MIN)
-		neighborCoords.x += 2;
-		Light_TryUnSpreadInto(x, <, World.MaxX, X, MIN, MAX)
-		neighborCoords.x--;
-
-		neighborCoords.y--;
-		Light_TryUnSpreadInto(y, >, 0, Y, MAX, MIN)
-		neighborCoords.y += 2;
-		Light_TryUnSpreadInto(y, <, World.MaxY, Y, MIN, MAX)
-		neighborCoords.y--;
-
-		neighborCoords.z--;
-		Light_TryUnSpreadInto(z, >, 0, Z, MAX, MIN)
-		neighborCoords.z += 2;
-		Light_TryUnSpreadInto(z, <, World.MaxZ, Z, MIN, MAX)
+			Light_TryUnSpreadInto(x > 0,          x - 1, y, z, FACE_XMAX, FACE_XMIN)
+			Light_TryUnSpreadInto(x < World.MaxX, x + 1, y, z, FACE_XMIN, FACE_XMAX)
+			Light_TryUnSpreadInto(y > 0,          x, y - 1, z, FACE_YMAX, FACE_YMIN)
+			Light_TryUnSpreadInto(y < World.MaxY, x, y + 1, z, FACE_YMIN, FACE_YMAX)
+			Light_TryUnSpreadInto(z > 0,          x, y, z - 1, FACE_ZMAX, FACE_ZMIN)
+			Light_TryUnSpreadInto(z < World.MaxZ, x, y, z + 1, FACE_ZMIN, FACE_ZMAX)
+		}
 	}
 
-	FlushLightQueue(isLamp, true);
+	LightFlood_LightPending(f, f, channel);
+	LightFlood_Spread(f, channel);
 }
-static void CalcBlockChange(int x, int y, int z, BlockID oldBlock, BlockID newBlock, cc_bool isLamp) {
-	cc_uint8 oldBlockLightLevel = GetBlockBrightness(oldBlock, isLamp);
-	cc_uint8 newBlockLightLevel = GetBlockBrightness(newBlock, isLamp);
-	cc_uint8 oldLightLevelHere = GetBrightness(x, y, z, isLamp);
-	struct LightNode entry;
+
+/* Spreads darkness out from this point and relights any necessary areas afterward */
+static void CalcUnlight(int x, int y, int z, cc_uint8 brightness, int channel) {
+	LightFlood_Begin(&mainFlood, x, y, z, true);
+	SetBrightness(0, x, y, z, channel, true);
+
+	LightQueue_Push(&unlightQueue, LightNode_Make(&mainFlood, x, y, z, brightness));
+	LightFlood_Unlight(&mainFlood, brightness, channel);
+}
+
+static void CalcBlockChange(int x, int y, int z, BlockID oldBlock, BlockID newBlock, int channel) {
+	cc_uint8 oldBlockLightLevel = GetBlockBrightness(oldBlock, channel);
+	cc_uint8 newBlockLightLevel = GetBlockBrightness(newBlock, channel);
+	cc_uint8 oldLightLevelHere = GetBrightness(x, y, z, channel);
 
 	/* Cell has no lighting and new block doesn't cast light and blocks all light, no change */
 	if (!oldLightLevelHere && !newBlockLightLevel && IsFullOpaque(newBlock)) return;
@@ -449,25 +735,81 @@ static void CalcBlockChange(int x, int y, int z, BlockID oldBlock, BlockID newBl
 	/* Cell is darker than the new block, only brighter case */
 	if (oldLightLevelHere < newBlockLightLevel) {
 		/* brighten this spot, recalculate lighting */
-		LightNode_Init(entry, x, y, z, newBlockLightLevel);
-		Queue_Enqueue(&lightQueue, &entry);
-		FlushLightQueue(isLamp, true);
+		LightFlood_Begin(&mainFlood, x, y, z, true);
+		LightFlood_Light(&mainFlood, x, y, z, newBlockLightLevel, channel);
+		LightFlood_Spread(&mainFlood, channel);
 		return;
 	}
 
 	/* Light passes through old and new, old block does not cast light, new block does not cast light; no change */
 	if (IsFullTransparent(oldBlock) && IsFullTransparent(newBlock) && !oldBlockLightLevel && !newBlockLightLevel) return;
 
-	CalcUnlight(x, y, z, oldLightLevelHere, isLamp);
+	CalcUnlight(x, y, z, oldLightLevelHere, channel);
+}
+
+/* Max number of column cells that are darkened or lit at once when the heightmap changes */
+/*  (as light nodes can only store coordinates within 128 blocks of the flood fill's anchor) */
+#define SKY_COLUMN_STEP 64
+
+/* Updates sky light after the light height of a column changed from oldHeight to newHeight */
+static void CalcSkyHeightChange(int x, int z, int oldHeight, int newHeight) {
+	int y, minY, maxY;
+	/* Columns with no light blocking blocks have a height below the bottom of the map */
+	oldHeight = max(oldHeight, -1);
+	newHeight = max(newHeight, -1);
+
+	if (newHeight > oldHeight) {
+		/* Column cells that were directly exposed to the sky no longer are */
+		for (maxY = newHeight; maxY > oldHeight; maxY -= SKY_COLUMN_STEP)
+		{
+			minY = max(maxY - SKY_COLUMN_STEP, oldHeight);
+			LightFlood_Begin(&mainFlood, x, maxY, z, true);
+
+			for (y = minY + 1; y <= maxY; y++)
+			{
+				LightQueue_Push(&unlightQueue, LightNode_Make(&mainFlood, x, y, z, FANCY_LIGHTING_MAX_LEVEL));
+			}
+			LightFlood_Unlight(&mainFlood, FANCY_LIGHTING_MAX_LEVEL, LIGHT_CHANNEL_SKY);
+		}
+	} else {
+		/* Column cells are now directly exposed to the sky */
+		for (minY = newHeight; minY < oldHeight; minY += SKY_COLUMN_STEP)
+		{
+			maxY = min(minY + SKY_COLUMN_STEP, oldHeight);
+			LightFlood_Begin(&mainFlood, x, minY, z, true);
+
+			for (y = minY + 1; y <= maxY; y++)
+			{
+				/* Exposed cells should have no stored sky light, in case they later stop being exposed */
+				SetBrightness(0, x, y, z, LIGHT_CHANNEL_SKY, false);
+				LightQueue_Push(&mainFlood.queue[LIGHT_CHANNEL_SKY], LightNode_Make(&mainFlood, x, y, z, FANCY_LIGHTING_MAX_LEVEL));
+			}
+			LightFlood_Spread(&mainFlood, LIGHT_CHANNEL_SKY);
+		}
+	}
 }
+
 static void OnBlockChanged(int x, int y, int z, BlockID oldBlock, BlockID newBlock) {
+	int oldHeight, newHeight;
+	/* Sky light can't depend on a column whose heightmap hasn't been calculated yet */
+	cc_bool skyChanged = skyLight && ClassicLighting_HasLightHeight(x, z);
+
 	/* For some reason this is a possible case */
 	if (oldBlock == newBlock) { return; }
 
+	oldHeight = skyChanged ? ClassicLighting_GetLightHeight(x, z) : 0;
 	ClassicLighting_OnBlockChanged(x, y, z, oldBlock, newBlock);
 
-	CalcBlockChange(x, y, z, oldBlock, newBlock, false);
-	CalcBlockChange(x, y, z, oldBlock, newBlock, true);
+	CalcBlockChange(x, y, z, oldBlock, newBlock, LIGHT_CHANNEL_LAVA);
+	CalcBlockChange(x, y, z, oldBlock, newBlock, LIGHT_CHANNEL_LAMP);
+	if (!skyChanged) return;
+
+	newHeight = ClassicLighting_GetLightHeight(x, z);
+	if (newHeight != oldHeight) CalcSkyHeightChange(x, z, oldHeight, newHeight);
+
+	/* The top light blocking block of a column is still directly lit by the sky, */
+	/*  so the changed block itself may still need to be updated even if the height changed */
+	CalcBlockChange(x, y, z, oldBlock, newBlock, LIGHT_CHANNEL_SKY);
 }
 /* Invalidates/Resets lighting state for all of the blocks in the world */
 /*  (e.g. because a block changed whether it is full bright or not) */
@@ -504,8 +846,11 @@ static PackedCol Color_Core(int x, int y, int z, int paletteFace) {
 		lightData = chunkLightingData[chunkIndex][chunkCoordsIndex];
 	}
 
-	/* This cell is exposed to sunlight */
-	if (y > ClassicLighting_GetLightHeight(x, z)) {
+	if (skyLight) {
+		/* Push the pointer forward into the palette section for this sky light level */
+		paletteFace += GetBrightness(x, y, z, LIGHT_CHANNEL_SKY) * PALETTE_SHADES;
+	} else if (y > ClassicLighting_GetLightHeight(x, z)) {
+		/* This cell is exposed to sunlight */
 		/* Push the pointer forward into the sun lit palette section */
 		paletteFace += PALETTE_SHADES;
 	}
@@ -566,6 +911,8 @@ void FancyLighting_SetActive(void) {
 	Lighting.FreeState  = FreeState;
 	Lighting.AllocState = AllocState;
 	Lighting.LightHint  = LightHint;
+	/* Light spreads through neighbouring blocks, so needs to be updated as each block changes */
+	Lighting.OnBlocksChanged = NULL;
 }
 
 static void OnEnvVariableChanged(void* obj, int envVar) {
@@ -17,11 +17,17 @@
 #include "TexturePack.h"
 #include "Utils.h"
 #include "Audio.h"
+#include "Options.h"
 
 #ifdef CC_BUILD_FILESYSTEM
 static struct LocationUpdate* spawn_point;
 static struct MapImporter* imp_head;
 static struct MapImporter* imp_tail;
+/* Blocks of the map currently being imported */
+static BlockRaw* map_blocks;
+#ifdef EXTENDED_BLOCKS
+static BlockRaw* map_blocks2;
+#endif
 
 
 /*########################################################################################################################*
@@ -29,21 +35,91 @@ static struct MapImporter* imp_tail;
 *#########################################################################################################################*/
 static cc_result Map_ReadBlocks(struct Stream* stream) {
 	World.Volume = World.Width * World.Length * World.Height;
-	World.Blocks = (BlockRaw*)Mem_TryAlloc(World.Volume, 1);
+	map_blocks   = (BlockRaw*)Mem_TryAlloc(World.Volume, 1);
 
-	if (!World.Blocks) return ERR_OUT_OF_MEMORY;
-	return Stream_Read(stream, World.Blocks, World.Volume);
+	if (!map_blocks) return ERR_OUT_OF_MEMORY;
+	return Stream_Read(stream, map_blocks, World.Volume);
 }
 
-static cc_result Map_SkipGZipHeader(struct Stream* stream) {
-	struct GZipHeader gzHeader;
+static void Map_FreeBlocks(void) {
+	Mem_Free(map_blocks);
+	map_blocks  = NULL;
+#ifdef EXTENDED_BLOCKS
+	Mem_Free(map_blocks2);
+	map_blocks2 = NULL;
+#endif
+}
+
+/* Changes the world to use the blocks of the imported map */
+static void Map_SetBlocks(void) {
+#if defined EXTENDED_BLOCKS && defined CC_BUILD_COMPRESSEDWORLD
+	struct WorldSection* upper;
+
+	if (map_blocks && map_blocks2) {
+		upper = WorldSections_Compress(map_blocks2, World.Width * World.Height * World.Length);
+		if (upper) { World_SetMapUpper(upper); } else { World_OutOfMemory(); }
+	}
+	Mem_Free(map_blocks2);
+	map_blocks2 = NULL;
+#elif defined EXTENDED_BLOCKS
+	if (map_blocks && map_blocks2) {
+		World_SetMapUpper(map_blocks2);
+	} else {
+		Mem_Free(map_blocks2);
+	}
+	map_blocks2 = NULL;
+#endif
+
+	World_SetNewMap(map_blocks, World.Width, World.Height, World.Length);
+	map_blocks = NULL;
+}
+
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/* Writes every block in the given blocks array */
+static cc_result Map_WriteBlocks(struct Stream* stream, const struct WorldSection* blocks) {
+	BlockRaw buffer[WORLD_SECTION_SIZE];
+	int i, count;
 	cc_result res;
+
+	for (i = 0; i < World.Volume; i += count) 
+	{
+		count = min(World.Volume - i, WORLD_SECTION_SIZE);
+		WorldSections_Read(blocks, i, buffer, count);
+		if ((res = Stream_Write(stream, buffer, count))) return res;
+	}
+	return 0;
+}
+#else
+#define Map_WriteBlocks(stream, blocks) Stream_Write(stream, blocks, World.Volume)
+#endif
+
+/* Skips the GZIP header, then opens a stream for decompressing the rest of the data */
+/* NOTE: If the map was saved in segments (see GZip_MakeParallelStream), they are decompressed in parallel */
+/* NOTE: compStream must be closed afterwards */
+static cc_result Map_OpenGZip(struct Stream* compStream, struct InflateState* state, struct Stream* stream) {
+	struct GZipHeader gzHeader;
+	struct GZipSegments* index;
+	cc_result res = 0;
+	int numThreads;
 	GZipHeader_Init(&gzHeader);
 
+	/* Segment index is only an optimisation, so fine to ignore it if out of memory */
+	index = (struct GZipSegments*)Mem_TryAlloc(1, sizeof(struct GZipSegments));
+	gzHeader.segments = index;
+
 	while (!gzHeader.done) {
-		if ((res = GZipHeader_Read(stream, &gzHeader))) return res;
+		if ((res = GZipHeader_Read(stream, &gzHeader))) break;
 	}
-	return 0;
+
+	if (!res && index && index->Count) {
+		numThreads = Options_GetInt(OPT_MAP_LOAD_THREADS, 0, GZIP_MAX_THREADS, 4);
+		res = Inflate_MakeSegmentedStream(compStream, state, stream, index, numThreads);
+	} else if (!res) {
+		Inflate_MakeStream2(compStream, state, stream);
+	}
+
+	Mem_Free(index);
+	return res;
 }
 
 void MapImporter_Register(struct MapImporter* imp) {
@@ -82,13 +158,14 @@ cc_result Map_LoadFrom(const cc_string* path) {
 		res = ERR_NOT_SUPPORTED;
 	} else if ((res = imp->import(&stream))) {
 		World_Reset();
+		Map_FreeBlocks();
 	}
 
 	/* No point logging error for closing readonly file */
 	(void)stream.Close(&stream);
 	if (res) Logger_IOWarn2(res, "decoding", &raw_path);
 
-	World_SetNewMap(World.Blocks, World.Width, World.Height, World.Length);
+	Map_SetBlocks();
 	if (!spawn_point) LocalPlayer_CalcDefaultSpawn(Entities.CurPlayer, &update);
 	LocalPlayers_MoveToSpawn(&update);
 
@@ -163,7 +240,7 @@ static cc_result Lvl_ReadCustomBlocks(struct Stream* stream) {
 						xx = i & 0xF; yy = (i >> 8) & 0xF; zz = (i >> 4) & 0xF;
 
 						index = baseIndex + World_Pack(xx, yy, zz);
-						World.Blocks[index] = World.Blocks[index] == LVL_CUSTOMTILE ? chunk[i] : World.Blocks[index];
+						map_blocks[index] = map_blocks[index] == LVL_CUSTOMTILE ? chunk[i] : map_blocks[index];
 					}
 				} else {
 					for (i = 0; i < sizeof(chunk); i++) {
@@ -171,7 +248,7 @@ static cc_result Lvl_ReadCustomBlocks(struct Stream* stream) {
 						if ((x + xx) >= World.Width || (y + yy) >= World.Height || (z + zz) >= World.Length) continue;
 
 						index = baseIndex + World_Pack(xx, yy, zz);
-						World.Blocks[index] = World.Blocks[index] == LVL_CUSTOMTILE ? chunk[i] : World.Blocks[index];
+						map_blocks[index] = map_blocks[index] == LVL_CUSTOMTILE ? chunk[i] : map_blocks[index];
 					}
 				}
 			}
@@ -180,21 +257,14 @@ static cc_result Lvl_ReadCustomBlocks(struct Stream* stream) {
 	return 0;
 }
 
-/* Imports a world from a .lvl MCSharp server map file */
-/* Used by MCSharp/MCLawl/MCForge/MCDzienny/MCGalaxy */
-static cc_result Lvl_Load(struct Stream* stream) {
+static cc_result Lvl_LoadData(struct Stream* compStream) {
 	cc_uint8 header[18];
 	cc_uint8* blocks;
 	cc_uint8 section;
 	cc_result res;
 	int i;
 
-	struct Stream compStream;
-	struct InflateState state;
-	Inflate_MakeStream2(&compStream, &state, stream);
-	
-	if ((res = Map_SkipGZipHeader(stream)))                       return res;
-	if ((res = Stream_Read(&compStream, header, sizeof(header)))) return res;
+	if ((res = Stream_Read(compStream, header, sizeof(header)))) return res;
 	if (Mem_ReadU16_LE(&header[0]) != 1874) return LVL_ERR_VERSION;
 
 	World.Width  = Mem_ReadU16_LE(&header[2]);
@@ -209,8 +279,8 @@ static cc_result Lvl_Load(struct Stream* stream) {
 	spawn_point->pitch = Math_Packed2Deg(header[15]);
 	/* (2) pervisit, perbuild permissions */
 
-	if ((res = Map_ReadBlocks(&compStream))) return res;
-	blocks = World.Blocks;
+	if ((res = Map_ReadBlocks(compStream))) return res;
+	blocks = map_blocks;
 	/* Bulk convert 4 blocks at once */
 	for (i = 0; i < (World.Volume & ~3); i += 4) {
 		*blocks = Lvl_table[*blocks]; blocks++;
@@ -223,14 +293,14 @@ static cc_result Lvl_Load(struct Stream* stream) {
 	}
 
 	/* 0xBD section type is not present in older .lvl files */
-	res = compStream.ReadU8(&compStream, &section);
+	res = compStream->ReadU8(compStream, &section);
 	if (res == ERR_END_OF_STREAM) return 0;
 
 	if (res) return res;
 	/* Unrecognised section type, stop reading */
 	if (section != 0xBD) return 0;
 
-	res = Lvl_ReadCustomBlocks(&compStream);
+	res = Lvl_ReadCustomBlocks(compStream);
 	/* At least one map out there has a corrupted 0xBD section */
 	if (res == ERR_END_OF_STREAM) {
 		Chat_AddRaw("&cEnd of stream reading .lvl custom blocks section");
@@ -240,6 +310,19 @@ static cc_result Lvl_Load(struct Stream* stream) {
 	return res;
 }
 
+/* Imports a world from a .lvl MCSharp server map file */
+/* Used by MCSharp/MCLawl/MCForge/MCDzienny/MCGalaxy */
+static cc_result Lvl_Load(struct Stream* stream) {
+	struct Stream compStream;
+	struct InflateState state;
+	cc_result res;
+
+	if ((res = Map_OpenGZip(&compStream, &state, stream))) return res;
+	res = Lvl_LoadData(&compStream);
+	(void)compStream.Close(&compStream);
+	return res;
+}
+
 
 /*########################################################################################################################*
 *----------------------------------------------------fCraft map format----------------------------------------------------*
@@ -525,12 +608,14 @@ static cc_result Nbt_Read(struct Stream* stream, Nbt_Callback callback) {
 	cc_result res;
 	cc_uint8 tag;
 
-	Inflate_MakeStream2(&compStream, &state, stream);
-	if ((res = Map_SkipGZipHeader(stream))) return res;
-	if ((res = compStream.ReadU8(&compStream, &tag))) return res;
+	if ((res = Map_OpenGZip(&compStream, &state, stream))) return res;
+	res = compStream.ReadU8(&compStream, &tag);
 
-	if (tag != NBT_DICT) return CW_ERR_ROOT_TAG;
-	return Nbt_ReadTag(NBT_DICT, true, &compStream, NULL, callback, 0);
+	if (!res && tag != NBT_DICT) res = CW_ERR_ROOT_TAG;
+	if (!res) res = Nbt_ReadTag(NBT_DICT, true, &compStream, NULL, callback, 0);
+
+	(void)compStream.Close(&compStream);
+	return res;
 }
 
 
@@ -672,11 +757,11 @@ static void Cw_Callback_1(struct NbtTag* tag) {
 
 	if (IsTag(tag, "BlockArray")) {
 		World.Volume = tag->dataSize;
-		World.Blocks = Nbt_TakeArray(tag, ".cw map blocks");
+		map_blocks   = Nbt_TakeArray(tag, ".cw map blocks");
 	}
 #ifdef EXTENDED_BLOCKS
 	if (IsTag(tag, "BlockArray2")) {
-		World_SetMapUpper(Nbt_TakeArray(tag, ".cw map blocks2"));
+		map_blocks2  = Nbt_TakeArray(tag, ".cw map blocks2");
 	}
 #endif
 }
@@ -1263,12 +1348,12 @@ static cc_result Dat_LoadFormat0(struct Stream* stream) {
 
 	#define PC_VOLUME (256 * 64 * 256)
 	World.Volume = PC_VOLUME;
-	World.Blocks = (BlockRaw*)Mem_TryAlloc(PC_VOLUME, 1);
-	if (!World.Blocks) return ERR_OUT_OF_MEMORY;
+	map_blocks   = (BlockRaw*)Mem_TryAlloc(PC_VOLUME, 1);
+	if (!map_blocks) return ERR_OUT_OF_MEMORY;
 
 	/* First 5 bytes already read earlier as .dat header */
-	Mem_Set(World.Blocks, BLOCK_STONE, 5);
-	return Stream_Read(stream, World.Blocks + 5, PC_VOLUME - 5);
+	Mem_Set(map_blocks, BLOCK_STONE, 5);
+	return Stream_Read(stream, map_blocks + 5, PC_VOLUME - 5);
 }
 
 static cc_result Dat_LoadFormat1(struct Stream* stream) {
@@ -1326,7 +1411,7 @@ static cc_result Dat_LoadFormat2(struct Stream* stream) {
 			World.Height = Java_I32(field);
 		} else if (String_CaselessEqualsConst(&fieldName, "blocks")) {
 			if (field->Type != JFIELD_ARRAY) Process_Abort("Blocks field must be Array");
-			World.Blocks = field->Value.Array.Ptr;
+			map_blocks   = field->Value.Array.Ptr;
 			World.Volume = field->Value.Array.Size;
 		} else if (String_CaselessEqualsConst(&fieldName, "xSpawn")) {
 			spawn_point->pos.x = (float)Java_I32(field);
@@ -1342,18 +1427,12 @@ static cc_result Dat_LoadFormat2(struct Stream* stream) {
 	return 0;
 }
 
-/* Imports a world from a .dat classic map file */
-/* Used by Minecraft Classic/WoM client */
-static cc_result Dat_Load(struct Stream* stream) {
+static cc_result Dat_LoadData(struct Stream* compStream) {
 	cc_uint8 header[4 + 1];
 	cc_uint32 signature;
 	cc_result res;
 
-	struct Stream compStream;
-	struct InflateState state;
-	Inflate_MakeStream2(&compStream, &state, stream);
-	if ((res = Map_SkipGZipHeader(stream)))                       return res;
-	if ((res = Stream_Read(&compStream, header, sizeof(header)))) return res;
+	if ((res = Stream_Read(compStream, header, sizeof(header)))) return res;
 
 	signature = Mem_ReadU32_BE(header + 0);
 	switch (signature)
@@ -1362,7 +1441,7 @@ static cc_result Dat_Load(struct Stream* stream) {
 	case 0x271BB788: break;
 		/* Not an actual signature, but 99% of preclassic */
 		/*  to classic 0.12 maps start with these 4 bytes */
-	case 0x01010101: return Dat_LoadFormat0(&compStream);
+	case 0x01010101: return Dat_LoadFormat0(compStream);
 		/* Bogus .dat file */
 	default:         return DAT_ERR_IDENTIFIER;
 	}
@@ -1371,14 +1450,27 @@ static cc_result Dat_Load(struct Stream* stream) {
 	switch (header[4])
 	{
 		/* Format version 1 = classic 0.13 */
-	case 0x01: return Dat_LoadFormat1(&compStream);
+	case 0x01: return Dat_LoadFormat1(compStream);
 		/* Format version 2 = classic 0.15 to 0.30 */
-	case 0x02: return Dat_LoadFormat2(&compStream);
+	case 0x02: return Dat_LoadFormat2(compStream);
 		/* Bogus .dat file */
 	default:   return DAT_ERR_VERSION;
 	}
 }
 
+/* Imports a world from a .dat classic map file */
+/* Used by Minecraft Classic/WoM client */
+static cc_result Dat_Load(struct Stream* stream) {
+	struct Stream compStream;
+	struct InflateState state;
+	cc_result res;
+
+	if ((res = Map_OpenGZip(&compStream, &state, stream))) return res;
+	res = Dat_LoadData(&compStream);
+	(void)compStream.Close(&compStream);
+	return res;
+}
+
 
 /*########################################################################################################################*
 *-----------------------------------------------------MCLevel format------------------------------------------------------*
@@ -1406,7 +1498,7 @@ static void MCLevel_ParseMap(struct NbtTag* tag) {
 
 	if (IsTag(tag, "blocks")) {
 		World.Volume = tag->dataSize;
-		World.Blocks = Nbt_TakeArray(tag, ".mclevel map blocks");
+		map_blocks   = Nbt_TakeArray(tag, ".mclevel map blocks");
 	}
 }
 
@@ -1607,7 +1699,7 @@ cc_result Cw_Save(struct Stream* stream) {
 	cur = Nbt_WriteArray(cur, "BlockArray", World.Volume);
 
 	if ((res = Stream_Write(stream, buffer, (int)(cur - buffer)))) return res;
-	if ((res = Stream_Write(stream, World.Blocks, World.Volume)))  return res;
+	if ((res = Map_WriteBlocks(stream, World.Blocks)))             return res;
 
 #ifdef EXTENDED_BLOCKS
 	if (World.Blocks != World.Blocks2) {
@@ -1615,7 +1707,7 @@ cc_result Cw_Save(struct Stream* stream) {
 		cur = Nbt_WriteArray(cur, "BlockArray2", World.Volume);
 
 		if ((res = Stream_Write(stream, buffer, (int)(cur - buffer)))) return res;
-		if ((res = Stream_Write(stream, World.Blocks2, World.Volume))) return res;
+		if ((res = Map_WriteBlocks(stream, World.Blocks2)))            return res;
 	}
 #endif
 
@@ -1715,7 +1807,7 @@ cc_result Schematic_Save(struct Stream* stream) {
 		Mem_WriteU32_BE(&tmp[74], World.Volume);
 	}
 	if ((res = Stream_Write(stream, tmp, sizeof(sc_begin)))) return res;
-	if ((res = Stream_Write(stream, World.Blocks, World.Volume))) return res;
+	if ((res = Map_WriteBlocks(stream, World.Blocks))) return res;
 
 	Mem_Copy(tmp, sc_data, sizeof(sc_data));
 	{
@@ -209,8 +209,14 @@ void Game_Disconnect(const cc_string* title, const cc_string* reason) {
 	DisconnectScreen_Show(title, reason);
 }
 
+static int blockBatchDepth;
+static struct BlockChange* blockBatch;
+static int blockBatchCount, blockBatchCapacity;
+
 void Game_Reset(void) {
 	struct IGameComponent* comp;
+	/* Changes from a batch that was never ended refer to the old map */
+	blockBatchCount = 0;
 	World_NewMap();
 
 	for (comp = comps_head; comp; comp = comp->next) {
@@ -218,6 +224,19 @@ void Game_Reset(void) {
 	}
 }
 
+static void Game_AddBatchedBlock(int x, int y, int z, BlockID old, BlockID block) {
+	struct BlockChange* change;
+	if (blockBatchCount == blockBatchCapacity) {
+		Utils_Resize((void**)&blockBatch, &blockBatchCapacity,
+					sizeof(struct BlockChange), 0, 512);
+	}
+
+	change = &blockBatch[blockBatchCount++];
+	change->x = x; change->y = y; change->z = z;
+	change->oldBlock = old;
+	change->newBlock = block;
+}
+
 void Game_UpdateBlock(int x, int y, int z, BlockID block) {
 	BlockID old = World_GetBlock(x, y, z);
 	World_SetBlock(x, y, z, block);
@@ -225,10 +244,38 @@ void Game_UpdateBlock(int x, int y, int z, BlockID block) {
 	if (Weather_Heightmap) {
 		EnvRenderer_OnBlockChanged(x, y, z, old, block);
 	}
+
+	if (blockBatchDepth) {
+		Game_AddBatchedBlock(x, y, z, old, block);
+		/* Lighting engines that can't update in batches still need to see each change as it happens */
+		if (!Lighting.OnBlocksChanged) Lighting.OnBlockChanged(x, y, z, old, block);
+		return;
+	}
 	Lighting.OnBlockChanged(x, y, z, old, block);
 	MapRenderer_OnBlockChanged(x, y, z, block);
 }
 
+void Game_BeginBlockBatch(void) { blockBatchDepth++; }
+
+void Game_EndBlockBatch(void) {
+	if (blockBatchDepth <= 0 || --blockBatchDepth) return;
+	if (!blockBatchCount) return;
+
+	/* Mark changed chunks first, so lighting can skip checking whether they need refreshing */
+	MapRenderer_OnBlocksChanged(blockBatch, blockBatchCount);
+	if (Lighting.OnBlocksChanged) {
+		Lighting.OnBlocksChanged(blockBatch, blockBatchCount);
+	}
+
+	Event_RaiseInt(&WorldEvents.BlocksChanged, blockBatchCount);
+	blockBatchCount = 0;
+}
+
+const struct BlockChange* Game_GetBlockBatch(int* count) {
+	*count = blockBatchCount;
+	return blockBatch;
+}
+
 void Game_ChangeBlock(int x, int y, int z, BlockID block) {
 	BlockID old = World_GetBlock(x, y, z);
 	Game_UpdateBlock(x, y, z, block);
@@ -110,6 +110,20 @@ CC_API void Game_UpdateBlock(int x, int y, int z, BlockID block);
 /* In multiplayer this is sent to the server, in singleplayer just activates physics. */
 CC_API void Game_ChangeBlock(int x, int y, int z, BlockID block);
 
+/* Describes a block that was changed while a block batch was active. */
+struct BlockChange { int x, y, z; BlockID oldBlock, newBlock; };
+/* Starts a batch of block changes. Until the batch is ended, Game_UpdateBlock only sets the block */
+/*  and records the change, and then lighting and chunk redrawing for all the changes is done at once. */
+/* NOTE: Batches can be nested, in which case changes are only applied when the outermost batch ends. */
+/* NOTE: Lighting may not reflect changes made in a batch until the batch is ended. */
+CC_API void Game_BeginBlockBatch(void);
+/* Ends a batch of block changes, updates state for all the blocks changed during it, */
+/*  and then raises WorldEvents.BlocksChanged if any blocks were changed. */
+CC_API void Game_EndBlockBatch(void);
+/* Returns the blocks changed in the batch that is currently being ended. */
+/* NOTE: Only valid while WorldEvents.BlocksChanged is being raised. */
+CC_API const struct BlockChange* Game_GetBlockBatch(int* count);
+
 cc_bool Game_CanPick(BlockID block);
 /* Updates Game_Width and Game_Height. */
 void Game_UpdateDimensions(void);
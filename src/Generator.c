@@ -1,4 +1,7 @@
 #include "Generator.h"
+#if defined CC_BUILD_SSE2
+#include <emmintrin.h>
+#endif
 #include "BlockID.h"
 #include "ExtMath.h"
 #include "Funcs.h"
@@ -8,6 +11,7 @@
 #include "Game.h"
 #include "Screens.h"
 #include "Window.h"
+#include "Options.h"
 
 static const struct MapGenerator* gen_active;
 BlockRaw* Gen_Blocks;
@@ -104,6 +108,60 @@ void Gen_Start(const struct MapGenerator* gen, int seed,
 }
 
 
+/*########################################################################################################################*
+*-------------------------------------------------------Row bands---------------------------------------------------------*
+*#########################################################################################################################*/
+/* Stages that only depend on the (x, z) of each column are split into bands of Z rows, */
+/*  which are then processed in parallel by multiple threads */
+#define GEN_BAND_ROWS 16
+#define GEN_MAX_THREADS 64
+typedef void (*Gen_BandFunc)(int zBeg, int zEnd);
+
+static int gen_numThreads;
+static Gen_BandFunc gen_bandFunc;
+static int gen_nextRow;
+
+static struct WorkerPool gen_bandPool;
+static cc_bool gen_bandWorkersStarted;
+
+static void Gen_BandWorker(int workerID) {
+	int z;
+	for (;;)
+	{
+		Mutex_Lock(gen_bandPool.mutex);
+		{
+			z = gen_nextRow;
+			gen_nextRow += GEN_BAND_ROWS;
+		}
+		Mutex_Unlock(gen_bandPool.mutex);
+
+		if (z >= World.Length) return;
+		Gen_CurrentProgress = (float)z / World.Length;
+		gen_bandFunc(z, min(z + GEN_BAND_ROWS, World.Length));
+	}
+}
+
+/* Starts the band worker threads if not already */
+/* NOTE: Must be called from the main thread (i.e. not from the map gen thread) */
+/* NOTE: The number of threads is only read from options the first time a map is generated */
+static void Gen_StartBandWorkers(void) {
+	if (gen_bandWorkersStarted) return;
+	gen_bandWorkersStarted = true;
+
+	/* The map gen thread processes bands too */
+	WorkerPool_Start(&gen_bandPool, gen_numThreads - 1, Gen_BandWorker, 128 * 1024, "Map gen worker");
+}
+
+/* Calls func for every band of Z rows in the map, returning once all bands have been processed */
+/* NOTE: func must only write to data belonging to the columns in the band, */
+/*  so that the output is identical regardless of how many threads are used */
+static void Gen_RunBands(Gen_BandFunc func) {
+	gen_bandFunc = func;
+	gen_nextRow  = 0;
+	WorkerPool_Run(&gen_bandPool);
+}
+
+
 /*########################################################################################################################*
 *-----------------------------------------------------Flatgrass gen-------------------------------------------------------*
 *#########################################################################################################################*/
@@ -234,9 +292,115 @@ static void CombinedNoise_Init(struct CombinedNoise* n, RNGState* rnd, int octav
 	OctaveNoise_Init(&n->noise2, rnd, octaves2);
 }
 
-static float CombinedNoise_Calc(const struct CombinedNoise* n, float x, float y) {
-	float offset = OctaveNoise_Calc(&n->noise2, x, y);
-	return OctaveNoise_Calc(&n->noise1, x + offset, y);
+
+/*########################################################################################################################*
+*-------------------------------------------------Batch noise generation--------------------------------------------------*
+*#########################################################################################################################*/
+/* Max number of samples that can be calculated in one batch */
+#define NOISE_BATCH_SIZE 64
+
+/* Adds ImprovedNoise_Calc(p, xs[i] * freq, ys[i] * freq) * amplitude to sums[i] for each sample */
+/* NOTE: Results are identical to calling ImprovedNoise_Calc for each sample */
+#if defined CC_BUILD_SSE2
+static void ImprovedNoise_CalcBatch(const cc_uint8* p, const float* xs, const float* ys, 
+									float freq, float amplitude, float* sums, int count) {
+	CC_ALIGNED(16) int Xs[4], Ys[4];
+	CC_ALIGNED(16) int gx[4][4], gy[4][4];
+	__m128 x, y, u, v, c1, c2, g11, g12, g21, g22;
+	__m128i xFloor, yFloor;
+	int i, j, A, B, hash;
+
+	__m128  vFreq = _mm_set1_ps(freq), vAmp = _mm_set1_ps(amplitude);
+	__m128  zero  = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+	__m128  six   = _mm_set1_ps(6.0f), fifteen = _mm_set1_ps(15.0f), ten = _mm_set1_ps(10.0f);
+	__m128i mask  = _mm_set1_epi32(0xFF);
+
+	for (i = 0; i + 4 <= count; i += 4)
+	{
+		x = _mm_mul_ps(_mm_loadu_ps(xs + i), vFreq);
+		y = _mm_mul_ps(_mm_loadu_ps(ys + i), vFreq);
+
+		/* (int)x, minus 1 in lanes where x is not >= 0 */
+		xFloor = _mm_add_epi32(_mm_cvttps_epi32(x), _mm_castps_si128(_mm_cmpnge_ps(x, zero)));
+		yFloor = _mm_add_epi32(_mm_cvttps_epi32(y), _mm_castps_si128(_mm_cmpnge_ps(y, zero)));
+		_mm_store_si128((__m128i*)Xs, _mm_and_si128(xFloor, mask));
+		_mm_store_si128((__m128i*)Ys, _mm_and_si128(yFloor, mask));
+		x = _mm_sub_ps(x, _mm_cvtepi32_ps(xFloor));
+		y = _mm_sub_ps(y, _mm_cvtepi32_ps(yFloor));
+
+		/* Fade(x) and Fade(y) */
+		u = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(x, x), x),
+			_mm_add_ps(_mm_mul_ps(x, _mm_sub_ps(_mm_mul_ps(x, six), fifteen)), ten));
+		v = _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(y, y), y),
+			_mm_add_ps(_mm_mul_ps(y, _mm_sub_ps(_mm_mul_ps(y, six), fifteen)), ten));
+
+		/* Permutation table lookups can't be vectorised with SSE2, so gather them per lane */
+		for (j = 0; j < 4; j++)
+		{
+			A = p[Xs[j]] + Ys[j]; B = p[Xs[j] + 1] + Ys[j];
+
+			hash = (p[p[A]]     & 0xF) << 1; gx[0][j] = ((X_FLAGS >> hash) & 3) - 1; gy[0][j] = ((Y_FLAGS >> hash) & 3) - 1;
+			hash = (p[p[B]]     & 0xF) << 1; gx[1][j] = ((X_FLAGS >> hash) & 3) - 1; gy[1][j] = ((Y_FLAGS >> hash) & 3) - 1;
+			hash = (p[p[A + 1]] & 0xF) << 1; gx[2][j] = ((X_FLAGS >> hash) & 3) - 1; gy[2][j] = ((Y_FLAGS >> hash) & 3) - 1;
+			hash = (p[p[B + 1]] & 0xF) << 1; gx[3][j] = ((X_FLAGS >> hash) & 3) - 1; gy[3][j] = ((Y_FLAGS >> hash) & 3) - 1;
+		}
+
+		#define Grad4(i, x, y) _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((__m128i*)gx[i])), x), \
+										  _mm_mul_ps(_mm_cvtepi32_ps(_mm_load_si128((__m128i*)gy[i])), y))
+		g22 = Grad4(0, x,                   y);
+		g12 = Grad4(1, _mm_sub_ps(x, one), y);
+		c1  = _mm_add_ps(g22, _mm_mul_ps(u, _mm_sub_ps(g12, g22)));
+
+		g21 = Grad4(2, x,                   _mm_sub_ps(y, one));
+		g11 = Grad4(3, _mm_sub_ps(x, one), _mm_sub_ps(y, one));
+		c2  = _mm_add_ps(g21, _mm_mul_ps(u, _mm_sub_ps(g11, g21)));
+
+		c1  = _mm_add_ps(c1, _mm_mul_ps(v, _mm_sub_ps(c2, c1)));
+		_mm_storeu_ps(sums + i, _mm_add_ps(_mm_loadu_ps(sums + i), _mm_mul_ps(c1, vAmp)));
+	}
+
+	for (; i < count; i++)
+	{
+		sums[i] += ImprovedNoise_Calc(p, xs[i] * freq, ys[i] * freq) * amplitude;
+	}
+}
+#else
+static void ImprovedNoise_CalcBatch(const cc_uint8* p, const float* xs, const float* ys, 
+									float freq, float amplitude, float* sums, int count) {
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		sums[i] += ImprovedNoise_Calc(p, xs[i] * freq, ys[i] * freq) * amplitude;
+	}
+}
+#endif
+
+/* Calculates OctaveNoise_Calc(n, xs[i], ys[i]) for each sample */
+/* NOTE: count must be <= NOISE_BATCH_SIZE */
+static void OctaveNoise_CalcBatch(const struct OctaveNoise* n, const float* xs, const float* ys, 
+								  float* results, int count) {
+	float amplitude = 1, freq = 1;
+	int i;
+
+	for (i = 0; i < count; i++) results[i] = 0;
+
+	for (i = 0; i < n->octaves; i++) {
+		ImprovedNoise_CalcBatch(n->p[i], xs, ys, freq, amplitude, results, count);
+		amplitude *= 2.0f;
+		freq *= 0.5f;
+	}
+}
+
+/* Calculates noise1 at (xs[i] + noise2 at (xs[i], ys[i]), ys[i]) for each sample */
+/* NOTE: count must be <= NOISE_BATCH_SIZE */
+static void CombinedNoise_CalcBatch(const struct CombinedNoise* n, const float* xs, const float* ys, 
+									float* results, int count) {
+	float offsets[NOISE_BATCH_SIZE];
+	int i;
+	OctaveNoise_CalcBatch(&n->noise2, xs, ys, offsets, count);
+
+	for (i = 0; i < count; i++) offsets[i] += xs[i];
+	OctaveNoise_CalcBatch(&n->noise1, offsets, ys, results, count);
 }
 
 
@@ -246,6 +410,12 @@ static float CombinedNoise_Calc(const struct CombinedNoise* n, float x, float y)
 static int waterLevel, minHeight;
 static cc_int16* heightmap;
 static RNGState rnd;
+/* Noise used by the stage currently being processed in bands */
+static const struct CombinedNoise* gen_cNoise1;
+static const struct CombinedNoise* gen_cNoise2;
+static const struct OctaveNoise*   gen_oNoise1;
+static const struct OctaveNoise*   gen_oNoise2;
+static int gen_minStoneY;
 
 static void NotchyGen_FillOblateSpheroid(int x, int y, int z, float radius, BlockRaw block) {
 	int xBeg = Math_Floor(max(x - radius, 0));
@@ -314,10 +484,60 @@ static void NotchyGen_FloodFill(int index, BlockRaw block) {
 }
 
 
+static void NotchyGen_HeightmapBand(int zBeg, int zEnd) {
+	const struct CombinedNoise* n1 = gen_cNoise1;
+	const struct CombinedNoise* n2 = gen_cNoise2;
+	const struct OctaveNoise*   n3 = gen_oNoise1;
+	float xs[NOISE_BATCH_SIZE], ys[NOISE_BATCH_SIZE];
+	float hXs[NOISE_BATCH_SIZE], hYs[NOISE_BATCH_SIZE];
+	float lows[NOISE_BATCH_SIZE], highs[NOISE_BATCH_SIZE];
+	float choose[NOISE_BATCH_SIZE];
+	int highIdx[NOISE_BATCH_SIZE];
+	float hHigh, height;
+	int hIndex, count, numHigh;
+	int i, x, z;
+
+	for (z = zBeg; z < zEnd; z++) {
+		for (x = 0; x < World.Width; x += count) {
+			count = min(World.Width - x, NOISE_BATCH_SIZE);
+
+			for (i = 0; i < count; i++) {
+				xs[i] = (float)(x + i); ys[i] = (float)z;
+				hXs[i] = (x + i) * 1.3f; hYs[i] = z * 1.3f;
+			}
+			CombinedNoise_CalcBatch(n1, hXs, hYs, lows,   count);
+			OctaveNoise_CalcBatch(n3,   xs,  ys,  choose, count);
+
+			/* Only calculate the high noise for columns that actually use it */
+			for (i = 0, numHigh = 0; i < count; i++) {
+				if (choose[i] > 0) continue;
+				highIdx[numHigh] = i;
+				xs[numHigh] = hXs[i]; ys[numHigh] = hYs[i];
+				numHigh++;
+			}
+			CombinedNoise_CalcBatch(n2, xs, ys, highs, numHigh);
+
+			for (i = 0; i < count; i++) {
+				lows[i] = lows[i] / 6 - 4;
+			}
+			for (i = 0; i < numHigh; i++) {
+				hHigh = highs[i] / 5 + 6;
+				lows[highIdx[i]] = max(lows[highIdx[i]], hHigh);
+			}
+
+			hIndex = z * World.Width + x;
+			for (i = 0; i < count; i++) {
+				height = lows[i];
+				height *= 0.5f;
+				if (height < 0) height *= 0.8f;
+				heightmap[hIndex++] = (int)(height + waterLevel);
+			}
+		}
+	}
+}
+
 static void NotchyGen_CreateHeightmap(void) {
-	float hLow, hHigh, height;
-	int hIndex = 0, adjHeight;
-	int x, z;
+	int i, count = World.Width * World.Length;
 
 #if CC_BUILD_MAXSTACK <= (16 * 1024)
 	struct NoiseBuffer { 
@@ -341,25 +561,11 @@ static void NotchyGen_CreateHeightmap(void) {
 	OctaveNoise_Init(n3,   &rnd, 6);
 
 	Gen_CurrentState = "Building heightmap";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
-
-		for (x = 0; x < World.Width; x++) {
-			hLow   = CombinedNoise_Calc(n1, x * 1.3f, z * 1.3f) / 6 - 4;
-			height = hLow;
-
-			if (OctaveNoise_Calc(n3, (float)x, (float)z) <= 0) {
-				hHigh = CombinedNoise_Calc(n2, x * 1.3f, z * 1.3f) / 5 + 6;
-				height = max(hLow, hHigh);
-			}
-
-			height *= 0.5f;
-			if (height < 0) height *= 0.8f;
+	gen_cNoise1 = n1; gen_cNoise2 = n2; gen_oNoise1 = n3;
+	Gen_RunBands(NotchyGen_HeightmapBand);
 
-			adjHeight = (int)(height + waterLevel);
-			minHeight = min(adjHeight, minHeight);
-			heightmap[hIndex++] = adjHeight;
-		}
+	for (i = 0; i < count; i++) {
+		minHeight = min(heightmap[i], minHeight);
 	}
 }
 
@@ -392,23 +598,29 @@ static int NotchyGen_CreateStrataFast(void) {
 	return max(stoneHeight, 1);
 }
 
-static void NotchyGen_CreateStrata(void) {
+static void NotchyGen_StrataBand(int zBeg, int zEnd) {
+	const struct OctaveNoise* n = gen_oNoise1;
 	int dirtThickness, dirtHeight;
-	int minStoneY, stoneHeight;
-	int hIndex = 0, maxY = World.MaxY, index = 0;
+	int minStoneY = gen_minStoneY, stoneHeight;
+	int hIndex = zBeg * World.Width, maxY = World.MaxY, index = 0;
+	float xs[NOISE_BATCH_SIZE], ys[NOISE_BATCH_SIZE];
+	float noise[NOISE_BATCH_SIZE];
+	int i, count = 0;
 	int x, y, z;
-	struct OctaveNoise n;
-
-	/* Try to bulk fill bottom of the map if possible */
-	minStoneY = NotchyGen_CreateStrataFast();
-	OctaveNoise_Init(&n, &rnd, 8);
-
-	Gen_CurrentState = "Creating strata";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
 
+	for (z = zBeg; z < zEnd; z++) {
 		for (x = 0; x < World.Width; x++) {
-			dirtThickness = (int)(OctaveNoise_Calc(&n, (float)x, (float)z) / 24 - 4);
+			/* Calculate noise for the next batch of columns at once */
+			i = x % NOISE_BATCH_SIZE;
+			if (i == 0) {
+				count = min(World.Width - x, NOISE_BATCH_SIZE);
+				for (i = 0; i < count; i++) { xs[i] = (float)(x + i); ys[i] = (float)z; }
+
+				OctaveNoise_CalcBatch(n, xs, ys, noise, count);
+				i = 0;
+			}
+
+			dirtThickness = (int)(noise[i] / 24 - 4);
 			dirtHeight    = heightmap[hIndex++];
 			stoneHeight   = dirtHeight + dirtThickness;
 
@@ -429,6 +641,18 @@ static void NotchyGen_CreateStrata(void) {
 	}
 }
 
+static void NotchyGen_CreateStrata(void) {
+	struct OctaveNoise n;
+
+	/* Try to bulk fill bottom of the map if possible */
+	gen_minStoneY = NotchyGen_CreateStrataFast();
+	OctaveNoise_Init(&n, &rnd, 8);
+
+	Gen_CurrentState = "Creating strata";
+	gen_oNoise1 = &n;
+	Gen_RunBands(NotchyGen_StrataBand);
+}
+
 static void NotchyGen_CarveCaves(void) {
 	int cavesCount, caveLen;
 	float caveX, caveY, caveZ;
@@ -569,10 +793,32 @@ static void NotchyGen_FloodFillLava(void) {
 	}
 }
 
-static void NotchyGen_CreateSurfaceLayer(void) {	
-	int hIndex = 0, index;
+static void NotchyGen_SurfaceBand(int zBeg, int zEnd) {
+	const struct OctaveNoise* n1 = gen_oNoise1;
+	const struct OctaveNoise* n2 = gen_oNoise2;
+	int hIndex = zBeg * World.Width, index;
 	BlockRaw above;
 	int x, y, z;
+
+	for (z = zBeg; z < zEnd; z++) {
+		for (x = 0; x < World.Width; x++) {
+			y = heightmap[hIndex++];
+			if (y < 0 || y >= World.Height) continue;
+
+			index = World_Pack(x, y, z);
+			above = y >= World.MaxY ? BLOCK_AIR : Gen_Blocks[index + World.OneY];
+
+			/* TODO: update heightmap */
+			if (above == BLOCK_STILL_WATER && (OctaveNoise_Calc(n2, (float)x, (float)z) > 12)) {
+				Gen_Blocks[index] = BLOCK_GRAVEL;
+			} else if (above == BLOCK_AIR) {
+				Gen_Blocks[index] = (y <= waterLevel && (OctaveNoise_Calc(n1, (float)x, (float)z) > 8)) ? BLOCK_SAND : BLOCK_GRASS;
+			}
+		}
+	}
+}
+
+static void NotchyGen_CreateSurfaceLayer(void) {	
 #if CC_BUILD_MAXSTACK <= (16 * 1024)
 	struct NoiseBuffer { 
 		struct OctaveNoise n1, n2;
@@ -590,24 +836,8 @@ static void NotchyGen_CreateSurfaceLayer(void) {
 	OctaveNoise_Init(n2, &rnd, 8);
 
 	Gen_CurrentState = "Creating surface";
-	for (z = 0; z < World.Length; z++) {
-		Gen_CurrentProgress = (float)z / World.Length;
-
-		for (x = 0; x < World.Width; x++) {
-			y = heightmap[hIndex++];
-			if (y < 0 || y >= World.Height) continue;
-
-			index = World_Pack(x, y, z);
-			above = y >= World.MaxY ? BLOCK_AIR : Gen_Blocks[index + World.OneY];
-
-			/* TODO: update heightmap */
-			if (above == BLOCK_STILL_WATER && (OctaveNoise_Calc(n2, (float)x, (float)z) > 12)) {
-				Gen_Blocks[index] = BLOCK_GRAVEL;
-			} else if (above == BLOCK_AIR) {
-				Gen_Blocks[index] = (y <= waterLevel && (OctaveNoise_Calc(n1, (float)x, (float)z) > 8)) ? BLOCK_SAND : BLOCK_GRASS;
-			}
-		}
-	}
+	gen_oNoise1 = n1; gen_oNoise2 = n2;
+	Gen_RunBands(NotchyGen_SurfaceBand);
 }
 
 static void NotchyGen_PlantFlowers(void) {
@@ -739,6 +969,12 @@ static cc_bool NotchyGen_Prepare(int seed) {
 	minHeight  = World.Height;
 
 	heightmap  = (cc_int16*)Mem_TryAlloc(World.Width * World.Length, 2);
+#ifdef CC_BUILD_COOPTHREADED
+	gen_numThreads = 1;
+#else
+	gen_numThreads = Options_GetInt(OPT_MAP_GEN_THREADS, 1, GEN_MAX_THREADS, 4);
+#endif
+	Gen_StartBandWorkers();
 	return heightmap != NULL;
 }
 
@@ -777,6 +1013,7 @@ const struct MapGenerator NotchyGen = {
 *#########################################################################################################################*/
 BlockRaw* Tree_Blocks;
 RNGState* Tree_Rnd;
+#define Tree_GetBlock(index) (Tree_Blocks ? Tree_Blocks[index] : World_GetLowerBlock(index))
 
 cc_bool TreeGen_CanGrow(int treeX, int treeY, int treeZ, int treeHeight) {
 	int baseHeight = treeHeight - 4;
@@ -790,7 +1027,7 @@ cc_bool TreeGen_CanGrow(int treeX, int treeY, int treeZ, int treeHeight) {
 
 				if (!World_Contains(x, y, z)) return false;
 				index = World_Pack(x, y, z);
-				if (Tree_Blocks[index] != BLOCK_AIR) return false;
+				if (Tree_GetBlock(index) != BLOCK_AIR) return false;
 			}
 		}
 	}
@@ -802,7 +1039,7 @@ cc_bool TreeGen_CanGrow(int treeX, int treeY, int treeZ, int treeHeight) {
 
 				if (!World_Contains(x, y, z)) return false;
 				index = World_Pack(x, y, z);
-				if (Tree_Blocks[index] != BLOCK_AIR) return false;
+				if (Tree_GetBlock(index) != BLOCK_AIR) return false;
 			}
 		}
 	}
@@ -31,6 +31,8 @@ void Gen_Start(STRING_REF const struct MapGenerator* gen, int seed,
 cc_bool Gen_IsDone(void);
 
 
+/* Blocks trees are grown in */
+/* NOTE: When NULL, trees are grown in the world blocks instead */
 extern BlockRaw* Tree_Blocks;
 extern RNGState* Tree_Rnd;
 /* Appropriate buffer size to hold positions and blocks generated by the tree generator. */
@@ -24,6 +24,17 @@ static int db_stride;
 static void* gfx_vertices;
 static GfxResourceID white_square;
 
+#if !defined CC_BUILD_COOPTHREADED && !defined CC_BUILD_LOWMEM
+/* Triangles are binned into screen tiles, which are then rasterised by multiple threads */
+#define SOFTGPU_BINNING
+#endif
+/* Whether state used for rasterising triangles has changed since last triangle */
+static cc_bool rasterStateDirty = true;
+static void FlushTriangles(void);
+static void StartRasterWorkers(void);
+static void AllocTileBins(void);
+static void FreeTileBins(void);
+
 static void Gfx_RestoreState(void) {
 	InitDefaultResources();
 
@@ -45,9 +56,14 @@ void Gfx_Create(void) {
 	Gfx.Created      = true;
 	Gfx.BackendType  = CC_GFX_BACKEND_SOFTGPU;
 	Gfx.Limitations  = GFX_LIMIT_MINIMAL;
+	customMipmapsLevels = true;
+	StartRasterWorkers();
 }
 
 static void DestroyBuffers(void) {
+	FlushTriangles();
+	FreeTileBins();
+
 	Window_FreeFramebuffer(&fb_bmp);
 	Mem_Free(depthBuffer);
 	depthBuffer = NULL;
@@ -61,10 +77,12 @@ void Gfx_Free(void) {
 
 typedef struct CCTexture {
 	unsigned short width, height;
+	cc_uint8 mipmapLevels; /* Number of mipmap levels stored after the base level pixels */
 	BitmapCol pixels[];
 } CCTexture;
 
 static CCTexture* curTexture;
+static cc_bool mipmapsEnabled;
 static BitmapCol* curTexPixels;
 static int curTexWidth, curTexHeight;
 static int texWidthMask, texHeightMask;
@@ -85,25 +103,85 @@ void Gfx_BindTexture(GfxResourceID texId) {
 	/* Technically the optimisation should only apply if width and height is 1 */
 	/* But it's worth sacrificing this, so that rendering the world when */
 	/*   no texture pack can use the more optimised rendering path */
-	texSinglePixel = curTexWidth == 1;
+	texSinglePixel   = curTexWidth == 1;
+	rasterStateDirty = true;
 }
 		
 void Gfx_DeleteTexture(GfxResourceID* texId) {
 	GfxResourceID data = *texId;
+	/* Queued triangles might still be using the texture */
+	FlushTriangles();
 	if (data) Mem_Free(data);
 	*texId = NULL;
 }
 		
+/* Returns the pixels of the given mipmap level, and updates width/height to the dimensions of that level */
+/* NOTE: Mipmap levels are stored one after another, immediately after the base level pixels */
+static BitmapCol* GetMipmapLevel(BitmapCol* pixels, int* width, int* height, int level) {
+	for (; level > 0; level--)
+	{
+		pixels += *width * *height;
+		if (*width  > 1) *width  /= 2;
+		if (*height > 1) *height /= 2;
+	}
+	return pixels;
+}
+
+static void GenerateMipmaps(CCTexture* tex, int x, int y, struct Bitmap* bmp, int rowWidth) {
+	BitmapCol* prev = bmp->scan0;
+	BitmapCol* cur;
+	BitmapCol* dst;
+
+	int lvl, width = bmp->width, height = bmp->height;
+	int lvlWidth, lvlHeight;
+
+	for (lvl = 1; lvl <= tex->mipmapLevels; lvl++) {
+		x /= 2; y /= 2;
+		if (width > 1)  width /= 2;
+		if (height > 1) height /= 2;
+
+		cur = (BitmapCol*)Mem_Alloc(width * height, BITMAPCOLOR_SIZE, "mipmaps");
+		GenMipmaps(width, height, cur, prev, rowWidth);
+
+		lvlWidth  = tex->width;
+		lvlHeight = tex->height;
+		dst = GetMipmapLevel(tex->pixels, &lvlWidth, &lvlHeight, lvl);
+
+		CopyPixels(dst + y * lvlWidth + x, lvlWidth * BITMAPCOLOR_SIZE,
+				   cur,                    width    * BITMAPCOLOR_SIZE,
+				   width, height);
+
+		if (prev != bmp->scan0) Mem_Free(prev);
+		prev     = cur;
+		rowWidth = width;
+	}
+	if (prev != bmp->scan0) Mem_Free(prev);
+}
+
 GfxResourceID Gfx_AllocTexture(struct Bitmap* bmp, int rowWidth, cc_uint8 flags, cc_bool mipmaps) {
-	CCTexture* tex = (CCTexture*)Mem_TryAlloc(2 + bmp->width * bmp->height, BITMAPCOLOR_SIZE);
+	int lvls  = mipmaps ? CalcMipmapsLevels(bmp->width, bmp->height) : 0;
+	int width = bmp->width, height = bmp->height;
+	int i, size = 0;
+
+	/* Mipmaps are stored immediately after the base level pixels */
+	for (i = 0; i <= lvls; i++)
+	{
+		size += width * height;
+		if (width > 1)  width /= 2;
+		if (height > 1) height /= 2;
+	}
+
+	CCTexture* tex = (CCTexture*)Mem_TryAlloc(1, sizeof(CCTexture) + size * BITMAPCOLOR_SIZE);
 	if (!tex) return NULL;
 
 	tex->width  = bmp->width;
 	tex->height = bmp->height;
+	tex->mipmapLevels = lvls;
 
 	CopyPixels(tex->pixels, bmp->width * BITMAPCOLOR_SIZE,
 			   bmp->scan0,  rowWidth * BITMAPCOLOR_SIZE,
 			   bmp->width,  bmp->height);
+	if (lvls) GenerateMipmaps(tex, 0, 0, bmp, rowWidth);
 	return tex;
 }
 
@@ -111,23 +189,105 @@ void Gfx_UpdateTexture(GfxResourceID texId, int x, int y, struct Bitmap* part, i
 	CCTexture* tex = (CCTexture*)texId;
 	BitmapCol* dst = (tex->pixels + x) + y * tex->width;
 
+	FlushTriangles();
 	CopyPixels(dst,         tex->width * BITMAPCOLOR_SIZE,
 			   part->scan0, rowWidth   * BITMAPCOLOR_SIZE,
 			   part->width, part->height);
+	if (mipmaps && tex->mipmapLevels) GenerateMipmaps(tex, x, y, part, rowWidth);
 }
 
-void Gfx_EnableMipmaps(void)  { }
-void Gfx_DisableMipmaps(void) { }
+/* Mipmap level is selected per triangle when the triangle is drawn (see CalcMipmapLevel) */
+void Gfx_EnableMipmaps(void)  { mipmapsEnabled = true;  }
+void Gfx_DisableMipmaps(void) { mipmapsEnabled = false; }
 
 
 /*########################################################################################################################*
 *------------------------------------------------------State management---------------------------------------------------*
 *#########################################################################################################################*/
-void Gfx_SetFog(cc_bool enabled)	{ }
-void Gfx_SetFogCol(PackedCol col)   { }
-void Gfx_SetFogDensity(float value) { }
-void Gfx_SetFogEnd(float value) 	{ }
-void Gfx_SetFogMode(FogFunc func)   { }
+static PackedCol fogColor;
+static FogFunc fogMode;
+static float fogDensity = -1.0f, fogEnd = -1.0f;
+
+/* Fog is looked up from a table indexed by eye distance, instead of calculating exp() for every pixel */
+#define FOG_TABLE_SIZE 1024
+/* Amount of the original colour kept (0 = entirely fog colour, 256 = no fog) at each table distance */
+static int fogTable[FOG_TABLE_SIZE];
+/* Multiplier to convert eye distance into an index into fogTable */
+static float fogTableScale;
+static cc_bool fogTableDirty = true;
+
+#define LOG2_E 1.44269504088896f
+/* Natural logarithm of 256 (i.e. distance at which exp fog is within 1/256 of the fog colour) */
+#define LOG_256 5.54517744447956f
+
+static void UpdateFogTable(void) {
+	float maxDist, dist, f;
+	int i;
+	fogTableDirty = false;
+
+	if (fogMode == FOG_LINEAR) {
+		maxDist = fogEnd;
+	} else if (fogMode == FOG_EXP) {
+		maxDist = LOG_256 / fogDensity;
+	} else {
+		maxDist = Math_SqrtF(LOG_256) / fogDensity;
+	}
+
+	/* Invalid fog end/density, so don't apply any fog */
+	if (!(maxDist > 0.0f)) {
+		for (i = 0; i < FOG_TABLE_SIZE; i++) fogTable[i] = 256;
+		fogTableScale = 0.0f;
+		return;
+	}
+	fogTableScale = (FOG_TABLE_SIZE - 1) / maxDist;
+
+	for (i = 0; i < FOG_TABLE_SIZE; i++)
+	{
+		dist = i / fogTableScale;
+		if (fogMode == FOG_LINEAR) {
+			f = 1.0f - dist / fogEnd;
+		} else if (fogMode == FOG_EXP) {
+			f = (float)Math_Exp2(-fogDensity * dist * LOG2_E);
+		} else {
+			f = (float)Math_Exp2(-(fogDensity * dist) * (fogDensity * dist) * LOG2_E);
+		}
+		fogTable[i] = (int)(f * 256.0f + 0.5f);
+		Math_Clamp(fogTable[i], 0, 256);
+	}
+}
+
+void Gfx_SetFog(cc_bool enabled) {
+	gfx_fogEnabled   = enabled;
+	rasterStateDirty = true;
+}
+
+void Gfx_SetFogCol(PackedCol color) {
+	if (color == fogColor) return;
+	fogColor = color;
+	rasterStateDirty = true;
+}
+
+/* NOTE: Queued triangles might still be using the fog table, so must be flushed before it changes */
+void Gfx_SetFogDensity(float value) {
+	if (value == fogDensity) return;
+	FlushTriangles();
+	fogDensity    = value;
+	fogTableDirty = rasterStateDirty = true;
+}
+
+void Gfx_SetFogEnd(float value) {
+	if (value == fogEnd) return;
+	FlushTriangles();
+	fogEnd        = value;
+	fogTableDirty = rasterStateDirty = true;
+}
+
+void Gfx_SetFogMode(FogFunc func) {
+	if (func == fogMode) return;
+	FlushTriangles();
+	fogMode       = func;
+	fogTableDirty = rasterStateDirty = true;
+}
 
 void Gfx_SetFaceCulling(cc_bool enabled) {
 	faceCulling = enabled;
@@ -135,10 +295,12 @@ void Gfx_SetFaceCulling(cc_bool enabled) {
 
 static void SetAlphaTest(cc_bool enabled) {
 	/* Uses value from Gfx_SetAlphaTest */
+	rasterStateDirty = true;
 }
 
 static void SetAlphaBlend(cc_bool enabled) {
 	/* Uses value from Gfx_SetAlphaBlending */
+	rasterStateDirty = true;
 }
 
 void Gfx_SetAlphaArgBlend(cc_bool enabled) { }
@@ -165,6 +327,7 @@ static void ClearDepthBuffer(void) {
 }
 
 void Gfx_ClearBuffers(GfxBuffers buffers) {
+	FlushTriangles();
 	if (buffers & GFX_BUFFER_COLOR) ClearColorBuffer();
 	if (buffers & GFX_BUFFER_DEPTH) ClearDepthBuffer();
 }
@@ -180,10 +343,12 @@ void Gfx_ClearColor(PackedCol color) {
 
 void Gfx_SetDepthTest(cc_bool enabled) {
 	depthTest = enabled;
+	rasterStateDirty = true;
 }
 
 void Gfx_SetDepthWrite(cc_bool enabled) {
 	depthWrite = enabled;
+	rasterStateDirty = true;
 }
 
 static void SetColorWrite(cc_bool r, cc_bool g, cc_bool b, cc_bool a) {
@@ -192,6 +357,7 @@ static void SetColorWrite(cc_bool r, cc_bool g, cc_bool b, cc_bool a) {
 
 void Gfx_DepthOnlyRendering(cc_bool depthOnly) {
 	colWrite = !depthOnly;
+	rasterStateDirty = true;
 }
 
 
@@ -357,57 +523,81 @@ static void ViewportVertex3D(Vertex* vertex) {
 	vertex->v *= invW;
 }
 
+/* State that a triangle is rasterised with */
+typedef struct RasterState_ {
+	BitmapCol* texPixels;
+	int texWidth, texHeight;
+	int texWidthMask, texHeightMask;
+	cc_bool texSinglePixel, texturing;
+	cc_bool alphaTest, alphaBlend;
+	cc_bool depthTest, depthWrite, colWrite;
+	cc_bool fog;
+	int fogR, fogG, fogB;
+} RasterState;
+
+#define TRI_TYPE_SPRITE2D 0
+#define TRI_TYPE_2D       1
+#define TRI_TYPE_3D       2
+#define TRI_TYPE_LINE     3 /* Only v[0] and v[1] are used */
+
+/* Triangles are always rasterised one screen tile at a time */
+#define TILE_SHIFT 6
+#define TILE_SIZE  (1 << TILE_SHIFT)
+
+/* Triangle with vertices in screen space, ready to be rasterised */
+typedef struct Triangle_ {
+	Vertex v[3];
+	int minX, minY, maxX, maxY; /* Bounds of the triangle on screen, after scissoring */
+	int state; /* Index of the raster state to rasterise with (see queuedStates) */
+	int type;
+	int mipmapLevel; /* Mipmap level of the bound texture to sample from */
+} Triangle;
+
 // Ensure it's inlined, whereas Math_FloorF might not be
 static CC_INLINE int FastFloor(float value) {
 	int valueI = (int)value;
 	return valueI > value ? valueI - 1 : valueI;
 }
 
-static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+// NOTE: minX/minY/maxX/maxY are the region of the screen to rasterise the triangle into,
+//  which is always the part of the triangle within a single tile (see RasterTriangleTiles)
+static void RasterSprite2D(const Triangle* t, const RasterState* s, int minX, int minY, int maxX, int maxY) {
+	const Vertex* V0 = &t->v[0];
+	const Vertex* V1 = &t->v[1];
+	const Vertex* V2 = &t->v[2];
 	PackedCol vColor = V0->c;
-	int minX = (int)V0->x;
-	int minY = (int)V0->y;
-	int maxX = (int)V1->x;
-	int maxY = (int)V2->y;
 
-	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
-
-	int begTX = (int)(V0->u * curTexWidth);
-	int begTY = (int)(V0->v * curTexHeight);
-	int delTX = (int)(V1->u * curTexWidth)  - begTX;
-	int delTY = (int)(V2->v * curTexHeight) - begTY;
+	int begTX = (int)(V0->u * s->texWidth);
+	int begTY = (int)(V0->v * s->texHeight);
+	int delTX = (int)(V1->u * s->texWidth)  - begTX;
+	int delTY = (int)(V2->v * s->texHeight) - begTY;
 
-	int width = maxX - minX, height = maxY - minY;
+	int width  = (int)V1->x - (int)V0->x;
+	int height = (int)V2->y - (int)V0->y;
 	if (width == 0) width = 1;
 	if (height == 0) height = 1;
 
 	int fast =  delTX == width && delTY == height && 
-				(begTX + delTX < curTexWidth ) && 
-				(begTY + delTY < curTexHeight);
-
-	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
+				(begTX + delTX < s->texWidth ) && 
+				(begTY + delTY < s->texHeight);
 
 	int x, y;
 	for (y = minY; y <= maxY; y++) 
 	{
-		int texY = fast ? (begTY + (y - minY)) : (((begTY + delTY * (y - minY) / height)) & texHeightMask);
+		int texY = fast ? (begTY + (y - t->minY)) : (((begTY + delTY * (y - t->minY) / height)) & s->texHeightMask);
 		for (x = minX; x <= maxX; x++) 
 		{
-			int texX = fast ? (begTX + (x - minX)) : (((begTX + delTX * (x - minX) / width)) & texWidthMask);
-			int texIndex = texY * curTexWidth + texX;
+			int texX = fast ? (begTX + (x - t->minX)) : (((begTX + delTX * (x - t->minX) / width)) & s->texWidthMask);
+			int texIndex = texY * s->texWidth + texX;
 
-			BitmapCol color = curTexPixels[texIndex];
+			BitmapCol color = s->texPixels[texIndex];
 			int R, G, B, A;
 
 			A = BitmapCol_A(color);
-			if (gfx_alphaBlend && A == 0) continue;
+			if (s->alphaBlend && A == 0) continue;
 			int cb_index = y * cb_stride + x;
 
-			if (gfx_alphaBlend && A != 255) {
+			if (s->alphaBlend && A != 255) {
 				BitmapCol dst = colorBuffer[cb_index];
 				int dstR = BitmapCol_R(dst);
 				int dstG = BitmapCol_G(dst);
@@ -440,41 +630,38 @@ static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 }
 
 #define edgeFunction(ax,ay, bx,by, cx,cy) (((bx) - (ax)) * ((cy) - (ay)) - ((by) - (ay)) * ((cx) - (ax)))
-
-static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+// Calculates edgeFunction at the centre of the given pixel (i.e. cx + 0.5, cy + 0.5), multiplied by 2
+// NOTE: This is calculated exactly using integers, so that the result only depends on the given pixel
+#define edgeFunction2(ax,ay, bx,by, cx,cy) \
+	((cc_int64)((bx) - (ax)) * ((cc_int64)(cy) * 2 + 1 - (cc_int64)(ay) * 2) - \
+	 (cc_int64)((by) - (ay)) * ((cc_int64)(cx) * 2 + 1 - (cc_int64)(ax) * 2))
+
+static void RasterTriangle2D(const Triangle* t, const RasterState* s, int minX, int minY, int maxX, int maxY) {
+	const Vertex* V0 = &t->v[0];
+	const Vertex* V1 = &t->v[1];
+	const Vertex* V2 = &t->v[2];
 	int x0 = (int)V0->x, y0 = (int)V0->y;
 	int x1 = (int)V1->x, y1 = (int)V1->y;
 	int x2 = (int)V2->x, y2 = (int)V2->y;
-	int minX = min(x0, min(x1, x2));
-	int minY = min(y0, min(y1, y2));
-	int maxX = max(x0, max(x1, x2));
-	int maxY = max(y0, max(y1, y2));
 
-	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
-
-	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
-
-	float u0 = V0->u * curTexWidth,  u1 = V1->u * curTexWidth,  u2 = V2->u * curTexWidth;
-	float v0 = V0->v * curTexHeight, v1 = V1->v * curTexHeight, v2 = V2->v * curTexHeight;
+	float u0 = V0->u * s->texWidth,  u1 = V1->u * s->texWidth,  u2 = V2->u * s->texWidth;
+	float v0 = V0->v * s->texHeight, v1 = V1->v * s->texHeight, v2 = V2->v * s->texHeight;
 	PackedCol color = V0->c;
 
 	int area = edgeFunction(x0,y0, x1,y1, x2,y2);
-	float factor = 1.0f / area;
+	// Edge functions below are multiplied by 2, so halve the factor to compensate
+	float factor = 0.5f / area;
 	int x, y;
 	
 	// https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
 	// Essentially these are the deltas of edge functions between X/Y and X/Y + 1 (i.e. one X/Y step)
-	int dx01  = y0 - y1, dy01 = x1 - x0;
-	int dx12  = y1 - y2, dy12 = x2 - x1;
-	int dx20  = y2 - y0, dy20 = x0 - x2;
+	int dx01  = (y0 - y1) * 2, dy01 = (x1 - x0) * 2;
+	int dx12  = (y1 - y2) * 2, dy12 = (x2 - x1) * 2;
+	int dx20  = (y2 - y0) * 2, dy20 = (x0 - x2) * 2;
 
-	float bc0_start = edgeFunction(x1,y1, x2,y2, minX+0.5f,minY+0.5f);
-	float bc1_start = edgeFunction(x2,y2, x0,y0, minX+0.5f,minY+0.5f);
-	float bc2_start = edgeFunction(x0,y0, x1,y1, minX+0.5f,minY+0.5f);
+	float bc0_start = (float)edgeFunction2(x1,y1, x2,y2, minX,minY);
+	float bc1_start = (float)edgeFunction2(x2,y2, x0,y0, minX,minY);
+	float bc2_start = (float)edgeFunction2(x0,y0, x1,y1, minX,minY);
 
 	for (y = minY; y <= maxY; y++, bc0_start += dy12, bc1_start += dy20, bc2_start += dy01) 
 	{
@@ -492,14 +679,14 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 			int cb_index = y * cb_stride + x;
 
 			int R, G, B, A;
-			if (gfx_format == VERTEX_FORMAT_TEXTURED) {
+			if (s->texturing) {
 				float u = ic0 * u0 + ic1 * u1 + ic2 * u2;
 				float v = ic0 * v0 + ic1 * v1 + ic2 * v2;
-				int texX = ((int)u) & texWidthMask;
-				int texY = ((int)v) & texHeightMask;
-				int texIndex = texY * curTexWidth + texX;
+				int texX = ((int)u) & s->texWidthMask;
+				int texY = ((int)v) & s->texHeightMask;
+				int texIndex = texY * s->texWidth + texX;
 
-				BitmapCol tColor = curTexPixels[texIndex];
+				BitmapCol tColor = s->texPixels[texIndex];
 				int a1 = PackedCol_A(color), a2 = BitmapCol_A(tColor);
 				A = ( a1 * a2 ) >> 8;
 				int r1 = PackedCol_R(color), r2 = BitmapCol_R(tColor);
@@ -515,10 +702,10 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 				A = PackedCol_A(color);
 			}
 
-			if (gfx_alphaTest && A < 0x80) continue;
-			if (gfx_alphaBlend && A == 0)  continue;
+			if (s->alphaTest && A < 0x80) continue;
+			if (s->alphaBlend && A == 0)  continue;
 
-			if (gfx_alphaBlend && A != 255) {
+			if (s->alphaBlend && A != 255) {
 				BitmapCol dst = colorBuffer[cb_index];
 				int dstR = BitmapCol_R(dst);
 				int dstG = BitmapCol_G(dst);
@@ -551,82 +738,310 @@ static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
 	b2 = BitmapCol_B(tColor); \
 	B  = ( b1 * b2 ) >> 8;    \
 
-static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
+/* Returns the amount of the original colour kept (see fogTable) for a pixel at the given eye distance */
+static CC_INLINE int FogFactor(float w) {
+	float index = w * fogTableScale;
+	// NOTE: Also handles NaN
+	if (!(index < FOG_TABLE_SIZE - 1)) index = FOG_TABLE_SIZE - 1;
+	if (index < 0.0f) index = 0.0f;
+	return fogTable[(int)index];
+}
+
+/*########################################################################################################################*
+*--------------------------------------------------------SIMD helpers-----------------------------------------------------*
+*#########################################################################################################################*/
+/* Wrappers around the SIMD instructions used to rasterise 4 pixels at once */
+/* NOTE: Integer masks have all bits of a lane set when true, and no bits set when false */
+#if defined CC_BUILD_SSE2 && !defined BITMAP_16BPP
+#include <emmintrin.h>
+#define SOFTGPU_SIMD
+typedef __m128  Vec4f;
+typedef __m128i Vec4i;
+
+#define Vec4f_Set1(value)   _mm_set1_ps(value)
+#define Vec4f_Set(a, b, c, d) _mm_setr_ps(a, b, c, d)
+#define Vec4f_Load(src)     _mm_loadu_ps(src)
+#define Vec4f_Store(dst, v) _mm_storeu_ps(dst, v)
+#define Vec4f_Add(a, b)     _mm_add_ps(a, b)
+#define Vec4f_Mul(a, b)     _mm_mul_ps(a, b)
+#define Vec4f_Div(a, b)     _mm_div_ps(a, b)
+#define Vec4f_Less(a, b)    _mm_castps_si128(_mm_cmplt_ps(a, b))
+#define Vec4f_Greater(a, b) _mm_castps_si128(_mm_cmpgt_ps(a, b))
+/* NOTE: Returns b when a is NaN */
+#define Vec4f_Min(a, b)     _mm_min_ps(a, b)
+#define Vec4f_Max(a, b)     _mm_max_ps(a, b)
+#define Vec4f_ToInt(a)      _mm_cvttps_epi32(a)
+/* Selects b in lanes where mask is set, a otherwise */
+#define Vec4f_Select(mask, a, b) _mm_castsi128_ps(Vec4i_Select(mask, _mm_castps_si128(a), _mm_castps_si128(b)))
+
+#define Vec4i_Set1(value)   _mm_set1_epi32(value)
+#define Vec4i_Set(a, b, c, d) _mm_setr_epi32(a, b, c, d)
+#define Vec4i_Load(src)     _mm_loadu_si128((const __m128i*)(src))
+#define Vec4i_Store(dst, v) _mm_storeu_si128((__m128i*)(dst), v)
+#define Vec4i_Add(a, b)     _mm_add_epi32(a, b)
+#define Vec4i_Sub(a, b)     _mm_sub_epi32(a, b)
+#define Vec4i_And(a, b)     _mm_and_si128(a, b)
+#define Vec4i_Or(a, b)      _mm_or_si128(a, b)
+#define Vec4i_Less(a, b)    _mm_cmplt_epi32(a, b)
+#define Vec4i_Select(mask, a, b) _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, a))
+#define Vec4i_ShiftLeft(a, bits)  _mm_slli_epi32(a, bits)
+#define Vec4i_ShiftRight(a, bits) _mm_srli_epi32(a, bits)
+/* NOTE: Only works when both values are between 0 and 32767 */
+#define Vec4i_MulSmall(a, b) _mm_madd_epi16(a, b)
+#define Vec4i_AllSet(mask)   (_mm_movemask_epi8(mask) == 0xFFFF)
+#elif defined CC_BUILD_NEON && !defined BITMAP_16BPP
+#include <arm_neon.h>
+#define SOFTGPU_SIMD
+typedef float32x4_t Vec4f;
+typedef int32x4_t   Vec4i;
+
+static CC_INLINE Vec4f Vec4f_Set(float a, float b, float c, float d) {
+	float v[4] = { a, b, c, d }; return vld1q_f32(v);
+}
+static CC_INLINE Vec4i Vec4i_Set(int a, int b, int c, int d) {
+	int32_t v[4] = { a, b, c, d }; return vld1q_s32(v);
+}
+
+#define Vec4f_Set1(value)   vdupq_n_f32(value)
+#define Vec4f_Load(src)     vld1q_f32(src)
+#define Vec4f_Store(dst, v) vst1q_f32(dst, v)
+#define Vec4f_Add(a, b)     vaddq_f32(a, b)
+#define Vec4f_Mul(a, b)     vmulq_f32(a, b)
+#define Vec4f_Div(a, b)     vdivq_f32(a, b)
+#define Vec4f_Less(a, b)    vreinterpretq_s32_u32(vcltq_f32(a, b))
+#define Vec4f_Greater(a, b) vreinterpretq_s32_u32(vcgtq_f32(a, b))
+/* NOTE: Returns NaN when a is NaN (which Vec4f_ToInt then converts to 0) */
+#define Vec4f_Min(a, b)     vminq_f32(a, b)
+#define Vec4f_Max(a, b)     vmaxq_f32(a, b)
+#define Vec4f_ToInt(a)      vcvtq_s32_f32(a)
+/* Selects b in lanes where mask is set, a otherwise */
+#define Vec4f_Select(mask, a, b) vbslq_f32(vreinterpretq_u32_s32(mask), b, a)
+
+#define Vec4i_Set1(value)   vdupq_n_s32(value)
+#define Vec4i_Load(src)     vld1q_s32((const int32_t*)(src))
+#define Vec4i_Store(dst, v) vst1q_s32((int32_t*)(dst), v)
+#define Vec4i_Add(a, b)     vaddq_s32(a, b)
+#define Vec4i_Sub(a, b)     vsubq_s32(a, b)
+#define Vec4i_And(a, b)     vandq_s32(a, b)
+#define Vec4i_Or(a, b)      vorrq_s32(a, b)
+#define Vec4i_Less(a, b)    vreinterpretq_s32_u32(vcltq_s32(a, b))
+#define Vec4i_Select(mask, a, b) vbslq_s32(vreinterpretq_u32_s32(mask), b, a)
+#define Vec4i_ShiftLeft(a, bits)  vreinterpretq_s32_u32(vshlq_n_u32(vreinterpretq_u32_s32(a), bits))
+#define Vec4i_ShiftRight(a, bits) vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), bits))
+/* NOTE: Only works when both values are between 0 and 32767 */
+#define Vec4i_MulSmall(a, b) vmulq_s32(a, b)
+#define Vec4i_AllSet(mask)   (vminvq_u32(vreinterpretq_u32_s32(mask)) == 0xFFFFFFFFU)
+#endif
+
+#ifdef SOFTGPU_SIMD
+/* Extracts a colour component from each of the 4 given colours */
+#define Vec4i_Component(colors, shift) Vec4i_And(Vec4i_ShiftRight(colors, shift), Vec4i_Set1(0xFF))
+
+/* Multiplies a colour component from each of the 4 given colours by the given vertex colour component */
+#define Vec4i_MultiplyComponent(colors, shift, value) Vec4i_ShiftRight(Vec4i_MulSmall(Vec4i_Component(colors, shift), value), 8)
+
+/* Blends the given source colour components with the given destination colours */
+static CC_INLINE Vec4i Vec4i_BlendColor(Vec4i src, Vec4i dst, Vec4i A, Vec4i invA) {
+	return Vec4i_ShiftRight(Vec4i_Add(Vec4i_MulSmall(src, A), Vec4i_MulSmall(dst, invA)), 8);
+}
+
+/* Combines R/G/B components into 4 opaque colours */
+static CC_INLINE Vec4i Vec4i_MakeColors(Vec4i R, Vec4i G, Vec4i B) {
+	Vec4i col = Vec4i_Set1((int)BITMAPCOLOR_A_MASK);
+	col = Vec4i_Or(col, Vec4i_ShiftLeft(R, BITMAPCOLOR_R_SHIFT));
+	col = Vec4i_Or(col, Vec4i_ShiftLeft(G, BITMAPCOLOR_G_SHIFT));
+	return Vec4i_Or(col, Vec4i_ShiftLeft(B, BITMAPCOLOR_B_SHIFT));
+}
+#endif
+
+static void RasterTriangle3D(const Triangle* t, const RasterState* s, int minX, int minY, int maxX, int maxY) {
+	const Vertex* V0 = &t->v[0];
+	const Vertex* V1 = &t->v[1];
+	const Vertex* V2 = &t->v[2];
 	int x0 = (int)V0->x, y0 = (int)V0->y;
 	int x1 = (int)V1->x, y1 = (int)V1->y;
 	int x2 = (int)V2->x, y2 = (int)V2->y;
-	int minX = min(x0, min(x1, x2));
-	int minY = min(y0, min(y1, y2));
-	int maxX = max(x0, max(x1, x2));
-	int maxY = max(y0, max(y1, y2));
 
 	int area = edgeFunction(x0,y0, x1,y1, x2,y2);
-	if (faceCulling) {
-		// https://gamedev.stackexchange.com/questions/203694/how-to-make-backface-culling-work-correctly-in-both-orthographic-and-perspective
-		if (area < 0) return;
-	}
-
-	// Reject triangles completely outside
-	if (maxX < 0 || minX > fb_maxX) return;
-	if (maxY < 0 || minY > fb_maxY) return;
-
-	// Perform scissoring
-	minX = max(minX, 0); maxX = min(maxX, fb_maxX);
-	minY = max(minY, 0); maxY = min(maxY, fb_maxY);
+	// Edge functions below are multiplied by 2, so halve the factor to compensate
+	float factor = 0.5f / area;
 
 	// NOTE: W in frag variables below is actually 1/W 
-	float factor = 1.0f / area;
 	float w0 = V0->w, w1 = V1->w, w2 = V2->w;
-	
-	// TODO proper clipping
-	if (w0 <= 0 || w1 <= 0 || w2 <= 0) {
-		return;
-	}
-
 	float z0 = V0->z, z1 = V1->z, z2 = V2->z;
 	PackedCol color = V0->c;
 
-	float u0 = V0->u * curTexWidth,  u1 = V1->u * curTexWidth,  u2 = V2->u * curTexWidth;
-	float v0 = V0->v * curTexHeight, v1 = V1->v * curTexHeight, v2 = V2->v * curTexHeight;
+	BitmapCol* texPixels = s->texPixels;
+	int texWidth     = s->texWidth,     texHeight     = s->texHeight;
+	int texWidthMask = s->texWidthMask, texHeightMask = s->texHeightMask;
+
+	if (t->mipmapLevel) {
+		texPixels     = GetMipmapLevel(texPixels, &texWidth, &texHeight, t->mipmapLevel);
+		texWidthMask  = texWidth  - 1;
+		texHeightMask = texHeight - 1;
+	}
+
+	float u0 = V0->u * texWidth,  u1 = V1->u * texWidth,  u2 = V2->u * texWidth;
+	float v0 = V0->v * texHeight, v1 = V1->v * texHeight, v2 = V2->v * texHeight;
 	
 	// https://fgiesen.wordpress.com/2013/02/10/optimizing-the-basic-rasterizer/
 	// Essentially these are the deltas of edge functions between X/Y and X/Y + 1 (i.e. one X/Y step)
-	int dx01  = y0 - y1, dy01 = x1 - x0;
-	int dx12  = y1 - y2, dy12 = x2 - x1;
-	int dx20  = y2 - y0, dy20 = x0 - x2;
+	int dx01  = (y0 - y1) * 2, dy01 = (x1 - x0) * 2;
+	int dx12  = (y1 - y2) * 2, dy12 = (x2 - x1) * 2;
+	int dx20  = (y2 - y0) * 2, dy20 = (x0 - x2) * 2;
 
-	float bc0_start = edgeFunction(x1,y1, x2,y2, minX+0.5f,minY+0.5f);
-	float bc1_start = edgeFunction(x2,y2, x0,y0, minX+0.5f,minY+0.5f);
-	float bc2_start = edgeFunction(x0,y0, x1,y1, minX+0.5f,minY+0.5f);
+	float bc0_start = (float)edgeFunction2(x1,y1, x2,y2, minX,minY);
+	float bc1_start = (float)edgeFunction2(x2,y2, x0,y0, minX,minY);
+	float bc2_start = (float)edgeFunction2(x0,y0, x1,y1, minX,minY);
 
 	int R, G, B, A, x, y;
 	int a1, r1, g1, b1;
 	int a2, r2, g2, b2;
-	cc_bool texturing = gfx_format == VERTEX_FORMAT_TEXTURED;
+	cc_bool texturing = s->texturing;
 
 	if (!texturing) {
 		R = PackedCol_R(color);
 		G = PackedCol_G(color);
 		B = PackedCol_B(color);
 		A = PackedCol_A(color);
-	} else if (texSinglePixel) {
+	} else if (s->texSinglePixel) {
 		/* Don't need to calculate complicated texturing in this case */
 		float rawY0 = v0 / w0;
 		float rawY1 = v1 / w1;
 
 		float rawY = min(rawY0, rawY1);
 		int texY   = (int)(rawY + 0.01f) & texHeightMask;
-		MultiplyColors(color, curTexPixels[texY * curTexWidth]);
+		MultiplyColors(color, texPixels[texY * texWidth]);
 		texturing = false;
 	}
 
+#ifdef SOFTGPU_SIMD
+	Vec4f vFactor = Vec4f_Set1(factor);
+	Vec4f vZero   = Vec4f_Set1(0.0f);
+	Vec4f vOne    = Vec4f_Set1(1.0f);
+	// Edge function offsets of each of the 4 pixels from the first pixel
+	Vec4f vStep0  = Vec4f_Set(0.0f, (float)dx12, (float)(dx12 * 2), (float)(dx12 * 3));
+	Vec4f vStep1  = Vec4f_Set(0.0f, (float)dx20, (float)(dx20 * 2), (float)(dx20 * 3));
+	Vec4f vStep2  = Vec4f_Set(0.0f, (float)dx01, (float)(dx01 * 2), (float)(dx01 * 3));
+
+	Vec4f vW0 = Vec4f_Set1(w0), vW1 = Vec4f_Set1(w1), vW2 = Vec4f_Set1(w2);
+	Vec4f vZ0 = Vec4f_Set1(z0), vZ1 = Vec4f_Set1(z1), vZ2 = Vec4f_Set1(z2);
+	Vec4f vU0 = Vec4f_Set1(u0), vU1 = Vec4f_Set1(u1), vU2 = Vec4f_Set1(u2);
+	Vec4f vV0 = Vec4f_Set1(v0), vV1 = Vec4f_Set1(v1), vV2 = Vec4f_Set1(v2);
+
+	Vec4i vWidthMask  = Vec4i_Set1(texWidthMask);
+	Vec4i vHeightMask = Vec4i_Set1(texHeightMask);
+	Vec4i vTexWidth   = Vec4i_Set1(texWidth);
+	Vec4i vAlphaTest  = Vec4i_Set1(0x80);
+	Vec4i v255        = Vec4i_Set1(255);
+
+	Vec4f vFogScale = Vec4f_Set1(fogTableScale);
+	Vec4f vFogMax   = Vec4f_Set1(FOG_TABLE_SIZE - 1);
+	Vec4i vFogR     = Vec4i_Set1(s->fogR), vFogG = Vec4i_Set1(s->fogG);
+	Vec4i vFogB     = Vec4i_Set1(s->fogB), v256  = Vec4i_Set1(256);
+
+	Vec4i vR, vG, vB, vA;
+	if (texturing) {
+		vR = Vec4i_Set1(PackedCol_R(color)); vG = Vec4i_Set1(PackedCol_G(color));
+		vB = Vec4i_Set1(PackedCol_B(color)); vA = Vec4i_Set1(PackedCol_A(color));
+	} else {
+		vR = Vec4i_Set1(R); vG = Vec4i_Set1(G);
+		vB = Vec4i_Set1(B); vA = Vec4i_Set1(A);
+	}
+#endif
+
 	for (y = minY; y <= maxY; y++, bc0_start += dy12, bc1_start += dy20, bc2_start += dy01) 
 	{
 		float bc0 = bc0_start;
 		float bc1 = bc1_start;
 		float bc2 = bc2_start;
+		x = minX;
 
-		for (x = minX; x <= maxX; x++, bc0 += dx12, bc1 += dx20, bc2 += dx01) 
+#ifdef SOFTGPU_SIMD
+		// Rasterise 4 pixels at a time, then any remaining pixels one at a time below
+		for (; x + 3 <= maxX; x += 4, bc0 += dx12 * 4, bc1 += dx20 * 4, bc2 += dx01 * 4)
+		{
+			Vec4f ic0 = Vec4f_Mul(Vec4f_Add(Vec4f_Set1(bc0), vStep0), vFactor);
+			Vec4f ic1 = Vec4f_Mul(Vec4f_Add(Vec4f_Set1(bc1), vStep1), vFactor);
+			Vec4f ic2 = Vec4f_Mul(Vec4f_Add(Vec4f_Set1(bc2), vStep2), vFactor);
+
+			// Lanes are set for pixels which are not drawn
+			Vec4i reject = Vec4i_Or(Vec4i_Or(Vec4f_Less(ic0, vZero), Vec4f_Less(ic1, vZero)), Vec4f_Less(ic2, vZero));
+			if (Vec4i_AllSet(reject)) continue;
+
+			float* depth = &depthBuffer[y * db_stride + x];
+			Vec4f w = Vec4f_Add(Vec4f_Add(Vec4f_Mul(ic0, vW0), Vec4f_Mul(ic1, vW1)), Vec4f_Mul(ic2, vW2));
+			w       = Vec4f_Div(vOne, w);
+			Vec4f z = Vec4f_Add(Vec4f_Add(Vec4f_Mul(ic0, vZ0), Vec4f_Mul(ic1, vZ1)), Vec4f_Mul(ic2, vZ2));
+			z       = Vec4f_Mul(z, w);
+			Vec4f oldZ = Vec4f_Load(depth);
+
+			if (s->depthTest) {
+				reject = Vec4i_Or(reject, Vec4i_Or(Vec4f_Less(z, vZero), Vec4f_Greater(z, oldZ)));
+				if (Vec4i_AllSet(reject)) continue;
+			}
+			if (!s->colWrite) {
+				if (s->depthWrite) Vec4f_Store(depth, Vec4f_Select(reject, z, oldZ));
+				continue;
+			}
+
+			Vec4i vRed, vGreen, vBlue, vAlpha;
+			if (texturing) {
+				Vec4f u = Vec4f_Add(Vec4f_Add(Vec4f_Mul(ic0, vU0), Vec4f_Mul(ic1, vU1)), Vec4f_Mul(ic2, vU2));
+				Vec4f v = Vec4f_Add(Vec4f_Add(Vec4f_Mul(ic0, vV0), Vec4f_Mul(ic1, vV1)), Vec4f_Mul(ic2, vV2));
+				Vec4i texX = Vec4i_And(Vec4f_ToInt(Vec4f_Mul(u, w)), vWidthMask);
+				Vec4i texY = Vec4i_And(Vec4f_ToInt(Vec4f_Mul(v, w)), vHeightMask);
+
+				int texIndex[4];
+				Vec4i_Store(texIndex, Vec4i_Add(Vec4i_MulSmall(texY, vTexWidth), texX));
+				Vec4i tColor = Vec4i_Set(texPixels[texIndex[0]], texPixels[texIndex[1]],
+										texPixels[texIndex[2]], texPixels[texIndex[3]]);
+				vRed   = Vec4i_MultiplyComponent(tColor, BITMAPCOLOR_R_SHIFT, vR);
+				vGreen = Vec4i_MultiplyComponent(tColor, BITMAPCOLOR_G_SHIFT, vG);
+				vBlue  = Vec4i_MultiplyComponent(tColor, BITMAPCOLOR_B_SHIFT, vB);
+				vAlpha = Vec4i_MultiplyComponent(tColor, BITMAPCOLOR_A_SHIFT, vA);
+			} else {
+				vRed = vR; vGreen = vG; vBlue = vB; vAlpha = vA;
+			}
+
+			if (s->alphaTest) {
+				reject = Vec4i_Or(reject, Vec4i_Less(vAlpha, vAlphaTest));
+				if (Vec4i_AllSet(reject)) continue;
+			}
+			if (s->depthWrite) Vec4f_Store(depth, Vec4f_Select(reject, z, oldZ));
+
+			if (s->fog) {
+				// Same as FogFactor, but for 4 pixels
+				Vec4f index = Vec4f_Max(Vec4f_Min(Vec4f_Mul(w, vFogScale), vFogMax), vZero);
+				int fogIndex[4];
+				Vec4i_Store(fogIndex, Vec4f_ToInt(index));
+
+				Vec4i f    = Vec4i_Set(fogTable[fogIndex[0]], fogTable[fogIndex[1]],
+									   fogTable[fogIndex[2]], fogTable[fogIndex[3]]);
+				Vec4i invF = Vec4i_Sub(v256, f);
+				vRed   = Vec4i_BlendColor(vRed,   vFogR, f, invF);
+				vGreen = Vec4i_BlendColor(vGreen, vFogG, f, invF);
+				vBlue  = Vec4i_BlendColor(vBlue,  vFogB, f, invF);
+			}
+
+			BitmapCol* dst = &colorBuffer[y * cb_stride + x];
+			Vec4i dstColor = Vec4i_Load(dst);
+			Vec4i srcColor;
+
+			if (!s->alphaBlend) {
+				srcColor = Vec4i_MakeColors(vRed, vGreen, vBlue);
+			} else {
+				Vec4i invA = Vec4i_Sub(v255, vAlpha);
+				srcColor   = Vec4i_MakeColors(
+					Vec4i_BlendColor(vRed,   Vec4i_Component(dstColor, BITMAPCOLOR_R_SHIFT), vAlpha, invA),
+					Vec4i_BlendColor(vGreen, Vec4i_Component(dstColor, BITMAPCOLOR_G_SHIFT), vAlpha, invA),
+					Vec4i_BlendColor(vBlue,  Vec4i_Component(dstColor, BITMAPCOLOR_B_SHIFT), vAlpha, invA));
+			}
+			Vec4i_Store(dst, Vec4i_Select(reject, srcColor, dstColor));
+		}
+#endif
+
+		for (; x <= maxX; x++, bc0 += dx12, bc1 += dx20, bc2 += dx01) 
 		{
 			float ic0 = bc0 * factor;
 			float ic1 = bc1 * factor;
@@ -637,9 +1052,9 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 			float w = 1 / (ic0 * w0 + ic1 * w1 + ic2 * w2);
 			float z = (ic0 * z0 + ic1 * z1 + ic2 * z2) * w;
 
-			if (depthTest && (z < 0 || z > depthBuffer[db_index])) continue;
-			if (!colWrite) {
-				if (depthWrite) depthBuffer[db_index] = z;
+			if (s->depthTest && (z < 0 || z > depthBuffer[db_index])) continue;
+			if (!s->colWrite) {
+				if (s->depthWrite) depthBuffer[db_index] = z;
 				continue;
 			}
 
@@ -649,18 +1064,26 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 				int texX = ((int)u) & texWidthMask;
 				int texY = ((int)v) & texHeightMask;
 
-				int texIndex = texY * curTexWidth + texX;
-				BitmapCol tColor = curTexPixels[texIndex];
+				int texIndex = texY * texWidth + texX;
+				BitmapCol tColor = texPixels[texIndex];
 
 				MultiplyColors(color, tColor);
 			}
 
-			if (gfx_alphaTest && A < 0x80) continue;
-			if (depthWrite) depthBuffer[db_index] = z;
+			if (s->alphaTest && A < 0x80) continue;
+			if (s->depthWrite) depthBuffer[db_index] = z;
 			int cb_index = y * cb_stride + x;
+			int finR = R, finG = G, finB = B;
+
+			if (s->fog) {
+				int f = FogFactor(w);
+				finR = (R * f + s->fogR * (256 - f)) >> 8;
+				finG = (G * f + s->fogG * (256 - f)) >> 8;
+				finB = (B * f + s->fogB * (256 - f)) >> 8;
+			}
 			
-			if (!gfx_alphaBlend) {
-				colorBuffer[cb_index] = BitmapCol_Make(R, G, B, 0xFF);
+			if (!s->alphaBlend) {
+				colorBuffer[cb_index] = BitmapCol_Make(finR, finG, finB, 0xFF);
 				continue;
 			}
 
@@ -669,14 +1092,443 @@ static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
 			int dstG = BitmapCol_G(dst);
 			int dstB = BitmapCol_B(dst);
 
-			int finR = (R * A + dstR * (255 - A)) >> 8;
-			int finG = (G * A + dstG * (255 - A)) >> 8;
-			int finB = (B * A + dstB * (255 - A)) >> 8;
+			finR = (finR * A + dstR * (255 - A)) >> 8;
+			finG = (finG * A + dstG * (255 - A)) >> 8;
+			finB = (finB * A + dstB * (255 - A)) >> 8;
 			colorBuffer[cb_index] = BitmapCol_Make(finR, finG, finB, 0xFF);
 		}
 	}
 }
 
+static void RasterLine(const Triangle* t, const RasterState* s, int minX, int minY, int maxX, int maxY) {
+	const Vertex* V0 = &t->v[0];
+	const Vertex* V1 = &t->v[1];
+	float dx = V1->x - V0->x, dy = V1->y - V0->y;
+	float dz = V1->z - V0->z, dw = V1->w - V0->w;
+	int steps = (int)max(Math_AbsF(dx), Math_AbsF(dy));
+	float invSteps = steps ? 1.0f / steps : 0.0f;
+
+	// Only step along the part of the line within the region being rasterised
+	// NOTE: Pixel positions are always calculated from the step index, so the same pixels are
+	//  produced regardless of how the line is split up into regions (see RasterTriangleTiles)
+	cc_bool xMajor = Math_AbsF(dx) >= Math_AbsF(dy);
+	float beg   = xMajor ? V0->x : V0->y;
+	float delta = xMajor ? dx : dy;
+	int regionMin = xMajor ? minX : minY;
+	int regionMax = xMajor ? maxX : maxY;
+	int i, iBeg = 0, iEnd = steps;
+
+	if (delta != 0.0f) {
+		float a = (regionMin     - beg) / delta * steps;
+		float b = (regionMax + 1 - beg) / delta * steps;
+		if (a > b) { float tmp = a; a = b; b = tmp; }
+
+		if (a > iBeg) iBeg = (int)a - 1;
+		if (b < iEnd) iEnd = (int)b + 1;
+		iBeg = max(iBeg, 0); iEnd = min(iEnd, steps);
+	}
+
+	PackedCol color = V0->c;
+	int R = PackedCol_R(color), G = PackedCol_G(color);
+	int B = PackedCol_B(color), A = PackedCol_A(color);
+	if (s->alphaTest && A < 0x80) return;
+
+	for (i = iBeg; i <= iEnd; i++)
+	{
+		float f = i * invSteps;
+		int x = FastFloor(V0->x + dx * f);
+		int y = FastFloor(V0->y + dy * f);
+		if (x < minX || x > maxX || y < minY || y > maxY) continue;
+
+		int db_index = y * db_stride + x;
+		float z = V0->z + dz * f;
+		// NOTE: W in vertices is actually 1/W, which can be linearly interpolated in screen space
+		float w = 1 / (V0->w + dw * f);
+
+		if (s->depthTest && (z < 0 || z > depthBuffer[db_index])) continue;
+		if (s->depthWrite) depthBuffer[db_index] = z;
+		if (!s->colWrite) continue;
+
+		int cb_index = y * cb_stride + x;
+		int finR = R, finG = G, finB = B;
+
+		if (s->fog) {
+			int fog = FogFactor(w);
+			finR = (R * fog + s->fogR * (256 - fog)) >> 8;
+			finG = (G * fog + s->fogG * (256 - fog)) >> 8;
+			finB = (B * fog + s->fogB * (256 - fog)) >> 8;
+		}
+
+		if (s->alphaBlend) {
+			BitmapCol dst = colorBuffer[cb_index];
+			finR = (finR * A + BitmapCol_R(dst) * (255 - A)) >> 8;
+			finG = (finG * A + BitmapCol_G(dst) * (255 - A)) >> 8;
+			finB = (finB * A + BitmapCol_B(dst) * (255 - A)) >> 8;
+		}
+		colorBuffer[cb_index] = BitmapCol_Make(finR, finG, finB, 0xFF);
+	}
+}
+
+static void RasterTriangle(const Triangle* t, const RasterState* s, int minX, int minY, int maxX, int maxY) {
+	switch (t->type)
+	{
+	case TRI_TYPE_SPRITE2D:
+		RasterSprite2D(t, s, minX, minY, maxX, maxY);   break;
+	case TRI_TYPE_2D:
+		RasterTriangle2D(t, s, minX, minY, maxX, maxY); break;
+	case TRI_TYPE_3D:
+		RasterTriangle3D(t, s, minX, minY, maxX, maxY); break;
+	case TRI_TYPE_LINE:
+		RasterLine(t, s, minX, minY, maxX, maxY);       break;
+	}
+}
+
+/* Rasterises the parts of the triangle within each screen tile it covers */
+/* NOTE: Edge functions are accumulated in floats, so rasterising per tile (instead of the entire triangle at once) */
+/*  ensures that the result is identical to when triangles are binned and each tile is rasterised separately */
+static void RasterTriangleTiles(const Triangle* t, const RasterState* s) {
+	int minX, minY, maxX, maxY;
+
+	for (minY = t->minY; minY <= t->maxY; minY = maxY + 1)
+	{
+		maxY = min(t->maxY, minY | (TILE_SIZE - 1));
+		for (minX = t->minX; minX <= t->maxX; minX = maxX + 1)
+		{
+			maxX = min(t->maxX, minX | (TILE_SIZE - 1));
+			RasterTriangle(t, s, minX, minY, maxX, maxY);
+		}
+	}
+}
+
+static RasterState rasterState;
+static void UpdateRasterState(RasterState* s) {
+	s->texPixels      = curTexPixels;
+	s->texWidth       = curTexWidth;
+	s->texHeight      = curTexHeight;
+	s->texWidthMask   = texWidthMask;
+	s->texHeightMask  = texHeightMask;
+	s->texSinglePixel = texSinglePixel;
+	s->texturing      = gfx_format == VERTEX_FORMAT_TEXTURED;
+
+	s->alphaTest  = gfx_alphaTest;
+	s->alphaBlend = gfx_alphaBlend;
+	s->depthTest  = depthTest;
+	s->depthWrite = depthWrite;
+	s->colWrite   = colWrite;
+
+	if (fogTableDirty) UpdateFogTable();
+	s->fog  = gfx_fogEnabled;
+	s->fogR = PackedCol_R(fogColor);
+	s->fogG = PackedCol_G(fogColor);
+	s->fogB = PackedCol_B(fogColor);
+}
+
+
+/*########################################################################################################################*
+*------------------------------------------------------Triangle binning---------------------------------------------------*
+*#########################################################################################################################*/
+#ifdef SOFTGPU_BINNING
+/* Triangles are queued up and sorted into the screen tiles they cover, instead of being rasterised immediately. */
+/* Then when the queued triangles are needed (e.g. end of frame), the tiles are rasterised by multiple threads. */
+/* Since each tile rasterises its triangles in the same order they were drawn in, the result is identical to */
+/*  rasterising every triangle immediately on the main thread */
+#define MAX_QUEUED_TRIS    16384
+#define MAX_QUEUED_STATES  1024
+#define MAX_TILE_TRIS      2048
+
+static Triangle* queuedTris;
+static int queuedTrisCount;
+static RasterState* queuedStates;
+static int queuedStatesCount;
+
+/* Indices of the queued triangles that cover each tile, MAX_TILE_TRIS entries per tile */
+static cc_uint16* tileTris;
+static int* tileTrisCount;
+static int tilesX, tilesY, tilesCount;
+
+static struct WorkerPool rasterPool;
+static int nextTile;
+
+static void RasterTile(int tile) {
+	cc_uint16* tris = tileTris + tile * MAX_TILE_TRIS;
+	int count = tileTrisCount[tile];
+	int tileMinX = (tile % tilesX) << TILE_SHIFT;
+	int tileMinY = (tile / tilesX) << TILE_SHIFT;
+	int tileMaxX = tileMinX + TILE_SIZE - 1;
+	int tileMaxY = tileMinY + TILE_SIZE - 1;
+	int i;
+
+	for (i = 0; i < count; i++)
+	{
+		Triangle* t = &queuedTris[tris[i]];
+		RasterTriangle(t, &queuedStates[t->state],
+						max(t->minX, tileMinX), max(t->minY, tileMinY),
+						min(t->maxX, tileMaxX), min(t->maxY, tileMaxY));
+	}
+}
+
+static void RasterTiles(int workerID) {
+	int tile;
+	for (;;)
+	{
+		Mutex_Lock(rasterPool.mutex);
+		{
+			tile = nextTile++;
+		}
+		Mutex_Unlock(rasterPool.mutex);
+
+		if (tile >= tilesCount) return;
+		if (tileTrisCount[tile]) RasterTile(tile);
+	}
+}
+
+static void StartRasterWorkers(void) {
+	int count;
+	if (rasterPool.count) return;
+
+	count = Options_GetInt(OPT_SOFTGPU_THREADS, 0, WORKERPOOL_MAX_THREADS, 4);
+	if (!count) return;
+
+	queuedTris   = (Triangle*)Mem_TryAlloc(MAX_QUEUED_TRIS, sizeof(Triangle));
+	queuedStates = (RasterState*)Mem_TryAlloc(MAX_QUEUED_STATES, sizeof(RasterState));
+	if (!queuedTris || !queuedStates) {
+		Mem_Free(queuedTris);   queuedTris   = NULL;
+		Mem_Free(queuedStates); queuedStates = NULL;
+		return;
+	}
+
+	WorkerPool_Start(&rasterPool, count, RasterTiles, 256 * 1024, "Rasteriser");
+}
+
+static void AllocTileBins(void) {
+	if (!rasterPool.count) return;
+	tilesX     = (fb_width  + TILE_SIZE - 1) >> TILE_SHIFT;
+	tilesY     = (fb_height + TILE_SIZE - 1) >> TILE_SHIFT;
+	tilesCount = tilesX * tilesY;
+
+	tileTris      = (cc_uint16*)Mem_TryAlloc(tilesCount * MAX_TILE_TRIS, 2);
+	tileTrisCount = (int*)Mem_TryAllocCleared(tilesCount, sizeof(int));
+
+	/* Just rasterise triangles immediately if out of memory */
+	if (!tileTris || !tileTrisCount) FreeTileBins();
+}
+
+static void FreeTileBins(void) {
+	Mem_Free(tileTris);      tileTris      = NULL;
+	Mem_Free(tileTrisCount); tileTrisCount = NULL;
+	tilesCount = 0;
+}
+
+static void FlushTriangles(void) {
+	if (!queuedTrisCount) return;
+
+	nextTile = 0;
+	/* Main thread rasterises tiles too while waiting */
+	WorkerPool_Run(&rasterPool);
+
+	Mem_Set(tileTrisCount, 0, tilesCount * sizeof(int));
+	queuedTrisCount   = 0;
+	queuedStatesCount = 0;
+	rasterStateDirty  = true;
+}
+
+static cc_bool AnyTileFull(int beginX, int beginY, int endX, int endY) {
+	int x, y;
+	for (y = beginY; y <= endY; y++)
+		for (x = beginX; x <= endX; x++)
+	{
+		if (tileTrisCount[y * tilesX + x] == MAX_TILE_TRIS) return true;
+	}
+	return false;
+}
+
+static void SubmitTriangle(Triangle* t) {
+	int beginX, beginY, endX, endY;
+	int x, y, index;
+
+	if (!tileTris) {
+		if (rasterStateDirty) UpdateRasterState(&rasterState);
+		rasterStateDirty = false;
+
+		RasterTriangleTiles(t, &rasterState);
+		return;
+	}
+
+	beginX = t->minX >> TILE_SHIFT; endX = min(t->maxX >> TILE_SHIFT, tilesX - 1);
+	beginY = t->minY >> TILE_SHIFT; endY = min(t->maxY >> TILE_SHIFT, tilesY - 1);
+
+	/* Make sure there's space in the queue and in every tile the triangle covers */
+	if (queuedTrisCount == MAX_QUEUED_TRIS || (rasterStateDirty && queuedStatesCount == MAX_QUEUED_STATES)
+			|| AnyTileFull(beginX, beginY, endX, endY)) {
+		FlushTriangles();
+	}
+
+	if (rasterStateDirty) {
+		UpdateRasterState(&queuedStates[queuedStatesCount++]);
+		rasterStateDirty = false;
+	}
+	t->state = queuedStatesCount - 1;
+
+	index = queuedTrisCount++;
+	queuedTris[index] = *t;
+
+	for (y = beginY; y <= endY; y++)
+		for (x = beginX; x <= endX; x++)
+	{
+		int tile = y * tilesX + x;
+		tileTris[tile * MAX_TILE_TRIS + tileTrisCount[tile]++] = index;
+	}
+}
+#else
+static void StartRasterWorkers(void) { }
+static void AllocTileBins(void) { }
+static void FreeTileBins(void)  { }
+static void FlushTriangles(void) { }
+
+static void SubmitTriangle(Triangle* t) {
+	if (rasterStateDirty) UpdateRasterState(&rasterState);
+	rasterStateDirty = false;
+
+	RasterTriangleTiles(t, &rasterState);
+}
+#endif
+
+
+/*########################################################################################################################*
+*------------------------------------------------------Triangle setup-----------------------------------------------------*
+*#########################################################################################################################*/
+static void DrawSprite2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+	Triangle t;
+	int minX = (int)V0->x;
+	int minY = (int)V0->y;
+	int maxX = (int)V1->x;
+	int maxY = (int)V2->y;
+
+	// Reject triangles completely outside
+	if (maxX < 0 || minX > fb_maxX) return;
+	if (maxY < 0 || minY > fb_maxY) return;
+
+	// Perform scissoring
+	t.minX = max(minX, 0); t.maxX = min(maxX, fb_maxX);
+	t.minY = max(minY, 0); t.maxY = min(maxY, fb_maxY);
+
+	t.v[0] = *V0; t.v[1] = *V1; t.v[2] = *V2;
+	t.type = TRI_TYPE_SPRITE2D;
+	SubmitTriangle(&t);
+}
+
+static void DrawTriangle2D(Vertex* V0, Vertex* V1, Vertex* V2) {
+	Triangle t;
+	int x0 = (int)V0->x, y0 = (int)V0->y;
+	int x1 = (int)V1->x, y1 = (int)V1->y;
+	int x2 = (int)V2->x, y2 = (int)V2->y;
+	int minX = min(x0, min(x1, x2));
+	int minY = min(y0, min(y1, y2));
+	int maxX = max(x0, max(x1, x2));
+	int maxY = max(y0, max(y1, y2));
+
+	// Reject triangles completely outside
+	if (maxX < 0 || minX > fb_maxX) return;
+	if (maxY < 0 || minY > fb_maxY) return;
+
+	// Perform scissoring
+	t.minX = max(minX, 0); t.maxX = min(maxX, fb_maxX);
+	t.minY = max(minY, 0); t.maxY = min(maxY, fb_maxY);
+
+	t.v[0] = *V0; t.v[1] = *V1; t.v[2] = *V2;
+	t.type = TRI_TYPE_2D;
+	SubmitTriangle(&t);
+}
+
+/* Selects the mipmap level of the bound texture that is closest to 1 texel per pixel across the triangle */
+static int CalcMipmapLevel(const Vertex* V0, const Vertex* V1, const Vertex* V2, int area) {
+	// NOTE: U/V were premultiplied by 1/W in ViewportVertex3D
+	float u0 = V0->u / V0->w * curTexWidth, v0 = V0->v / V0->w * curTexHeight;
+	float u1 = V1->u / V1->w * curTexWidth, v1 = V1->v / V1->w * curTexHeight;
+	float u2 = V2->u / V2->w * curTexWidth, v2 = V2->v / V2->w * curTexHeight;
+	float ratio;
+	int lvl;
+	if (!area) return 0;
+
+	// Number of texels covered by each pixel of the triangle
+	ratio = Math_AbsF(edgeFunction(u0,v0, u1,v1, u2,v2)) / Math_AbsF((float)area);
+
+	// Each mipmap level has 1/4 the texels of the previous level
+	for (lvl = 0; lvl < curTexture->mipmapLevels && ratio >= 2.0f; lvl++)
+	{
+		ratio *= 0.25f;
+	}
+	return lvl;
+}
+
+static void DrawTriangle3D(Vertex* V0, Vertex* V1, Vertex* V2) {
+	Triangle t;
+	int x0 = (int)V0->x, y0 = (int)V0->y;
+	int x1 = (int)V1->x, y1 = (int)V1->y;
+	int x2 = (int)V2->x, y2 = (int)V2->y;
+	int minX = min(x0, min(x1, x2));
+	int minY = min(y0, min(y1, y2));
+	int maxX = max(x0, max(x1, x2));
+	int maxY = max(y0, max(y1, y2));
+
+	int area = edgeFunction(x0,y0, x1,y1, x2,y2);
+	if (faceCulling) {
+		// https://gamedev.stackexchange.com/questions/203694/how-to-make-backface-culling-work-correctly-in-both-orthographic-and-perspective
+		if (area < 0) return;
+	}
+
+	// Reject triangles completely outside
+	if (maxX < 0 || minX > fb_maxX) return;
+	if (maxY < 0 || minY > fb_maxY) return;
+
+	// Triangles crossing the near plane were already clipped by DrawClipped,
+	//  so this only rejects triangles left behind the camera by float rounding
+	if (V0->w <= 0 || V1->w <= 0 || V2->w <= 0) {
+		return;
+	}
+
+	// Perform scissoring
+	t.minX = max(minX, 0); t.maxX = min(maxX, fb_maxX);
+	t.minY = max(minY, 0); t.maxY = min(maxY, fb_maxY);
+
+	t.v[0] = *V0; t.v[1] = *V1; t.v[2] = *V2;
+	t.type = TRI_TYPE_3D;
+	t.mipmapLevel = 0;
+
+	if (mipmapsEnabled && gfx_format == VERTEX_FORMAT_TEXTURED && curTexture && curTexture->mipmapLevels)
+		t.mipmapLevel = CalcMipmapLevel(V0, V1, V2, area);
+	SubmitTriangle(&t);
+}
+
+/* Lines with coordinates beyond this are rejected, to avoid integer overflow when rasterising */
+#define MAX_LINE_COORD 1e7f
+
+static void DrawLine(Vertex* V0, Vertex* V1) {
+	Triangle t;
+	// 3D lines crossing the near plane were already clipped in Gfx_DrawVb_Lines,
+	//  so this only rejects lines left behind the camera by float rounding
+	if (V0->w <= 0 || V1->w <= 0) return;
+	if (!(Math_AbsF(V0->x) < MAX_LINE_COORD) || !(Math_AbsF(V0->y) < MAX_LINE_COORD)) return;
+	if (!(Math_AbsF(V1->x) < MAX_LINE_COORD) || !(Math_AbsF(V1->y) < MAX_LINE_COORD)) return;
+
+	int x0 = FastFloor(V0->x), y0 = FastFloor(V0->y);
+	int x1 = FastFloor(V1->x), y1 = FastFloor(V1->y);
+	int minX = min(x0, x1), minY = min(y0, y1);
+	int maxX = max(x0, x1), maxY = max(y0, y1);
+
+	// Reject lines completely outside
+	if (maxX < 0 || minX > fb_maxX) return;
+	if (maxY < 0 || minY > fb_maxY) return;
+
+	// Perform scissoring
+	t.minX = max(minX, 0); t.maxX = min(maxX, fb_maxX);
+	t.minY = max(minY, 0); t.maxY = min(maxY, fb_maxY);
+
+	t.v[0] = *V0; t.v[1] = *V1;
+	t.type = TRI_TYPE_LINE;
+	SubmitTriangle(&t);
+}
+
 #define V0_VIS (1 << 0)
 #define V1_VIS (1 << 1)
 #define V2_VIS (1 << 2)
@@ -997,9 +1849,42 @@ void DrawQuads(int startVertex, int verticesCount, DrawHints hints) {
 void Gfx_SetVertexFormat(VertexFormat fmt) {
 	gfx_format = fmt;
 	gfx_stride = strideSizes[fmt];
+	rasterStateDirty = true;
 }
 
-void Gfx_DrawVb_Lines(int verticesCount) { } /* TODO */
+void Gfx_DrawVb_Lines(int verticesCount) {
+	Vertex v0, v1, clipped;
+	int i;
+
+	if (gfx_rendering2D) {
+		// 2D vertices are already in pixel coordinates
+		for (i = 0; i + 1 < verticesCount; i += 2)
+		{
+			TransformVertex2D(i + 0, &v0);
+			TransformVertex2D(i + 1, &v1);
+			v0.z = 0.0f; v0.w = 1.0f;
+			v1.z = 0.0f; v1.w = 1.0f;
+			DrawLine(&v0, &v1);
+		}
+		return;
+	}
+
+	// 2 vertices = 1 line
+	for (i = 0; i + 1 < verticesCount; i += 2)
+	{
+		int vis0 = TransformVertex3D(i + 0, &v0);
+		int vis1 = TransformVertex3D(i + 1, &v1);
+
+		if (!vis0 && !vis1) continue;
+		// Line partially visible, so clip it against the near plane
+		if (!vis0) { ClipLine(&v1, &v0, &clipped); v0 = clipped; }
+		if (!vis1) { ClipLine(&v0, &v1, &clipped); v1 = clipped; }
+
+		ViewportVertex3D(&v0);
+		ViewportVertex3D(&v1);
+		DrawLine(&v0, &v1);
+	}
+}
 
 void Gfx_DrawVb_IndexedTris_Range(int verticesCount, int startVertex, DrawHints hints) {
 	DrawQuads(startVertex, verticesCount, hints);
@@ -1023,6 +1908,7 @@ static BitmapCol* CB_GetRow(struct Bitmap* bmp, int y, void* ctx) {
 
 cc_result Gfx_TakeScreenshot(struct Stream* output) {
 	struct Bitmap bmp;
+	FlushTriangles();
 	Bitmap_Init(bmp, fb_width, fb_height, NULL);
 	return Png_Encode(&bmp, output, CB_GetRow, false, NULL);
 }
@@ -1034,6 +1920,7 @@ void Gfx_BeginFrame(void) { }
 
 void Gfx_EndFrame(void) {
 	Rect2D r = { 0, 0, fb_width, fb_height };
+	FlushTriangles();
 	Window_DrawFramebuffer(r, &fb_bmp);
 }
 
@@ -1053,6 +1940,7 @@ void Gfx_OnWindowResize(int width, int height) {
 
 	depthBuffer = Mem_Alloc(width * height, 4, "depth buffer");
 	db_stride   = width;
+	AllocTileBins();
 
 	Gfx_SetViewport(0, 0, width, height);
 	Gfx_SetScissor (0, 0, width, height);
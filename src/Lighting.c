@@ -1,4 +1,9 @@
 #include "Lighting.h"
+#if defined CC_BUILD_SSE2
+#include <emmintrin.h>
+#elif defined CC_BUILD_NEON
+#include <arm_neon.h>
+#endif
 #include "Block.h"
 #include "Funcs.h"
 #include "MapRenderer.h"
@@ -35,6 +40,8 @@ void Lighting_SetMode(cc_uint8 mode, cc_bool fromServer) {
 *#########################################################################################################################*/
 static cc_int16* classic_heightmap;
 #define HEIGHT_UNCALCULATED Int16_MaxValue
+/* Whether light heights of all the columns in each chunk column have been calculated */
+static cc_uint8* classic_chunksDone;
 
 #define ClassicLighting_CalcBody(get_block)\
 for (y = maxY; y >= 0; y--, i -= World.OneY) {\
@@ -53,12 +60,12 @@ static int ClassicLighting_CalcHeightAt(int x, int maxY, int z, int hIndex) {
 	int y, offset;
 
 #ifndef EXTENDED_BLOCKS
-	ClassicLighting_CalcBody(World.Blocks[i]);
+	ClassicLighting_CalcBody(World_GetLowerBlock(i));
 #else
 	if (World.IDMask <= 0xFF) {
-		ClassicLighting_CalcBody(World.Blocks[i]);
+		ClassicLighting_CalcBody(World_GetLowerBlock(i));
 	} else {
-		ClassicLighting_CalcBody(World.Blocks[i] | (World.Blocks2[i] << 8));
+		ClassicLighting_CalcBody(World_GetLowerBlock(i) | (World_GetUpperBlock(i) << 8));
 	}
 #endif
 
@@ -72,6 +79,10 @@ int ClassicLighting_GetLightHeight(int x, int z) {
 	return lightH == HEIGHT_UNCALCULATED ? ClassicLighting_CalcHeightAt(x, World.Height - 1, z, hIndex) : lightH;
 }
 
+cc_bool ClassicLighting_HasLightHeight(int x, int z) {
+	return classic_heightmap[Lighting_Pack(x, z)] != HEIGHT_UNCALCULATED;
+}
+
 /* Outside color is same as sunlight color, so we reuse when possible */
 cc_bool ClassicLighting_IsLit(int x, int y, int z) {
 	return y > ClassicLighting_GetLightHeight(x, z);
@@ -122,24 +133,35 @@ void ClassicLighting_Refresh(void) {
 	for (i = 0; i < World.Width * World.Length; i++) {
 		classic_heightmap[i] = HEIGHT_UNCALCULATED;
 	}
+	if (classic_chunksDone) Mem_Set(classic_chunksDone, 0, World.ChunksX * World.ChunksZ);
 }
 
 
 /*########################################################################################################################*
 *----------------------------------------------------Lighting update------------------------------------------------------*
 *#########################################################################################################################*/
-static void ClassicLighting_UpdateLighting(int x, int y, int z, BlockID oldBlock, BlockID newBlock, int index, int lightH) {
+/* Whether changing a block from oldBlock to newBlock might change the light height of its column */
+static cc_bool ClassicLighting_AffectsHeight(BlockID oldBlock, BlockID newBlock) {
 	cc_bool didBlock  = Blocks.BlocksLight[oldBlock];
 	cc_bool nowBlocks = Blocks.BlocksLight[newBlock];
 	int oldOffset     = (Blocks.LightOffset[oldBlock] >> LIGHT_FLAG_SHADES_FROM_BELOW) & 1;
 	int newOffset     = (Blocks.LightOffset[newBlock] >> LIGHT_FLAG_SHADES_FROM_BELOW) & 1;
-	BlockID above;
 
-	/* Two cases we need to handle here: */
+	/* Two cases where light height is unaffected: */
 	if (didBlock == nowBlocks) {
-		if (!didBlock) return;              /* a) both old and new block do not block light */
-		if (oldOffset == newOffset) return; /* b) both blocks blocked light at the same Y coordinate */
+		if (!didBlock) return false;              /* a) both old and new block do not block light */
+		if (oldOffset == newOffset) return false; /* b) both blocks blocked light at the same Y coordinate */
 	}
+	return true;
+}
+
+static void ClassicLighting_UpdateLighting(int x, int y, int z, BlockID oldBlock, BlockID newBlock, int index, int lightH) {
+	cc_bool nowBlocks = Blocks.BlocksLight[newBlock];
+	int oldOffset     = (Blocks.LightOffset[oldBlock] >> LIGHT_FLAG_SHADES_FROM_BELOW) & 1;
+	int newOffset     = (Blocks.LightOffset[newBlock] >> LIGHT_FLAG_SHADES_FROM_BELOW) & 1;
+	BlockID above;
+
+	if (!ClassicLighting_AffectsHeight(oldBlock, newBlock)) return;
 
 	if ((y - newOffset) >= lightH) {
 		if (nowBlocks) {
@@ -180,12 +202,12 @@ static cc_bool ClassicLighting_NeedsNeighour(BlockID block, int i, int minY, int
 	cc_bool affected;
 
 #ifndef EXTENDED_BLOCKS
-	ClassicLighting_NeedsNeighourBody(World.Blocks[i]);
+	ClassicLighting_NeedsNeighourBody(World_GetLowerBlock(i));
 #else
 	if (World.IDMask <= 0xFF) {
-		ClassicLighting_NeedsNeighourBody(World.Blocks[i]);
+		ClassicLighting_NeedsNeighourBody(World_GetLowerBlock(i));
 	} else {
-		ClassicLighting_NeedsNeighourBody(World.Blocks[i] | (World.Blocks2[i] << 8));
+		ClassicLighting_NeedsNeighourBody(World_GetLowerBlock(i) | (World_GetUpperBlock(i) << 8));
 	}
 #endif
 	return false;
@@ -194,8 +216,10 @@ static cc_bool ClassicLighting_NeedsNeighour(BlockID block, int i, int minY, int
 static void ClassicLighting_ResetNeighbour(int x, int y, int z, BlockID block, int cx, int cy, int cz, int minCy, int maxCy) {
 	int minY, maxY;
 
+	/* NOTE: Chunks already pending being rebuilt don't need to be checked */
 	if (minCy == maxCy) {
 		minY = cy << CHUNK_SHIFT;
+		if (MapRenderer_IsChunkDirty(cx, cy, cz)) return;
 
 		if (ClassicLighting_NeedsNeighour(block, World_Pack(x, y, z), minY, y, y)) {
 			MapRenderer_RefreshChunk(cx, cy, cz);
@@ -205,6 +229,7 @@ static void ClassicLighting_ResetNeighbour(int x, int y, int z, BlockID block, i
 			minY = (cy << CHUNK_SHIFT); 
 			maxY = (cy << CHUNK_SHIFT) + CHUNK_MAX;
 			if (maxY > World.MaxY) maxY = World.MaxY;
+			if (MapRenderer_IsChunkDirty(cx, cy, cz)) continue;
 
 			if (ClassicLighting_NeedsNeighour(block, World_Pack(x, maxY, z), minY, maxY, y)) {
 				MapRenderer_RefreshChunk(cx, cy, cz);
@@ -223,17 +248,11 @@ static void ClassicLighting_ResetColumn(int cx, int cy, int cz, int minCy, int m
 	}
 }
 
-static void ClassicLighting_RefreshAffected(int x, int y, int z, BlockID block, int oldHeight, int newHeight) {
+static void ClassicLighting_RefreshNeighbours(int x, int y, int z, BlockID block, int minCy, int maxCy) {
 	int cx = x >> CHUNK_SHIFT, bX = x & CHUNK_MASK;
 	int cy = y >> CHUNK_SHIFT, bY = y & CHUNK_MASK;
 	int cz = z >> CHUNK_SHIFT, bZ = z & CHUNK_MASK;
 
-	/* NOTE: much faster to only update the chunks that are affected by the change in shadows, rather than the entire column. */
-	int newCy = newHeight < 0 ? 0 : newHeight >> 4;
-	int oldCy = oldHeight < 0 ? 0 : oldHeight >> 4;
-	int minCy = min(oldCy, newCy), maxCy = max(oldCy, newCy);
-	ClassicLighting_ResetColumn(cx, cy, cz, minCy, maxCy);
-
 	if (bX == 0 && cx > 0) {
 		ClassicLighting_ResetNeighbour(x - 1, y, z, block, cx - 1, cy, cz, minCy, maxCy);
 	}
@@ -255,6 +274,16 @@ static void ClassicLighting_RefreshAffected(int x, int y, int z, BlockID block,
 	}
 }
 
+static void ClassicLighting_RefreshAffected(int x, int y, int z, BlockID block, int oldHeight, int newHeight) {
+	/* NOTE: much faster to only update the chunks that are affected by the change in shadows, rather than the entire column. */
+	int newCy = newHeight < 0 ? 0 : newHeight >> 4;
+	int oldCy = oldHeight < 0 ? 0 : oldHeight >> 4;
+	int minCy = min(oldCy, newCy), maxCy = max(oldCy, newCy);
+
+	ClassicLighting_ResetColumn(x >> CHUNK_SHIFT, y >> CHUNK_SHIFT, z >> CHUNK_SHIFT, minCy, maxCy);
+	ClassicLighting_RefreshNeighbours(x, y, z, block, minCy, maxCy);
+}
+
 void ClassicLighting_OnBlockChanged(int x, int y, int z, BlockID oldBlock, BlockID newBlock) {
 	int hIndex = Lighting_Pack(x, z);
 	int lightH = classic_heightmap[hIndex];
@@ -270,9 +299,149 @@ void ClassicLighting_OnBlockChanged(int x, int y, int z, BlockID oldBlock, Block
 }
 
 
+/*########################################################################################################################*
+*--------------------------------------------------Batched block changes--------------------------------------------------*
+*#########################################################################################################################*/
+/* Highest changed Y in each column whose light height needs updating while a block batch is being applied */
+/*  (HEIGHT_UNCALCULATED for all other columns) */
+static cc_int16* classic_batch;
+
+/* Refreshes chunks in a neighbouring column that have blocks whose lighting may have changed */
+static void ClassicLighting_ResetNeighbourColumn(int x, int z, int minCy, int maxCy) {
+	int cy, minY, maxY;
+	if (x < 0 || z < 0 || x >= World.Width || z >= World.Length) return;
+
+	for (cy = maxCy; cy >= minCy; cy--) {
+		minY = (cy << CHUNK_SHIFT); 
+		maxY = (cy << CHUNK_SHIFT) + CHUNK_MAX;
+		if (maxY > World.MaxY) maxY = World.MaxY;
+		if (MapRenderer_IsChunkDirty(x >> CHUNK_SHIFT, cy, z >> CHUNK_SHIFT)) continue;
+
+		if (ClassicLighting_NeedsNeighour(BLOCK_AIR, World_Pack(x, maxY, z), minY, maxY, -1)) {
+			MapRenderer_RefreshChunk(x >> CHUNK_SHIFT, cy, z >> CHUNK_SHIFT);
+		}
+	}
+}
+
+static void ClassicLighting_UpdateColumn(int x, int topY, int z, int hIndex) {
+	int cx = x >> CHUNK_SHIFT, bX = x & CHUNK_MASK;
+	int cz = z >> CHUNK_SHIFT, bZ = z & CHUNK_MASK;
+	int oldHeight = classic_heightmap[hIndex];
+	int newHeight, oldCy, newCy, minCy, maxCy;
+
+	/* Blocks above the highest changed block are unchanged, so light height only */
+	/*  changes when the block it is currently from is at or below the highest changed block */
+	if (oldHeight > topY) return;
+
+	/* Block just above highest changed block might shade from below, and so have light height of topY */
+	newHeight = ClassicLighting_CalcHeightAt(x, min(topY + 1, World.MaxY), z, hIndex);
+	if (newHeight == oldHeight) return;
+
+	newCy = newHeight < -1 ? 0 : (newHeight + 1) >> 4;
+	oldCy = oldHeight < -1 ? 0 : (oldHeight + 1) >> 4;
+	minCy = min(oldCy, newCy); maxCy = max(oldCy, newCy);
+	ClassicLighting_ResetColumn(cx, minCy, cz, minCy, maxCy);
+
+	if (bX == 0)         ClassicLighting_ResetNeighbourColumn(x - 1, z, minCy, maxCy);
+	if (bX == CHUNK_MAX) ClassicLighting_ResetNeighbourColumn(x + 1, z, minCy, maxCy);
+	if (bZ == 0)         ClassicLighting_ResetNeighbourColumn(x, z - 1, minCy, maxCy);
+	if (bZ == CHUNK_MAX) ClassicLighting_ResetNeighbourColumn(x, z + 1, minCy, maxCy);
+}
+
+static void ClassicLighting_OnBlocksChanged(const struct BlockChange* changes, int count) {
+	const struct BlockChange* c;
+	int i, hIndex, topY, cy;
+
+	if (!classic_batch) {
+		classic_batch = (cc_int16*)Mem_TryAlloc(World.Width * World.Length, 2);
+		if (!classic_batch) { World_OutOfMemory(); return; }
+
+		for (i = 0; i < World.Width * World.Length; i++) {
+			classic_batch[i] = HEIGHT_UNCALCULATED;
+		}
+	}
+
+	/* Find the highest block in each column whose change might affect light height */
+	for (i = 0, c = changes; i < count; i++, c++) 
+	{
+		if (!ClassicLighting_AffectsHeight(c->oldBlock, c->newBlock)) continue;
+		hIndex = Lighting_Pack(c->x, c->z);
+		/* Since light wasn't checked to begin with, means column never had meshes for any of its chunks built. */
+		if (classic_heightmap[hIndex] == HEIGHT_UNCALCULATED) continue;
+
+		topY = classic_batch[hIndex];
+		if (topY == HEIGHT_UNCALCULATED || c->y > topY) classic_batch[hIndex] = c->y;
+	}
+
+	for (i = 0, c = changes; i < count; i++, c++) 
+	{
+		hIndex = Lighting_Pack(c->x, c->z);
+		if (classic_heightmap[hIndex] == HEIGHT_UNCALCULATED) continue;
+		topY = classic_batch[hIndex];
+
+		/* Light height of each column only needs to be updated once */
+		if (topY != HEIGHT_UNCALCULATED) {
+			ClassicLighting_UpdateColumn(c->x, topY, c->z, hIndex);
+			classic_batch[hIndex] = HEIGHT_UNCALCULATED;
+		}
+
+		cy = c->y >> CHUNK_SHIFT;
+		ClassicLighting_RefreshNeighbours(c->x, c->y, c->z, c->newBlock, cy, cy);
+	}
+}
+
+
 /*########################################################################################################################*
 *---------------------------------------------------Lighting heightmap----------------------------------------------------*
 *#########################################################################################################################*/
+/* Returns whether the given row of blocks consists entirely of air */
+#if defined CC_BUILD_SSE2
+static cc_bool Heightmap_IsAirRow(const BlockRaw* row, int count) {
+	__m128i blocks;
+	int i;
+	if (count < 16) {
+		for (i = 0; i < count; i++) { if (row[i]) return false; }
+		return true;
+	}
+
+	/* Rows are at most EXTCHUNK_SIZE long, so two overlapping 16 block loads cover the entire row */
+	blocks = _mm_or_si128(_mm_loadu_si128((const __m128i*)row), 
+						  _mm_loadu_si128((const __m128i*)(row + count - 16)));
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(blocks, _mm_setzero_si128())) == 0xFFFF;
+}
+#elif defined CC_BUILD_NEON
+static cc_bool Heightmap_IsAirRow(const BlockRaw* row, int count) {
+	uint8x16_t blocks;
+	int i;
+	if (count < 16) {
+		for (i = 0; i < count; i++) { if (row[i]) return false; }
+		return true;
+	}
+
+	/* Rows are at most EXTCHUNK_SIZE long, so two overlapping 16 block loads cover the entire row */
+	blocks = vorrq_u8(vld1q_u8(row), vld1q_u8(row + count - 16));
+	return vmaxvq_u8(blocks) == 0;
+}
+#else
+static cc_bool Heightmap_IsAirRow(const BlockRaw* row, int count) {
+	BlockRaw any = 0;
+	int i;
+	for (i = 0; i < count; i++) { any |= row[i]; }
+	return any == 0;
+}
+#endif
+
+#ifdef CC_BUILD_COMPRESSEDWORLD
+static cc_bool Heightmap_IsAirSections(const struct WorldSection* sections, int index, int count) {
+	BlockRaw row[EXTCHUNK_SIZE];
+	WorldSections_Read(sections, index, row, count);
+	return Heightmap_IsAirRow(row, count);
+}
+#define Heightmap_IsAirBlocks(blocks, index, count) Heightmap_IsAirSections(blocks, index, count)
+#else
+#define Heightmap_IsAirBlocks(blocks, index, count) Heightmap_IsAirRow(blocks + index, count)
+#endif
+
 static int Heightmap_InitialCoverage(int x1, int z1, int xCount, int zCount, int* skip) {
 	int elemsLeft = 0, index = 0, curRunCount = 0;
 	int x, z, hIndex, lightH;
@@ -297,7 +466,7 @@ static int Heightmap_InitialCoverage(int x1, int z1, int xCount, int zCount, int
 	return elemsLeft;
 }
 
-#define Heightmap_CalculateBody(get_block)\
+#define Heightmap_CalculateBody(get_block, is_air_row)\
 for (y = World.Height - 1; y >= 0; y--) {\
 	if (elemsLeft <= 0) { return true; } \
 	mapIndex = World_Pack(x1, y, z1);\
@@ -306,7 +475,10 @@ for (y = World.Height - 1; y >= 0; y--) {\
 	for (z = 0; z < zCount; z++) {\
 		baseIndex = mapIndex;\
 		index = z * xCount;\
-		for (x = 0; x < xCount;) {\
+		/* Most rows above the terrain are only air, which can be skipped over in bulk */ \
+		x = (skipAir && is_air_row) ? xCount : 0;\
+\
+		for (; x < xCount;) {\
 			curRunCount = skip[index];\
 			x += curRunCount; mapIndex += curRunCount; index += curRunCount;\
 \
@@ -345,14 +517,18 @@ static cc_bool Heightmap_CalculateCoverage(int x1, int z1, int xCount, int zCoun
 	int lightOffset, offset;
 	int mapIndex, hIndex, baseIndex, index;
 	int x, y, z;
+	cc_bool skipAir = !Blocks.BlocksLight[BLOCK_AIR];
 
 #ifndef EXTENDED_BLOCKS
-	Heightmap_CalculateBody(World.Blocks[mapIndex]);
+	Heightmap_CalculateBody(World_GetLowerBlock(mapIndex),
+							Heightmap_IsAirBlocks(World.Blocks, mapIndex, xCount));
 #else
 	if (World.IDMask <= 0xFF) {
-		Heightmap_CalculateBody(World.Blocks[mapIndex]);
+		Heightmap_CalculateBody(World_GetLowerBlock(mapIndex),
+								Heightmap_IsAirBlocks(World.Blocks, mapIndex, xCount));
 	} else {
-		Heightmap_CalculateBody(World.Blocks[mapIndex] | (World.Blocks2[mapIndex] << 8));
+		Heightmap_CalculateBody(World_GetLowerBlock(mapIndex) | (World_GetUpperBlock(mapIndex) << 8),
+								Heightmap_IsAirBlocks(World.Blocks, mapIndex, xCount) && Heightmap_IsAirBlocks(World.Blocks2, mapIndex, xCount));
 	}
 #endif
 	return false;
@@ -374,26 +550,62 @@ static void Heightmap_FinishCoverage(int x1, int z1, int xCount, int zCount) {
 }
 
 
+/* Returns whether light heights of all columns in the given chunk columns have been calculated */
+static cc_bool Heightmap_ChunksDone(int cx1, int cz1, int cx2, int cz2) {
+	int cx, cz;
+	for (cz = cz1; cz <= cz2; cz++) 
+	{
+		for (cx = cx1; cx <= cx2; cx++) 
+		{
+			if (!classic_chunksDone[cx + cz * World.ChunksX]) return false;
+		}
+	}
+	return true;
+}
+
 void ClassicLighting_LightHint(int startX, int startY, int startZ) {
 	int x1 = max(startX, 0), x2 = min(World.Width,  startX + EXTCHUNK_SIZE);
 	int z1 = max(startZ, 0), z2 = min(World.Length, startZ + EXTCHUNK_SIZE);
 	int xCount = x2 - x1, zCount = z2 - z1;
 	int skip[EXTCHUNK_SIZE * EXTCHUNK_SIZE];
+	int elemsLeft, cx, cz;
+
+	/* Every chunk in a chunk column hints the same columns, so usually nothing is left to calculate */
+	if (Heightmap_ChunksDone(x1 >> CHUNK_SHIFT, z1 >> CHUNK_SHIFT, 
+							(x2 - 1) >> CHUNK_SHIFT, (z2 - 1) >> CHUNK_SHIFT)) return;
 
-	int elemsLeft = Heightmap_InitialCoverage(x1, z1, xCount, zCount, skip);
+	elemsLeft = Heightmap_InitialCoverage(x1, z1, xCount, zCount, skip);
 	if (!Heightmap_CalculateCoverage(x1, z1, xCount, zCount, elemsLeft, skip)) {
 		Heightmap_FinishCoverage(x1, z1, xCount, zCount);
 	}
+
+	/* Mark chunk columns that lie entirely within the calculated area as done */
+	for (cz = (z1 + CHUNK_MAX) >> CHUNK_SHIFT; (cz << CHUNK_SHIFT) < z2; cz++) 
+	{
+		if (min((cz + 1) << CHUNK_SHIFT, World.Length) > z2) break;
+
+		for (cx = (x1 + CHUNK_MAX) >> CHUNK_SHIFT; (cx << CHUNK_SHIFT) < x2; cx++) 
+		{
+			if (min((cx + 1) << CHUNK_SHIFT, World.Width) > x2) break;
+			classic_chunksDone[cx + cz * World.ChunksX] = true;
+		}
+	}
 }
 
 void ClassicLighting_FreeState(void) {
 	Mem_Free(classic_heightmap);
 	classic_heightmap = NULL;
+	Mem_Free(classic_batch);
+	classic_batch = NULL;
+	Mem_Free(classic_chunksDone);
+	classic_chunksDone = NULL;
 }
 
 void ClassicLighting_AllocState(void) {
-	classic_heightmap = (cc_int16*)Mem_TryAlloc(World.Width * World.Length, 2);
-	if (classic_heightmap) {
+	classic_heightmap  = (cc_int16*)Mem_TryAlloc(World.Width * World.Length, 2);
+	classic_chunksDone = (cc_uint8*)Mem_TryAlloc(World.ChunksX * World.ChunksZ, 1);
+
+	if (classic_heightmap && classic_chunksDone) {
 		ClassicLighting_Refresh();
 	} else {
 		World_OutOfMemory();
@@ -420,6 +632,7 @@ static void ClassicLighting_SetActive(void) {
 	Lighting.FreeState  = ClassicLighting_FreeState;
 	Lighting.AllocState = ClassicLighting_AllocState;
 	Lighting.LightHint  = ClassicLighting_LightHint;
+	Lighting.OnBlocksChanged = ClassicLighting_OnBlocksChanged;
 }
 
 
@@ -463,7 +676,11 @@ static void OnInit(void) {
 
 	Event_Register_(&WorldEvents.LightingModeChanged, NULL, Lighting_HandleModeChanged);
 }
-static void OnReset(void)        { Lighting.FreeState(); }
+static void OnReset(void) {
+	/* Chunk builder worker threads may still be reading lighting state */
+	Builder_CancelChunks();
+	Lighting.FreeState();
+}
 static void OnNewMapLoaded(void) { Lighting.AllocState(); }
 
 struct IGameComponent Lighting_Component = {
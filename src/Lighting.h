@@ -11,6 +11,7 @@ Abstracts lighting of blocks in the world
 Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 */
 struct IGameComponent;
+struct BlockChange;
 extern struct IGameComponent Lighting_Component;
 
 enum LightingMode {
@@ -72,6 +73,11 @@ CC_VAR extern struct _Lighting {
 	PackedCol (*Color_YMin_Fast)(int x, int y, int z);
 	PackedCol (*Color_XSide_Fast)(int x, int y, int z);
 	PackedCol (*Color_ZSide_Fast)(int x, int y, int z);
+
+	/* Called when a block batch ends, to update internal lighting state for all the blocks changed in it. */
+	/* (see Game_BeginBlockBatch) If NULL, OnBlockChanged is instead called as each block is changed. */
+	/* NOTE: Implementations ***MUST*** mark all chunks affected by this lighting change as needing to be refreshed. */
+	void (*OnBlocksChanged)(const struct BlockChange* changes, int count);
 } Lighting;
 
 void FancyLighting_SetActive(void);
@@ -82,6 +88,7 @@ void ClassicLighting_Refresh(void);
 void ClassicLighting_FreeState(void);
 void ClassicLighting_AllocState(void);
 int ClassicLighting_GetLightHeight(int x, int z);
+cc_bool ClassicLighting_HasLightHeight(int x, int z);
 void ClassicLighting_LightHint(int startX, int startY, int startZ);
 cc_bool ClassicLighting_IsLit(int x, int y, int z);
 cc_bool ClassicLighting_IsLit_Fast(int x, int y, int z);
@@ -44,6 +44,12 @@ static int renderChunksCount;
 static cc_uint32* distances;
 /* Maximum number of chunk updates that can be performed in one frame. */
 static int maxChunkUpdates;
+/* Whether chunks hidden behind other chunks are culled. */
+static cc_bool occlusionCulling;
+/* Whether chunk occlusion needs to be recalculated, as which faces of a chunk can see each other changed. */
+static cc_bool occlusionDirty;
+/* Indices of chunks to flood fill outwards from when calculating chunk occlusion. */
+static int* occlusionQueue;
 /* Cached number of chunks in the world */
 static int chunksCount;
 
@@ -60,6 +66,9 @@ static void ChunkInfo_Init(struct ChunkInfo* chunk, int x, int y, int z) {
 	chunk->noData   = true;
 	chunk->dirty    = true;
 	chunk->skipClip = false;
+	chunk->occluded = false;
+	chunk->connectedFaces = CHUNK_ALL_FACES_CONNECTED;
+	chunk->building = false;
 
 	chunk->drawXMin = false; chunk->drawXMax = false; chunk->drawZMin = false;
 	chunk->drawZMax = false; chunk->drawYMin = false; chunk->drawYMax = false;
@@ -222,9 +231,6 @@ void MapRenderer_RenderNormal(float delta) {
 
 	CheckWeather(delta);
 	Gfx_SetAlphaTest(false);
-#if DEBUG_OCCLUSION
-	DebugPickedPos();
-#endif
 }
 
 #define DrawTranslucentFaces(minFace, maxFace) \
@@ -340,11 +346,6 @@ static void DeleteChunk(struct ChunkInfo* chunk) {
 	chunk->noData = true;
 	chunk->dirty  = true;
 
-#ifdef OCCLUSION
-	chunk.OcclusionFlags = 0;
-	chunk.OccludedFlags = 0;
-#endif
-
 	if (chunk->normalParts) {
 		ptr = chunk->normalParts;
 		for (i = 0; i < MapRenderer_1DUsedCount; i++, ptr += chunksCount) {
@@ -370,15 +371,11 @@ static void DeleteChunk(struct ChunkInfo* chunk) {
 	}
 }
 
-/* Builds the mesh (hence vertex buffer) for the given chunk, and updates internal state */
-static void BuildChunk(struct ChunkInfo* chunk, int* chunkUpdates) {
+/* Updates internal state after the mesh (hence vertex buffer) for the given chunk has been built */
+static void OnChunkBuilt(struct ChunkInfo* chunk) {
 	struct ChunkPartInfo* ptr;
 	int i;
 
-	Game.ChunkUpdates++;
-	(*chunkUpdates)++;
-	if (!Builder_MakeChunk(chunk)) return;
-
 	chunk->dirty  = false;
 	chunk->noData = !chunk->normalParts && !chunk->translucentParts;
 	chunk->empty  = chunk->noData;
@@ -399,6 +396,58 @@ static void BuildChunk(struct ChunkInfo* chunk, int* chunkUpdates) {
 	}
 }
 
+/* Maximum number of chunks that can be built/queued in the current frame */
+static int buildTarget;
+/* Builds the mesh (hence vertex buffer) for the given chunk, and updates internal state */
+static void BuildChunk(struct ChunkInfo* chunk, int* chunkUpdates) {
+	cc_uint16 connected;
+	if (Builder_WorkersCount()) {
+		/* Stop queueing chunks for this frame when worker threads are too far behind */
+		if (!Builder_QueueChunk(chunk)) { *chunkUpdates = buildTarget; return; }
+
+		/* Existing mesh is still rendered until the new mesh has been uploaded */
+		chunk->dirty    = false;
+		chunk->building = true;
+	} else {
+		connected = chunk->connectedFaces;
+		DeleteChunk(chunk);
+		if (Builder_MakeChunk(chunk)) OnChunkBuilt(chunk);
+		occlusionDirty |= chunk->connectedFaces != connected;
+	}
+
+	Game.ChunkUpdates++;
+	(*chunkUpdates)++;
+}
+
+/* Uploads the meshes of chunks that have finished being built on worker threads */
+static int UploadBuiltChunks(void) {
+	struct ChunkInfo* chunk;
+	cc_uint16 connected;
+	cc_bool dirty;
+	int uploaded = 0;
+
+	while ((chunk = Builder_NextBuiltChunk())) 
+	{
+		/* Chunk may have been changed again while its mesh was being built */
+		dirty = chunk->dirty;
+		chunk->building = false;
+		connected = chunk->connectedFaces;
+
+		DeleteChunk(chunk);
+		if (Builder_UploadChunk(chunk)) {
+			OnChunkBuilt(chunk);
+		} else {
+			/* Out of GPU memory, so try building the chunk again later */
+			chunk->dirty = true;
+		}
+
+		chunk->dirty   |= dirty;
+		occlusionDirty |= chunk->connectedFaces != connected;
+		uploaded++;
+	}
+	return uploaded;
+}
+
 
 /*########################################################################################################################*
 *----------------------------------------------------Chunks mangagement---------------------------------------------------*
@@ -414,11 +463,13 @@ static void FreeChunks(void) {
 	Mem_Free(sortedChunks);
 	Mem_Free(renderChunks);
 	Mem_Free(distances);
+	Mem_Free(occlusionQueue);
 
 	mapChunks    = NULL;
 	sortedChunks = NULL;
 	renderChunks = NULL;
 	distances    = NULL;
+	occlusionQueue = NULL;
 }
 
 static void AllocateParts(void) {
@@ -435,6 +486,7 @@ static void AllocateChunks(void) {
 	sortedChunks = (struct ChunkInfo**)Mem_Alloc(chunksCount, sizeof(struct ChunkInfo*), "sorted chunk info");
 	renderChunks = (struct ChunkInfo**)Mem_Alloc(chunksCount, sizeof(struct ChunkInfo*), "render chunk info");
 	distances    = (cc_uint32*)Mem_Alloc(chunksCount, 4, "chunk distances");
+	occlusionQueue = (int*)Mem_Alloc(chunksCount, 4, "chunk occlusion queue");
 }
 
 static void ResetPartFlags(void) {
@@ -483,6 +535,7 @@ static void RefreshChunks(void) {
 static void DeleteChunks(void) {
 	int i;
 	if (!mapChunks) return;
+	Builder_CancelChunks();
 
 	for (i = 0; i < chunksCount; i++) 
 	{
@@ -531,6 +584,134 @@ static void RefreshBorderChunks(int maxHeight) {
 }
 
 
+/*########################################################################################################################*
+*----------------------------------------------------Occlusion culling----------------------------------------------------*
+*#########################################################################################################################*/
+/* Chunks are culled by flood filling outwards from the chunk the camera is in. The flood fill only moves from */
+/*  a chunk into a neighbouring chunk when the face it entered the chunk through can see the face leading into */
+/*  the neighbouring chunk, and never moves in the opposite direction to a direction it has already moved in. */
+/* Chunks that are never reached by the flood fill can't be seen from the camera, and so aren't rendered. */
+#define OCCLUSION_FACE_CAMERA 0x40 /* Flood fill started in this chunk */
+#define OCCLUSION_PROCESSED   0x80 /* Flood fill has already moved outwards from this chunk */
+
+static cc_bool CanSeeFaces(int connected, int face1, int face2) {
+	if (face1 > face2) { int tmp = face1; face1 = face2; face2 = tmp; }
+	return (connected & ChunkInfo_FacesBit(face1, face2)) != 0;
+}
+
+static void Occlusion_Enter(int cx, int cy, int cz, int faces, int dirs, int renderDistSqr, int* count) {
+	struct ChunkInfo* chunk;
+	int index, dx, dy, dz;
+
+	index = World_ChunkPack(cx, cy, cz);
+	chunk = &mapChunks[index];
+	if (chunk->occlusionFaces & OCCLUSION_PROCESSED) return;
+
+	if (chunk->occluded) {
+		/* Chunks past render distance aren't drawn anyways */
+		dx = chunk->centreX - chunkPos.x; dy = chunk->centreY - chunkPos.y; dz = chunk->centreZ - chunkPos.z;
+		if (dx * dx + dy * dy + dz * dz > renderDistSqr) return;
+
+		chunk->occluded      = false;
+		chunk->occlusionDirs = dirs;
+		occlusionQueue[(*count)++] = index;
+	} else {
+		/* Chunk has been reached through multiple faces, and hasn't been flood filled outwards from yet */
+		chunk->occlusionDirs &= dirs;
+	}
+	chunk->occlusionFaces |= faces;
+}
+
+/* Flood fills outwards into all chunks on the given face of the world */
+static void Occlusion_EnterWorldFace(int face, int renderDistSqr, int* count) {
+	int x, y, z, x1 = 0, y1 = 0, z1 = 0;
+	int x2 = World.ChunksX - 1, y2 = World.ChunksY - 1, z2 = World.ChunksZ - 1;
+
+	switch (face) {
+	case FACE_XMIN: x2 = x1; break;
+	case FACE_XMAX: x1 = x2; break;
+	case FACE_ZMIN: z2 = z1; break;
+	case FACE_ZMAX: z1 = z2; break;
+	case FACE_YMIN: y2 = y1; break;
+	case FACE_YMAX: y1 = y2; break;
+	}
+
+	for (z = z1; z <= z2; z++) 
+		for (y = y1; y <= y2; y++) 
+			for (x = x1; x <= x2; x++)
+			{
+				/* e.g. entering the world through its minimum X face means moving in positive X direction */
+				Occlusion_Enter(x, y, z, 1 << face, 1 << (face ^ 1), renderDistSqr, count);
+			}
+}
+
+static void CalcOcclusion(int renderDistSqr) {
+	static const IVec3 offsets[FACE_COUNT] = { { -1,0,0 }, { 1,0,0 }, { 0,0,-1 }, { 0,0,1 }, { 0,-1,0 }, { 0,1,0 } };
+	struct ChunkInfo* chunk;
+	int i, count = 0, face, entry, exits;
+	int cx, cy, cz, nx, ny, nz;
+
+	occlusionDirty = false;
+	if (!mapChunks) return;
+
+	for (i = 0; i < chunksCount; i++) 
+	{
+		mapChunks[i].occluded       = occlusionCulling;
+		mapChunks[i].occlusionFaces = 0;
+	}
+	if (!occlusionCulling) return;
+
+	cx = chunkPos.x >> CHUNK_SHIFT; cy = chunkPos.y >> CHUNK_SHIFT; cz = chunkPos.z >> CHUNK_SHIFT;
+	if (cx >= 0 && cy >= 0 && cz >= 0 && cx < World.ChunksX && cy < World.ChunksY && cz < World.ChunksZ) {
+		Occlusion_Enter(cx, cy, cz, OCCLUSION_FACE_CAMERA, 0, renderDistSqr, &count);
+	} else {
+		/* Camera is outside the world, so start from the faces of the world facing the camera */
+		if (cx < 0)               Occlusion_EnterWorldFace(FACE_XMIN, renderDistSqr, &count);
+		if (cx >= World.ChunksX)  Occlusion_EnterWorldFace(FACE_XMAX, renderDistSqr, &count);
+		if (cz < 0)               Occlusion_EnterWorldFace(FACE_ZMIN, renderDistSqr, &count);
+		if (cz >= World.ChunksZ)  Occlusion_EnterWorldFace(FACE_ZMAX, renderDistSqr, &count);
+		if (cy < 0)               Occlusion_EnterWorldFace(FACE_YMIN, renderDistSqr, &count);
+		if (cy >= World.ChunksY)  Occlusion_EnterWorldFace(FACE_YMAX, renderDistSqr, &count);
+	}
+
+	/* NOTE: count increases as more chunks are reached */
+	for (i = 0; i < count; i++) 
+	{
+		chunk = &mapChunks[occlusionQueue[i]];
+		chunk->occlusionFaces |= OCCLUSION_PROCESSED;
+
+		/* Determine which faces can be seen from the faces the flood fill entered the chunk through */
+		if (chunk->occlusionFaces & OCCLUSION_FACE_CAMERA) {
+			exits = (1 << FACE_COUNT) - 1;
+		} else {
+			exits = 0;
+			for (entry = 0; entry < FACE_COUNT; entry++) 
+			{
+				if (!(chunk->occlusionFaces & (1 << entry))) continue;
+
+				for (face = 0; face < FACE_COUNT; face++) 
+				{
+					if (face != entry && CanSeeFaces(chunk->connectedFaces, entry, face)) exits |= 1 << face;
+				}
+			}
+		}
+
+		cx = chunk->centreX >> CHUNK_SHIFT; cy = chunk->centreY >> CHUNK_SHIFT; cz = chunk->centreZ >> CHUNK_SHIFT;
+		for (face = 0; face < FACE_COUNT; face++) 
+		{
+			if (!(exits & (1 << face))) continue;
+			/* Moving back towards the camera can't reveal any more chunks */
+			if (chunk->occlusionDirs & (1 << (face ^ 1))) continue;
+
+			nx = cx + offsets[face].x; ny = cy + offsets[face].y; nz = cz + offsets[face].z;
+			if (nx < 0 || ny < 0 || nz < 0 || nx >= World.ChunksX || ny >= World.ChunksY || nz >= World.ChunksZ) continue;
+
+			Occlusion_Enter(nx, ny, nz, 1 << (face ^ 1), chunk->occlusionDirs | (1 << face), renderDistSqr, &count);
+		}
+	}
+}
+
+
 /*########################################################################################################################*
 *--------------------------------------------------Chunks updating/sorting------------------------------------------------*
 *#########################################################################################################################*/
@@ -574,12 +755,11 @@ static int UpdateChunksAndVisibility(int* chunkUpdates) {
 			DeleteChunk(chunk); continue;
 		}
 
-		if (chunk->dirty && distSqr <= buildDistSqr && *chunkUpdates < chunksTarget) {
-			DeleteChunk(chunk);
+		if (chunk->dirty && !chunk->building && distSqr <= buildDistSqr && *chunkUpdates < buildTarget) {
 			BuildChunk(chunk, chunkUpdates);
 		}
 
-		if (distSqr > renderDistSqr) {
+		if (distSqr > renderDistSqr || chunk->occluded) {
 			chunk->visible  = false;
 		} else {
 			res = Frustum_TestSphere(chunk->centreX, chunk->centreY, chunk->centreZ, 14); /* 14 ~ sqrt(3 * 8^2) */
@@ -610,12 +790,11 @@ static int UpdateChunksStill(int* chunkUpdates) {
 			DeleteChunk(chunk); continue;
 		}
 
-		if (chunk->dirty && distSqr <= buildDistSqr && *chunkUpdates < chunksTarget) {
-			DeleteChunk(chunk);
+		if (chunk->dirty && !chunk->building && distSqr <= buildDistSqr && *chunkUpdates < buildTarget) {
 			BuildChunk(chunk, chunkUpdates);
 
 			/* only need to update the visibility of chunks in range. */
-			if (distSqr > renderDistSqr) {
+			if (distSqr > renderDistSqr || chunk->occluded) {
 				chunk->visible  = false;
 			} else {
 				res = Frustum_TestSphere(chunk->centreX, chunk->centreY, chunk->centreZ, 14); /* 14 ~ sqrt(3 * 8^2) */
@@ -634,12 +813,21 @@ static int UpdateChunksStill(int* chunkUpdates) {
 static void UpdateChunks(float delta) {
 	struct LocalPlayer* p;
 	cc_bool samePos;
-	int chunkUpdates = 0;
+	int chunkUpdates = 0, uploaded;
 
 	/* Build more chunks if 30 FPS or over, otherwise slowdown */
 	chunksTarget += delta < CHUNK_TARGET_TIME ? 1 : -1; 
 	Math_Clamp(chunksTarget, 4, maxChunkUpdates);
 
+	/* Queueing a chunk is much cheaper than building it on the main thread */
+	buildTarget = chunksTarget * (Builder_WorkersCount() + 1);
+	uploaded    = UploadBuiltChunks();
+	if (occlusionDirty) {
+		CalcOcclusion(renderDistSquared);
+		/* Force visibility of all chunks to be recalculated */
+		lastCamPos = Vec3_BigPos();
+	}
+
 	p = Entities.CurPlayer;
 	samePos = Vec3_Equals(&Camera.CurrentPos, &lastCamPos)
 		&& p->Base.Pitch == lastPitch && p->Base.Yaw == lastYaw;
@@ -652,7 +840,7 @@ static void UpdateChunks(float delta) {
 	lastPitch  = p->Base.Pitch;
 	lastYaw    = p->Base.Yaw;
 
-	if (!samePos || chunkUpdates) ResetPartFlags();
+	if (!samePos || chunkUpdates || uploaded) ResetPartFlags();
 }
 
 static void SortMapChunks(int left, int right) {
@@ -711,7 +899,7 @@ static void UpdateSortOrder(void) {
 
 	SortMapChunks(0, chunksCount - 1);
 	ResetPartFlags();
-	/*SimpleOcclusionCulling();*/
+	CalcOcclusion(renderDistSquared);
 }
 
 void MapRenderer_Update(float delta) {
@@ -732,6 +920,10 @@ void MapRenderer_RefreshChunk(int cx, int cy, int cz) {
 	ChunkInfo_Refresh(chunk);
 }
 
+cc_bool MapRenderer_IsChunkDirty(int cx, int cy, int cz) {
+	return mapChunks[World_ChunkPack(cx, cy, cz)].dirty;
+}
+
 void MapRenderer_OnBlockChanged(int x, int y, int z, BlockID block) {
 	int cx = x >> CHUNK_SHIFT, cy = y >> CHUNK_SHIFT, cz = z >> CHUNK_SHIFT;
 	struct ChunkInfo* chunk;
@@ -742,6 +934,24 @@ void MapRenderer_OnBlockChanged(int x, int y, int z, BlockID block) {
 	ChunkInfo_Refresh(chunk);
 }
 
+void MapRenderer_OnBlocksChanged(const struct BlockChange* changes, int count) {
+	struct ChunkInfo* chunk;
+	struct ChunkInfo* last = NULL;
+	int i, cx, cy, cz;
+
+	for (i = 0; i < count; i++) 
+	{
+		cx = changes[i].x >> CHUNK_SHIFT; cy = changes[i].y >> CHUNK_SHIFT; cz = changes[i].z >> CHUNK_SHIFT;
+		chunk = &mapChunks[World_ChunkPack(cx, cy, cz)];
+
+		/* Batched changes are usually next to each other, so only refresh once per run of changes in a chunk */
+		if (last && chunk != last) ChunkInfo_Refresh(last);
+		chunk->allAir &= Blocks.Draw[changes[i].newBlock] == DRAW_GAS;
+		last = chunk;
+	}
+	if (last) ChunkInfo_Refresh(last);
+}
+
 static void OnEnvVariableChanged(void* obj, int envVar) {
 	if (envVar == ENV_VAR_SUN_COLOR || envVar == ENV_VAR_SHADOW_COLOR) {
 		RefreshChunks();
@@ -776,6 +986,7 @@ static void OnBlockDefinitionChanged(void* obj) {
 static void OnVisibilityChanged(void* obj) {
 	lastCamPos = Vec3_BigPos();
 	CalcViewDists();
+	occlusionDirty = true;
 }
 static void DeleteChunks_(void* obj) { DeleteChunks(); }
 static void Refresh_(void* obj)      { MapRenderer_Refresh(); }
@@ -819,6 +1030,7 @@ static void OnInit(void) {
 	MapRenderer_1DUsedCount = 87; /* Atlas1D_UsedAtlasesCount(); */
 	chunkPos   = IVec3_MaxValue();
 	maxChunkUpdates = Options_GetInt(OPT_MAX_CHUNK_UPDATES, 4, 1024, 30);
+	occlusionCulling = Options_GetBool(OPT_OCCLUSION_CULLING, true);
 	CalcViewDists();
 }
 
@@ -10,6 +10,7 @@ CC_BEGIN_HEADER
    Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 */
 struct IGameComponent;
+struct BlockChange;
 extern struct IGameComponent MapRenderer_Component;
 
 /* Max used 1D atlases. (i.e. Atlas1D_Index(maxTextureLoc) + 1) */
@@ -32,6 +33,12 @@ struct ChunkPartInfo {
 	cc_uint16 counts[FACE_COUNT]; /* Counts per face */
 };
 
+/* Returns the bit in ChunkInfo.connectedFaces for whether the two given faces can see each other */
+/* NOTE: face1 must be less than face2 */
+#define ChunkInfo_FacesBit(face1, face2) (1 << ((face1) * (11 - (face1)) / 2 + (face2) - (face1) - 1))
+/* Value of ChunkInfo.connectedFaces when all faces of the chunk can see each other */
+#define CHUNK_ALL_FACES_CONNECTED 0x7FFF
+
 /* Describes data necessary for rendering a chunk. */
 struct ChunkInfo {	
 	cc_uint16 centreX, centreY, centreZ; /* Centre coordinates of the chunk */
@@ -42,6 +49,8 @@ struct ChunkInfo {
 	cc_uint8 allAir  : 1; /* Whether chunk is completely air */
 	cc_uint8 noData  : 1; /* Whether chunk is currently empty of data, but may have data if built */
 	cc_uint8 skipClip: 1; /* Whether chunk can skip GPU backend clipping (see CC_CLIPPING_FLAGS) */
+	cc_uint8 building: 1; /* Whether chunk mesh is currently being built on a worker thread */
+	cc_uint8 occluded: 1; /* Whether chunk is hidden behind other chunks from the camera (see occlusion culling) */
 	cc_uint8 : 0;         /* pad to next byte*/
 
 	cc_uint8 drawXMin : 1;
@@ -51,10 +60,11 @@ struct ChunkInfo {
 	cc_uint8 drawYMin : 1;
 	cc_uint8 drawYMax : 1;
 	cc_uint8 : 0;          /* pad to next byte */
-#ifdef OCCLUSION
-	public cc_bool Visited = false, Occluded = false;
-	public byte OcclusionFlags, OccludedFlags, DistanceFlags;
-#endif
+	/* Bit flags of which pairs of faces of the chunk can see each other through non-opaque blocks */
+	/* (see ChunkInfo_FacesBit) */
+	cc_uint16 connectedFaces;
+	cc_uint8 occlusionFaces; /* Faces the occlusion culling flood fill has entered this chunk through */
+	cc_uint8 occlusionDirs;  /* Directions the occlusion culling flood fill moved in to reach this chunk */
 #if CC_GFX_BACKEND != CC_GFX_BACKEND_GL11
 	GfxResourceID vb;
 #endif
@@ -74,8 +84,13 @@ void MapRenderer_Update(float delta);
 /* Marks the given chunk as needing to be rebuilt/redrawn. */
 /* NOTE: Coordinates outside the map are simply ignored. */
 void MapRenderer_RefreshChunk(int cx, int cy, int cz);
+/* Returns whether the given chunk is already pending being rebuilt. */
+/* NOTE: Does ***NOT*** check that the coordinates are inside the map. */
+cc_bool MapRenderer_IsChunkDirty(int cx, int cy, int cz);
 /* Called when a block is changed, to update internal state. */
 void MapRenderer_OnBlockChanged(int x, int y, int z, BlockID block);
+/* Called when a block batch ends, to update internal state for all the blocks changed in it. */
+void MapRenderer_OnBlocksChanged(const struct BlockChange* changes, int count);
 /* Deletes all chunks and resets internal state. */
 void MapRenderer_Refresh(void);
 
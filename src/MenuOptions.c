@@ -716,7 +716,7 @@ void EnvSettingsScreen_Show(void) {
 *--------------------------------------------------GraphicsOptionsScreen--------------------------------------------------*
 *#########################################################################################################################*/
 static void GrO_CheckLightingModeAllowed(struct MenuOptionsScreen* s) {
-	Widget_SetDisabled(s->widgets[3], Lighting_ModeLockedByServer);
+	Widget_SetDisabled(s->widgets[4], Lighting_ModeLockedByServer);
 }
 
 static int  GrO_GetFPS(void) { return Game_FpsLimit; }
@@ -737,6 +737,14 @@ static void    GrO_SetSmooth(cc_bool v) {
 	MapRenderer_Refresh();
 }
 
+static cc_bool GrO_GetGreedy(void) { return Builder_GreedyMeshing; }
+static void    GrO_SetGreedy(cc_bool v) {
+	Builder_GreedyMeshing = v;
+	Options_SetBool(OPT_GREEDY_MESHING, v);
+	Builder_ApplyActive();
+	MapRenderer_Refresh();
+}
+
 static int  GrO_GetLighting(void) { return Lighting_Mode; }
 static void GrO_SetLighting(int v) {
 	cc_string str = String_FromReadonly(LightingMode_Names[v]);
@@ -783,6 +791,12 @@ static void GraphicsOptionsScreen_InitWidgets(struct MenuOptionsScreen* s) {
 			GrO_GetSmooth,     GrO_SetSmooth,
 			"&eSmooth lighting smooths lighting and adds a minor glow to bright blocks.\n" \
 			"&cNote: &eThis setting may reduce performance.");
+		MenuOptionsScreen_AddBool(s, "Greedy meshing",
+			GrO_GetGreedy,     GrO_SetGreedy,
+			"&eMerges faces of blocks that look the same into larger faces,\n" \
+			"    so that chunks have far fewer vertices.\n" \
+			"&cNote: &eIgnored when smooth lighting is enabled.\n" \
+			"&cNote: &eThis setting uses more memory and texture switches.");
 		MenuOptionsScreen_AddEnum(s, "Lighting mode", LightingMode_Names, LIGHTING_MODE_COUNT,
 			GrO_GetLighting,   GrO_SetLighting,
 			"&eClassic: &fTwo levels of light, sun and shadow.\n" \
@@ -1351,7 +1351,7 @@ static void SaveLevelScreen_OnInputTextChanged(void* elem) {
 	SaveLevelScreen_RemoveOverwrites(&SaveLevelScreen);
 }
 
-static cc_result DoSaveMap(const cc_string* path, struct GZipState* state) {
+static cc_result DoSaveMap(const cc_string* path, void* state, int numThreads) {
 	static const cc_string schematic = String_FromConst(".schematic");
 	static const cc_string mine      = String_FromConst(".mine");
 	struct Stream stream, compStream;
@@ -1362,7 +1362,15 @@ static cc_result DoSaveMap(const cc_string* path, struct GZipState* state) {
 	res = Stream_CreatePath(&stream, &raw_path);
 	if (res) { Logger_IOWarn2(res, "creating", &raw_path); return res; }
 
-	GZip_MakeStream(&compStream, state, &stream);
+	if (numThreads) {
+		/* Saving using multiple threads is meant for large maps, where save time matters more */
+		GZip_MakeParallelStream(&compStream, (struct GZipParallelState*)state, &stream, 
+								DEFLATE_LEVEL_DEFAULT, numThreads);
+	} else {
+		GZip_MakeStream(&compStream, (struct GZipState*)state, &stream);
+		/* Maps are saved rarely, so spending longer compressing them is fine */
+		Deflate_SetLevel(&((struct GZipState*)state)->Base, DEFLATE_LEVEL_BEST);
+	}
 
 	if (String_CaselessEnds(path, &schematic)) {
 		res = Schematic_Save(&compStream);
@@ -1388,14 +1396,17 @@ static cc_result DoSaveMap(const cc_string* path, struct GZipState* state) {
 }
 
 static cc_result SaveLevelScreen_SaveMap(const cc_string* path) {
-	struct GZipState* state;
+	int numThreads = Options_GetInt(OPT_MAP_SAVE_THREADS, 0, GZIP_MAX_THREADS, 0);
+	cc_uint32 size = numThreads ? sizeof(struct GZipParallelState) : sizeof(struct GZipState);
+	void* state;
 	cc_result res;
 
-	state = (struct GZipState*)Mem_TryAlloc(1, sizeof(struct GZipState));
+	state = Mem_TryAlloc(1, size);
 	res   = ERR_OUT_OF_MEMORY;
 	if (!state) { Logger_SysWarn(res, "allocating temp memory"); return res; }
 
-	res = DoSaveMap(path, state);
+	res = DoSaveMap(path, state, numThreads);
+	if (numThreads) GZip_FreeParallelStream((struct GZipParallelState*)state);
 	Mem_Free(state);
 	if (res) return res;
 
@@ -100,12 +100,24 @@ void Model_GetEntityTransform(struct Model* model, struct Entity* e, struct Matr
 	model->GetTransform(e, pos, transform);
 }
 
+static cc_bool Batch_Reserve(struct Model* model);
+static struct Matrix batch_transform;
+static cc_bool batch_begun, batch_drawing;
+
 void Model_Render(struct Model* model, struct Entity* e) {
 	struct Matrix m, transform;
 	Model_SetupState(model, e);
-	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
-
 	Model_GetEntityTransform(model, e, &transform);
+
+	if (batch_begun && Batch_Reserve(model)) {
+		batch_transform = transform;
+		batch_drawing   = true;
+		model->Draw(e);
+		batch_drawing   = false;
+		return;
+	}
+
+	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
 	Matrix_Mul(&m, &transform, &Gfx.View);
 
 	Gfx_LoadMatrix(MATRIX_VIEW, &m);
@@ -162,7 +174,7 @@ void Model_ApplyTexture(struct Entity* e) {
 		Models.skinType = data->skinType;
 	}
 
-	Gfx_BindTexture(tex);
+	Model_BindTexture(tex);
 	_64x64 = Models.skinType != SKIN_64x32;
 
 	Models.uScale = e->uScale * 0.015625f;
@@ -184,7 +196,12 @@ void Model_UpdateVB(void) {
 static struct VertexTextured* real_vertices;
 static GfxResourceID modelVB;
 
+static void Batch_Lock(int verticesCount);
+static void Batch_Unlock(void);
+
 void Model_LockVB(struct Entity* entity, int verticesCount) {
+	if (batch_drawing) { Batch_Lock(verticesCount); return; }
+
 #ifdef CC_BUILD_CONSOLE
 	if (!entity->ModelVB) {
 		entity->ModelVB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, Models.Active->maxVertices);
@@ -202,11 +219,181 @@ void Model_LockVB(struct Entity* entity, int verticesCount) {
 }
 
 void Model_UnlockVB(void) {
+	if (batch_drawing) { Batch_Unlock(); return; }
+
 	Gfx_UnlockDynamicVb(modelVB);
 	Models.Vertices = real_vertices;
 }
 
 
+/*########################################################################################################################*
+*--------------------------------------------------------Model batching---------------------------------------------------*
+*#########################################################################################################################*/
+struct ModelBatchDraw { GfxResourceID tex; int offset, count; cc_bool opaque; };
+
+/* Vertices of all the models in the batch, already transformed into world space */
+static struct VertexTextured* batch_vertices;
+static int batch_count, batch_capacity, batch_base;
+static struct ModelBatchDraw* batch_draws;
+static struct ModelBatchDraw* batch_groups;
+static int batch_numDraws, batch_maxDraws;
+static GfxResourceID batch_tex, batch_vb;
+static int batch_vbSize;
+
+/* Draws all the vertices in the batch, grouped by texture */
+static void Batch_Flush(void) {
+	struct VertexTextured* dst;
+	struct ModelBatchDraw* draw;
+	struct ModelBatchDraw* group;
+	int i, j, numGroups = 0, offset = 0;
+	if (!batch_numDraws) return;
+
+	if (batch_vbSize < batch_capacity) Gfx_DeleteDynamicVb(&batch_vb);
+	if (!batch_vb) {
+		batch_vb     = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, batch_capacity);
+		batch_vbSize = batch_capacity;
+	}
+	if (!batch_vb) { batch_count = 0; batch_numDraws = 0; return; }
+
+	Gfx_SetVertexFormat(VERTEX_FORMAT_TEXTURED);
+	dst = (struct VertexTextured*)Gfx_LockDynamicVb(batch_vb, VERTEX_FORMAT_TEXTURED, batch_count);
+
+	/* Vertices of all draws sharing a texture are made contiguous, so they can be drawn with one call */
+	for (i = 0; i < batch_numDraws; i++)
+	{
+		if (!batch_draws[i].count) continue;
+		group = &batch_groups[numGroups++];
+		*group = batch_draws[i];
+		group->offset = offset;
+		group->count  = 0;
+
+		for (j = i; j < batch_numDraws; j++)
+		{
+			draw = &batch_draws[j];
+			if (!draw->count || draw->tex != group->tex || draw->opaque != group->opaque) continue;
+
+			Mem_Copy(dst + offset, batch_vertices + draw->offset, draw->count * SIZEOF_VERTEX_TEXTURED);
+			offset       += draw->count;
+			group->count += draw->count;
+			draw->count   = 0;
+		}
+	}
+	Gfx_UnlockDynamicVb(batch_vb);
+
+	for (i = 0; i < numGroups; i++)
+	{
+		group = &batch_groups[i];
+		Gfx_BindTexture(group->tex);
+
+		if (group->opaque) Gfx_SetAlphaTest(false);
+		Gfx_DrawVb_IndexedTris_Range(group->count, group->offset, DRAW_HINT_NONE);
+		if (group->opaque) Gfx_SetAlphaTest(true);
+	}
+	batch_count    = 0;
+	batch_numDraws = 0;
+}
+
+/* Ensures there is room in the batch for all the vertices of the given model */
+static cc_bool Batch_Reserve(struct Model* model) {
+	struct VertexTextured* vertices;
+	int capacity, count = model->maxVertices;
+	if (!(model->flags & MODEL_FLAG_BATCHED) || count > GFX_MAX_VERTICES) return false;
+
+	if (batch_count + count > GFX_MAX_VERTICES) Batch_Flush();
+	if (batch_count + count <= batch_capacity)  return true;
+
+	capacity = max(batch_count + count, batch_capacity * 2);
+	capacity = min(max(capacity, 1024), GFX_MAX_VERTICES);
+
+	vertices = (struct VertexTextured*)Mem_TryRealloc(batch_vertices, capacity, SIZEOF_VERTEX_TEXTURED);
+	if (!vertices) return false;
+
+	batch_vertices = vertices;
+	batch_capacity = capacity;
+	return true;
+}
+
+static void Batch_Lock(int verticesCount) {
+	real_vertices   = Models.Vertices;
+	Models.Vertices = batch_vertices + batch_count;
+
+	batch_base   = batch_count;
+	batch_count += verticesCount;
+}
+
+/* Transforms the vertices of the model into world space */
+static void Batch_Unlock(void) {
+	struct VertexTextured* v = Models.Vertices;
+	struct Matrix m = batch_transform; /* local copy, as vertices could otherwise alias it */
+	float x, y, z;
+	int i;
+
+	for (i = batch_base; i < batch_count; i++, v++)
+	{
+		x = v->x; y = v->y; z = v->z;
+		v->x = x * m.row1.x + y * m.row2.x + z * m.row3.x + m.row4.x;
+		v->y = x * m.row1.y + y * m.row2.y + z * m.row3.y + m.row4.y;
+		v->z = x * m.row1.z + y * m.row2.z + z * m.row3.z + m.row4.z;
+	}
+	Models.Vertices = real_vertices;
+}
+
+static void Batch_AddDraw(int offset, int count, cc_bool opaque) {
+	struct ModelBatchDraw* draw;
+
+	if (batch_numDraws == batch_maxDraws) {
+		batch_maxDraws = max(batch_maxDraws * 2, 64);
+		batch_draws    = (struct ModelBatchDraw*)Mem_Realloc(batch_draws,  batch_maxDraws, 
+															sizeof(struct ModelBatchDraw), "model batch draws");
+		batch_groups   = (struct ModelBatchDraw*)Mem_Realloc(batch_groups, batch_maxDraws, 
+															sizeof(struct ModelBatchDraw), "model batch groups");
+	}
+
+	draw = &batch_draws[batch_numDraws++];
+	draw->tex    = batch_tex;
+	draw->offset = batch_base + offset;
+	draw->count  = count;
+	draw->opaque = opaque;
+}
+
+void Model_BindTexture(GfxResourceID tex) {
+	if (batch_drawing) { batch_tex = tex; return; }
+	Gfx_BindTexture(tex);
+}
+
+void Model_DrawVertices(int offset, int count, cc_bool opaque) {
+	if (batch_drawing) { Batch_AddDraw(offset, count, opaque); return; }
+
+	/* e.g. human model draws the body opaque so players can't have invisible skins */
+	if (opaque) Gfx_SetAlphaTest(false);
+	if (offset) {
+		Gfx_DrawVb_IndexedTris_Range(count, offset, DRAW_HINT_NONE);
+	} else {
+		Gfx_DrawVb_IndexedTris(count);
+	}
+	if (opaque) Gfx_SetAlphaTest(true);
+}
+
+void Model_BeginBatch(void) { batch_begun = true; }
+
+void Model_EndBatch(void) {
+	Batch_Flush();
+	batch_begun = false;
+}
+
+static void Batch_Free(void) {
+	Mem_Free(batch_vertices);
+	Mem_Free(batch_draws);
+	Mem_Free(batch_groups);
+
+	batch_vertices = NULL;
+	batch_draws    = NULL;
+	batch_groups   = NULL;
+	batch_capacity = 0;
+	batch_maxDraws = 0;
+}
+
+
 void Model_DrawPart(struct ModelPart* part) {
 	struct Model* model        = Models.Active;
 	struct ModelVertex* src    = &model->vertices[part->offset];
@@ -820,7 +1007,7 @@ static void CustomModel_Draw(struct Entity* e) {
 	}
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(cm->numParts * MODEL_BOX_VERTICES);
+	Model_DrawVertices(0, cm->numParts * MODEL_BOX_VERTICES, false);
 	Models.Rotation = ROTATE_ORDER_ZYX;
 }
 
@@ -878,6 +1065,7 @@ void CustomModel_Register(struct CustomModel* cm) {
 	cm->model.name        = cm->name;
 	cm->model.defaultTex  = &customDefaultTex;
 	cm->model.maxVertices = cm->numParts * MODEL_BOX_VERTICES;
+	cm->model.flags      |= MODEL_FLAG_BATCHED;
 
 	cm->model.MakeParts = Model_NoParts;
 	cm->model.Draw      = CustomModel_Draw;
@@ -972,12 +1160,10 @@ static void HumanModel_DrawCore(struct Entity* e, struct ModelSet* model, cc_boo
 	Model_UnlockVB();
 	if (opaqueBody) {
 		/* human model draws the body opaque so players can't have invisible skins */
-		Gfx_SetAlphaTest(false);
-		Gfx_DrawVb_IndexedTris_Range(HUMAN_BASE_VERTICES, 0, DRAW_HINT_NONE);
-		Gfx_SetAlphaTest(true);
-		Gfx_DrawVb_IndexedTris_Range(num - HUMAN_BASE_VERTICES, HUMAN_BASE_VERTICES, DRAW_HINT_NONE);
+		Model_DrawVertices(0, HUMAN_BASE_VERTICES, true);
+		Model_DrawVertices(HUMAN_BASE_VERTICES, num - HUMAN_BASE_VERTICES, false);
 	} else {
-		Gfx_DrawVb_IndexedTris(num);
+		Model_DrawVertices(0, num, false);
 	}
 }
 
@@ -1171,7 +1357,7 @@ static void HumanoidModel_Register(void) {
 
 	human_model.calcHumanAnims = true;
 	human_model.usesHumanSkin  = true;
-	human_model.flags |= MODEL_FLAG_CLEAR_HAT;
+	human_model.flags |= MODEL_FLAG_CLEAR_HAT | MODEL_FLAG_BATCHED;
 	human_model.maxVertices    = HUMAN_MAX_VERTICES;
 
 	Model_Register(&human_model);
@@ -1266,7 +1452,7 @@ static void ChibiModel_Register(void) {
 
 	chibi_model.calcHumanAnims = true;
 	chibi_model.usesHumanSkin  = true;
-	chibi_model.flags |= MODEL_FLAG_CLEAR_HAT;
+	chibi_model.flags |= MODEL_FLAG_CLEAR_HAT | MODEL_FLAG_BATCHED;
 	chibi_model.maxVertices    = HUMAN_MAX_VERTICES;
 
 	chibi_model.maxScale    = 3.0f;
@@ -1307,7 +1493,7 @@ static void SittingModel_Register(void) {
 
 	sitting_model.calcHumanAnims = true;
 	sitting_model.usesHumanSkin  = true;
-	sitting_model.flags |= MODEL_FLAG_CLEAR_HAT;
+	sitting_model.flags |= MODEL_FLAG_CLEAR_HAT | MODEL_FLAG_BATCHED;
 	sitting_model.maxVertices    = HUMAN_MAX_VERTICES;
 
 	sitting_model.shadowScale  = 0.5f;
@@ -1359,7 +1545,7 @@ static void HeadModel_Draw(struct Entity* e) {
 	Model_DrawRotate(-e->Pitch * MATH_DEG2RAD, 0, 0, &part, true);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(HEAD_MAX_VERTICES);
+	Model_DrawVertices(0, HEAD_MAX_VERTICES, false);
 }
 
 static float HeadModel_GetEyeY(struct Entity* e)  { return 6.0f/16.0f; }
@@ -1375,7 +1561,7 @@ static struct Model head_model = { "head", human_vertices, &human_tex,
 static void HeadModel_Register(void) {
 	Model_Init(&head_model);
 	head_model.usesHumanSkin = true;
-	head_model.flags |= MODEL_FLAG_CLEAR_HAT;
+	head_model.flags |= MODEL_FLAG_CLEAR_HAT | MODEL_FLAG_BATCHED;
 
 	head_model.pushes        = false;
 	head_model.GetTransform  = HeadModel_GetTransform;
@@ -1473,7 +1659,7 @@ static void ChickenModel_Draw(struct Entity* e) {
 	Model_DrawRotate(e->Anim.RightLegX, 0, 0, &chicken_rightLeg, false);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(CHICKEN_MAX_VERTICES);
+	Model_DrawVertices(0, CHICKEN_MAX_VERTICES, false);
 }
 
 static float ChickenModel_GetNameY(struct Entity* e) { return 1.0125f; }
@@ -1492,6 +1678,7 @@ static struct Model chicken_model = { "chicken", chicken_vertices, &chicken_tex,
 static void ChickenModel_Register(void) {
 	Model_Init(&chicken_model);
 	chicken_model.maxVertices = CHICKEN_MAX_VERTICES;
+	chicken_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&chicken_model);
 }
 
@@ -1555,7 +1742,7 @@ static void CreeperModel_Draw(struct Entity* e) {
 	Model_DrawRotate(e->Anim.LeftLegX,  0, 0, &creeper_rightLegBack,  false);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(CREEPER_MAX_VERTICES);
+	Model_DrawVertices(0, CREEPER_MAX_VERTICES, false);
 }
 
 static float CreeperModel_GetNameY(struct Entity* e) { return 1.7f; }
@@ -1575,6 +1762,7 @@ static struct Model creeper_model  = {
 static void CreeperModel_Register(void) {
 	Model_Init(&creeper_model);
 	creeper_model.maxVertices = CREEPER_MAX_VERTICES;
+	creeper_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&creeper_model);
 }
 
@@ -1638,7 +1826,7 @@ static void PigModel_Draw(struct Entity* e) {
 	Model_DrawRotate(e->Anim.LeftLegX,  0, 0, &pig_rightLegBack,  false);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(PIG_MAX_VERTICES);
+	Model_DrawVertices(0, PIG_MAX_VERTICES, false);
 }
 
 static float PigModel_GetNameY(struct Entity* e) { return 1.075f; }
@@ -1657,6 +1845,7 @@ static struct Model pig_model  = { "pig", pig_vertices, &pig_tex,
 static void PigModel_Register(void) {
 	Model_Init(&pig_model);
 	pig_model.maxVertices = PIG_MAX_VERTICES;
+	pig_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&pig_model);
 }
 
@@ -1772,7 +1961,7 @@ static void FurlessModel_Draw(struct Entity* e) {
 	SheepModel_DrawBody(e);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(SHEEP_BODY_VERTICES);
+	Model_DrawVertices(0, SHEEP_BODY_VERTICES, false);
 }
 
 static void SheepModel_Draw(struct Entity* e) {
@@ -1788,9 +1977,9 @@ static void SheepModel_Draw(struct Entity* e) {
 	Model_DrawRotate(e->Anim.LeftLegX,  0, 0, &fur_rightLegBack,  false);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(SHEEP_BODY_VERTICES);
-	Gfx_BindTexture(fur_tex.texID);
-	Gfx_DrawVb_IndexedTris_Range(SHEEP_FUR_VERTICES, SHEEP_BODY_VERTICES, DRAW_HINT_NONE);
+	Model_DrawVertices(0, SHEEP_BODY_VERTICES, false);
+	Model_BindTexture(fur_tex.texID);
+	Model_DrawVertices(SHEEP_BODY_VERTICES, SHEEP_FUR_VERTICES, false);
 }
 
 static float SheepModel_GetNameY(struct Entity* e) { return 1.48125f; }
@@ -1814,12 +2003,14 @@ static struct Model nofur_model  = { "sheep_nofur", sheep_vertices, &sheep_tex,
 static void SheepModel_Register(void) {
 	Model_Init(&sheep_model);
 	sheep_model.maxVertices = SHEEP_BODY_VERTICES + SHEEP_FUR_VERTICES;
+	sheep_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&sheep_model);
 }
 
 static void NoFurModel_Register(void) {
 	Model_Init(&nofur_model);
 	nofur_model.maxVertices = SHEEP_BODY_VERTICES;
+	nofur_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&nofur_model);
 }
 
@@ -1883,7 +2074,7 @@ static void SkeletonModel_Draw(struct Entity* e) {
 	Model_DrawRotate(90.0f * MATH_DEG2RAD,   0, e->Anim.RightArmZ, &skeleton_rightArm, false);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(SKELETON_MAX_VERTICES);
+	Model_DrawVertices(0, SKELETON_MAX_VERTICES, false);
 }
 
 static void SkeletonModel_DrawArm(struct Entity* e) {
@@ -1912,6 +2103,7 @@ static void SkeletonModel_Register(void) {
 	skeleton_model.DrawArm     = SkeletonModel_DrawArm;
 	skeleton_model.armX        = 5;
 	skeleton_model.maxVertices = SKELETON_MAX_VERTICES;
+	skeleton_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&skeleton_model);
 }
 
@@ -1987,7 +2179,7 @@ static void SpiderModel_Draw(struct Entity* e) {
 	Models.Rotation = ROTATE_ORDER_ZYX;
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(SPIDER_MAX_VERTICES);
+	Model_DrawVertices(0, SPIDER_MAX_VERTICES, false);
 }
 
 static float SpiderModel_GetNameY(struct Entity* e) { return 1.0125f; }
@@ -2006,6 +2198,7 @@ static struct Model spider_model  = { "spider", spider_vertices, &spider_tex,
 static void SpiderModel_Register(void) {
 	Model_Init(&spider_model);
 	spider_model.maxVertices = SPIDER_MAX_VERTICES;
+	spider_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&spider_model);
 }
 
@@ -2035,6 +2228,7 @@ static void ZombieModel_Register(void) {
 	Model_Init(&zombie_model);
 	zombie_model.DrawArm     = ZombieModel_DrawArm;
 	zombie_model.maxVertices = HUMAN_MAX_VERTICES;
+	zombie_model.flags      |= MODEL_FLAG_BATCHED;
 	Model_Register(&zombie_model);
 }
 
@@ -2280,7 +2474,7 @@ static void SkinnedCubeModel_Draw(struct Entity* e) {
 	Model_DrawRotate(-e->Pitch * MATH_DEG2RAD, 0, 0, &skinnedCube_head, true);
 
 	Model_UnlockVB();
-	Gfx_DrawVb_IndexedTris(SKINNEDCUBE_MAX_VERTICES);
+	Model_DrawVertices(0, SKINNEDCUBE_MAX_VERTICES, false);
 }
 
 static float SkinnedCubeModel_GetNameY(struct Entity* e) { return 1.075f; }
@@ -2301,6 +2495,7 @@ static void SkinnedCubeModel_Register(void) {
 	skinnedCube_model.usesHumanSkin = true;
 	skinnedCube_model.pushes        = false;
 	skinnedCube_model.maxVertices   = SKINNEDCUBE_MAX_VERTICES;
+	skinnedCube_model.flags        |= MODEL_FLAG_BATCHED;
 	Model_Register(&skinnedCube_model);
 }
 
@@ -2373,6 +2568,8 @@ static void HoldModel_Register(void) {
 	hold_model.MakeParts = Model_NoParts;
 	hold_model.Draw      = HoldModel_Draw;
 	hold_model.GetEyeY   = HoldModel_GetEyeY;
+	/* Held block is drawn with its own transform */
+	hold_model.flags    &= ~MODEL_FLAG_BATCHED;
 	Model_Register(&hold_model);
 }
 
@@ -2421,6 +2618,7 @@ static void RegisterDefaultModels(void) {
 static void OnContextLost(void* obj) {
 	struct ModelTex* tex;
 	Gfx_DeleteDynamicVb(&Models.Vb);
+	Gfx_DeleteDynamicVb(&batch_vb);
 	if (Gfx.ManagedTextures) return;
 
 	for (tex = textures_head; tex; tex = tex->next) 
@@ -2441,6 +2639,7 @@ static void OnInit(void) {
 static void OnFree(void) {
 	OnContextLost(NULL);
 	CustomModel_FreeAll();
+	Batch_Free();
 }
 
 static void OnReset(void) { CustomModel_FreeAll(); }
@@ -41,6 +41,8 @@ struct ModelTex { const char* name; cc_uint8 skinType; GfxResourceID texID; stru
 
 #define MODEL_FLAG_INITED    0x01
 #define MODEL_FLAG_CLEAR_HAT 0x02
+/* Model only draws using Model_BindTexture and Model_DrawVertices, so can be drawn in batches */
+#define MODEL_FLAG_BATCHED   0x04
 
 struct Model;
 /* Contains a set of quads and/or boxes that describe a 3D object as well as
@@ -139,6 +141,18 @@ CC_API void Model_ApplyTexture(struct Entity* entity);
 CC_API void Model_UpdateVB(void);
 void Model_LockVB(struct Entity* entity, int verticesCount);
 void Model_UnlockVB(void);
+/* Binds the given texture for drawing the model's vertices. */
+void Model_BindTexture(GfxResourceID tex);
+/* Draws count vertices starting at offset from the vertices last written between Model_LockVB/Model_UnlockVB. */
+/* If opaque is true, the vertices are drawn without alpha testing. */
+void Model_DrawVertices(int offset, int count, cc_bool opaque);
+
+/* Begins batching the drawing of models which have MODEL_FLAG_BATCHED set. */
+/* Vertices of such models are transformed into world space and buffered, */
+/*  instead of being drawn immediately with a per-entity transform. */
+void Model_BeginBatch(void);
+/* Draws all buffered vertices, with one draw call per distinct texture. */
+void Model_EndBatch(void);
 
 /* Draws the given part with no part-specific rotation (e.g. torso). */
 CC_API void Model_DrawPart(struct ModelPart* part);
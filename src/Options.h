@@ -26,6 +26,7 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 #define OPT_RENDER_TYPE "normal"
 #define OPT_SMOOTH_LIGHTING "gfx-smoothlighting"
 #define OPT_LIGHTING_MODE "gfx-lightingmode"
+#define OPT_GREEDY_MESHING "gfx-greedymeshing"
 #define OPT_MIPMAPS "gfx-mipmaps"
 #define OPT_CHAT_LOGGING "chat-logging"
 #define OPT_WINDOW_WIDTH "window-width"
@@ -72,6 +73,16 @@ Copyright 2014-2025 ClassiCube | Licensed under BSD-3
 #define OPT_CLASSIC_CHAT "nostalgia-classicchat"
 #define OPT_CLASSIC_INVENTORY "nostalgia-classicinventory"
 #define OPT_MAX_CHUNK_UPDATES "gfx-maxchunkupdates"
+#define OPT_MAX_PARTICLES "gfx-maxparticles"
+#define OPT_BUILDER_THREADS "gfx-builderthreads"
+#define OPT_OCCLUSION_CULLING "gfx-occlusionculling"
+#define OPT_SOFTGPU_THREADS "gfx-softgputhreads"
+#define OPT_LIGHTING_THREADS "gfx-lightingthreads"
+#define OPT_FANCY_SKY_LIGHT "gfx-skylight"
+#define OPT_MAP_SAVE_THREADS "map-savethreads"
+#define OPT_MAP_LOAD_THREADS "map-loadthreads"
+#define OPT_MAP_GEN_THREADS "map-genthreads"
+#define OPT_PHYSICS_THREADS "physics-threads"
 #define OPT_CAMERA_MASS "cameramass"
 #define OPT_CAMERA_SMOOTH "camera-smooth"
 #define OPT_GRAB_CURSOR "win-grab-cursor"
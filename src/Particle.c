@@ -9,12 +9,18 @@
 #include "Funcs.h"
 #include "Game.h"
 #include "Event.h"
+#include "Options.h"
+#include "Platform.h"
 
-#ifdef CC_BUILD_TINYMEM
-	#define PARTICLES_MAX 10
+#if defined CC_BUILD_TINYMEM
+	#define PARTICLES_DEF_MAX 10
+#elif defined CC_BUILD_LOWMEM
+	#define PARTICLES_DEF_MAX 600
 #else
-	#define PARTICLES_MAX 600
+	#define PARTICLES_DEF_MAX 16384
 #endif
+/* Max number of particles of each type that can be drawn in one draw call */
+#define PARTICLES_MAX_BATCH (GFX_MAX_VERTICES / 4)
 
 
 /*########################################################################################################################*
@@ -23,8 +29,106 @@
 static GfxResourceID particles_TexId, particles_VB;
 static RNGState rnd;
 static cc_bool hitTerrain;
+static int particles_max, particles_batch;
 typedef cc_bool (*CanPassThroughFunc)(BlockID b);
 
+/* Stores each component of the particles in its own array (rather than an array of particle structs), */
+/*  so that the physics integration loop is simple enough to be vectorised by the compiler */
+struct ParticleList {
+	float* lastX; float* lastY; float* lastZ;
+	float* nextX; float* nextY; float* nextZ;
+	float* velX;  float* velY;  float* velZ;
+	float* lifetime;
+	float* gravity;
+	float* size;
+	void* extra;   /* Data specific to the type of particle */
+	int extraSize; /* Size of data specific to the type of particle */
+	int count, capacity;
+	int evict;     /* Index of particle replaced by the next new particle when the list is full */
+};
+/* Number of float arrays in a particle list */
+#define PARTICLE_FLOATS 12
+/* Distance between the start of each float array. Padded so that the arrays don't all start */
+/*  at power of two offsets, which would make them compete for the same CPU cache sets */
+#define ParticleList_Stride(capacity) ((capacity) + 16)
+#define ParticleList_Extra(l, i) ((cc_uint8*)(l)->extra + (i) * (l)->extraSize)
+
+/* NOTE: All of the arrays are allocated in one block, starting with lastX */
+static void ParticleList_SetArrays(struct ParticleList* l, float* data) {
+	int cap = ParticleList_Stride(l->capacity);
+	l->lastX    = data;            l->lastY = data +  1 * cap; l->lastZ = data +  2 * cap;
+	l->nextX    = data +  3 * cap; l->nextY = data +  4 * cap; l->nextZ = data +  5 * cap;
+	l->velX     = data +  6 * cap; l->velY  = data +  7 * cap; l->velZ  = data +  8 * cap;
+	l->lifetime = data +  9 * cap;
+	l->gravity  = data + 10 * cap;
+	l->size     = data + 11 * cap;
+	l->extra    = data + PARTICLE_FLOATS * cap;
+}
+
+static cc_bool ParticleList_Grow(struct ParticleList* l) {
+	int i, capacity = min(max(l->capacity * 2, 64), particles_max);
+	int stride = ParticleList_Stride(capacity);
+	float* data;
+	if (capacity <= l->capacity) return false;
+
+	data = (float*)Mem_TryAlloc(1, stride * PARTICLE_FLOATS * 4 + capacity * l->extraSize);
+	if (!data) return false;
+
+	if (l->count) {
+		for (i = 0; i < PARTICLE_FLOATS; i++)
+		{
+			Mem_Copy(data + i * stride, l->lastX + i * ParticleList_Stride(l->capacity), l->count * 4);
+		}
+		Mem_Copy(data + PARTICLE_FLOATS * stride, l->extra, l->count * l->extraSize);
+	}
+	if (l->lastX) Mem_Free(l->lastX);
+
+	l->capacity = capacity;
+	ParticleList_SetArrays(l, data);
+	return true;
+}
+
+/* Returns the index of the slot for a new particle, or -1 if there is no free memory */
+/* NOTE: When the list is full, an existing particle is replaced */
+static int ParticleList_Add(struct ParticleList* l) {
+	int i;
+	if (l->count < l->capacity || ParticleList_Grow(l)) return l->count++;
+	if (!l->count) return -1;
+
+	if (l->evict >= l->count) l->evict = 0;
+	i = l->evict++;
+	return i;
+}
+
+/* Removes the given particle by replacing it with the last particle in the list */
+static void ParticleList_RemoveAt(struct ParticleList* l, int i) {
+	int j, last = --l->count;
+	int stride  = ParticleList_Stride(l->capacity);
+	float* data = l->lastX;
+	if (i == last) return;
+
+	for (j = 0; j < PARTICLE_FLOATS; j++, data += stride)
+	{
+		data[i] = data[last];
+	}
+	Mem_Copy(ParticleList_Extra(l, i), ParticleList_Extra(l, last), l->extraSize);
+}
+
+static void ParticleList_Free(struct ParticleList* l) {
+	if (l->lastX) Mem_Free(l->lastX);
+	l->lastX    = NULL;
+	l->count    = 0;
+	l->capacity = 0;
+	l->evict    = 0;
+}
+
+/* NOTE: Same as Vec3_Lerp, but reads directly from the arrays */
+static void ParticleList_GetPosition(struct ParticleList* l, int i, float t, Vec3* pos) {
+	pos->x = t * (l->nextX[i] - l->lastX[i]) + l->lastX[i];
+	pos->y = t * (l->nextY[i] - l->lastY[i]) + l->lastY[i];
+	pos->z = t * (l->nextZ[i] - l->lastZ[i]) + l->lastZ[i];
+}
+
 void Particle_DoRender(const Vec2* size, const Vec3* pos, const TextureRec* rec, PackedCol col, struct VertexTextured* v) {
 	struct Matrix* view;
 	float sX, sY;
@@ -44,12 +148,10 @@ void Particle_DoRender(const Vec2* size, const Vec3* pos, const TextureRec* rec,
 	v->x = centre.x + aX - bX; v->y = centre.y + aY - bY; v->z = centre.z + aZ - bZ; v->Col = col; v->U = rec->u2; v->V = rec->v2; v++;
 }
 
-static cc_bool CollidesHor(Vec3* nextPos, BlockID block) {
-	Vec3 horPos = Vec3_Create3((float)Math_Floor(nextPos->x), 0.0f, (float)Math_Floor(nextPos->z));
-	Vec3 min, max;
-	Vec3_Add(&min, &Blocks.MinBB[block], &horPos);
-	Vec3_Add(&max, &Blocks.MaxBB[block], &horPos);
-	return nextPos->x >= min.x && nextPos->z >= min.z && nextPos->x < max.x && nextPos->z < max.z;
+static cc_bool CollidesHor(float x, float z, BlockID block) {
+	float minX = Math_Floor(x) + Blocks.MinBB[block].x, maxX = Math_Floor(x) + Blocks.MaxBB[block].x;
+	float minZ = Math_Floor(z) + Blocks.MinBB[block].z, maxZ = Math_Floor(z) + Blocks.MaxBB[block].z;
+	return x >= minX && z >= minZ && x < maxX && z < maxZ;
 }
 
 static BlockID GetBlock(int x, int y, int z) {
@@ -60,79 +162,95 @@ static BlockID GetBlock(int x, int y, int z) {
 	return Env.SidesBlock;
 }
 
-static cc_bool ClipY(struct Particle* p, int y, cc_bool topFace, CanPassThroughFunc canPassThrough) {
+static cc_bool ClipY(struct ParticleList* l, int i, int y, cc_bool topFace, CanPassThroughFunc canPassThrough) {
 	BlockID block;
 	Vec3 minBB, maxBB;
 	float collideY;
 	cc_bool collideVer;
 
 	if (y < 0) {
-		p->nextPos.y = ENTITY_ADJUSTMENT; 
-		p->lastPos.y = ENTITY_ADJUSTMENT;
+		l->nextY[i] = ENTITY_ADJUSTMENT; 
+		l->lastY[i] = ENTITY_ADJUSTMENT;
 
-		Vec3_Set(p->velocity, 0,0,0);
+		l->velX[i] = 0; l->velY[i] = 0; l->velZ[i] = 0;
 		hitTerrain = true;
 		return false;
 	}
 
-	block = GetBlock((int)p->nextPos.x, y, (int)p->nextPos.z);
+	block = GetBlock((int)l->nextX[i], y, (int)l->nextZ[i]);
 	if (canPassThrough(block)) return true;
 	minBB = Blocks.MinBB[block]; maxBB = Blocks.MaxBB[block];
 
 	collideY   = y + (topFace ? maxBB.y : minBB.y);
-	collideVer = topFace ? (p->nextPos.y < collideY) : (p->nextPos.y > collideY);
+	collideVer = topFace ? (l->nextY[i] < collideY) : (l->nextY[i] > collideY);
 
-	if (collideVer && CollidesHor(&p->nextPos, block)) {
+	if (collideVer && CollidesHor(l->nextX[i], l->nextZ[i], block)) {
 		float adjust = topFace ? ENTITY_ADJUSTMENT : -ENTITY_ADJUSTMENT;
-		p->lastPos.y = collideY + adjust;
-		p->nextPos.y = p->lastPos.y;
+		l->lastY[i] = collideY + adjust;
+		l->nextY[i] = l->lastY[i];
 
-		Vec3_Set(p->velocity, 0,0,0);
+		l->velX[i] = 0; l->velY[i] = 0; l->velZ[i] = 0;
 		hitTerrain = true;
 		return false;
 	}
 	return true;
 }
 
-static cc_bool IntersectsBlock(struct Particle* p, CanPassThroughFunc canPassThrough) {
-	BlockID cur = GetBlock((int)p->nextPos.x, (int)p->nextPos.y, (int)p->nextPos.z);
-	float minY  = Math_Floor(p->nextPos.y) + Blocks.MinBB[cur].y;
-	float maxY  = Math_Floor(p->nextPos.y) + Blocks.MaxBB[cur].y;
+static cc_bool IntersectsBlock(float x, float y, float z, CanPassThroughFunc canPassThrough) {
+	BlockID cur = GetBlock((int)x, (int)y, (int)z);
+	float minY  = Math_Floor(y) + Blocks.MinBB[cur].y;
+	float maxY  = Math_Floor(y) + Blocks.MaxBB[cur].y;
 
-	return !canPassThrough(cur) && p->nextPos.y >= minY && p->nextPos.y < maxY && CollidesHor(&p->nextPos, cur);
+	return !canPassThrough(cur) && y >= minY && y < maxY && CollidesHor(x, z, cur);
 }
 
-static cc_bool PhysicsTick(struct Particle* p, float gravity, CanPassThroughFunc canPassThrough, float delta) {
-	Vec3 velocity;
-	int y, begY, endY;
+/* Moves all particles in the list by their velocity */
+/* NOTE: Collisions must then be resolved using PhysicsTick */
+static void Integrate(struct ParticleList* l, float delta) {
+	float* nextX = l->nextX; float* nextY = l->nextY; float* nextZ = l->nextZ;
+	float* velX  = l->velX;  float* velY  = l->velY;  float* velZ  = l->velZ;
+	float* lifetime = l->lifetime;
+	float* gravity  = l->gravity;
+	float scale = delta * 3.0f;
+	int i, count = l->count;
+	if (!count) return;
 
-	p->lastPos = p->nextPos;
-	if (IntersectsBlock(p, canPassThrough)) return true;
+	Mem_Copy(l->lastX, nextX, count * 4);
+	Mem_Copy(l->lastY, nextY, count * 4);
+	Mem_Copy(l->lastZ, nextZ, count * 4);
 
-	p->velocity.y -= gravity * delta;
-	begY = Math_Floor(p->nextPos.y);
-	
-	Vec3_Mul1(&velocity, &p->velocity, delta * 3.0f);
-	Vec3_Add(&p->nextPos, &p->nextPos, &velocity);
-	endY = Math_Floor(p->nextPos.y);
+	for (i = 0; i < count; i++) 
+	{
+		velY[i]     -= gravity[i] * delta;
+		nextX[i]    += velX[i] * scale;
+		nextY[i]    += velY[i] * scale;
+		nextZ[i]    += velZ[i] * scale;
+		lifetime[i] -= delta;
+	}
+}
+
+/* Resolves collisions of a particle moved by Integrate, returning whether the particle has expired */
+static cc_bool PhysicsTick(struct ParticleList* l, int i, CanPassThroughFunc canPassThrough) {
+	int y, begY, endY;
+	if (IntersectsBlock(l->lastX[i], l->lastY[i], l->lastZ[i], canPassThrough)) return true;
 
-	if (p->velocity.y > 0.0f) {
+	begY = Math_Floor(l->lastY[i]);
+	endY = Math_Floor(l->nextY[i]);
+
+	if (l->velY[i] > 0.0f) {
 		/* don't test block we are already in */
-		for (y = begY + 1; y <= endY && ClipY(p, y, false, canPassThrough); y++) {}
+		for (y = begY + 1; y <= endY && ClipY(l, i, y, false, canPassThrough); y++) {}
 	} else {
-		for (y = begY; y >= endY && ClipY(p, y, true, canPassThrough); y--) {}
+		for (y = begY; y >= endY && ClipY(l, i, y, true, canPassThrough); y--) {}
 	}
-
-	p->lifetime -= delta;
-	return p->lifetime < 0.0f;
+	return l->lifetime[i] < 0.0f;
 }
 
 
 /*########################################################################################################################*
 *-------------------------------------------------------Rain particle-----------------------------------------------------*
 *#########################################################################################################################*/
-static struct Particle rain_Particles[PARTICLES_MAX];
-static int rain_count;
+static struct ParticleList rain;
 static TextureRec rain_rec = { 2.0f/128.0f, 14.0f/128.0f, 5.0f/128.0f, 16.0f/128.0f };
 
 static cc_bool RainParticle_CanPass(BlockID block) {
@@ -140,19 +258,14 @@ static cc_bool RainParticle_CanPass(BlockID block) {
 	return draw == DRAW_GAS || draw == DRAW_SPRITE;
 }
 
-static cc_bool RainParticle_Tick(struct Particle* p, float delta) {
-	hitTerrain = false;
-	return PhysicsTick(p, 3.5f, RainParticle_CanPass, delta) || hitTerrain;
-}
-
-static void RainParticle_Render(struct Particle* p, float t, struct VertexTextured* vertices) {
+static void RainParticle_Render(int i, float t, struct VertexTextured* vertices) {
 	Vec3 pos;
 	Vec2 size;
 	PackedCol col;
 	int x, y, z;
 
-	Vec3_Lerp(&pos, &p->lastPos, &p->nextPos, t);
-	size.x = p->size * 0.015625f; size.y = size.x;
+	ParticleList_GetPosition(&rain, i, t, &pos);
+	size.x = rain.size[i] * 0.015625f; size.y = size.x;
 
 	x = Math_Floor(pos.x); y = Math_Floor(pos.y); z = Math_Floor(pos.z);
 	col = Lighting.Color(x, y, z);
@@ -161,58 +274,60 @@ static void RainParticle_Render(struct Particle* p, float t, struct VertexTextur
 
 static void Rain_Render(float t) {
 	struct VertexTextured* data;
-	int i;
-	if (!rain_count) return;
-	
-	data = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
-										VERTEX_FORMAT_TEXTURED, rain_count * 4);
-	for (i = 0; i < rain_count; i++) {
-		RainParticle_Render(&rain_Particles[i], t, data);
-		data += 4;
-	}
-
+	int i, beg, count;
+	if (!rain.count) return;
 	Gfx_BindTexture(particles_TexId);
-	Gfx_UnlockDynamicVb(particles_VB);
-	Gfx_DrawVb_IndexedTris(rain_count * 4);
-}
 
-static void Rain_RemoveAt(int i) {
-	for (; i < rain_count - 1; i++) {
-		rain_Particles[i] = rain_Particles[i + 1];
+	for (beg = 0; beg < rain.count; beg += count)
+	{
+		count = min(rain.count - beg, particles_batch);
+		data  = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
+											VERTEX_FORMAT_TEXTURED, count * 4);
+		for (i = beg; i < beg + count; i++) {
+			RainParticle_Render(i, t, data);
+			data += 4;
+		}
+
+		Gfx_UnlockDynamicVb(particles_VB);
+		Gfx_DrawVb_IndexedTris(count * 4);
 	}
-	rain_count--;
 }
 
 static void Rain_Tick(float delta) {
 	int i;
-	for (i = 0; i < rain_count; i++) {
-		if (RainParticle_Tick(&rain_Particles[i], delta)) {
-			Rain_RemoveAt(i); i--;
-		}
+	Integrate(&rain, delta);
+
+	for (i = 0; i < rain.count; ) 
+	{
+		hitTerrain = false;
+		if (PhysicsTick(&rain, i, RainParticle_CanPass) || hitTerrain) {
+			ParticleList_RemoveAt(&rain, i);
+		} else { i++; }
 	}
 }
 
 void Particles_RainSnowEffect(float x, float y, float z) {
-	struct Particle* p;
-	int i, type;
+	int i, j, type;
 
-	for (i = 0; i < 2; i++) {
-		if (rain_count == PARTICLES_MAX) Rain_RemoveAt(0);
-		p = &rain_Particles[rain_count++];
+	for (j = 0; j < 2; j++) {
+		if ((i = ParticleList_Add(&rain)) < 0) return;
 
-		p->velocity.x = Random_Float(&rnd) * 0.8f - 0.4f; /* [-0.4, 0.4] */
-		p->velocity.z = Random_Float(&rnd) * 0.8f - 0.4f;
-		p->velocity.y = Random_Float(&rnd) + 0.4f;
+		rain.velX[i] = Random_Float(&rnd) * 0.8f - 0.4f; /* [-0.4, 0.4] */
+		rain.velZ[i] = Random_Float(&rnd) * 0.8f - 0.4f;
+		rain.velY[i] = Random_Float(&rnd) + 0.4f;
 
-		p->lastPos.x = x + Random_Float(&rnd); /* [0.0, 1.0] */
-		p->lastPos.y = y + Random_Float(&rnd) * 0.1f + 0.01f;
-		p->lastPos.z = z + Random_Float(&rnd);
+		rain.lastX[i] = x + Random_Float(&rnd); /* [0.0, 1.0] */
+		rain.lastY[i] = y + Random_Float(&rnd) * 0.1f + 0.01f;
+		rain.lastZ[i] = z + Random_Float(&rnd);
 
-		p->nextPos  = p->lastPos;
-		p->lifetime = 40.0f;
+		rain.nextX[i]    = rain.lastX[i];
+		rain.nextY[i]    = rain.lastY[i];
+		rain.nextZ[i]    = rain.lastZ[i];
+		rain.lifetime[i] = 40.0f;
+		rain.gravity[i]  = 3.5f;
 
 		type = Random_Next(&rnd, 30);
-		p->size = type >= 28 ? 2 : (type >= 25 ? 4 : 3);
+		rain.size[i] = (float)(type >= 28 ? 2 : (type >= 25 ? 4 : 3));
 	}
 }
 
@@ -221,34 +336,30 @@ void Particles_RainSnowEffect(float x, float y, float z) {
 *------------------------------------------------------Terrain particle---------------------------------------------------*
 *#########################################################################################################################*/
 struct TerrainParticle {
-	struct Particle base;
 	TextureRec rec;
 	TextureLoc texLoc;
 	BlockID block;
 };
 
-static struct TerrainParticle terrain_particles[PARTICLES_MAX];
-static int terrain_count;
-static cc_uint16 terrain_1DCount[ATLAS1D_MAX_ATLASES];
-static cc_uint16 terrain_1DIndices[ATLAS1D_MAX_ATLASES];
+static struct ParticleList terrain;
+static int terrain_1DCount[ATLAS1D_MAX_ATLASES];
+static int terrain_1DIndices[ATLAS1D_MAX_ATLASES];
+#define TerrainParticle_Get(i) ((struct TerrainParticle*)ParticleList_Extra(&terrain, i))
 
 static cc_bool TerrainParticle_CanPass(BlockID block) {
 	cc_uint8 draw = Blocks.Draw[block];
 	return draw == DRAW_GAS || draw == DRAW_SPRITE || Blocks.IsLiquid[block];
 }
 
-static cc_bool TerrainParticle_Tick(struct TerrainParticle* p, float delta) {
-	return PhysicsTick(&p->base, Blocks.ParticleGravity[p->block], TerrainParticle_CanPass, delta);
-}
-
-static void TerrainParticle_Render(struct TerrainParticle* p, float t, struct VertexTextured* vertices) {
+static void TerrainParticle_Render(int i, float t, struct VertexTextured* vertices) {
+	struct TerrainParticle* p = TerrainParticle_Get(i);
 	PackedCol col = PACKEDCOL_WHITE;
 	Vec3 pos;
 	Vec2 size;
 	int x, y, z;
 
-	Vec3_Lerp(&pos, &p->base.lastPos, &p->base.nextPos, t);
-	size.x = p->base.size * 0.015625f; size.y = size.x;
+	ParticleList_GetPosition(&terrain, i, t, &pos);
+	size.x = terrain.size[i] * 0.015625f; size.y = size.x;
 	
 	if (!Blocks.Brightness[p->block]) {
 		x = Math_Floor(pos.x); y = Math_Floor(pos.y); z = Math_Floor(pos.z);
@@ -259,15 +370,15 @@ static void TerrainParticle_Render(struct TerrainParticle* p, float t, struct Ve
 	Particle_DoRender(&size, &pos, &p->rec, col, vertices);
 }
 
-static void Terrain_Update1DCounts(void) {
+static void Terrain_Update1DCounts(int beg, int end) {
 	int i, index;
 
 	for (i = 0; i < ATLAS1D_MAX_ATLASES; i++) {
 		terrain_1DCount[i]   = 0;
 		terrain_1DIndices[i] = 0;
 	}
-	for (i = 0; i < terrain_count; i++) {
-		index = Atlas1D_Index(terrain_particles[i].texLoc);
+	for (i = beg; i < end; i++) {
+		index = Atlas1D_Index(TerrainParticle_Get(i)->texLoc);
 		terrain_1DCount[index] += 4;
 	}
 	for (i = 1; i < Atlas1D.Count; i++) {
@@ -278,49 +389,47 @@ static void Terrain_Update1DCounts(void) {
 static void Terrain_Render(float t) {
 	struct VertexTextured* data;
 	struct VertexTextured* ptr;
-	int offset = 0;
+	int beg, count, offset;
 	int i, index;
-	if (!terrain_count) return;
-
-	data = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
-										VERTEX_FORMAT_TEXTURED, terrain_count * 4);
-	Terrain_Update1DCounts();
-	for (i = 0; i < terrain_count; i++) 
-	{
-		index = Atlas1D_Index(terrain_particles[i].texLoc);
-		ptr   = data + terrain_1DIndices[index];
-
-		TerrainParticle_Render(&terrain_particles[i], t, ptr);
-		terrain_1DIndices[index] += 4;
-	}
+	if (!terrain.count) return;
 
-	Gfx_UnlockDynamicVb(particles_VB);
-	for (i = 0; i < Atlas1D.Count; i++) 
+	for (beg = 0; beg < terrain.count; beg += count)
 	{
-		int partCount = terrain_1DCount[i];
-		if (!partCount) continue;
+		count = min(terrain.count - beg, particles_batch);
+		data  = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
+											VERTEX_FORMAT_TEXTURED, count * 4);
+		Terrain_Update1DCounts(beg, beg + count);
+		for (i = beg; i < beg + count; i++) 
+		{
+			index = Atlas1D_Index(TerrainParticle_Get(i)->texLoc);
+			ptr   = data + terrain_1DIndices[index];
+
+			TerrainParticle_Render(i, t, ptr);
+			terrain_1DIndices[index] += 4;
+		}
 
-		Atlas1D_Bind(i);
-		Gfx_DrawVb_IndexedTris_Range(partCount, offset, DRAW_HINT_NONE);
-		offset += partCount;
-	}
-}
+		Gfx_UnlockDynamicVb(particles_VB);
+		for (i = 0, offset = 0; i < Atlas1D.Count; i++) 
+		{
+			int partCount = terrain_1DCount[i];
+			if (!partCount) continue;
 
-static void Terrain_RemoveAt(int i) {
-	for (; i < terrain_count - 1; i++) 
-	{
-		terrain_particles[i] = terrain_particles[i + 1];
+			Atlas1D_Bind(i);
+			Gfx_DrawVb_IndexedTris_Range(partCount, offset, DRAW_HINT_NONE);
+			offset += partCount;
+		}
 	}
-	terrain_count--;
 }
 
 static void Terrain_Tick(float delta) {
 	int i;
-	for (i = 0; i < terrain_count; i++) 
+	Integrate(&terrain, delta);
+
+	for (i = 0; i < terrain.count; ) 
 	{
-		if (TerrainParticle_Tick(&terrain_particles[i], delta)) {
-			Terrain_RemoveAt(i); i--;
-		}
+		if (PhysicsTick(&terrain, i, TerrainParticle_CanPass)) {
+			ParticleList_RemoveAt(&terrain, i);
+		} else { i++; }
 	}
 }
 
@@ -340,7 +449,7 @@ void Particles_BreakBlockEffect(IVec3 coords, BlockID old, BlockID now) {
 	/* per-particle variables */
 	float cellX, cellY, cellZ;
 	Vec3 cell;
-	int x, y, z, type;
+	int x, y, z, i, type;
 
 	if (now != BLOCK_AIR || Blocks.Draw[old] == DRAW_GAS) return;
 	IVec3_ToVec3(&origin, &coords);
@@ -375,13 +484,13 @@ void Particles_BreakBlockEffect(IVec3 coords, BlockID old, BlockID now) {
 				if (cell.x < minBB.x || cell.x > maxBB.x || cell.y < minBB.y
 					|| cell.y > maxBB.y || cell.z < minBB.z || cell.z > maxBB.z) continue;
 
-				if (terrain_count == PARTICLES_MAX) Terrain_RemoveAt(0);
-				p = &terrain_particles[terrain_count++];
+				if ((i = ParticleList_Add(&terrain)) < 0) return;
+				p = TerrainParticle_Get(i);
 
 				/* centre random offset around [-0.2, 0.2] */
-				p->base.velocity.x = CELL_CENTRE + (cellX - 0.5f) + (Random_Float(&rnd) * 0.4f - 0.2f);
-				p->base.velocity.y = CELL_CENTRE + (cellY - 0.0f) + (Random_Float(&rnd) * 0.4f - 0.2f);
-				p->base.velocity.z = CELL_CENTRE + (cellZ - 0.5f) + (Random_Float(&rnd) * 0.4f - 0.2f);
+				terrain.velX[i] = CELL_CENTRE + (cellX - 0.5f) + (Random_Float(&rnd) * 0.4f - 0.2f);
+				terrain.velY[i] = CELL_CENTRE + (cellY - 0.0f) + (Random_Float(&rnd) * 0.4f - 0.2f);
+				terrain.velZ[i] = CELL_CENTRE + (cellZ - 0.5f) + (Random_Float(&rnd) * 0.4f - 0.2f);
 
 				rec = baseRec;
 				rec.u1 = baseRec.u1 + Random_Range(&rnd, minU, maxUsedU) * uScale;
@@ -391,15 +500,17 @@ void Particles_BreakBlockEffect(IVec3 coords, BlockID old, BlockID now) {
 				rec.u2 = min(rec.u2, maxU2) - 0.01f * uScale;
 				rec.v2 = min(rec.v2, maxV2) - 0.01f * vScale;
 		
-				Vec3_Add(&p->base.lastPos, &origin, &cell);
-				p->base.nextPos  = p->base.lastPos;
-				p->base.lifetime = 0.3f + Random_Float(&rnd) * 1.2f;
+				terrain.lastX[i] = origin.x + cell.x; terrain.nextX[i] = terrain.lastX[i];
+				terrain.lastY[i] = origin.y + cell.y; terrain.nextY[i] = terrain.lastY[i];
+				terrain.lastZ[i] = origin.z + cell.z; terrain.nextZ[i] = terrain.lastZ[i];
+				terrain.lifetime[i] = 0.3f + Random_Float(&rnd) * 1.2f;
+				terrain.gravity[i]  = Blocks.ParticleGravity[old];
 
 				p->rec    = rec;
 				p->texLoc = loc;
 				p->block  = old;
 				type = Random_Next(&rnd, 30);
-				p->base.size = type >= 28 ? 12 : (type >= 25 ? 10 : 8);
+				terrain.size[i] = (float)(type >= 28 ? 12 : (type >= 25 ? 10 : 8));
 			}
 		}
 	}
@@ -411,19 +522,18 @@ void Particles_BreakBlockEffect(IVec3 coords, BlockID old, BlockID now) {
 *#########################################################################################################################*/
 #ifdef CC_BUILD_NETWORKING
 struct CustomParticle {
-	struct Particle base;
 	int effectId;
 	float totalLifespan;
 };
 
 struct CustomParticleEffect Particles_CustomEffects[256];
-static struct CustomParticle custom_particles[PARTICLES_MAX];
-static int custom_count;
+static struct ParticleList custom;
 static cc_uint8 collideFlags;
 #define EXPIRES_UPON_TOUCHING_GROUND (1 << 0)
 #define SOLID_COLLIDES  (1 << 1)
 #define LIQUID_COLLIDES (1 << 2)
 #define LEAF_COLLIDES   (1 << 3)
+#define CustomParticle_Get(i) ((struct CustomParticle*)ParticleList_Extra(&custom, i))
 
 static cc_bool CustomParticle_CanPass(BlockID block) {
 	cc_uint8 draw, collide;
@@ -437,16 +547,17 @@ static cc_bool CustomParticle_CanPass(BlockID block) {
 	return true;
 }
 
-static cc_bool CustomParticle_Tick(struct CustomParticle* p, float delta) {
-	struct CustomParticleEffect* e = &Particles_CustomEffects[p->effectId];
+static cc_bool CustomParticle_Tick(int i) {
+	struct CustomParticleEffect* e = &Particles_CustomEffects[CustomParticle_Get(i)->effectId];
 	hitTerrain   = false;
 	collideFlags = e->collideFlags;
 
-	return PhysicsTick(&p->base, e->gravity, CustomParticle_CanPass, delta)
+	return PhysicsTick(&custom, i, CustomParticle_CanPass)
 		|| (hitTerrain && (e->collideFlags & EXPIRES_UPON_TOUCHING_GROUND));
 }
 
-static void CustomParticle_Render(struct CustomParticle* p, float t, struct VertexTextured* vertices) {
+static void CustomParticle_Render(int i, float t, struct VertexTextured* vertices) {
+	struct CustomParticle* p       = CustomParticle_Get(i);
 	struct CustomParticleEffect* e = &Particles_CustomEffects[p->effectId];
 	Vec3 pos;
 	Vec2 size;
@@ -454,15 +565,15 @@ static void CustomParticle_Render(struct CustomParticle* p, float t, struct Vert
 	TextureRec rec = e->rec;
 	int x, y, z;
 
-	float time_lived = p->totalLifespan - p->base.lifetime;
+	float time_lived = p->totalLifespan - custom.lifetime[i];
 	int curFrame = Math_Floor(e->frameCount * (time_lived / p->totalLifespan));
 	float shiftU = curFrame * (rec.u2 - rec.u1);
 
 	rec.u1 += shiftU;/* * 0.0078125f; */
 	rec.u2 += shiftU;/* * 0.0078125f; */
 
-	Vec3_Lerp(&pos, &p->base.lastPos, &p->base.nextPos, t);
-	size.x = p->base.size; size.y = size.x;
+	ParticleList_GetPosition(&custom, i, t, &pos);
+	size.x = custom.size[i]; size.y = size.x;
 
 	x = Math_Floor(pos.x); y = Math_Floor(pos.y); z = Math_Floor(pos.z);
 	col = e->fullBright ? PACKEDCOL_WHITE : Lighting.Color(x, y, z);
@@ -473,50 +584,50 @@ static void CustomParticle_Render(struct CustomParticle* p, float t, struct Vert
 
 static void Custom_Render(float t) {
 	struct VertexTextured* data;
-	int i;
-	if (!custom_count) return;
-
-	data = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
-										VERTEX_FORMAT_TEXTURED, custom_count * 4);
-	for (i = 0; i < custom_count; i++) {
-		CustomParticle_Render(&custom_particles[i], t, data);
-		data += 4;
-	}
-
+	int i, beg, count;
+	if (!custom.count) return;
 	Gfx_BindTexture(particles_TexId);
-	Gfx_UnlockDynamicVb(particles_VB);
-	Gfx_DrawVb_IndexedTris(custom_count * 4);
-}
 
-static void Custom_RemoveAt(int i) {
-	for (; i < custom_count - 1; i++) {
-		custom_particles[i] = custom_particles[i + 1];
+	for (beg = 0; beg < custom.count; beg += count)
+	{
+		count = min(custom.count - beg, particles_batch);
+		data  = (struct VertexTextured*)Gfx_LockDynamicVb(particles_VB, 
+											VERTEX_FORMAT_TEXTURED, count * 4);
+		for (i = beg; i < beg + count; i++) {
+			CustomParticle_Render(i, t, data);
+			data += 4;
+		}
+
+		Gfx_UnlockDynamicVb(particles_VB);
+		Gfx_DrawVb_IndexedTris(count * 4);
 	}
-	custom_count--;
 }
 
 static void Custom_Tick(float delta) {
 	int i;
-	for (i = 0; i < custom_count; i++) {
-		if (CustomParticle_Tick(&custom_particles[i], delta)) {
-			Custom_RemoveAt(i); i--;
-		}
+	Integrate(&custom, delta);
+
+	for (i = 0; i < custom.count; ) 
+	{
+		if (CustomParticle_Tick(i)) {
+			ParticleList_RemoveAt(&custom, i);
+		} else { i++; }
 	}
 }
 
 void Particles_CustomEffect(int effectID, float x, float y, float z, float originX, float originY, float originZ) {
 	struct CustomParticle* p;
 	struct CustomParticleEffect* e = &Particles_CustomEffects[effectID];
-	int i, count = e->particleCount;
-	Vec3 offset, delta, origin;
+	int i, j, count = e->particleCount;
+	Vec3 offset, delta, origin, pos;
 	float d;
 
 	origin.x = originX; origin.y = originY; origin.z = originZ;
 
-	for (i = 0; i < count; i++) 
+	for (j = 0; j < count; j++) 
 	{
-		if (custom_count == PARTICLES_MAX) Custom_RemoveAt(0);
-		p = &custom_particles[custom_count++];
+		if ((i = ParticleList_Add(&custom)) < 0) return;
+		p = CustomParticle_Get(i);
 		p->effectId = effectID;
 
 		offset.x = Random_Float(&rnd) - 0.5f;
@@ -530,31 +641,34 @@ void Particles_CustomEffect(int effectID, float x, float y, float z, float origi
 		d  = Math_Exp2(Math_Log2(d) / 3.0); /* d^1/3 for better distribution */
 		d *= e->spread;
 
-		p->base.lastPos.x = x + offset.x * d;
-		p->base.lastPos.y = y + offset.y * d;
-		p->base.lastPos.z = z + offset.z * d;
+		pos.x = x + offset.x * d;
+		pos.y = y + offset.y * d;
+		pos.z = z + offset.z * d;
 		
-		Vec3_Sub(&delta, &p->base.lastPos, &origin);
+		Vec3_Sub(&delta, &pos, &origin);
 		Vec3_Normalise(&delta);
 
-		p->base.velocity.x = delta.x * e->speed;
-		p->base.velocity.y = delta.y * e->speed;
-		p->base.velocity.z = delta.z * e->speed;
+		custom.velX[i] = delta.x * e->speed;
+		custom.velY[i] = delta.y * e->speed;
+		custom.velZ[i] = delta.z * e->speed;
 
-		p->base.nextPos  = p->base.lastPos;
-		p->base.lifetime = e->baseLifetime + (e->baseLifetime * e->lifetimeVariation) * ((Random_Float(&rnd) - 0.5f) * 2);
-		p->totalLifespan = p->base.lifetime;
+		custom.lastX[i] = pos.x; custom.nextX[i] = pos.x;
+		custom.lastY[i] = pos.y; custom.nextY[i] = pos.y;
+		custom.lastZ[i] = pos.z; custom.nextZ[i] = pos.z;
+		custom.lifetime[i] = e->baseLifetime + (e->baseLifetime * e->lifetimeVariation) * ((Random_Float(&rnd) - 0.5f) * 2);
+		custom.gravity[i]  = e->gravity;
+		p->totalLifespan   = custom.lifetime[i];
 
-		p->base.size = e->size + (e->size * e->sizeVariation) * ((Random_Float(&rnd) - 0.5f) * 2);
+		custom.size[i] = e->size + (e->size * e->sizeVariation) * ((Random_Float(&rnd) - 0.5f) * 2);
 
 		/* Don't spawn custom particle inside a block (otherwise it appears */
 		/*   for a few frames, then disappears in first PhysicsTick call)*/
 		collideFlags = e->collideFlags;
-		if (IntersectsBlock(&p->base, CustomParticle_CanPass)) custom_count--;
+		if (IntersectsBlock(pos.x, pos.y, pos.z, CustomParticle_CanPass)) ParticleList_RemoveAt(&custom, i);
 	}
 }
 #else
-static int custom_count;
+static struct ParticleList custom;
 
 static void Custom_Render(float t) { }
 static void Custom_Tick(float delta) { }
@@ -565,11 +679,11 @@ static void Custom_Tick(float delta) { }
 *--------------------------------------------------------Particles--------------------------------------------------------*
 *#########################################################################################################################*/
 void Particles_Render(float t) {
-	if (!terrain_count && !rain_count && !custom_count) return;
+	if (!terrain.count && !rain.count && !custom.count) return;
 
 	if (Gfx.LostContext) return;
 	if (!particles_VB)
-		particles_VB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, PARTICLES_MAX * 4);
+		particles_VB = Gfx_CreateDynamicVb(VERTEX_FORMAT_TEXTURED, particles_batch * 4);
 
 	Gfx_SetAlphaTest(true);
 
@@ -618,13 +732,25 @@ static void OnInit(void) {
 	Random_SeedFromCurrentTime(&rnd);
 	TextureEntry_Register(&particles_entry);
 
+	particles_max   = Options_GetInt(OPT_MAX_PARTICLES, 10, 262144, PARTICLES_DEF_MAX);
+	particles_batch = min(particles_max, PARTICLES_MAX_BATCH);
+	terrain.extraSize = sizeof(struct TerrainParticle);
+#ifdef CC_BUILD_NETWORKING
+	custom.extraSize  = sizeof(struct CustomParticle);
+#endif
+
 	Event_Register_(&UserEvents.BlockChanged, NULL, OnBreakBlockEffect_Handler);
 	Event_Register_(&GfxEvents.ContextLost,   NULL, OnContextLost);
 }
 
-static void OnFree(void) { OnContextLost(NULL); }
+static void OnFree(void) { 
+	OnContextLost(NULL);
+	ParticleList_Free(&rain);
+	ParticleList_Free(&terrain);
+	ParticleList_Free(&custom);
+}
 
-static void OnReset(void) { rain_count = 0; terrain_count = 0; custom_count = 0; }
+static void OnReset(void) { rain.count = 0; terrain.count = 0; custom.count = 0; }
 
 struct IGameComponent Particles_Component = {
 	OnInit,  /* Init  */
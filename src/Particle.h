@@ -14,13 +14,6 @@ struct VertexTextured;
 struct ScheduledTask;
 extern struct IGameComponent Particles_Component;
 
-struct Particle {
-	Vec3 velocity;
-	float lifetime;
-	Vec3 lastPos, nextPos;
-	float size;
-};
-
 struct CustomParticleEffect {
 	TextureRec rec;
 	PackedCol tintCol;
@@ -347,6 +347,31 @@ CC_API void  Waitable_Wait(void* handle);
 /* Blocks the calling thread until the waitable gets signalled, or milliseconds delay passes. */
 CC_API void  Waitable_WaitFor(void* handle, cc_uint32 milliseconds);
 
+
+/*########################################################################################################################*
+*-------------------------------------------------------Worker pool-------------------------------------------------------*
+*#########################################################################################################################*/
+#define WORKERPOOL_MAX_THREADS 64
+/* Function that performs a share of the pool's work, called on each thread when the pool is run. */
+/* NOTE: workerID is from 0 to pool count - 1 for worker threads, and -1 for the thread calling WorkerPool_Run */
+typedef void (*WorkerPool_JobFunc)(int workerID);
+
+/* A set of threads that sleep until woken up to all work on the same job. */
+struct WorkerPool {
+	int count;   /* Number of worker threads (0 if pool has not been started) */
+	void* mutex; /* Mutex that the job function can use to hand out work between threads */
+	WorkerPool_JobFunc jobFunc;
+	void* done;
+	void* wakeup[WORKERPOOL_MAX_THREADS];
+	int busy, nextID;
+};
+/* Starts the given number of worker threads, which sleep until WorkerPool_Run is called. */
+/* NOTE: Must only be called from the main thread, and at most once per pool. */
+void WorkerPool_Start(struct WorkerPool* pool, int count, WorkerPool_JobFunc jobFunc, int stackSize, const char* name);
+/* Calls the job function on every worker thread and also on the calling thread, */
+/*  then blocks the calling thread until all of the calls have returned. */
+void WorkerPool_Run(struct WorkerPool* pool);
+
 /* Calls SysFonts_Register on each font that is available on this platform. */
 void Platform_LoadSysFonts(void);
 
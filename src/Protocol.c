@@ -352,7 +352,13 @@ static void WoM_Tick(void) {
 struct MapState {
 	struct InflateState inflateState;
 	struct Stream stream;
+#ifdef CC_BUILD_COMPRESSEDWORLD
+	struct WorldSection* blocks;
+	/* Blocks of the section currently being received */
+	BlockRaw section[WORLD_SECTION_SIZE];
+#else
 	BlockRaw* blocks;
+#endif
 	struct GZipHeader gzHeader;
 	cc_uint8 size[MAP_SIZE_LEN];
 	int index, sizeIndex;
@@ -387,15 +393,62 @@ static CC_INLINE void MapState_SkipHeader(struct MapState* m) {
 	m->sizeIndex     = MAP_SIZE_LEN;
 }
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+#define MapState_FreeBlocks(blocks) WorldSections_Free(blocks, map_volume)
+#else
+#define MapState_FreeBlocks(blocks) Mem_Free(blocks)
+#endif
+
 static void FreeMapStates(void) {
-	Mem_Free(map1.blocks);
+	MapState_FreeBlocks(map1.blocks);
 	map1.blocks = NULL;
 #ifdef EXTENDED_BLOCKS
-	Mem_Free(map2.blocks);
+	MapState_FreeBlocks(map2.blocks);
 	map2.blocks = NULL;
 #endif
 }
 
+static void MapState_AllocFailed(struct MapState* m) {
+	Window_ShowDialog("Out of memory", "Not enough free memory to join that map.\nTry joining a different map.");
+	m->allocFailed = true;
+}
+
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/* Decompresses map data into the current section, compressing it into the map blocks once full */
+/* NOTE: This means the uncompressed map never needs to be in memory all at once */
+static cc_result MapState_ReadBlocks(struct MapState* m) {
+	cc_uint32 left, read;
+	cc_result res;
+	int offset;
+
+	while (m->index < map_volume) {
+		offset = m->index & WORLD_SECTION_MASK;
+		left   = min(map_volume - m->index, WORLD_SECTION_SIZE - offset);
+		res    = m->stream.Read(&m->stream, &m->section[offset], left, &read);
+
+		m->index += read;
+		if (read && ((m->index & WORLD_SECTION_MASK) == 0 || m->index == map_volume)) {
+			if (!WorldSections_Pack(&m->blocks[(m->index - 1) >> WORLD_SECTION_SHIFT], m->section, offset + read)) {
+				MapState_AllocFailed(m); return 0;
+			}
+		}
+		if (res || read < left) return res;
+	}
+	return 0;
+}
+#else
+static cc_result MapState_ReadBlocks(struct MapState* m) {
+	cc_uint32 left, read;
+	cc_result res;
+
+	left = map_volume - m->index;
+	res  = m->stream.Read(&m->stream, &m->blocks[m->index], left, &read);
+
+	m->index += read;
+	return res;
+}
+#endif
+
 static cc_result MapState_Read(struct MapState* m) {
 	cc_uint32 left, read;
 	cc_result res;
@@ -415,20 +468,15 @@ static cc_result MapState_Read(struct MapState* m) {
 	if (!map_volume) map_volume = Mem_ReadU32_BE(m->size);
 
 	if (!m->blocks) {
+#ifdef CC_BUILD_COMPRESSEDWORLD
+		m->blocks = WorldSections_Alloc(map_volume);
+#else
 		m->blocks = (BlockRaw*)Mem_TryAlloc(map_volume, 1);
+#endif
 		/* unlikely but possible */
-		if (!m->blocks) {
-			Window_ShowDialog("Out of memory", "Not enough free memory to join that map.\nTry joining a different map.");
-			m->allocFailed = true;
-			return 0;
-		}
+		if (!m->blocks) { MapState_AllocFailed(m); return 0; }
 	}
-
-	left = map_volume - m->index;
-	res  = m->stream.Read(&m->stream, &m->blocks[m->index], left, &read);
-
-	m->index += read;
-	return res;
+	return MapState_ReadBlocks(m);
 }
 
 
@@ -640,7 +688,11 @@ static void Classic_LevelFinalise(cc_uint8* data) {
 	}
 	map2.blocks = NULL;
 #endif
+#ifdef CC_BUILD_COMPRESSEDWORLD
+	World_SetNewSections(map1.blocks, width, height, length);
+#else
 	World_SetNewMap(map1.blocks, width, height, length);
+#endif
 	map1.blocks  = NULL;
 }
 
@@ -1285,8 +1337,8 @@ static void CPE_ExtAddEntity2(cc_uint8* data) {
 static void CPE_BulkBlockUpdate(cc_uint8* data) {
 	cc_int32 indices[BULK_MAX_BLOCKS];
 	BlockID blocks[BULK_MAX_BLOCKS];
-	int index, i;
-	int x, y, z;
+	int index, i, delta, last = 0;
+	int x = 0, y = 0, z = 0;
 	int count = 1 + *data++;
 
 	for (i = 0; i < count; i++) {
@@ -1310,10 +1362,23 @@ static void CPE_BulkBlockUpdate(cc_uint8* data) {
 		data += BULK_MAX_BLOCKS / 4;
 	}
 
+	Game_BeginBlockBatch();
 	for (i = 0; i < count; i++) {
 		index = indices[i];
 		if (index < 0 || index >= World.Volume) continue;
-		World_Unpack(index, x, y, z);
+
+		/* Servers usually send indices in ascending order (e.g. from /draw), so most of the time */
+		/*  coordinates can just be stepped along from the previous index instead of dividing */
+		delta = index - last; last = index;
+		if (delta >= 0 && delta < World.Width) {
+			x += delta;
+			if (x >= World.Width) {
+				x -= World.Width; z++;
+				if (z == World.Length) { z = 0; y++; }
+			}
+		} else {
+			World_Unpack(index, x, y, z);
+		}
 
 #ifdef EXTENDED_BLOCKS
 		Game_UpdateBlock(x, y, z, blocks[i] % BLOCK_COUNT);
@@ -1321,6 +1386,7 @@ static void CPE_BulkBlockUpdate(cc_uint8* data) {
 		Game_UpdateBlock(x, y, z, blocks[i]);
 #endif
 	}
+	Game_EndBlockBatch();
 }
 
 static void CPE_SetTextColor(cc_uint8* data) {
@@ -405,7 +405,16 @@ static void DisconnectInvalidOpcode(cc_uint8 opcode) {
 	Game_Disconnect(&title, &tmp); return;
 }
 
-static cc_bool MPConnection_Tick(struct ScheduledTask2* task) {
+/* NOTE: using a read call that is a multiple of 4096 (appears to?) improve read performance */
+#define NET_READ_SIZE (4096 * 4)
+/* Maximum number of reads from the socket per network tick */
+/* NOTE: Only reading once per tick would limit download speed to ~1 MB/s, */
+/*  which makes joining servers with very large maps take much longer than necessary */
+#define NET_MAX_READS_PER_TICK 16
+
+/* Reads data from the socket and processes all the complete packets received */
+/* Returns whether the read was completely filled (i.e. more data is likely available) */
+static cc_bool MPConnection_ReadPackets(void) {
 	Net_Handler handler;
 	cc_uint8* readEnd;
 	cc_uint8* readCur;
@@ -413,24 +422,21 @@ static cc_bool MPConnection_Tick(struct ScheduledTask2* task) {
 	int i, remaining;
 	cc_result res;
 
-	timeSinceLast += task->interval;
-	if (Server.Disconnected) return true;
-	if (net_connecting) { MPConnection_TickConnect(); return true; }
-
-	/* NOTE: using a read call that is a multiple of 4096 (appears to?) improve read performance */	
-	res = Socket_Read(net_socket, net_readCurrent, 4096 * 4, &read);
+	res = Socket_Read(net_socket, net_readCurrent, NET_READ_SIZE, &read);
 	
 	if (res) {
 		/* 'no data available for non-blocking read' is an expected error */
 		if (res == ReturnCode_SocketInProgess)  res = 0;
 		if (res == ReturnCode_SocketWouldBlock) res = 0;
 
-		if (res) { DisconnectReadFailed(res); return true; }
+		if (res) DisconnectReadFailed(res);
+		return false;
 	} else if (read == 0) {
 		/* recv only returns 0 read when socket is closed.. probably? */
 		/* Over 30 seconds since last packet, connection probably dropped */
 		/* TODO: Should this be checked unconditonally instead of just when read = 0 ? */
-		if (timeSinceLast >= 30.0f) { MPConnection_Disconnect(); return true; }
+		if (timeSinceLast >= 30.0f) MPConnection_Disconnect();
+		return false;
 	} else {
 		readCur       = net_readBuffer;
 		readEnd       = net_readCurrent + read;
@@ -449,7 +455,7 @@ static cc_bool MPConnection_Tick(struct ScheduledTask2* task) {
 
 			if (readCur + Protocol.Sizes[opcode] > readEnd) break;
 			handler = Protocol.Handlers[opcode];
-			if (!handler) { DisconnectInvalidOpcode(opcode); return true; }
+			if (!handler) { DisconnectInvalidOpcode(opcode); return false; }
 
 			lastOpcode = opcode;
 			handler(readCur + 1); /* skip opcode */
@@ -466,6 +472,22 @@ static cc_bool MPConnection_Tick(struct ScheduledTask2* task) {
 		}
 		net_readCurrent = net_readBuffer + remaining;
 	}
+	return read == NET_READ_SIZE;
+}
+
+static cc_bool MPConnection_Tick(struct ScheduledTask2* task) {
+	int i;
+	timeSinceLast += task->interval;
+	if (Server.Disconnected) return true;
+	if (net_connecting) { MPConnection_TickConnect(); return true; }
+
+	for (i = 0; i < NET_MAX_READS_PER_TICK; i++)
+	{
+		if (!MPConnection_ReadPackets()) break;
+		/* A packet might have disconnected (e.g. kicked from the server) */
+		if (Server.Disconnected) return true;
+	}
+	if (Server.Disconnected) return true;
 
 	if (net_writeFailure) {
 		Platform_Log1("Error from send: %e", &net_writeFailure);
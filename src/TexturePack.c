@@ -65,6 +65,7 @@ static void LoadFallbackAtlas(void) {
 struct _Atlas2DData Atlas2D;
 struct _Atlas1DData Atlas1D;
 int TexturePack_ReqID;
+static cc_bool atlas1D_singleTile;
 
 TextureRec Atlas1D_TexRec(TextureLoc texLoc, int uCount, int* index) {
 	TextureRec rec;
@@ -161,6 +162,7 @@ static void Atlas_Update1D(void) {
 	maxTiles         = Atlas2D.RowsCount * ATLAS2D_TILES_PER_ROW;
 
 	Atlas1D.TilesPerAtlas = min(maxTilesPerAtlas, maxTiles);
+	if (atlas1D_singleTile) Atlas1D.TilesPerAtlas = 1;
 	Atlas1D.Count = Math_CeilDiv(maxTiles, Atlas1D.TilesPerAtlas);
 
 	Atlas1D.InvTileSize = 1.0f / Atlas1D.TilesPerAtlas;
@@ -207,6 +209,17 @@ static void Atlas1D_Free(void) {
 	}
 }
 
+void Atlas1D_UseSingleTiles(cc_bool singleTile) {
+	if (singleTile == atlas1D_singleTile) return;
+	atlas1D_singleTile = singleTile;
+	if (!Atlas2D.Bmp.scan0 || Gfx.LostContext) return;
+
+	Atlas1D_Free();
+	Atlas_Update1D();
+	Atlas_Convert2DTo1D();
+	Event_RaiseVoid(&TextureEvents.AtlasChanged);
+}
+
 cc_bool Atlas_TryChange(struct Bitmap* atlas) {
 	static const cc_string terrain = String_FromConst("terrain.png");
 	int tileSize;
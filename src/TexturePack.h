@@ -78,6 +78,9 @@ cc_bool Atlas_TryChange(struct Bitmap* bmp);
 /* index is set to the index of the 1D atlas that the tile is in. */
 TextureRec Atlas1D_TexRec(TextureLoc texLoc, int uCount, int* index);
 void Atlas1D_Bind(int index);
+/* Sets whether each 1D atlas only contains a single tile, recreating the 1D atlases if necessary. */
+/* NOTE: This means textures also repeat along V, but many more 1D atlases have to be bound when rendering. */
+void Atlas1D_UseSingleTiles(cc_bool singleTile);
 
 /* Whether the given URL is in list of accepted URLs. */
 cc_bool TextureUrls_HasAccepted(const cc_string* url);
@@ -10,6 +10,7 @@
 #include "Game.h"
 #include "TexturePack.h"
 #include "Window.h"
+#include "Funcs.h"
 
 struct _WorldData World;
 static char nameBuffer[STRING_SIZE];
@@ -37,13 +38,19 @@ static void GenerateNewUuid(void) {
 	World.Uuid[8] |= 0x80; /* variant 2*/
 }
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+#define World_FreeBlocks(blocks) WorldSections_Free(blocks, World.Volume)
+#else
+#define World_FreeBlocks(blocks) Mem_Free(blocks)
+#endif
+
 void World_Reset(void) {
 #ifdef EXTENDED_BLOCKS
-	if (World.Blocks != World.Blocks2) Mem_Free(World.Blocks2);
+	if (World.Blocks != World.Blocks2) World_FreeBlocks(World.Blocks2);
 	World.Blocks2 = NULL;
 	World.IDMask  = 0xFF;
 #endif
-	Mem_Free(World.Blocks);
+	World_FreeBlocks(World.Blocks);
 	World.Blocks = NULL;
 	String_InitArray(World.Name, nameBuffer);
 
@@ -59,7 +66,22 @@ void World_NewMap(void) {
 	Event_RaiseVoid(&WorldEvents.NewMap);
 }
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
 void World_SetNewMap(BlockRaw* blocks, int width, int height, int length) {
+	struct WorldSection* sections = NULL;
+
+	if (blocks) {
+		sections = WorldSections_Compress(blocks, width * height * length);
+		Mem_Free(blocks);
+		if (!sections) World_OutOfMemory();
+	}
+	World_SetNewSections(sections, width, height, length);
+}
+
+void World_SetNewSections(struct WorldSection* blocks, int width, int height, int length) {
+#else
+void World_SetNewMap(BlockRaw* blocks, int width, int height, int length) {
+#endif
 	/* TODO: TEMP HACK */
 	if (!blocks) { width = 0; height = 0; length = 0; }
 
@@ -101,7 +123,11 @@ CC_NOINLINE void World_SetDimensions(int width, int height, int length) {
 }
 
 #ifdef EXTENDED_BLOCKS
+#ifdef CC_BUILD_COMPRESSEDWORLD
+void World_SetMapUpper(struct WorldSection* blocks) {
+#else
 void World_SetMapUpper(BlockRaw* blocks) {
+#endif
 	World.Blocks2 = blocks;
 	World.IDMask  = 0x3FF;
 }
@@ -113,7 +139,32 @@ void World_OutOfMemory(void) {
 }
 
 
+#if defined CC_BUILD_COMPRESSEDWORLD
 #ifdef EXTENDED_BLOCKS
+static CC_NOINLINE void LazyInitUpper(int i, BlockID block) {
+	struct WorldSection* data = WorldSections_Alloc(World.Volume);
+	if (!data) { World_OutOfMemory(); return; }
+
+	World_SetMapUpper(data);
+	if (!WorldSections_Set(World.Blocks2, i, (BlockRaw)(block >> 8))) World_OutOfMemory();
+}
+#endif
+
+void World_SetBlock(int x, int y, int z, BlockID block) {
+	int i = World_Pack(x, y, z);
+	if (!WorldSections_Set(World.Blocks, i, (BlockRaw)block)) { World_OutOfMemory(); return; }
+
+#ifdef EXTENDED_BLOCKS
+	/* defer allocation of second map array if possible */
+	if (World.Blocks == World.Blocks2) {
+		if (block < 256) return;
+		LazyInitUpper(i, block);
+		return;
+	}
+	if (!WorldSections_Set(World.Blocks2, i, (BlockRaw)(block >> 8))) World_OutOfMemory();
+#endif
+}
+#elif defined EXTENDED_BLOCKS
 static CC_NOINLINE void LazyInitUpper(int i, BlockID block) {
 	BlockRaw* data = (BlockRaw*)Mem_TryAllocCleared(World.Volume, 1);
 	if (!data) { World_OutOfMemory(); return; }
@@ -152,6 +203,189 @@ BlockID World_SafeGetBlock(int x, int y, int z) {
 }
 
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/*########################################################################################################################*
+*-----------------------------------------------------World sections------------------------------------------------------*
+*#########################################################################################################################*/
+/* Number of blocks in the palette of a section (no palette is used for 8 bits per block) */
+#define Section_PaletteSize(bits) ((bits) == 8 ? 0 : (1 << (bits)))
+#define Section_DataSize(bits)    (Section_PaletteSize(bits) + WORLD_SECTION_SIZE * (bits) / 8)
+
+static int Section_GetIndex(const BlockRaw* data, int bits, int i) {
+	int bit = i * bits;
+	return (data[(1 << bits) + (bit >> 3)] >> (bit & 7)) & ((1 << bits) - 1);
+}
+
+/* NOTE: The palette index of the block must be 0 beforehand */
+static void Section_OrIndex(BlockRaw* data, int bits, int i, int index) {
+	int bit = i * bits;
+	data[(1 << bits) + (bit >> 3)] |= index << (bit & 7);
+}
+
+static void Section_SetIndex(BlockRaw* data, int bits, int i, int index) {
+	int bit = i * bits, mask = (1 << bits) - 1;
+	BlockRaw* ptr = &data[(1 << bits) + (bit >> 3)];
+	*ptr = (*ptr & ~(mask << (bit & 7))) | (index << (bit & 7));
+}
+
+struct WorldSection* WorldSections_Alloc(int volume) {
+	/* All zeroes means every block in every section is air */
+	return (struct WorldSection*)Mem_TryAllocCleared(World_SectionsCount(volume), sizeof(struct WorldSection));
+}
+
+void WorldSections_Free(struct WorldSection* sections, int volume) {
+	int i, count = World_SectionsCount(volume);
+	if (!sections) return;
+
+	for (i = 0; i < count; i++) 
+	{
+		Mem_Free(sections[i].data);
+	}
+	Mem_Free(sections);
+}
+
+cc_bool WorldSections_Pack(struct WorldSection* s, const BlockRaw* blocks, int count) {
+	cc_uint8 indices[256];
+	BlockRaw palette[16];
+	int i, used = 0, bits;
+	BlockRaw* data;
+
+	Mem_Free(s->data);
+	s->data = NULL;
+	Mem_Set(indices, 0xFF, sizeof(indices));
+
+	/* Find the distinct blocks, giving up once there are too many for a palette */
+	for (i = 0; i < count && used <= 16; i++) 
+	{
+		if (indices[blocks[i]] != 0xFF) continue;
+		if (used < 16) palette[used] = blocks[i];
+		indices[blocks[i]] = used++;
+	}
+
+	bits = used == 1 ? 0 : (used <= 2 ? 1 : (used <= 4 ? 2 : (used <= 16 ? 4 : 8)));
+	s->bits  = bits;
+	s->used  = bits == 8 ? 0 : used;
+	s->value = blocks[0];
+	if (!bits) return true;
+
+	data = (BlockRaw*)Mem_TryAllocCleared(Section_DataSize(bits), 1);
+	if (!data) { s->bits = 0; return false; }
+	s->data = data;
+
+	if (bits == 8) {
+		Mem_Copy(data, blocks, count);
+		return true;
+	}
+
+	Mem_Copy(data, palette, used);
+	for (i = 0; i < count; i++) 
+	{
+		Section_OrIndex(data, bits, i, indices[blocks[i]]);
+	}
+	return true;
+}
+
+struct WorldSection* WorldSections_Compress(const BlockRaw* blocks, int volume) {
+	struct WorldSection* sections = WorldSections_Alloc(volume);
+	int i, count = World_SectionsCount(volume);
+	if (!sections) return NULL;
+
+	for (i = 0; i < count; i++, blocks += WORLD_SECTION_SIZE, volume -= WORLD_SECTION_SIZE) 
+	{
+		if (WorldSections_Pack(&sections[i], blocks, min(volume, WORLD_SECTION_SIZE))) continue;
+
+		WorldSections_Free(sections, count << WORLD_SECTION_SHIFT);
+		return NULL;
+	}
+	return sections;
+}
+
+/* Increases the number of bits per block used by the given section */
+static cc_bool Section_Grow(struct WorldSection* s, int bits) {
+	BlockRaw* data = (BlockRaw*)Mem_TryAllocCleared(Section_DataSize(bits), 1);
+	int i, index;
+	if (!data) return false;
+
+	if (!s->bits) {
+		/* Every block is palette index 0 */
+		data[0] = s->value;
+		s->used = 1;
+	} else if (bits == 8) {
+		for (i = 0; i < WORLD_SECTION_SIZE; i++) 
+		{
+			data[i] = s->data[Section_GetIndex(s->data, s->bits, i)];
+		}
+		s->used = 0;
+	} else {
+		Mem_Copy(data, s->data, s->used);
+		for (i = 0; i < WORLD_SECTION_SIZE; i++) 
+		{
+			index = Section_GetIndex(s->data, s->bits, i);
+			Section_OrIndex(data, bits, i, index);
+		}
+	}
+
+	Mem_Free(s->data);
+	s->data = data;
+	s->bits = bits;
+	return true;
+}
+
+cc_bool WorldSections_Set(struct WorldSection* sections, int i, BlockRaw block) {
+	struct WorldSection* s = &sections[i >> WORLD_SECTION_SHIFT];
+	int index;
+	i &= WORLD_SECTION_MASK;
+
+	if (s->bits == 0) {
+		if (s->value == block) return true;
+		if (!Section_Grow(s, 1)) return false;
+	} else if (s->bits == 8) {
+		s->data[i] = block;
+		return true;
+	}
+
+	for (index = 0; index < s->used; index++) 
+	{
+		if (s->data[index] == block) break;
+	}
+
+	if (index == s->used) {
+		if (s->used == (1 << s->bits)) {
+			if (!Section_Grow(s, s->bits * 2)) return false;
+			if (s->bits == 8) { s->data[i] = block; return true; }
+		}
+		s->data[s->used++] = block;
+	}
+
+	Section_SetIndex(s->data, s->bits, i, index);
+	return true;
+}
+
+void WorldSections_Read(const struct WorldSection* sections, int i, BlockRaw* dst, int count) {
+	const struct WorldSection* s;
+	int j, offset, n;
+
+	for (; count > 0; i += n, dst += n, count -= n) 
+	{
+		s      = &sections[i >> WORLD_SECTION_SHIFT];
+		offset = i & WORLD_SECTION_MASK;
+		n      = min(count, WORLD_SECTION_SIZE - offset);
+
+		if (s->bits == 0) {
+			Mem_Set(dst, s->value, n);
+		} else if (s->bits == 8) {
+			Mem_Copy(dst, s->data + offset, n);
+		} else {
+			for (j = 0; j < n; j++) 
+			{
+				dst[j] = s->data[Section_GetIndex(s->data, s->bits, offset + j)];
+			}
+		}
+	}
+}
+#endif
+
+
 /*########################################################################################################################*
 *-------------------------------------------------------Environment-------------------------------------------------------*
 *#########################################################################################################################*/
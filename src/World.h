@@ -20,14 +20,44 @@ extern struct IGameComponent World_Component;
 #define World_ChunkPack(cx, cy, cz) (((cz) * World.ChunksY + (cy)) * World.ChunksX + (cx))
 /* TODO: Swap Y and Z? Make sure to update MapRenderer's ResetChunkCache and ClearChunkCache methods! */
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/* Blocks are stored in sections of 4096 consecutive blocks (by packed index), */
+/*  where each section only uses as many bits per block as it needs to */
+#define WORLD_SECTION_SHIFT 12
+#define WORLD_SECTION_SIZE  (1 << WORLD_SECTION_SHIFT)
+#define WORLD_SECTION_MASK  (WORLD_SECTION_SIZE - 1)
+#define World_SectionsCount(volume) (((volume) + WORLD_SECTION_MASK) >> WORLD_SECTION_SHIFT)
+
+struct WorldSection {
+	/* Bits per block (0, 1, 2, 4, or 8). 0 means that every block in the section is 'value' */
+	cc_uint8 bits;
+	/* Number of entries in the palette that are in use */
+	cc_uint8 used;
+	/* Block that every block in the section is, when bits is 0 */
+	BlockRaw value;
+	/* Palette of (1 << bits) blocks, followed by the bit packed palette index of each block */
+	/* NOTE: When bits is 8, there is no palette and this is just the blocks */
+	BlockRaw* data;
+};
+#endif
+
 
 CC_VAR extern struct _WorldData {
+#ifdef CC_BUILD_COMPRESSEDWORLD
+	/* The blocks in the world. (see WorldSections_Get) */
+	struct WorldSection* Blocks;
+#else
 	/* The blocks in the world. */
 	BlockRaw* Blocks;
+#endif
 #ifdef EXTENDED_BLOCKS
 	/* The upper 8 bit of blocks in the world. */
 	/* If only 8 bit blocks are used, equals World_Blocks. */
+#ifdef CC_BUILD_COMPRESSEDWORLD
+	struct WorldSection* Blocks2;
+#else
 	BlockRaw* Blocks2;
+#endif
 #endif
 	/* Volume of the world. */
 	int Volume;
@@ -75,11 +105,60 @@ CC_API void World_SetNewMap(BlockRaw* blocks, int width, int height, int length)
 CC_NOINLINE void World_SetDimensions(int width, int height, int length);
 void World_OutOfMemory(void);
 
+#ifdef CC_BUILD_COMPRESSEDWORLD
+/* Sets blocks array/dimensions of the map and raises WorldEvents.MapLoaded event */
+/* NOTE: World_SetNewMap compresses the given blocks and then calls this */
+void World_SetNewSections(struct WorldSection* blocks, int width, int height, int length);
+
+/* Allocates sections for the given number of blocks, with every block being air */
+struct WorldSection* WorldSections_Alloc(int volume);
+/* Frees the given sections and all their data */
+void WorldSections_Free(struct WorldSection* sections, int volume);
+/* Compresses the given blocks into the given section */
+/* NOTE: count must be WORLD_SECTION_SIZE, except for the last section in the world */
+cc_bool WorldSections_Pack(struct WorldSection* section, const BlockRaw* blocks, int count);
+/* Allocates sections and compresses all the given blocks into them */
+/* Returns NULL if out of memory */
+struct WorldSection* WorldSections_Compress(const BlockRaw* blocks, int volume);
+/* Changes the block at the given index */
+/* Returns false if out of memory */
+cc_bool WorldSections_Set(struct WorldSection* sections, int i, BlockRaw block);
+/* Decompresses count blocks starting at the given index into dst */
+void WorldSections_Read(const struct WorldSection* sections, int i, BlockRaw* dst, int count);
+
+/* Returns the block at the given index */
+/* NOTE: Does NOT check that the index is inside the map. */
+/* NOTE: Sections may be reallocated when changed, so must not be read while being changed on another thread. */
+static CC_INLINE BlockRaw WorldSections_Get(const struct WorldSection* sections, int i) {
+	const struct WorldSection* s = &sections[i >> WORLD_SECTION_SHIFT];
+	int bits = s->bits, bit;
+	i &= WORLD_SECTION_MASK;
+
+	if (bits == 0) return s->value;
+	if (bits == 8) return s->data[i];
+
+	bit = i * bits;
+	return s->data[(s->data[(1 << bits) + (bit >> 3)] >> (bit & 7)) & ((1 << bits) - 1)];
+}
+
+#define World_GetLowerBlock(idx) WorldSections_Get(World.Blocks,  idx)
+#define World_GetUpperBlock(idx) WorldSections_Get(World.Blocks2, idx)
+#else
+/* Returns the lower 8 bits of the block at the given index */
+#define World_GetLowerBlock(idx) World.Blocks[idx]
+/* Returns the upper 8 bits of the block at the given index */
+#define World_GetUpperBlock(idx) World.Blocks2[idx]
+#endif
+
 #ifdef EXTENDED_BLOCKS
 /* Sets World.Blocks2 and updates internal state for more than 256 blocks. */
+#ifdef CC_BUILD_COMPRESSEDWORLD
+void World_SetMapUpper(struct WorldSection* blocks);
+#else
 void World_SetMapUpper(BlockRaw* blocks);
+#endif
 
-#define World_GetRawBlock(idx) ((World.Blocks[idx] | (World.Blocks2[idx] << 8)) & World.IDMask)
+#define World_GetRawBlock(idx) ((World_GetLowerBlock(idx) | (World_GetUpperBlock(idx) << 8)) & World.IDMask)
 
 /* Gets the block at the given coordinates. */
 /* NOTE: Does NOT check that the coordinates are inside the map. */
@@ -88,8 +167,8 @@ static CC_INLINE BlockID World_GetBlock(int x, int y, int z) {
 	return (BlockID)World_GetRawBlock(i);
 }
 #else
-#define World_GetBlock(x, y, z) World.Blocks[World_Pack(x, y, z)]
-#define World_GetRawBlock(idx)  World.Blocks[idx]
+#define World_GetBlock(x, y, z) World_GetLowerBlock(World_Pack(x, y, z))
+#define World_GetRawBlock(idx)  World_GetLowerBlock(idx)
 #endif
 
 /* If Y is above the map, returns BLOCK_AIR. */
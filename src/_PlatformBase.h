@@ -631,3 +631,72 @@ void Waitable_Wait(void* handle) {
 void Waitable_WaitFor(void* handle, cc_uint32 milliseconds) {
 }
 #endif
+
+
+/*########################################################################################################################*
+*-------------------------------------------------------Worker pool-------------------------------------------------------*
+*#########################################################################################################################*/
+/* Thread_StartFunc has no argument, so the pool being started is handed off to each new thread through this */
+static struct WorkerPool* startingPool;
+
+static void WorkerPool_Loop(void) {
+	struct WorkerPool* pool = startingPool;
+	int workerID = pool->nextID++;
+	void* wakeup = pool->wakeup[workerID];
+	cc_bool lastWorker;
+	/* Let WorkerPool_Start know that startingPool can be reused */
+	Waitable_Signal(pool->done);
+
+	for (;;)
+	{
+		Waitable_Wait(wakeup);
+		pool->jobFunc(workerID);
+
+		Mutex_Lock(pool->mutex);
+		{
+			lastWorker = --pool->busy == 0;
+		}
+		Mutex_Unlock(pool->mutex);
+		if (lastWorker) Waitable_Signal(pool->done);
+	}
+}
+
+void WorkerPool_Start(struct WorkerPool* pool, int count, WorkerPool_JobFunc jobFunc, int stackSize, const char* name) {
+	void* thread;
+	int i;
+	pool->jobFunc = jobFunc;
+	pool->mutex   = Mutex_Create(name);
+	pool->done    = Waitable_Create(name);
+
+#ifdef CC_NO_THREADING
+	count = 0;
+#endif
+	if (count > WORKERPOOL_MAX_THREADS) count = WORKERPOOL_MAX_THREADS;
+
+	for (i = 0; i < count; i++)
+	{
+		pool->wakeup[i] = Waitable_Create(name);
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		startingPool = pool;
+		Thread_Run(&thread, WorkerPool_Loop, stackSize, name);
+		Thread_Detach(thread);
+		Waitable_Wait(pool->done);
+	}
+	pool->count = count;
+}
+
+void WorkerPool_Run(struct WorkerPool* pool) {
+	int i;
+	pool->busy = pool->count;
+	for (i = 0; i < pool->count; i++)
+	{
+		Waitable_Signal(pool->wakeup[i]);
+	}
+
+	/* Calling thread does a share of the work too while waiting */
+	pool->jobFunc(-1);
+	if (pool->count) Waitable_Wait(pool->done);
+}